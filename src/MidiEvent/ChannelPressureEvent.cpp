@@ -44,7 +44,7 @@ QByteArray ChannelPressureEvent::save() {
 }
 
 ProtocolEntry *ChannelPressureEvent::copy() {
-    return new ChannelPressureEvent(*this);
+    return new (file()) ChannelPressureEvent(*this);
 }
 
 void ChannelPressureEvent::reloadState(ProtocolEntry *entry) {
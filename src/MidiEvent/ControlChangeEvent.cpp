@@ -49,7 +49,7 @@ QByteArray ControlChangeEvent::save() {
 }
 
 ProtocolEntry *ControlChangeEvent::copy() {
-    return new ControlChangeEvent(*this);
+    return new (file()) ControlChangeEvent(*this);
 }
 
 void ControlChangeEvent::reloadState(ProtocolEntry *entry) {
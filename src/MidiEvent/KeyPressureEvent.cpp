@@ -47,7 +47,7 @@ QByteArray KeyPressureEvent::save() {
 }
 
 ProtocolEntry *KeyPressureEvent::copy() {
-    return new KeyPressureEvent(*this);
+    return new (file()) KeyPressureEvent(*this);
 }
 
 void KeyPressureEvent::reloadState(ProtocolEntry *entry) {
@@ -53,7 +53,7 @@ QByteArray KeySignatureEvent::save() {
 }
 
 ProtocolEntry *KeySignatureEvent::copy() {
-    return new KeySignatureEvent(*this);
+    return new (file()) KeySignatureEvent(*this);
 }
 
 void KeySignatureEvent::reloadState(ProtocolEntry *entry) {
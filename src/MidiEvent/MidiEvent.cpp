@@ -37,20 +37,20 @@
 #include <QByteArray>
 #include <QStringDecoder>
 #include <QSettings>
+#include <cstring>
 #include <uchardet.h>
 
+#include "../midi/MidiByteReader.h"
 #include "../midi/MidiChannel.h"
+#include "../midi/MidiEventArena.h"
+#include "../midi/MidiParseContext.h"
 
-quint8 MidiEvent::_startByte = 0;
 EventWidget *MidiEvent::_eventWidget = 0;
 
-// File-level encoding detection state
-static QByteArray s_accumulatedTextData;
-static QString s_cachedEncoding;
-
 void MidiEvent::resetTextEncodingCache() {
-    s_accumulatedTextData.clear();
-    s_cachedEncoding.clear();
+    MidiParseContext *context = MidiParseContext::current();
+    context->accumulatedTextData()->clear();
+    context->cachedEncoding()->clear();
 }
 
 MidiEvent::MidiEvent(int channel, MidiTrack *track)
@@ -73,7 +73,38 @@ MidiEvent::MidiEvent(MidiEvent &other)
     _tempID = other._tempID;
 }
 
-MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEvent, MidiTrack *track, quint8 startByte, quint8 secondByte) {
+void *MidiEvent::operator new(std::size_t size) {
+    return MidiEventArena::allocate(size, 0);
+}
+
+void *MidiEvent::operator new(std::size_t size, MidiFile *file) {
+    return MidiEventArena::allocate(size, file ? file->eventArena() : 0);
+}
+
+void MidiEvent::operator delete(void *ptr) {
+    MidiEventArena::deallocate(ptr);
+}
+
+void MidiEvent::operator delete(void *ptr, MidiFile *file) {
+    Q_UNUSED(file);
+    MidiEventArena::deallocate(ptr);
+}
+
+MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEvent, MidiTrack *track) {
+    if (!content->device()) {
+        *ok = false;
+        return 0;
+    }
+
+    // decode from the bytes left on the device and skip what was consumed
+    QByteArray data = content->device()->peek(content->device()->bytesAvailable());
+    MidiByteReader reader(data.constData(), data.size());
+    MidiEvent *event = loadMidiEvent(&reader, ok, endEvent, track);
+    content->skipRawData(reader.pos());
+    return event;
+}
+
+MidiEvent *MidiEvent::loadMidiEvent(MidiByteReader *content, bool *ok, bool *endEvent, MidiTrack *track, quint8 startByte, quint8 secondByte) {
     // first try to load the event. If this does not work try to use
     // old first byte as new first byte. This is implemented in the end of this
     // method using recursive calls.
@@ -84,14 +115,16 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
 
     quint8 tempByte;
 
-    quint8 prevStartByte = _startByte;
+    // running status and text encoding detection of the current track
+    MidiParseContext *context = MidiParseContext::current();
+    quint8 prevStartByte = context->runningStatus();
 
     if (!startByte) {
-        (*content) >> tempByte;
+        tempByte = content->readByte();
     } else {
         tempByte = startByte;
     }
-    _startByte = tempByte;
+    context->setRunningStatus(tempByte);
 
     int channel = tempByte & 0x0F;
 
@@ -104,7 +137,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0x80: {
             // Note Off
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
@@ -114,7 +147,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                 return 0;
             }
             // skip byte (velocity)
-            (*content) >> tempByte;
+            tempByte = content->readByte();
 
             OffEvent *event = new OffEvent(channel, 127 - note, track);
             *ok = true;
@@ -124,7 +157,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0x90: {
             // Note On
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
@@ -133,7 +166,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                 *ok = false;
                 return 0;
             }
-            (*content) >> tempByte;
+            tempByte = content->readByte();
             int velocity = tempByte;
             *ok = true;
 
@@ -149,7 +182,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0xA0: {
             // Key Pressure
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
@@ -158,7 +191,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                 *ok = false;
                 return 0;
             }
-            (*content) >> tempByte;
+            tempByte = content->readByte();
             int value = tempByte;
 
             *ok = true;
@@ -169,12 +202,12 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0xB0: {
             // Controller
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
             int control = tempByte;
-            (*content) >> tempByte;
+            tempByte = content->readByte();
             int value = tempByte;
             *ok = true;
             return new ControlChangeEvent(channel, control, value, track);
@@ -183,7 +216,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0xC0: {
             // programm change
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
@@ -194,7 +227,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0xD0: {
             // Key Pressure
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
@@ -208,12 +241,12 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         case 0xE0: {
             // Pitch Wheel
             if (!startByte) {
-                (*content) >> tempByte;
+                tempByte = content->readByte();
             } else {
                 tempByte = secondByte;
             }
             quint8 first = tempByte;
-            (*content) >> tempByte;
+            tempByte = content->readByte();
             quint8 second = tempByte;
 
             int value = (second << 7) | first;
@@ -230,17 +263,15 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
             switch (tempByte & 0x0F) {
                 case 0x00: {
                     // SysEx
-                    QByteArray array;
-                    while (tempByte != 0xF7) {
-                        if (content->atEnd()) {
-                            *ok = false;
-                            return nullptr;
-                        }
-                        (*content) >> tempByte;
-                        if (tempByte != 0xF7) {
-                            array.append((char) tempByte);
-                        }
+                    const char *start = content->current();
+                    const void *end = std::memchr(start, 0xF7, content->bytesLeft());
+                    if (!end) {
+                        content->seek(content->size());
+                        *ok = false;
+                        return nullptr;
                     }
+                    QByteArray array = content->readBytes(static_cast<const char *>(end) - start);
+                    content->readByte(); // 0xF7
                     *ok = true;
                     return new SysExEvent(channel, array, track);
                 }
@@ -248,7 +279,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                 case 0x0F: {
                     // MetaEvent
                     if (!startByte) {
-                        (*content) >> tempByte;
+                        tempByte = content->readByte();
                     } else {
                         tempByte = secondByte;
                     }
@@ -260,41 +291,39 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                             //	*ok = false;
                             //	return 0;
                             //}
-                            quint32 value;
-                            (*content) >> value;
+                            quint32 value = content->readUInt32();
                             // Mask off the length byte (MSB) to get the 3-byte tempo value
                             value &= 0x00FFFFFF;
                             return new TempoChangeEvent(17, (int) value, track);
                         }
                         case 0x58: {
                             // TimeSignature
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             if (tempByte != 4) {
                                 *ok = false;
                                 return 0;
                             }
 
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             int num = (int) tempByte;
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             int denom = (int) tempByte;
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             int metronome = (int) tempByte;
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             int num32 = (int) tempByte;
                             return new TimeSignatureEvent(18, num, denom, metronome, num32, track);
                         }
                         case 0x59: {
                             // keysignature
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             if (tempByte != 2) {
                                 *ok = false;
                                 return 0;
                             }
-                            qint8 t;
-                            (*content) >> t;
+                            qint8 t = (qint8) content->readByte();
                             int tonality = (int) t;
-                            (*content) >> tempByte;
+                            tempByte = content->readByte();
                             bool minor = true;
                             if (tempByte == 0) {
                                 minor = false;
@@ -313,7 +342,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                                 // read type
                                 TextEvent *textEvent = new TextEvent(channel, track);
                                 textEvent->setType(tempByte);
-                                uint length = MidiFile::variableLengthvalue(content);
+                                uint length = content->variableLengthValue();
 
                                 // Safety check: prevent unreasonably large text events that could cause memory issues
                                 if (length > 65535) { // 64KB limit for text events
@@ -329,20 +358,14 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                                     return textEvent;
                                 }
 
-                                // Use QByteArray for safe dynamic memory management
-                                QByteArray textData;
-                                textData.reserve(length);
-
-                                for (uint i = 0; i < length; i++) {
-                                    // Check if stream has ended unexpectedly
-                                    if (content->atEnd()) {
-                                        delete textEvent;
-                                        *ok = false;
-                                        return 0;
-                                    }
-                                    (*content) >> tempByte;
-                                    textData.append((char) tempByte);
+                                // Check if the track ends unexpectedly
+                                if (content->bytesLeft() < (qint64) length) {
+                                    content->seek(content->size());
+                                    delete textEvent;
+                                    *ok = false;
+                                    return 0;
                                 }
+                                QByteArray textData = content->readBytes(length);
 
                                 // Remove terminator null bytes which cause text truncation
                                 // and render as "[]" boxes in Windows UI
@@ -363,14 +386,15 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                                     if (fallback == "Auto-Detect") {
                                         // Accumulate non-UTF-8 bytes across events for
                                         // better statistical detection accuracy
-                                        s_accumulatedTextData.append(textData);
+                                        QByteArray *accumulatedTextData = context->accumulatedTextData();
+                                        accumulatedTextData->append(textData);
                                         
                                         uchardet_t ud = uchardet_new();
-                                        uchardet_handle_data(ud, s_accumulatedTextData.constData(), s_accumulatedTextData.size());
+                                        uchardet_handle_data(ud, accumulatedTextData->constData(), accumulatedTextData->size());
                                         uchardet_data_end(ud);
                                         const char *charset = uchardet_get_charset(ud);
                                         if (charset && charset[0] != '\0') {
-                                            s_cachedEncoding = QString::fromUtf8(charset);
+                                            *context->cachedEncoding() = QString::fromUtf8(charset);
                                         }
                                         uchardet_delete(ud);
                                         
@@ -399,7 +423,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                                             {"x-mac-cyrillic","windows-1251"},
                                         };
                                         
-                                        fallback = encodingMap.value(s_cachedEncoding, s_cachedEncoding);
+                                        fallback = encodingMap.value(*context->cachedEncoding(), *context->cachedEncoding());
                                         
                                         
                                         // Heuristic: if uchardet returns a single-byte encoding,
@@ -479,7 +503,7 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                                 int typeByte = ((char) tempByte);
 
                                 // read length
-                                int length = MidiFile::variableLengthvalue(content);
+                                int length = content->variableLengthValue();
 
                                 // Safety check for unknown events
                                 if (length < 0) {
@@ -494,16 +518,12 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
                                 }
 
                                 // content
-                                QByteArray array;
-                                array.reserve(length);
-                                for (int i = 0; i < length; i++) {
-                                    if (content->atEnd()) {
-                                        *ok = false;
-                                        return 0;
-                                    }
-                                    (*content) >> tempByte;
-                                    array.append((char) tempByte);
+                                if (content->bytesLeft() < length) {
+                                    content->seek(content->size());
+                                    *ok = false;
+                                    return 0;
                                 }
+                                QByteArray array = content->readBytes(length);
                                 *ok = true;
                                 return new UnknownEvent(channel, typeByte, array, track);
                             }
@@ -526,14 +546,18 @@ MidiEvent *MidiEvent::loadMidiEvent(QDataStream *content, bool *ok, bool *endEve
         *ok = false;
         return nullptr;
     }
-    _startByte = prevStartByte;
-    return loadMidiEvent(content, ok, endEvent, track, _startByte, tempByte);
+    context->setRunningStatus(prevStartByte);
+    return loadMidiEvent(content, ok, endEvent, track, prevStartByte, tempByte);
 }
 
 void MidiEvent::setTrack(MidiTrack *track, bool toProtocol) {
     ProtocolEntry *toCopy = copy();
 
     _track = track;
+    if (midiFile) {
+        midiFile->invalidateTrackIndex(numChannel);
+        midiFile->channel(channel())->invalidateNotes();
+    }
     if (toProtocol) {
         protocol(toCopy, this);
     } else {
@@ -611,6 +635,12 @@ int MidiEvent::midiTime() {
 
 void MidiEvent::setFile(MidiFile *f) {
     midiFile = f;
+
+    // heap events added to a file are destroyed with it, also when only
+    // its undo history still refers to them
+    if (f && f->eventArena()) {
+        f->eventArena()->own(dynamic_cast<void *>(this));
+    }
 }
 
 MidiFile *MidiEvent::file() {
@@ -628,7 +658,7 @@ void MidiEvent::draw(QPainter *p, QColor c) {
 }
 
 ProtocolEntry *MidiEvent::copy() {
-    return new MidiEvent(*this);
+    return new (file()) MidiEvent(*this);
 }
 
 void MidiEvent::reloadState(ProtocolEntry *entry) {
@@ -636,6 +666,10 @@ void MidiEvent::reloadState(ProtocolEntry *entry) {
     if (!other) {
         return;
     }
+    if (_track != other->_track) {
+        file()->invalidateTrackIndex(numChannel);
+        file()->invalidateTrackIndex(other->numChannel);
+    }
     _track = other->_track;
     file()->channelEvents(numChannel)->remove(timePos, this);
     numChannel = other->numChannel;
@@ -24,6 +24,9 @@
 #include "../gui/GraphicObject.h"
 #include "../protocol/ProtocolEntry.h"
 
+// Standard includes
+#include <cstddef>
+
 // Forward declarations
 class MidiFile;
 class QSpinBox;
@@ -31,6 +34,7 @@ class QLabel;
 class QWidget;
 class EventWidget;
 class MidiTrack;
+class MidiByteReader;
 
 /**
  * \class MidiEvent
@@ -67,8 +71,35 @@ public:
     MidiEvent(MidiEvent &other);
 
     /**
-     * \brief Loads a MIDI event from a data stream.
-     * \param content The data stream to read from
+     * \brief Allocates an event through MidiEventArena.
+     *
+     * The event goes into the arena of the MidiEventArena::Scope active on
+     * the calling thread, or onto the heap.
+     */
+    static void *operator new(std::size_t size);
+
+    /**
+     * \brief Allocates an event for a file.
+     *
+     * The event goes into the arena of the MidiEventArena::Scope active on
+     * the calling thread, or into the event arena of file (see
+     * MidiFile::eventArena()).
+     */
+    static void *operator new(std::size_t size, MidiFile *file);
+
+    /**
+     * \brief Frees an event allocated by one of the operators above.
+     */
+    static void operator delete(void *ptr);
+
+    /**
+     * \brief Frees an event whose constructor threw.
+     */
+    static void operator delete(void *ptr, MidiFile *file);
+
+    /**
+     * \brief Loads a MIDI event from a byte span.
+     * \param content The reader positioned at the event's status byte
      * \param ok Pointer to bool indicating success/failure
      * \param endEvent Pointer to bool indicating if this is an end event
      * \param track The MIDI track this event belongs to
@@ -76,10 +107,24 @@ public:
      * \param secondByte Optional second byte for parsing
      * \return Pointer to the loaded MidiEvent, or nullptr on failure
      */
-    static MidiEvent *loadMidiEvent(QDataStream *content,
+    static MidiEvent *loadMidiEvent(MidiByteReader *content,
                                     bool *ok, bool *endEvent, MidiTrack *track, quint8 startByte = 0,
                                     quint8 secondByte = 0);
 
+    /**
+     * \brief Loads a MIDI event from a data stream.
+     *
+     * Convenience overload for single messages; decodes the bytes left on
+     * the stream's device with the byte span loader.
+     * \param content The data stream to read from
+     * \param ok Pointer to bool indicating success/failure
+     * \param endEvent Pointer to bool indicating if this is an end event
+     * \param track The MIDI track this event belongs to
+     * \return Pointer to the loaded MidiEvent, or nullptr on failure
+     */
+    static MidiEvent *loadMidiEvent(QDataStream *content,
+                                    bool *ok, bool *endEvent, MidiTrack *track);
+
     /**
      * \brief Gets the global event widget instance.
      * \return Pointer to the EventWidget used for editing events
@@ -150,7 +195,7 @@ public:
     int temporaryRecordID();
 
     /**
-     * \brief Resets the text encoding detection cache.
+     * \brief Resets the text encoding detection cache of the current MidiParseContext.
      * Call this before loading a new MIDI file so that encoding
      * detection from a previously loaded file does not interfere.
      */
@@ -161,10 +206,11 @@ public:
 protected:
     int numChannel, timePos;
     MidiFile *midiFile;
-    static quint8 _startByte;
     static EventWidget *_eventWidget;
     MidiTrack *_track;
     int _tempID;
+
+    friend class EventEditBatch;
 };
 
 #endif // MIDIEVENT_H_
@@ -20,6 +20,9 @@
 
 #include "OffEvent.h"
 
+#include "../midi/MidiChannel.h"
+#include "../midi/MidiFile.h"
+
 NoteOnEvent::NoteOnEvent(int note, int velocity, int ch, MidiTrack *track)
     : OnEvent(ch, track) {
     _note = note;
@@ -55,6 +58,9 @@ void NoteOnEvent::setVelocity(int v, bool toProtocol) {
         v = 127;
     }
     _velocity = v;
+    if (file()) {
+        file()->channel(channel())->invalidateNotes();
+    }
     if (toProtocol) {
         protocol(toCopy, this);
     } else {
@@ -72,6 +78,9 @@ void NoteOnEvent::setNote(int n, bool toProtocol) {
         toCopy = copy();
     }
     _note = n;
+    if (file()) {
+        file()->channel(channel())->invalidateNotes();
+    }
     if (toProtocol) {
         protocol(toCopy, this);
     } else {
@@ -80,7 +89,7 @@ void NoteOnEvent::setNote(int n, bool toProtocol) {
 }
 
 ProtocolEntry *NoteOnEvent::copy() {
-    return new NoteOnEvent(*this);
+    return new (file()) NoteOnEvent(*this);
 }
 
 void NoteOnEvent::reloadState(ProtocolEntry *entry) {
@@ -92,6 +101,9 @@ void NoteOnEvent::reloadState(ProtocolEntry *entry) {
 
     _note = other->_note;
     _velocity = other->_velocity;
+    if (file()) {
+        file()->channel(channel())->invalidateNotes();
+    }
 }
 
 QString NoteOnEvent::toMessage() {
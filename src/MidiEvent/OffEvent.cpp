@@ -18,14 +18,13 @@
 
 #include "OffEvent.h"
 #include "OnEvent.h"
-
-QMultiMap<int, OnEvent *> *OffEvent::onEvents = new QMultiMap<int, OnEvent *>();
+#include "../midi/MidiParseContext.h"
 
 OffEvent::OffEvent(int ch, int l, MidiTrack *track)
     : MidiEvent(ch, track) {
     _line = l;
     _onEvent = 0;
-    QList<OnEvent *> eventsToClose = onEvents->values(line());
+    QList<OnEvent *> eventsToClose = MidiParseContext::current()->openOnEvents()->values(line());
     for (int i = 0; i < eventsToClose.length(); i++) {
         if (eventsToClose.at(i)->channel() == channel()) {
             setOnEvent(eventsToClose.at(i));
@@ -38,11 +37,11 @@ OffEvent::OffEvent(int ch, int l, MidiTrack *track)
 }
 
 QList<OnEvent *> OffEvent::corruptedOnEvents() {
-    return onEvents->values();
+    return MidiParseContext::current()->openOnEvents()->values();
 }
 
 void OffEvent::removeOnEvent(OnEvent *event) {
-    onEvents->remove(event->line(), event);
+    MidiParseContext::current()->openOnEvents()->remove(event->line(), event);
     /*
 	for(int j = 0; j<eventsToClose.length(); j++){
 		if(i!=j){
@@ -71,11 +70,11 @@ void OffEvent::setMidiTime(int t, bool toProtocol) {
 }
 
 void OffEvent::enterOnEvent(OnEvent *event) {
-    onEvents->insert(event->line(), event);
+    MidiParseContext::current()->openOnEvents()->insert(event->line(), event);
 }
 
 void OffEvent::clearOnEvents() {
-    onEvents->clear();
+    MidiParseContext::current()->openOnEvents()->clear();
 }
 
 void OffEvent::draw(QPainter *p, QColor c) {
@@ -85,7 +84,7 @@ void OffEvent::draw(QPainter *p, QColor c) {
 }
 
 ProtocolEntry *OffEvent::copy() {
-    return new OffEvent(*this);
+    return new (file()) OffEvent(*this);
 }
 
 void OffEvent::reloadState(ProtocolEntry *entry) {
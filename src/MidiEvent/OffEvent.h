@@ -40,9 +40,10 @@ class OnEvent;
  * - Line-based organization for display
  * - Integration with the MIDI file structure
  *
- * The class uses a static system to track OnEvents that haven't been paired
- * with their corresponding OffEvents, helping to identify and resolve
- * corrupted or incomplete event pairs.
+ * OnEvents that haven't been paired with their corresponding OffEvents are
+ * tracked in the current MidiParseContext, helping to identify and resolve
+ * corrupted or incomplete event pairs. When an OffEvent is created, it
+ * searches for its OnEvent there and removes it.
  */
 class OffEvent : public MidiEvent {
 public:
@@ -72,7 +73,7 @@ public:
      */
     OnEvent *onEvent();
 
-    // === Static OnEvent Management ===
+    // === Static OnEvent Management (current MidiParseContext) ===
 
     /**
      * \brief Registers an OnEvent as waiting for its OffEvent.
@@ -153,14 +154,6 @@ protected:
     /** \brief Pointer to the corresponding on event */
     OnEvent *_onEvent;
 
-    /**
-     * \brief Static map of OnEvents waiting for their OffEvents.
-     *
-     * Saves all opened and not closed OnEvents. When an OffEvent is created,
-     * it searches for its OnEvent in this map and removes it from the map.
-     */
-    static QMultiMap<int, OnEvent *> *onEvents;
-
     /**
      * \brief The display line for this event.
      *
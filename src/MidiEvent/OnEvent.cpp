@@ -44,7 +44,7 @@ OffEvent *OnEvent::offEvent() {
 }
 
 ProtocolEntry *OnEvent::copy() {
-    return new OnEvent(*this);
+    return new (file()) OnEvent(*this);
 }
 
 void OnEvent::reloadState(ProtocolEntry *entry) {
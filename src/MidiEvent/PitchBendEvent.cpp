@@ -47,7 +47,7 @@ QByteArray PitchBendEvent::save() {
 }
 
 ProtocolEntry *PitchBendEvent::copy() {
-    return new PitchBendEvent(*this);
+    return new (file()) PitchBendEvent(*this);
 }
 
 void PitchBendEvent::reloadState(ProtocolEntry *entry) {
@@ -46,7 +46,7 @@ QByteArray ProgChangeEvent::save() {
 }
 
 ProtocolEntry *ProgChangeEvent::copy() {
-    return new ProgChangeEvent(*this);
+    return new (file()) ProgChangeEvent(*this);
 }
 
 void ProgChangeEvent::reloadState(ProtocolEntry *entry) {
@@ -56,6 +56,7 @@ void ProgChangeEvent::reloadState(ProtocolEntry *entry) {
     }
     MidiEvent::reloadState(entry);
     _program = other->_program;
+    file()->invalidateTrackIndex(channel());
 }
 
 QString ProgChangeEvent::typeString() {
@@ -69,5 +70,6 @@ int ProgChangeEvent::program() {
 void ProgChangeEvent::setProgram(int p) {
     ProtocolEntry *toCopy = copy();
     _program = p;
+    file()->invalidateTrackIndex(channel());
     protocol(toCopy, this);
 }
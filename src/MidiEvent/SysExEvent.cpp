@@ -49,7 +49,7 @@ QString SysExEvent::typeString() {
 }
 
 ProtocolEntry *SysExEvent::copy() {
-    return new SysExEvent(*this);
+    return new (file()) SysExEvent(*this);
 }
 
 void SysExEvent::reloadState(ProtocolEntry *entry) {
@@ -40,7 +40,7 @@ double TempoChangeEvent::msPerTick() {
 }
 
 ProtocolEntry *TempoChangeEvent::copy() {
-    return new TempoChangeEvent(*this);
+    return new (file()) TempoChangeEvent(*this);
 }
 
 void TempoChangeEvent::reloadState(ProtocolEntry *entry) {
@@ -50,6 +50,7 @@ void TempoChangeEvent::reloadState(ProtocolEntry *entry) {
     }
     MidiEvent::reloadState(entry);
     _beats = other->_beats;
+    file()->invalidateTempoMap();
 }
 
 int TempoChangeEvent::line() {
@@ -73,6 +74,7 @@ QByteArray TempoChangeEvent::save() {
 void TempoChangeEvent::setBeats(int beats) {
     ProtocolEntry *toCopy = copy();
     _beats = beats;
+    file()->invalidateTempoMap();
     file()->calcMaxTime();
     protocol(toCopy, this);
 }
@@ -73,7 +73,7 @@ QString TextEvent::typeString() {
 }
 
 ProtocolEntry *TextEvent::copy() {
-    return new TextEvent(*this);
+    return new (file()) TextEvent(*this);
 }
 
 void TextEvent::reloadState(ProtocolEntry *entry) {
@@ -66,7 +66,7 @@ int TimeSignatureEvent::measures(int ticks, int *ticksLeft) {
 }
 
 ProtocolEntry *TimeSignatureEvent::copy() {
-    return new TimeSignatureEvent(*this);
+    return new (file()) TimeSignatureEvent(*this);
 }
 
 void TimeSignatureEvent::reloadState(ProtocolEntry *entry) {
@@ -79,6 +79,7 @@ void TimeSignatureEvent::reloadState(ProtocolEntry *entry) {
     denominator = other->denominator;
     midiClocksPerMetronome = other->midiClocksPerMetronome;
     num32In4th = other->num32In4th;
+    file()->invalidateMeterMap();
 }
 
 int TimeSignatureEvent::line() {
@@ -88,12 +89,14 @@ int TimeSignatureEvent::line() {
 void TimeSignatureEvent::setNumerator(int n) {
     ProtocolEntry *toCopy = copy();
     numerator = n;
+    file()->invalidateMeterMap();
     protocol(toCopy, this);
 }
 
 void TimeSignatureEvent::setDenominator(int d) {
     ProtocolEntry *toCopy = copy();
     denominator = d;
+    file()->invalidateMeterMap();
     protocol(toCopy, this);
 }
 
@@ -60,7 +60,7 @@ void UnknownEvent::reloadState(ProtocolEntry *entry) {
 }
 
 ProtocolEntry *UnknownEvent::copy() {
-    return new UnknownEvent(*this);
+    return new (file()) UnknownEvent(*this);
 }
 
 int UnknownEvent::type() {
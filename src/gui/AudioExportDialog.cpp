@@ -19,8 +19,11 @@
 #ifdef FLUIDSYNTH_SUPPORT
 
 #include "AudioExportDialog.h"
+#include "../midi/AudioExportSchedule.h"
 #include "../midi/FluidSynthEngine.h"
 #include "../midi/MidiFile.h"
+#include "../midi/MidiTrack.h"
+#include "../midi/NoteStore.h"
 #include "../tool/Selection.h"
 #include "../MidiEvent/MidiEvent.h"
 #include "../MidiEvent/NoteOnEvent.h"
@@ -29,15 +32,14 @@
 #include <QBoxLayout>
 #include <QCheckBox>
 #include <QComboBox>
-#include <QCoreApplication>
 #include <QDesktopServices>
 #include <QDir>
+#include <QDoubleSpinBox>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFont>
 #include <QGroupBox>
 #include <QLabel>
-#include <QMessageBox>
 #include <QPalette>
 #include "../midi/MidiChannel.h"
 #include "../MidiEvent/OnEvent.h"
@@ -248,8 +250,53 @@ void AudioExportDialog::buildConfigPage() {
     trimDesc->setWordWrap(true);
     optionsLayout->addWidget(trimDesc);
 
+    QHBoxLayout *stemsLayout = new QHBoxLayout();
+    _stemsCheck = new QCheckBox(tr("Export Stems"), optionsGroup);
+    _stemsCheck->setChecked(false);
+    stemsLayout->addWidget(_stemsCheck);
+    _stemModeCombo = new QComboBox(optionsGroup);
+    _stemModeCombo->addItem(tr("Per Track"));
+    _stemModeCombo->addItem(tr("Per Channel"));
+    _stemModeCombo->setEnabled(false);
+    stemsLayout->addWidget(_stemModeCombo);
+    _stemMixCheck = new QCheckBox(tr("Include Mix"), optionsGroup);
+    _stemMixCheck->setChecked(true);
+    _stemMixCheck->setEnabled(false);
+    stemsLayout->addWidget(_stemMixCheck);
+    stemsLayout->addStretch();
+    optionsLayout->addLayout(stemsLayout);
+
+    QLabel *stemsDesc = new QLabel(tr("Renders every track or channel to its own file, next to the mixed file. Stems are rendered in parallel."), optionsGroup);
+    stemsDesc->setStyleSheet("color: #777; font-size: 11px; margin-left: 20px;");
+    stemsDesc->setWordWrap(true);
+    optionsLayout->addWidget(stemsDesc);
+
+    QHBoxLayout *parallelLayout = new QHBoxLayout();
+    _parallelRenderCheck = new QCheckBox(tr("Parallel Render"), optionsGroup);
+    _parallelRenderCheck->setChecked(false);
+    parallelLayout->addWidget(_parallelRenderCheck);
+    parallelLayout->addWidget(new QLabel(tr("Pre-roll:"), optionsGroup));
+    _preRollSpin = new QDoubleSpinBox(optionsGroup);
+    _preRollSpin->setRange(0.0, 30.0);
+    _preRollSpin->setSingleStep(1.0);
+    _preRollSpin->setDecimals(1);
+    _preRollSpin->setSuffix(tr(" s"));
+    _preRollSpin->setValue(AudioExportSettings().preRollSeconds);
+    _preRollSpin->setEnabled(false);
+    parallelLayout->addWidget(_preRollSpin);
+    parallelLayout->addStretch();
+    optionsLayout->addLayout(parallelLayout);
+
+    QLabel *parallelDesc = new QLabel(tr("Renders long files in 30s slices on all cores. Each slice starts after a pre-roll, so long reverb tails and slow modulation can differ slightly from a normal render; raise the pre-roll if you hear seams."), optionsGroup);
+    parallelDesc->setStyleSheet("color: #777; font-size: 11px; margin-left: 20px;");
+    parallelDesc->setWordWrap(true);
+    optionsLayout->addWidget(parallelDesc);
+
     connect(_reverbTailCheck, &QCheckBox::toggled, this, &AudioExportDialog::updateEstimatedSize);
     connect(_trimSilenceCheck, &QCheckBox::toggled, this, &AudioExportDialog::updateEstimatedSize);
+    connect(_stemsCheck, &QCheckBox::toggled, _stemModeCombo, &QComboBox::setEnabled);
+    connect(_stemsCheck, &QCheckBox::toggled, _stemMixCheck, &QCheckBox::setEnabled);
+    connect(_parallelRenderCheck, &QCheckBox::toggled, _preRollSpin, &QDoubleSpinBox::setEnabled);
 
     // SoundFont list (read-only display)
     FluidSynthEngine *engine = FluidSynthEngine::instance();
@@ -433,6 +480,31 @@ int AudioExportDialog::lastActualEventTick() const {
     return lastTick;
 }
 
+void AudioExportDialog::trimToNotes(int *fromTick, int *toTick) const {
+    int firstNoteTick = -1;
+    int lastNoteTick = -1;
+    for (int i = 0; i < 16; i++) {
+        const NoteStore *notes = _file->channel(i)->noteStore();
+        const int *starts = notes->startTicks();
+        const int *ends = notes->endTicks();
+        int end = *toTick == -1 ? notes->size() : notes->lowerBound(*toTick + 1);
+
+        // the first note starting in the range
+        int first = notes->lowerBound(*fromTick);
+        if (first < end && (firstNoteTick == -1 || starts[first] < firstNoteTick)) {
+            firstNoteTick = starts[first];
+        }
+        // the last note ending in the range; notes ending in it start before its end
+        for (int n = 0; n < end; n++) {
+            if (ends[n] >= *fromTick && (*toTick == -1 || ends[n] <= *toTick) && ends[n] > lastNoteTick) {
+                lastNoteTick = ends[n];
+            }
+        }
+    }
+    if (firstNoteTick != -1) *fromTick = firstNoteTick;
+    if (lastNoteTick != -1) *toTick = lastNoteTick;
+}
+
 // ============================================================================
 // Settings Helpers
 // ============================================================================
@@ -443,6 +515,8 @@ AudioExportSettings AudioExportDialog::currentSettings() const {
     s.rate = _rateCombo->currentData().toInt();
     s.sampleFormat = _bitsCombo->currentData().toString();
     s.includeReverbTail = _reverbTailCheck->isChecked();
+    s.parallelRender = _parallelRenderCheck->isChecked();
+    s.preRollSeconds = _preRollSpin->value();
     return s;
 }
 
@@ -579,24 +653,7 @@ double AudioExportDialog::estimateDurationSeconds() const {
     }
 
     if (_trimSilenceCheck->isChecked()) {
-        int firstNoteTick = -1;
-        int lastNoteTick = -1;
-        for (int i = 0; i < 16; i++) {
-            if (_file->channel(i)->eventMap()->isEmpty()) continue;
-            QMultiMap<int, MidiEvent*>::iterator it = _file->channel(i)->eventMap()->lowerBound(fromTick);
-            while (it != _file->channel(i)->eventMap()->end()) {
-                if (toTick != -1 && it.key() > toTick) break;
-                if (dynamic_cast<NoteOnEvent*>(it.value())) {
-                    if (firstNoteTick == -1 || it.key() < firstNoteTick) firstNoteTick = it.key();
-                }
-                if (OffEvent* off = dynamic_cast<OffEvent*>(it.value())) {
-                    if (lastNoteTick == -1 || it.key() > lastNoteTick) lastNoteTick = it.key();
-                }
-                it++;
-            }
-        }
-        if (firstNoteTick != -1) fromTick = firstNoteTick;
-        if (lastNoteTick != -1) toTick = lastNoteTick;
+        trimToNotes(&fromTick, &toTick);
     }
 
     if (toTick < fromTick) toTick = fromTick;
@@ -631,10 +688,6 @@ void AudioExportDialog::onExportClicked() {
 
     _exportedPath = outputPath;
 
-    // Save a filtered temp MIDI (respects mute/solo)
-    QString tempMidi = QDir::tempPath() + "/MidiEditor_export_" +
-                       QString::number(QCoreApplication::applicationPid()) + ".mid";
-    
     // Handle Range
     int startTick = 0;
     int endTick = lastActualEventTick();
@@ -665,31 +718,48 @@ void AudioExportDialog::onExportClicked() {
     if (startTick < 0) startTick = 0;
 
     if (_trimSilenceCheck->isChecked()) {
-        int firstNoteTick = -1;
-        int lastNoteTick = -1;
-        for (int i = 0; i < 16; i++) {
-            if (_file->channel(i)->eventMap()->isEmpty()) continue;
-            QMultiMap<int, MidiEvent*>::iterator it = _file->channel(i)->eventMap()->lowerBound(startTick);
-            while (it != _file->channel(i)->eventMap()->end()) {
-                if (endTick != -1 && it.key() > endTick) break;
-                if (dynamic_cast<NoteOnEvent*>(it.value())) {
-                    if (firstNoteTick == -1 || it.key() < firstNoteTick) firstNoteTick = it.key();
-                }
-                if (OffEvent* off = dynamic_cast<OffEvent*>(it.value())) {
-                    if (lastNoteTick == -1 || it.key() > lastNoteTick) lastNoteTick = it.key();
-                }
-                it++;
-            }
-        }
-        if (firstNoteTick != -1) startTick = firstNoteTick;
-        if (lastNoteTick != -1) endTick = lastNoteTick;
+        trimToNotes(&startTick, &endTick);
     }
 
     if (endTick < startTick) endTick = startTick;
 
-    if (!_file->saveForExport(tempMidi, startTick, endTick)) {
-        QMessageBox::critical(this, tr("Export Error"), tr("Failed to prepare MIDI data for export."));
-        return;
+    // Snapshot the filtered events (respects mute/solo), so the file can be
+    // edited while the export renders
+    QList<const AudioExportSchedule *> stems;
+    QStringList stemPaths;
+    if (_stemsCheck->isChecked()) {
+        QFileInfo outputInfo(outputPath);
+        QString stemBase = outputInfo.path() + "/" + outputInfo.completeBaseName() + " - ";
+        bool perTrack = _stemModeCombo->currentIndex() == 0;
+        int count = perTrack ? _file->numTracks() : 16;
+        for (int i = 0; i < count; i++) {
+            AudioExportSchedule *stem = new AudioExportSchedule();
+            QString name;
+            if (perTrack) {
+                stem->build(_file, startTick, endTick, _file->track(i));
+                name = _file->track(i)->name();
+            } else {
+                stem->build(_file, startTick, endTick, 0, i);
+                name = tr("Channel %1").arg(i);
+            }
+            if (!stem->hasNotes()) {
+                delete stem;
+                continue;
+            }
+            stems.append(stem);
+            stemPaths.append(stemBase + stemFileName(i, name) + settings.extension());
+        }
+    }
+
+    // without stems the mix is always exported
+    QString mixPath;
+    AudioExportSchedule *schedule = 0;
+    if (stems.isEmpty() || _stemMixCheck->isChecked()) {
+        mixPath = outputPath;
+        if (stems.isEmpty()) {
+            schedule = new AudioExportSchedule();
+            schedule->build(_file, startTick, endTick);
+        }
     }
 
     _exportBtn->setEnabled(false);
@@ -711,12 +781,36 @@ void AudioExportDialog::onExportClicked() {
             this, &AudioExportDialog::onExportCancelled, Qt::QueuedConnection);
 
     // Run export in background thread
-    int totalTicks = (endTick == -1) ? _file->lastEventTick() : (endTick - startTick);
-    QThreadPool::globalInstance()->start([tempMidi, outputPath, settings, totalTicks]() {
-        FluidSynthEngine::instance()->exportAudio(tempMidi, outputPath, settings, totalTicks);
+    QThreadPool::globalInstance()->start([schedule, stems, stemPaths, mixPath, settings]() {
+        if (schedule) {
+            FluidSynthEngine::instance()->exportAudio(schedule, mixPath, settings);
+        } else {
+            // the mix is summed from the stems
+            FluidSynthEngine::instance()->exportStems(stems, stemPaths, mixPath, settings);
+        }
+        delete schedule;
+        qDeleteAll(stems);
     });
 }
 
+QString AudioExportDialog::stemFileName(int number, QString name) const {
+    // characters that are not allowed in file names on any platform
+    static const QString invalid = "\\/:*?\"<>|";
+    for (QChar &c : name) {
+        if (invalid.contains(c) || c < QChar(32)) {
+            c = '_';
+        }
+    }
+    name = name.trimmed();
+
+    // the number keeps stems of equally named tracks apart
+    QString fileName = QString("%1").arg(number, 2, 10, QChar('0'));
+    if (!name.isEmpty()) {
+        fileName += " " + name;
+    }
+    return fileName;
+}
+
 void AudioExportDialog::onExportProgress(int percent) {
     _targetPercent = percent;
     _progressBar->setValue(_targetPercent);
@@ -737,11 +831,6 @@ void AudioExportDialog::onExportFinished(bool success, const QString &path) {
     disconnect(engine, &FluidSynthEngine::exportCancelled,
                this, &AudioExportDialog::onExportCancelled);
 
-    // Clean up temp MIDI
-    QString tempMidi = QDir::tempPath() + "/MidiEditor_export_" +
-                       QString::number(QCoreApplication::applicationPid()) + ".mid";
-    QFile::remove(tempMidi);
-
     _exportedPath = path;
     showCompletionPage(success);
 }
@@ -760,11 +849,6 @@ void AudioExportDialog::onExportCancelled() {
                this, &AudioExportDialog::onExportFinished);
     disconnect(engine, &FluidSynthEngine::exportCancelled,
                this, &AudioExportDialog::onExportCancelled);
-
-    // Clean up temp MIDI
-    QString tempMidi = QDir::tempPath() + "/MidiEditor_export_" +
-                       QString::number(QCoreApplication::applicationPid()) + ".mid";
-    QFile::remove(tempMidi);
 }
 
 void AudioExportDialog::onCancelExport() {
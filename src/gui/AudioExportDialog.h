@@ -28,6 +28,7 @@ class QComboBox;
 class QRadioButton;
 class QSpinBox;
 class QCheckBox;
+class QDoubleSpinBox;
 class QLabel;
 class QPushButton;
 class QProgressBar;
@@ -40,7 +41,7 @@ struct AudioExportSettings;
  *
  * \brief Self-contained dialog for configuring and executing audio export.
  *
- * Provides format, quality, range, and reverb tail options.
+ * Provides format, quality, range, reverb tail and stem options.
  * Handles the full export lifecycle: configuration → progress → completion.
  */
 class AudioExportDialog : public QDialog {
@@ -73,9 +74,11 @@ private:
     void showCompletionPage(bool success);
 
     int lastActualEventTick() const;
+    void trimToNotes(int *fromTick, int *toTick) const;
 
     AudioExportSettings currentSettings() const;
     double estimateDurationSeconds() const;
+    QString stemFileName(int number, QString name) const;
     double estimateFileSize() const;
     QString formatFileSize(double bytes) const;
     QString formatDuration(double seconds) const;
@@ -97,6 +100,11 @@ private:
     QComboBox *_bitsCombo;
     QCheckBox *_reverbTailCheck;
     QCheckBox *_trimSilenceCheck;
+    QCheckBox *_stemsCheck;
+    QComboBox *_stemModeCombo;
+    QCheckBox *_stemMixCheck;
+    QCheckBox *_parallelRenderCheck;
+    QDoubleSpinBox *_preRollSpin;
     QLabel *_soundFontListLabel;
     QLabel *_estimatedSizeLabel;
     QPushButton *_exportBtn;
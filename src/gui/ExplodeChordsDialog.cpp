@@ -178,7 +178,7 @@ void ExplodeChordsDialog::analyzeChords(int &chordCount, int &maxVoices) {
     // If no selection, use all notes on source track
     if (!useSelection) {
         for (int ch = 0; ch < 16; ++ch) {
-            QMultiMap<int, MidiEvent *> *emap = _file->channel(ch)->eventMap();
+            EventMap *emap = _file->channel(ch)->eventMap();
             for (auto it = emap->begin(); it != emap->end(); ++it) {
                 NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(it.value());
                 if (on && on->offEvent() && on->track() == _sourceTrack) {
@@ -119,6 +119,8 @@
 #include "../MidiEvent/TimeSignatureEvent.h"
 #include "../MidiEvent/PitchBendEvent.h"
 #include "../MidiEvent/ProgChangeEvent.h"
+#include "../midi/EventEditBatch.h"
+#include "../midi/MeterMap.h"
 #include "../midi/Metronome.h"
 #include "../midi/MidiChannel.h"
 #include "../midi/MidiFile.h"
@@ -127,6 +129,8 @@
 #include "../midi/MidiPlayer.h"
 #include "../midi/MidiTrack.h"
 #include "../midi/PlayerThread.h"
+#include "../midi/QuantizationGrid.h"
+#include "../midi/TrackEventIndex.h"
 #include "../midi/InstrumentDefinitions.h"
 
 #ifdef FLUIDSYNTH_SUPPORT
@@ -176,6 +180,9 @@ MainWindow::MainWindow(QString initFile)
     bool loudnessOk;
     Metronome::setLoudness(_settings->value("metronome_velocity", 127).toInt(&loudnessOk));
 
+    // memory budget of the undo history in MB, 0 for no limit
+    Protocol::setMemoryBudget(_settings->value("undo_memory_budget_mb", 256).toLongLong() * 1024 * 1024);
+
 #ifdef FLUIDSYNTH_SUPPORT
     FluidSynthEngine::instance()->loadSettings(_settings);
     connect(FluidSynthEngine::instance(), &FluidSynthEngine::engineRestarted, this, [this]() {
@@ -1022,8 +1029,10 @@ void MainWindow::record() {
             // _matrixWidgetContainer->setEnabled(false);
             _trackWidget->setEnabled(false);
             eventWidget()->setEnabled(false);
-            MidiPlayer::play(file);
+            // start the input first, it drops the time bases of earlier
+            // recordings and the player sets the first one of this recording
             MidiInput::startInput();
+            MidiPlayer::play(file);
             connect(MidiPlayer::playerThread(), SIGNAL(playerStopped()), this, SLOT(stop()));
             // Connect playback cursor updates for all platforms (not just Windows)
             // This is essential for the playback cursor to move during playback
@@ -1107,7 +1116,6 @@ void MainWindow::forward() {
     if (!file)
         return;
 
-    QList<TimeSignatureEvent *> *eventlist = new QList<TimeSignatureEvent *>;
     int ticksleft;
     int oldTick = file->cursorTick();
     if (file->pauseTick() >= 0) {
@@ -1117,9 +1125,10 @@ void MainWindow::forward() {
         oldTick = file->tick(MidiPlayer::timeMs());
         stop(true);
     }
-    file->measure(oldTick, oldTick, &eventlist, &ticksleft);
+    MeterMap meters = file->meterMap();
+    meters.measure(oldTick, &ticksleft);
 
-    int newTick = oldTick - ticksleft + eventlist->last()->ticksPerMeasure();
+    int newTick = oldTick - ticksleft + meters.ticksPerMeasure(meters.segmentAtTick(oldTick));
     file->setPauseTick(-1);
     if (newTick <= file->endTick()) {
         file->setCursorTick(newTick);
@@ -1137,7 +1146,6 @@ void MainWindow::back() {
     if (!file)
         return;
 
-    QList<TimeSignatureEvent *> *eventlist = new QList<TimeSignatureEvent *>;
     int ticksleft;
     int oldTick = file->cursorTick();
     if (file->pauseTick() >= 0) {
@@ -1147,14 +1155,15 @@ void MainWindow::back() {
         oldTick = file->tick(MidiPlayer::timeMs());
         stop(true);
     }
-    file->measure(oldTick, oldTick, &eventlist, &ticksleft);
+    MeterMap meters = file->meterMap();
+    meters.measure(oldTick, &ticksleft);
     int newTick = oldTick;
     if (ticksleft > 0) {
         newTick -= ticksleft;
     } else {
-        newTick -= eventlist->last()->ticksPerMeasure();
+        newTick -= meters.ticksPerMeasure(meters.segmentAtTick(oldTick));
     }
-    file->measure(newTick, newTick, &eventlist, &ticksleft);
+    meters.measure(newTick, &ticksleft);
     if (ticksleft > 0) {
         newTick -= ticksleft;
     }
@@ -1586,6 +1595,7 @@ void MainWindow::closeEvent(QCloseEvent *event) {
     _settings->setValue("metronome", Metronome::enabled());
     _settings->setValue("metronome_velocity", Metronome::loudness());
     _settings->setValue("thru", MidiInput::thru());
+    _settings->setValue("undo_memory_budget_mb", Protocol::memoryBudget() / (1024 * 1024));
     _settings->setValue("quantization", _quantizationGrid);
 
 #ifdef FLUIDSYNTH_SUPPORT
@@ -1998,16 +2008,19 @@ void MainWindow::deleteTrack(QAction *action) {
     MidiTrack* track = file->track(num);
     file->protocol()->startNewAction(tr("Remove All Events from Track ") + QString::number(num) + ": " + track->name());
     
+    // the lists are taken before the first removal, so the index is not
+    // updated again for every channel
+    QList<MidiEvent *> trackEvents[19];
+    for (int i = 0; i < 19; i++) {
+        trackEvents[i] = file->trackIndex()->events(track, i);
+    }
     for (int i = 0; i < 19; i++) {
         MidiChannel* ch = file->channel(i);
-        QList<MidiEvent*> events = ch->eventMap()->values();
-        foreach(MidiEvent* event, events) {
-            if (event->track() == track) {
-                if (Selection::instance()->selectedEvents().contains(event)) {
-                    EventTool::deselectEvent(event);
-                }
-                ch->removeEvent(event);
+        foreach(MidiEvent* event, trackEvents[i]) {
+            if (Selection::instance()->selectedEvents().contains(event)) {
+                EventTool::deselectEvent(event);
             }
+            ch->removeEvent(event);
         }
     }
     
@@ -2519,15 +2532,13 @@ void MainWindow::selectAllFromTrack(QAction *action) {
     // Collect events for batch selection
     QList<MidiEvent *> eventsToSelect;
     for (int channel = 0; channel < 16; channel++) {
-        foreach(MidiEvent* e, file->channel(channel)->eventMap()->values()) {
-            if (e->track()->number() == track) {
-                file->channel(e->channel())->setVisible(true);
-
-                // Skip OffEvents
-                OffEvent *offevent = dynamic_cast<OffEvent *>(e);
-                if (!offevent) {
-                    eventsToSelect.append(e);
-                }
+        foreach(MidiEvent* e, file->trackIndex()->events(file->track(track), channel)) {
+            file->channel(e->channel())->setVisible(true);
+
+            // Skip OffEvents
+            OffEvent *offevent = dynamic_cast<OffEvent *>(e);
+            if (!offevent) {
+                eventsToSelect.append(e);
             }
         }
     }
@@ -2562,7 +2573,7 @@ void MainWindow::selectAll() {
             continue;
         }
 
-        const QMultiMap<int, MidiEvent *> *eventMap = file->channel(i)->eventMap();
+        const EventMap *eventMap = file->channel(i)->eventMap();
         foreach(MidiEvent* event, eventMap->values()) {
             // Pre-filter events to avoid redundant checks later
             if (event->track()->hidden()) {
@@ -2650,12 +2661,12 @@ void MainWindow::convertPitchBendToNotes() {
         if (t1 <= t0) continue;
 
         // Gather pitch bend events on this channel within [t0, t1)
-        QMultiMap<int, MidiEvent *> *emap = channel->eventMap();
+        EventMap *emap = channel->eventMap();
 
         // Find last pitch bend value at or before t0
         int startValue = 8192; // neutral
         if (emap && !emap->isEmpty()) {
-            QMultiMap<int, MidiEvent *>::const_iterator it = emap->upperBound(t0);
+            EventMap::const_iterator it = emap->upperBound(t0);
             if (it != emap->begin()) {
                 do {
                     --it;
@@ -2674,7 +2685,7 @@ void MainWindow::convertPitchBendToNotes() {
         QMap<int, int> bendAtTime; // time -> value
 
         if (emap && !emap->isEmpty()) {
-            QMultiMap<int, MidiEvent *>::const_iterator it2 = emap->lowerBound(t0);
+            EventMap::const_iterator it2 = emap->lowerBound(t0);
             while (it2 != emap->end() && it2.key() < t1) {
                 PitchBendEvent *pb = dynamic_cast<PitchBendEvent *>(it2.value());
                 if (pb) {
@@ -2723,7 +2734,7 @@ void MainWindow::convertPitchBendToNotes() {
         // will each remove only the pitch bends within their own time range
         QList<MidiEvent *> removeList;
         if (emap && !emap->isEmpty()) {
-            QMultiMap<int, MidiEvent *>::const_iterator it3 = emap->lowerBound(t0);
+            EventMap::const_iterator it3 = emap->lowerBound(t0);
             while (it3 != emap->end() && it3.key() < t1) {
                 PitchBendEvent *pb = dynamic_cast<PitchBendEvent *>(it3.value());
                 if (pb) {
@@ -2802,7 +2813,7 @@ void MainWindow::explodeChordsToTracks(MidiTrack *sourceTrack) {
     } else {
         // All notes on source track across channels 0..15
         for (int ch = 0; ch < 16; ++ch) {
-            QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
+            EventMap *emap = file->channel(ch)->eventMap();
             for (auto it = emap->begin(); it != emap->end(); ++it) {
                 NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(it.value());
                 if (on && on->offEvent() && on->track() == sourceTrack) {
@@ -2994,7 +3005,7 @@ void MainWindow::splitChannelsToTracks(MidiTrack *sourceTrack) {
     QList<ChannelInfo> activeChannels;
 
     for (int ch = 0; ch < 16; ++ch) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
+        EventMap *emap = file->channel(ch)->eventMap();
         int eventCount = 0;
         int noteCount = 0;
         int prog = -1;
@@ -3068,7 +3079,7 @@ void MainWindow::splitChannelsToTracks(MidiTrack *sourceTrack) {
                 }
 
                 // Collect NoteOn events, group them by preset track name
-                QMultiMap<int, MidiEvent *> *emap = file->channel(info.channel)->eventMap();
+                EventMap *emap = file->channel(info.channel)->eventMap();
                 QMap<QString, QList<NoteOnEvent*> > groupNotes;
                 
                 for (auto it = emap->begin(); it != emap->end(); ++it) {
@@ -3186,7 +3197,7 @@ void MainWindow::splitChannelsToTracks(MidiTrack *sourceTrack) {
         newTracks.append(dst);
 
         // Move all events on this channel from source track to new track
-        QMultiMap<int, MidiEvent *> *emap = file->channel(info.channel)->eventMap();
+        EventMap *emap = file->channel(info.channel)->eventMap();
         QList<MidiEvent *> toMove;
         for (auto it = emap->begin(); it != emap->end(); ++it) {
             if (it.value()->track() == sourceTrack) {
@@ -3222,7 +3233,7 @@ void MainWindow::splitChannelsToTracks(MidiTrack *sourceTrack) {
     if (removeSource) {
         bool sourceEmpty = true;
         for (int ch = 0; ch < 16; ++ch) {
-            QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
+            EventMap *emap = file->channel(ch)->eventMap();
             for (auto it = emap->begin(); it != emap->end(); ++it) {
                 if (it.value()->track() == sourceTrack) {
                     sourceEmpty = false;
@@ -3234,7 +3245,7 @@ void MainWindow::splitChannelsToTracks(MidiTrack *sourceTrack) {
         // Also check meta channel for tempo/time sig events
         // Keep the source track if it has meta events
         if (sourceEmpty) {
-            QMultiMap<int, MidiEvent *> *metaMap = file->channelEvents(17);
+            EventMap *metaMap = file->channelEvents(17);
             if (metaMap) {
                 for (auto it = metaMap->begin(); it != metaMap->end(); ++it) {
                     if (it.value()->track() == sourceTrack) {
@@ -3282,29 +3293,26 @@ void MainWindow::cloneTrack(MidiTrack *source) {
         }
     }
 
-    // Copy events
+    // Copy events; the lists are taken before the first insertion, so the
+    // index is not updated again for every channel
+    QList<MidiEvent *> sourceEvents[19];
     for (int ch = 0; ch < 19; ++ch) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        // Use uniqueKeys to iterate safely
-        QList<int> ticks = emap->uniqueKeys();
-        foreach(int tick, ticks) {
-            QList<MidiEvent *> events = emap->values(tick);
-            foreach(MidiEvent *ev, events) {
-                if (ev->track() == source) {
-                    if (NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev)) {
-                        // For notes, use insertNote to handle OffEvent correctly
-                        if (on->offEvent()) {
-                            file->channel(ch)->insertNote(on->note(), on->midiTime(), on->offEvent()->midiTime(), on->velocity(), newTrack);
-                        }
-                    } else if (!dynamic_cast<OffEvent *>(ev)) {
-                        // For other events (except OffEvents which are handled by insertNote), copy and insert
-                        ProtocolEntry *pe = ev->copy();
-                        MidiEvent *copy = dynamic_cast<MidiEvent *>(pe);
-                        if (copy) {
-                            copy->setTrack(newTrack, false);
-                            file->channel(ch)->insertEvent(copy, tick, false);
-                        }
-                    }
+        sourceEvents[ch] = file->trackIndex()->events(source, ch);
+    }
+    for (int ch = 0; ch < 19; ++ch) {
+        foreach(MidiEvent *ev, sourceEvents[ch]) {
+            if (NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev)) {
+                // For notes, use insertNote to handle OffEvent correctly
+                if (on->offEvent()) {
+                    file->channel(ch)->insertNote(on->note(), on->midiTime(), on->offEvent()->midiTime(), on->velocity(), newTrack);
+                }
+            } else if (!dynamic_cast<OffEvent *>(ev)) {
+                // For other events (except OffEvents which are handled by insertNote), copy and insert
+                ProtocolEntry *pe = ev->copy();
+                MidiEvent *copy = dynamic_cast<MidiEvent *>(pe);
+                if (copy) {
+                    copy->setTrack(newTrack, false);
+                    file->channel(ch)->insertEvent(copy, ev->midiTime(), false);
                 }
             }
         }
@@ -3328,17 +3336,8 @@ void MainWindow::mergeTrack(MidiTrack *source, MidiTrack *destination) {
     Selection::instance()->setSelection(Selection::instance()->selectedEvents());
 
     // Move all events from source to destination
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        QList<int> ticks = emap->uniqueKeys();
-        foreach(int tick, ticks) {
-            QList<MidiEvent *> events = emap->values(tick);
-            foreach(MidiEvent *ev, events) {
-                if (ev->track() == source) {
-                    ev->setTrack(destination, true);
-                }
-            }
-        }
+    foreach(MidiEvent *ev, file->trackIndex()->events(source)) {
+        ev->setTrack(destination, true);
     }
 
     // Remove source track
@@ -3384,24 +3383,19 @@ void MainWindow::moveTrackDown(MidiTrack *track) {
 
 void MainWindow::quantizeTrack(MidiTrack *track) {
     if (!file || !track) return;
-    QList<int> ticks = file->quantization(_quantizationGrid);
+    QuantizationGrid grid(file, _quantizationGrid);
     file->protocol()->startNewAction(tr("Quantize Track"), new QImage(":/run_environment/graphics/tool/quantize.png"));
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        foreach(MidiEvent* e, emap->values()) {
-            if (e->track() == track) {
-                int onTime = e->midiTime();
-                e->setMidiTime(quantize(onTime, ticks));
-                OnEvent *on = dynamic_cast<OnEvent *>(e);
-                if (on) {
-                    MidiEvent *off = on->offEvent();
-                    off->setMidiTime(quantize(off->midiTime(), ticks) - 1);
-                    if (off->midiTime() <= on->midiTime()) {
-                        int idx = ticks.indexOf(off->midiTime() + 1);
-                        if ((idx >= 0) && (ticks.size() > idx + 1)) {
-                            off->setMidiTime(ticks.at(idx + 1) - 1);
-                        }
-                    }
+    foreach(MidiEvent* e, file->trackIndex()->events(track)) {
+        int onTime = e->midiTime();
+        e->setMidiTime(grid.snap(onTime));
+        OnEvent *on = dynamic_cast<OnEvent *>(e);
+        if (on) {
+            MidiEvent *off = on->offEvent();
+            off->setMidiTime(grid.snap(off->midiTime()) - 1);
+            if (off->midiTime() <= on->midiTime() && grid.contains(off->midiTime() + 1)) {
+                int nextTick = grid.next(off->midiTime() + 1);
+                if (nextTick >= 0) {
+                    off->setMidiTime(nextTick - 1);
                 }
             }
         }
@@ -3413,14 +3407,9 @@ void MainWindow::quantizeTrack(MidiTrack *track) {
 void MainWindow::transposeTrack(MidiTrack *track) {
     if (!file || !track) return;
     QList<NoteOnEvent *> events;
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        foreach(MidiEvent* ev, emap->values()) {
-            if (ev->track() == track) {
-                NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev);
-                if (on) events.append(on);
-            }
-        }
+    foreach(MidiEvent* ev, file->trackIndex()->events(track)) {
+        NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev);
+        if (on) events.append(on);
     }
     if (events.isEmpty()) return;
     TransposeDialog *d = new TransposeDialog(events, file, this);
@@ -3431,15 +3420,10 @@ void MainWindow::transposeTrack(MidiTrack *track) {
 void MainWindow::transposeTrackOctaveUp(MidiTrack *track) {
     if (!file || !track) return;
     file->protocol()->startNewAction(tr("Transpose Octave Up"), new QImage(":/run_environment/graphics/tool/transpose_up.png"));
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        foreach(MidiEvent* ev, emap->values()) {
-            if (ev->track() == track) {
-                NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev);
-                if (on) {
-                    on->setNote(on->note() + 12);
-                }
-            }
+    foreach(MidiEvent* ev, file->trackIndex()->events(track)) {
+        NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev);
+        if (on) {
+            on->setNote(on->note() + 12);
         }
     }
     file->protocol()->endAction();
@@ -3449,15 +3433,10 @@ void MainWindow::transposeTrackOctaveUp(MidiTrack *track) {
 void MainWindow::transposeTrackOctaveDown(MidiTrack *track) {
     if (!file || !track) return;
     file->protocol()->startNewAction(tr("Transpose Octave Down"), new QImage(":/run_environment/graphics/tool/transpose_down.png"));
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        foreach(MidiEvent* ev, emap->values()) {
-            if (ev->track() == track) {
-                NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev);
-                if (on) {
-                    on->setNote(on->note() - 12);
-                }
-            }
+    foreach(MidiEvent* ev, file->trackIndex()->events(track)) {
+        NoteOnEvent *on = dynamic_cast<NoteOnEvent *>(ev);
+        if (on) {
+            on->setNote(on->note() - 12);
         }
     }
     file->protocol()->endAction();
@@ -3475,29 +3454,19 @@ void MainWindow::splitTrackChannels(MidiTrack *track) {
 void MainWindow::selectTrackEvents(MidiTrack *track) {
     if (!file || !track) return;
     Selection::instance()->clearSelection();
-    QList<MidiEvent *> events;
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        foreach(MidiEvent* ev, emap->values()) {
-            if (ev->track() == track) {
-                events.append(ev);
-            }
-        }
-    }
-    Selection::instance()->setSelection(events);
+    Selection::instance()->setSelection(file->trackIndex()->events(track));
     updateAll();
 }
 
 void MainWindow::clearTrackEvents(MidiTrack *track) {
     if (!file || !track) return;
     file->protocol()->startNewAction(tr("Clear All Events"), new QImage(":/run_environment/graphics/tool/eraser.png"));
+    QList<MidiEvent *> toRemove[19];
     for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        QList<MidiEvent *> toRemove;
-        foreach(MidiEvent* ev, emap->values()) {
-            if (ev->track() == track) toRemove.append(ev);
-        }
-        foreach(MidiEvent* ev, toRemove) {
+        toRemove[ch] = file->trackIndex()->events(track, ch);
+    }
+    for (int ch = 0; ch < 19; ch++) {
+        foreach(MidiEvent* ev, toRemove[ch]) {
             file->channel(ch)->removeEvent(ev);
         }
     }
@@ -3508,16 +3477,11 @@ void MainWindow::clearTrackEvents(MidiTrack *track) {
 void MainWindow::moveTrackEventsToChannel(MidiTrack *track, int channel) {
     if (!file || !track || channel < 0 || channel >= 16) return;
     file->protocol()->startNewAction(tr("Move Track to Channel"));
-    for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *emap = file->channel(ch)->eventMap();
-        foreach(MidiEvent* ev, emap->values()) {
-            if (ev->track() == track) {
-                if (OnEvent *on = dynamic_cast<OnEvent *>(ev)) {
-                    on->moveToChannel(channel, false);
-                } else if (!dynamic_cast<OffEvent *>(ev)) {
-                    ev->setChannel(channel, false);
-                }
-            }
+    foreach(MidiEvent* ev, file->trackIndex()->events(track)) {
+        if (OnEvent *on = dynamic_cast<OnEvent *>(ev)) {
+            on->moveToChannel(channel, false);
+        } else if (!dynamic_cast<OffEvent *>(ev)) {
+            ev->setChannel(channel, false);
         }
     }
     file->protocol()->endAction();
@@ -3600,12 +3564,14 @@ void MainWindow::transposeSelection(int semitones) {
 
     file->protocol()->startNewAction(actionName, new QImage(":/run_environment/graphics/tool/transpose.png"));
 
+    EventEditBatch batch(file);
     foreach(MidiEvent* event, selectedEvents) {
         NoteOnEvent *noteOnEvent = dynamic_cast<NoteOnEvent *>(event);
         if (noteOnEvent) {
-            noteOnEvent->setNote(noteOnEvent->note() + semitones);
+            batch.setNote(noteOnEvent, noteOnEvent->note() + semitones);
         }
     }
+    batch.commit();
 
     file->protocol()->endAction();
     updateAll();
@@ -3729,11 +3695,8 @@ void MainWindow::editTrackAndChannel(MidiTrack *track) {
     // Stage 1: Time-Aware Detection
     // Find the channel of the event belonging to this track that is closest to (but not after) the cursor.
     for (int ch = 0; ch < 16; ch++) {
-        QMultiMap<int, MidiEvent *> *chEvents = file->channelEvents(ch);
-        QMultiMapIterator<int, MidiEvent *> it(*chEvents);
-        while (it.hasNext()) {
-            it.next();
-            
+        EventMap *chEvents = file->channelEvents(ch);
+        for (auto it = chEvents->constBegin(); it != chEvents->constEnd(); ++it) {
             // Stop searching this channel if we've passed the cursor
             if (it.key() > cursorTick) {
                 break;
@@ -3757,10 +3720,8 @@ void MainWindow::editTrackAndChannel(MidiTrack *track) {
     if (detectedCh == -1) {
         int earliestTick = -1;
         for (int ch = 0; ch < 16; ch++) {
-            QMultiMap<int, MidiEvent *> *chEvents = file->channelEvents(ch);
-            QMultiMapIterator<int, MidiEvent *> it(*chEvents);
-            while (it.hasNext()) {
-                it.next();
+            EventMap *chEvents = file->channelEvents(ch);
+            for (auto it = chEvents->constBegin(); it != chEvents->constEnd(); ++it) {
                 MidiEvent *ev = it.value();
                 MidiTrack *evTrack = ev->track();
                 
@@ -6381,55 +6342,30 @@ void MainWindow::quantizeSelection() {
         return;
     }
 
-    // get list with all quantization ticks
-    QList<int> ticks = file->quantization(_quantizationGrid);
+    // the quantization grid of the file
+    QuantizationGrid grid(file, _quantizationGrid);
 
     file->protocol()->startNewAction(tr("Quantize Events"), new QImage(":/run_environment/graphics/tool/quantize.png"));
+    EventEditBatch batch(file);
     foreach(MidiEvent* e, Selection::instance()->selectedEvents()) {
         int onTime = e->midiTime();
-        e->setMidiTime(quantize(onTime, ticks));
+        batch.setMidiTime(e, grid.snap(onTime));
         OnEvent *on = dynamic_cast<OnEvent *>(e);
         if (on) {
             MidiEvent *off = on->offEvent();
-            off->setMidiTime(quantize(off->midiTime(), ticks) - 1);
-            if (off->midiTime() <= on->midiTime()) {
-                int idx = ticks.indexOf(off->midiTime() + 1);
-                if ((idx >= 0) && (ticks.size() > idx + 1)) {
-                    off->setMidiTime(ticks.at(idx + 1) - 1);
+            batch.setMidiTime(off, grid.snap(off->midiTime()) - 1);
+            if (off->midiTime() <= on->midiTime() && grid.contains(off->midiTime() + 1)) {
+                int nextTick = grid.next(off->midiTime() + 1);
+                if (nextTick >= 0) {
+                    batch.setMidiTime(off, nextTick - 1);
                 }
             }
         }
     }
+    batch.commit();
     file->protocol()->endAction();
 }
 
-int MainWindow::quantize(int t, QList<int> ticks) {
-    int min = -1;
-
-    for (int j = 0; j < ticks.size(); j++) {
-        if (min < 0) {
-            min = j;
-            continue;
-        }
-
-        int i = ticks.at(j);
-
-        int dist = t - i;
-
-        int a = std::abs(dist);
-        int b = std::abs(t - ticks.at(min));
-
-        if (a < b) {
-            min = j;
-        }
-
-        if (dist < 0) {
-            return ticks.at(min);
-        }
-    }
-    return ticks.last();
-}
-
 void MainWindow::quantizeNtoleDialog() {
     if (!file || Selection::instance()->selectedEvents().isEmpty()) {
         return;
@@ -6447,8 +6383,8 @@ void MainWindow::quantizeNtole() {
         return;
     }
 
-    // get list with all quantization ticks
-    QList<int> ticks = file->quantization(_quantizationGrid);
+    // the quantization grid of the file
+    QuantizationGrid grid(file, _quantizationGrid);
 
     file->protocol()->startNewAction(tr("Quantize Tuplet"), new QImage(":/run_environment/graphics/tool/quantize.png"));
 
@@ -6462,35 +6398,34 @@ void MainWindow::quantizeNtole() {
     }
 
     // quantize start tick
-    startTick = quantize(startTick, ticks);
+    startTick = grid.snap(startTick);
 
     // compute new quantization grid
-    QList<int> ntoleTicks;
     int ticksDuration = (NToleQuantizationDialog::replaceNumNum * file->ticksPerQuarter() * 4) / (qPow(2, NToleQuantizationDialog::replaceDenomNum));
     int fractionSize = ticksDuration / NToleQuantizationDialog::ntoleNNum;
-
-    for (int i = 0; i <= NToleQuantizationDialog::ntoleNNum; i++) {
-        ntoleTicks.append(startTick + i * fractionSize);
-    }
+    QuantizationGrid ntoleGrid(startTick, fractionSize, startTick + NToleQuantizationDialog::ntoleNNum * fractionSize);
 
     // quantize
+    EventEditBatch batch(file);
     foreach(MidiEvent* e, Selection::instance()->selectedEvents()) {
         int onTime = e->midiTime();
-        e->setMidiTime(quantize(onTime, ntoleTicks));
+        batch.setMidiTime(e, ntoleGrid.snap(onTime));
         OnEvent *on = dynamic_cast<OnEvent *>(e);
         if (on) {
             MidiEvent *off = on->offEvent();
-            off->setMidiTime(quantize(off->midiTime(), ntoleTicks));
-            if (off->midiTime() == on->midiTime()) {
-                int idx = ntoleTicks.indexOf(off->midiTime());
-                if ((idx >= 0) && (ntoleTicks.size() > idx + 1)) {
-                    off->setMidiTime(ntoleTicks.at(idx + 1));
-                } else if ((ntoleTicks.size() == idx + 1)) {
-                    on->setMidiTime(ntoleTicks.at(idx - 1));
+            batch.setMidiTime(off, ntoleGrid.snap(off->midiTime()));
+            if (off->midiTime() == on->midiTime() && ntoleGrid.contains(off->midiTime())) {
+                int nextTick = ntoleGrid.next(off->midiTime());
+                int previousTick = ntoleGrid.previous(off->midiTime());
+                if (nextTick >= 0) {
+                    batch.setMidiTime(off, nextTick);
+                } else if (previousTick >= 0) {
+                    batch.setMidiTime(on, previousTick);
                 }
             }
         }
     }
+    batch.commit();
     file->protocol()->endAction();
 }
 
@@ -1082,14 +1082,6 @@ private:
     /** \brief Current quantization grid setting */
     int _quantizationGrid;
 
-    /**
-     * \brief Quantizes a time value to the nearest grid position.
-     * \param t Time value to quantize
-     * \param ticks List of available tick positions
-     * \return Quantized time value
-     */
-    int quantize(int t, QList<int> ticks);
-
     // === Action Management ===
 
     /** \brief Actions that should be activated when selections are made */
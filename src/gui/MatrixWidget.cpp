@@ -26,12 +26,14 @@
 #include "../MidiEvent/TextEvent.h"
 #include "../MidiEvent/TempoChangeEvent.h"
 #include "../MidiEvent/TimeSignatureEvent.h"
+#include "../midi/MeterMap.h"
 #include "../midi/MidiChannel.h"
 #include "../midi/MidiFile.h"
 #include "../midi/MidiInput.h"
 #include "../midi/MidiPlayer.h"
 #include "../midi/MidiTrack.h"
 #include "../midi/MidiPlayer.h"
+#include "../midi/NoteSpanIndex.h"
 #include "../midi/PlayerThread.h"
 #include "../protocol/Protocol.h"
 #include "../tool/Tool.h"
@@ -88,7 +90,6 @@ MatrixWidget::MatrixWidget(QSettings *settings, QWidget *parent)
     lineNameWidth = 110;
     timeHeight = 50;
     currentTempoEvents = new QList<MidiEvent *>;
-    currentTimeSignatureEvents = new QList<TimeSignatureEvent *>;
     msOfFirstEventInList = 0;
     objects = new QList<MidiEvent *>;
     velocityObjects = new QList<MidiEvent *>;
@@ -333,7 +334,6 @@ void MatrixWidget::paintEvent(QPaintEvent *event) {
         objects->clear();
         velocityObjects->clear();
         currentTempoEvents->clear();
-        currentTimeSignatureEvents->clear();
         currentDivs.clear();
 
         startTick = file->tick(startTimeX, endTimeX, &currentTempoEvents,
@@ -548,29 +548,28 @@ void MatrixWidget::paintEvent(QPaintEvent *event) {
         }
 
         // draw measures foreground and text
-        int measure = file->measure(startTick, endTick, &currentTimeSignatureEvents);
-
-        TimeSignatureEvent *currentEvent = currentTimeSignatureEvents->at(0);
-        int i = 0;
-        if (!currentEvent) {
+        MeterMap meters = file->meterMap();
+        int segment = meters.segmentAtTick(startTick);
+        if (segment < 0) {
             return;
         }
-        int tick = currentEvent->midiTime();
-        while (tick + currentEvent->ticksPerMeasure() <= startTick) {
-            tick += currentEvent->ticksPerMeasure();
+        int measure = meters.measure(startTick);
+
+        int tick = meters.startTick(segment);
+        while (tick + meters.ticksPerMeasure(segment) <= startTick) {
+            tick += meters.ticksPerMeasure(segment);
         }
         while (tick < endTick) {
-            TimeSignatureEvent *measureEvent = currentTimeSignatureEvents->at(i);
+            int ticksPerMeasure = meters.ticksPerMeasure(segment);
             int xfrom = xPosOfMs(msOfTick(tick));
             currentDivs.append(QPair<int, int>(xfrom, tick));
             measure++;
             int measureStartTick = tick;
-            tick += currentEvent->ticksPerMeasure();
-            if (i < currentTimeSignatureEvents->length() - 1) {
-                if (currentTimeSignatureEvents->at(i + 1)->midiTime() <= tick) {
-                    currentEvent = currentTimeSignatureEvents->at(i + 1);
-                    tick = currentEvent->midiTime();
-                    i++;
+            tick += ticksPerMeasure;
+            if (segment + 1 < meters.size() && meters.startTick(segment + 1) <= endTick) {
+                if (meters.startTick(segment + 1) <= tick) {
+                    segment++;
+                    tick = meters.startTick(segment);
                 }
             }
             int xto = xPosOfMs(msOfTick(tick));
@@ -605,56 +604,13 @@ void MatrixWidget::paintEvent(QPaintEvent *event) {
                 pixpainter->drawText(textX, textY, text);
 
                 if (_div >= 0 || _div <= -100) {
-                    int ticksPerDiv;
-
-                    if (_div >= 0) {
-                        // Regular divisions: _div=0 (whole), _div=1 (half), _div=2 (quarter), etc.
-                        // Formula: 4 / 2^_div quarters per division
-                        double metronomeDiv = 4 / std::pow(2.0, _div);
-                        ticksPerDiv = metronomeDiv * file->ticksPerQuarter();
-                    } else if (_div <= -100) {
-                        // Extended subdivision system: 
-                        // -100 to -199: Triplets (÷3)
-                        // -200 to -299: Quintuplets (÷5)
-                        // -300 to -399: Sextuplets (÷6)
-                        // -400 to -499: Septuplets (÷7)
-                        // -500 to -599: Dotted notes (×1.5)
-                        // -600 to -699: Double dotted notes (×1.75)
-
-                        int subdivisionType = (-_div) / 100; // 1=triplets, 2=quintuplets, etc.
-                        int baseDivision = (-_div) % 100; // Extract base division
-
-                        double baseDiv = 4 / std::pow(2.0, baseDivision);
-
-                        if (subdivisionType == 1) {
-                            // Triplets: divide by 3
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) / 3;
-                        } else if (subdivisionType == 2) {
-                            // Quintuplets: divide by 5
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) / 5;
-                        } else if (subdivisionType == 3) {
-                            // Sextuplets: divide by 6
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) / 6;
-                        } else if (subdivisionType == 4) {
-                            // Septuplets: divide by 7
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) / 7;
-                        } else if (subdivisionType == 5) {
-                            // Dotted notes: multiply by 1.5
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) * 1.5;
-                        } else if (subdivisionType == 6) {
-                            // Double dotted notes: multiply by 1.75
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) * 1.75;
-                        } else {
-                            // Fallback to triplets for unknown types
-                            ticksPerDiv = (baseDiv * file->ticksPerQuarter()) / 3;
-                        }
-                    }
+                    int ticksPerDiv = QuantizationGrid::ticksOfFraction(_div, file->ticksPerQuarter());
 
                     int startTickDiv = ticksPerDiv;
                     QPen oldPen = pixpainter->pen();
                     QPen dashPen = QPen(_cachedTimelineGridColor, 1, Qt::DashLine);
                     pixpainter->setPen(dashPen);
-                    while (startTickDiv < measureEvent->ticksPerMeasure()) {
+                    while (startTickDiv < ticksPerMeasure) {
                         int divTick = startTickDiv + measureStartTick;
                         int xDiv = xPosOfMs(msOfTick(divTick));
                         currentDivs.append(QPair<int, int>(xDiv, divTick));
@@ -912,76 +868,11 @@ void MatrixWidget::paintChannel(QPainter *painter, int channel) {
         return;
     }
     QColor cC = *file->channel(channel)->color();
+    int height = lineHeight();
 
-    // filter events
-    QMultiMap<int, MidiEvent *> *map = file->channelEvents(channel);
-
-    // PERFORMANCE: Create local QSets for fast lookups during this paint cycle
-    // These are rebuilt each time so they can't get out of sync
-    QSet<MidiEvent*> localObjectsSet;
-    QSet<MidiEvent*> localVelocityObjectsSet;
-
-    // PERFORMANCE: Use const iterator for faster iteration
-    // Note: Spatial culling disabled to avoid missing notes that extend into viewport
-    // The color caching optimization provides the main performance benefit
-    QMultiMap<int, MidiEvent *>::const_iterator it = map->constBegin();
-    QMultiMap<int, MidiEvent *>::const_iterator end = map->constEnd();
-
-    for (; it != end; ++it) {
-        MidiEvent *currentEvent = it.value();
-
-        // Fast early rejection: check line visibility first (cheapest test)
-        int line = currentEvent->line();
-        if (line < startLineY || line > endLineY) {
-            continue;
-        }
-
-        // Only do full eventInWidget check if line is visible
-        if (!eventInWidget(currentEvent)) {
-            continue;
-        }
-
-        // insert all Events in objects, set their coordinates
-        // Only onEvents are inserted. When there is an On
-        // and an OffEvent, the OnEvent will hold the coordinates
-        // (line already declared above for early rejection check)
-
-        // Cache dynamic_cast results to avoid repeated calls
-        OffEvent *offEvent = dynamic_cast<OffEvent *>(currentEvent);
-        OnEvent *onEvent = dynamic_cast<OnEvent *>(currentEvent);
-
-        MidiEvent *event = currentEvent; // The event we'll process (may be reassigned to onEvent)
-
-        // PERFORMANCE: Cache coordinate calculations (VTune shows GraphicObject::y taking 0.173s)
-        int x, width;
+    // sets the coordinates of event, draws it and inserts it into objects
+    auto drawEvent = [&](MidiEvent *event, int line, int x, int width) {
         int y = yPosOfLine(line);
-        int height = lineHeight();
-
-        if (onEvent || offEvent) {
-            if (onEvent) {
-                offEvent = onEvent->offEvent();
-            } else if (offEvent) {
-                onEvent = dynamic_cast<OnEvent *>(offEvent->onEvent());
-            }
-
-            // Calculate raw coordinates
-            int rawX = xPosOfMs(msOfTick(onEvent->midiTime()));
-            int rawEndX = xPosOfMs(msOfTick(offEvent->midiTime()));
-
-            // Clamp coordinates to viewport for partially visible notes
-            x = qMax(rawX, lineNameWidth); // Don't start before the piano area
-            int endX = qMin(rawEndX, this->width()); // Don't extend beyond widget width
-            width = qMax(endX - x, 1); // Ensure minimum width of 1 pixel
-
-            event = onEvent;
-            if (localObjectsSet.contains(event)) {
-                continue;
-            }
-        } else {
-            width = PIXEL_PER_EVENT;
-            x = xPosOfMs(msOfTick(currentEvent->midiTime()));
-        }
-
         event->setX(x);
         event->setY(y);
         event->setWidth(width);
@@ -1007,21 +898,64 @@ void MatrixWidget::paintChannel(QPainter *painter, int channel) {
                 }
             }
             objects->prepend(event);
-            localObjectsSet.insert(event);
         }
+    };
 
-        // append event to velocityObjects if its not a offEvent and if it
-        // is in the x-Area
-        MidiEvent *originalEvent = (onEvent || offEvent) ? currentEvent : event;
-        if (!(originalEvent->track()->hidden())) {
-            OffEvent *velocityOffEvent = dynamic_cast<OffEvent *>(originalEvent);
-            if (!velocityOffEvent && originalEvent->midiTime() >= startTick && originalEvent->midiTime() <= endTick && !
-                localVelocityObjectsSet.contains(originalEvent)) {
-                originalEvent->setX(xPosOfMs(msOfTick(originalEvent->midiTime())));
-                velocityObjects->prepend(originalEvent);
-                localVelocityObjectsSet.insert(originalEvent);
-            }
+    // appends event to velocityObjects if it starts in the x-Area
+    auto addVelocityObject = [&](MidiEvent *event) {
+        if (!(event->track()->hidden()) && event->midiTime() >= startTick && event->midiTime() <= endTick) {
+            event->setX(xPosOfMs(msOfTick(event->midiTime())));
+            velocityObjects->prepend(event);
+        }
+    };
+
+    // Notes: the interval index returns every note overlapping the visible
+    // ticks and lines, including notes that start before and end behind the
+    // viewport. Only onEvents are inserted in objects; the OnEvent holds the
+    // coordinates of the whole note.
+    QList<NoteOnEvent *> notes;
+    file->channel(channel)->noteSpans()->query(startTick, endTick, startLineY, endLineY, &notes);
+    foreach (NoteOnEvent *onEvent, notes) {
+        OffEvent *offEvent = onEvent->offEvent();
+        onEvent->setShown(true);
+        offEvent->setShown(true);
+
+        // Calculate raw coordinates
+        int rawX = xPosOfMs(msOfTick(onEvent->midiTime()));
+        int rawEndX = xPosOfMs(msOfTick(offEvent->midiTime()));
+
+        // Clamp coordinates to viewport for partially visible notes
+        int x = qMax(rawX, lineNameWidth); // Don't start before the piano area
+        int endX = qMin(rawEndX, this->width()); // Don't extend beyond widget width
+        int width = qMax(endX - x, 1); // Ensure minimum width of 1 pixel
+
+        drawEvent(onEvent, onEvent->line(), x, width);
+        addVelocityObject(onEvent);
+    }
+
+    // All other events are drawn at their tick, so only the visible part of
+    // the map has to be searched
+    const EventMap &map = *(file->channelEvents(channel));
+    EventMap::const_iterator it = map.lowerBound(startTick);
+    for (; it != map.constEnd() && it.key() <= endTick; ++it) {
+        MidiEvent *currentEvent = it.value();
+
+        // notes have been painted above
+        if (dynamic_cast<OnEvent *>(currentEvent) || dynamic_cast<OffEvent *>(currentEvent)) {
+            continue;
+        }
+
+        // Fast early rejection: check line visibility first (cheapest test)
+        int line = currentEvent->line();
+        if (line < startLineY || line > endLineY) {
+            continue;
         }
+        if (!eventInWidget(currentEvent)) {
+            continue;
+        }
+
+        drawEvent(currentEvent, line, xPosOfMs(msOfTick(currentEvent->midiTime())), PIXEL_PER_EVENT);
+        addVelocityObject(currentEvent);
     }
 }
 
@@ -1283,9 +1217,9 @@ void MatrixWidget::setFile(MidiFile *f) {
     // scroll down to see events
     int maxNote = -1;
     for (int channel = 0; channel < 16; channel++) {
-        QMultiMap<int, MidiEvent *> *map = file->channelEvents(channel);
+        EventMap *map = file->channelEvents(channel);
 
-        QMultiMap<int, MidiEvent *>::iterator it = map->lowerBound(0);
+        EventMap::iterator it = map->lowerBound(0);
         while (it != map->end()) {
             NoteOnEvent *onev = dynamic_cast<NoteOnEvent *>(it.value());
             if (onev && eventInWidget(onev)) {
@@ -2192,7 +2126,7 @@ int MatrixWidget::msOfXPos(int x) {
 }
 
 int MatrixWidget::msOfTick(int tick) {
-    return file->msOfTick(tick, currentTempoEvents, msOfFirstEventInList);
+    return file->msOfTick(tick);
 }
 
 int MatrixWidget::timeMsOfWidth(int w) {
@@ -2819,9 +2753,9 @@ NoteOnEvent* MatrixWidget::findPreviousNoteInTrack(NoteOnEvent* note, const std:
     int latestOffTick = -1;
 
     for (int channel = 0; channel < 16; channel++) {
-        QMultiMap<int, MidiEvent*>* map = file->channelEvents(channel);
+        EventMap* map = file->channelEvents(channel);
         // Look at all notes starting strictly before currentTick
-        QMultiMap<int, MidiEvent*>::iterator it = map->lowerBound(currentTick);
+        EventMap::iterator it = map->lowerBound(currentTick);
 
         while (it != map->begin()) {
             --it;
@@ -2855,9 +2789,9 @@ NoteOnEvent* MatrixWidget::findNextNoteInTrack(NoteOnEvent* note, const std::set
     int earliestOnTick = -1;
 
     for (int channel = 0; channel < 16; channel++) {
-        QMultiMap<int, MidiEvent*>* map = file->channelEvents(channel);
+        EventMap* map = file->channelEvents(channel);
         // Look at all notes starting at or after currentTick
-        QMultiMap<int, MidiEvent*>::iterator it = map->lowerBound(currentTick);
+        EventMap::iterator it = map->lowerBound(currentTick);
 
         while (it != map->end()) {
             MidiEvent* event = it.value();
@@ -2911,6 +2845,13 @@ QList<QPair<int, int> > MatrixWidget::divs() {
     return currentDivs;
 }
 
+QuantizationGrid MatrixWidget::divGrid() {
+    if (!file) {
+        return QuantizationGrid();
+    }
+    return QuantizationGrid(file, _div, true);
+}
+
 int MatrixWidget::div() {
     return _div;
 }
@@ -2926,7 +2867,7 @@ void MatrixWidget::paintTimelineMarkers(QPainter *painter) {
     for (int ch = 0; ch < 19; ch++) {
         if (!ChannelVisibilityManager::instance().isChannelVisible(ch)) continue;
         
-        QMultiMap<int, MidiEvent*> *events = file->channelEvents(ch);
+        EventMap *events = file->channelEvents(ch);
         if (!events) continue;
         
         auto it = events->lowerBound(startTick);
@@ -3017,7 +2958,7 @@ MidiEvent *MatrixWidget::findTimelineMarkerNear(int x, int y) {
     for (int ch = 0; ch < 19; ch++) {
         if (!ChannelVisibilityManager::instance().isChannelVisible(ch)) continue;
         
-        QMultiMap<int, MidiEvent*> *events = file->channelEvents(ch);
+        EventMap *events = file->channelEvents(ch);
         if (!events) continue;
         
         int mouseTick = file->tick(msOfXPos(x));
@@ -23,6 +23,7 @@
 #include "PaintWidget.h"
 #include "Appearance.h"
 #include "../midi/MidiTrack.h"
+#include "../midi/QuantizationGrid.h"
 
 // Qt includes
 #include <QApplication>
@@ -37,7 +38,6 @@
 // Forward declarations
 class MidiFile;
 class TempoChangeEvent;
-class TimeSignatureEvent;
 class MidiEvent;
 class GraphicObject;
 class NoteOnEvent;
@@ -331,6 +331,12 @@ public:
      */
     QList<QPair<int, int> > divs();
 
+    /**
+     * \brief Gets the grid of the time divisions of the whole file.
+     * \return Measure grid for the current division (see QuantizationGrid)
+     */
+    QuantizationGrid divGrid();
+
 public slots:
     // === Scroll Control ===
 
@@ -755,12 +761,6 @@ private:
      */
     QList<MidiEvent *> *currentTempoEvents;
 
-    /**
-     * \brief Time signature events currently visible in the window.
-     * Used for timeline and grid display.
-     */
-    QList<TimeSignatureEvent *> *currentTimeSignatureEvents;
-
     /**
      * \brief All events currently visible in the main matrix area.
      */
@@ -25,6 +25,8 @@
 #include "../midi/MidiInput.h"
 #include "../midi/MidiOutput.h"
 #include "../midi/Metronome.h"
+#include "../midi/MidiThru.h"
+#include "../protocol/Protocol.h"
 #include <QCheckBox>
 #include <QComboBox>
 #include <QGridLayout>
@@ -35,6 +37,7 @@
 #include <QSettings>
 #include <QSpinBox>
 #include <QTextEdit>
+#include <QTimer>
 
 #ifdef FLUIDSYNTH_SUPPORT
 #include <QCoreApplication>
@@ -46,6 +49,7 @@
 #include <QHBoxLayout>
 #include <QSlider>
 #include <QVBoxLayout>
+#include <QThread>
 #include <QThreadPool>
 #include <QTableWidget>
 #include <QHeaderView>
@@ -402,7 +406,23 @@ AdditionalMidiSettingsWidget::AdditionalMidiSettingsWidget(QSettings *settings,
     
     layout->addWidget(separator(), 11, 0, 1, 6);
 
-    layout->addWidget(new QLabel(tr("Metronome Volume (Velocity):"), this), 12, 0, 1, 2, Qt::AlignVCenter);
+    layout->addWidget(new QLabel(tr("Undo History Memory:"), this), 12, 0, 1, 2);
+    _undoBudgetBox = new QSpinBox(this);
+    _undoBudgetBox->setMinimum(0);
+    _undoBudgetBox->setMaximum(16384);
+    _undoBudgetBox->setSingleStep(64);
+    _undoBudgetBox->setSuffix(tr(" MB"));
+    _undoBudgetBox->setSpecialValueText(tr("No limit"));
+    _undoBudgetBox->setValue(Protocol::memoryBudget() / (1024 * 1024));
+    connect(_undoBudgetBox, SIGNAL(valueChanged(int)), this, SLOT(setUndoMemoryBudget(int)));
+    layout->addWidget(_undoBudgetBox, 12, 2, 1, 4);
+
+    _undoBudgetInfoBox = createInfoBox(tr("The undo history of each file is limited to this amount of memory. When it is exceeded, the oldest steps are dropped. Set to \"No limit\" to keep all steps."));
+    layout->addWidget(_undoBudgetInfoBox, 13, 0, 1, 6);
+    
+    layout->addWidget(separator(), 14, 0, 1, 6);
+
+    layout->addWidget(new QLabel(tr("Metronome Volume (Velocity):"), this), 15, 0, 1, 2, Qt::AlignVCenter);
     
     QHBoxLayout *metronomeLayout = new QHBoxLayout();
     _metronomeLoudnessSlider = new QSlider(Qt::Horizontal, this);
@@ -414,19 +434,19 @@ AdditionalMidiSettingsWidget::AdditionalMidiSettingsWidget(QSettings *settings,
     _metronomeLoudnessLabel = new QLabel(QString::number(Metronome::loudness()), this);
     _metronomeLoudnessLabel->setFixedWidth(25);
     metronomeLayout->addWidget(_metronomeLoudnessLabel, 0);
-    layout->addLayout(metronomeLayout, 12, 2, 1, 4);
+    layout->addLayout(metronomeLayout, 15, 2, 1, 4);
 
-    layout->addWidget(new QLabel(tr("Start Command:"), this), 13, 0, 1, 2);
+    layout->addWidget(new QLabel(tr("Start Command:"), this), 16, 0, 1, 2);
     startCmd = new QLineEdit(this);
-    layout->addWidget(startCmd, 13, 2, 1, 4);
+    layout->addWidget(startCmd, 16, 2, 1, 4);
 
     _startCmdInfoBox = createInfoBox(tr("The start command can be used to start additional software components (e.g. MIDI synthesizers) each time, MidiEditor is started. You can see the output of the started software / script in the field below."));
-    layout->addWidget(_startCmdInfoBox, 14, 0, 1, 6);
+    layout->addWidget(_startCmdInfoBox, 17, 0, 1, 6);
 
-    layout->addWidget(Terminal::terminal()->console(), 15, 0, 1, 6);
+    layout->addWidget(Terminal::terminal()->console(), 18, 0, 1, 6);
 
     startCmd->setText(_settings->value("start_cmd", "").toString());
-    layout->setRowStretch(15, 1);
+    layout->setRowStretch(18, 1);
 }
 
 bool AdditionalMidiSettingsWidget::trackBasedProgramChanges() {
@@ -451,6 +471,12 @@ void AdditionalMidiSettingsWidget::setTextEncoding(int index) {
     _settings->sync();
 }
 
+void AdditionalMidiSettingsWidget::setUndoMemoryBudget(int megabytes) {
+    Protocol::setMemoryBudget(qint64(megabytes) * 1024 * 1024);
+    _settings->setValue("undo_memory_budget_mb", megabytes);
+    _settings->sync();
+}
+
 void AdditionalMidiSettingsWidget::resetTPQ() {
     _tpqBox->setValue(192);
     setDefaultTimePerQuarter(192);
@@ -492,6 +518,7 @@ void AdditionalMidiSettingsWidget::refreshColors() {
     updateInfoBox(_playerModeInfoBox);
     updateInfoBox(_trackModeInfoBox);
     updateInfoBox(_textEncodingInfoBox);
+    updateInfoBox(_undoBudgetInfoBox);
 
     update();
 }
@@ -549,6 +576,19 @@ MidiSettingsWidget::MidiSettingsWidget(MainWindow *mainWindow, QWidget *parent)
             SLOT(reloadInputPorts()));
     reloadInputPorts();
 
+    // MIDI thru latency
+    _thruLatencyLabel = new QLabel(this);
+    _thruLatencyLabel->setToolTip(tr("Time from receiving a message on the MIDI input until it has been passed to the output (MIDI thru)"));
+    layout->addWidget(_thruLatencyLabel, 3, 0, 1, 5);
+    QPushButton *resetThruLatency = new QPushButton(tr("Reset"), this);
+    resetThruLatency->setToolTip(tr("Clear the MIDI thru latency measurements"));
+    layout->addWidget(resetThruLatency, 3, 5, 1, 1);
+    connect(resetThruLatency, SIGNAL(clicked()), this, SLOT(resetThruLatency()));
+    QTimer *thruLatencyTimer = new QTimer(this);
+    connect(thruLatencyTimer, SIGNAL(timeout()), this, SLOT(updateThruLatency()));
+    thruLatencyTimer->start(500);
+    updateThruLatency();
+
 #ifdef FLUIDSYNTH_SUPPORT
     // === FluidSynth Settings Section ===
     _fluidSynthSettingsGroup = new QGroupBox(tr("FluidSynth Settings"), this);
@@ -611,13 +651,18 @@ MidiSettingsWidget::MidiSettingsWidget(MainWindow *mainWindow, QWidget *parent)
     sfRow->addLayout(sfBtnCol);
     fsLayout->addLayout(sfRow);
 
+    _soundFontLoadBar = new QProgressBar(_fluidSynthSettingsGroup);
+    _soundFontLoadBar->setFormat(tr("Loading SoundFonts... %v / %m"));
+    _soundFontLoadBar->setVisible(false);
+    fsLayout->addWidget(_soundFontLoadBar);
+
     connect(_addSoundFontBtn, SIGNAL(clicked()), this, SLOT(addSoundFont()));
     connect(_removeSoundFontBtn, SIGNAL(clicked()), this, SLOT(removeSoundFont()));
     connect(_moveSoundFontUpBtn, SIGNAL(clicked()), this, SLOT(moveSoundFontUp()));
     connect(_moveSoundFontDownBtn, SIGNAL(clicked()), this, SLOT(moveSoundFontDown()));
     connect(_downloadDefaultSoundFontBtn, SIGNAL(clicked()), this, SLOT(showDownloadSoundFontDialog()));
 
-    // Settings grid: 3 rows x 5 columns
+    // Settings grid: 5 rows x 5 columns
     FluidSynthEngine *engine = FluidSynthEngine::instance();
     QGridLayout *settingsGrid = new QGridLayout();
     settingsGrid->setSpacing(0);
@@ -768,6 +813,79 @@ MidiSettingsWidget::MidiSettingsWidget(MainWindow *mainWindow, QWidget *parent)
     _gainResetBtn->setFixedWidth(45);
     settingsGrid->addWidget(_gainResetBtn, 2, 2, Qt::AlignCenter);
 
+    // ========================================================================
+    // ROW 3
+    // ========================================================================
+
+    // (3,0): CPU Cores Label
+    settingsGrid->addWidget(new QLabel(tr("CPU Cores:"), _fluidSynthSettingsGroup), 3, 0);
+
+    // (3,1): CPU Cores + Period Size x Periods
+    QHBoxLayout *row3LeftLayout = new QHBoxLayout();
+    row3LeftLayout->setContentsMargins(0, 0, 0, 0);
+    row3LeftLayout->setSpacing(8);
+    _cpuCoresSpin = new QSpinBox(_fluidSynthSettingsGroup);
+    _cpuCoresSpin->setRange(1, qMax(1, QThread::idealThreadCount()));
+    _cpuCoresSpin->setValue(qMin(engine->cpuCores(), _cpuCoresSpin->maximum()));
+    _cpuCoresSpin->setToolTip(tr("Threads used to render voices. More cores help with dense files."));
+    row3LeftLayout->addWidget(_cpuCoresSpin, 0);
+
+    row3LeftLayout->addWidget(new QLabel(tr("Buffer:"), _fluidSynthSettingsGroup));
+    _periodSizeCombo = new QComboBox(_fluidSynthSettingsGroup);
+    _periodSizeCombo->addItem(tr("Default"), 0);
+    for (int frames : {64, 128, 256, 512, 1024, 2048}) {
+        _periodSizeCombo->addItem(QString::number(frames), frames);
+    }
+    int periodSizeIdx = _periodSizeCombo->findData(engine->periodSize());
+    if (periodSizeIdx != -1) _periodSizeCombo->setCurrentIndex(periodSizeIdx);
+    _periodSizeCombo->setToolTip(tr("Frames per audio buffer. Larger buffers are more robust, smaller ones have less latency."));
+    row3LeftLayout->addWidget(_periodSizeCombo, 1);
+
+    row3LeftLayout->addWidget(new QLabel(QString::fromUtf8("\u00D7"), _fluidSynthSettingsGroup));
+    _periodsCombo = new QComboBox(_fluidSynthSettingsGroup);
+    _periodsCombo->addItem(tr("Default"), 0);
+    for (int periods : {2, 4, 8, 16, 32}) {
+        _periodsCombo->addItem(QString::number(periods), periods);
+    }
+    int periodsIdx = _periodsCombo->findData(engine->periods());
+    if (periodsIdx != -1) _periodsCombo->setCurrentIndex(periodsIdx);
+    _periodsCombo->setToolTip(tr("Number of audio buffers."));
+    row3LeftLayout->addWidget(_periodsCombo, 1);
+    settingsGrid->addLayout(row3LeftLayout, 3, 1);
+
+    // (3,4): Voice Stealing: [_mode_]
+    QHBoxLayout *row3RightLayout = new QHBoxLayout();
+    row3RightLayout->setContentsMargins(0, 0, 0, 0);
+    row3RightLayout->setSpacing(8);
+    row3RightLayout->addWidget(new QLabel(tr("Voice Stealing:"), _fluidSynthSettingsGroup), 0);
+    _voiceStealingCombo = new QComboBox(_fluidSynthSettingsGroup);
+    _voiceStealingCombo->addItem(tr("Default"), "default");
+    _voiceStealingCombo->addItem(tr("Favor New Notes"), "newest");
+    int stealingIdx = _voiceStealingCombo->findData(engine->voiceStealing());
+    if (stealingIdx != -1) _voiceStealingCombo->setCurrentIndex(stealingIdx);
+    _voiceStealingCombo->setToolTip(tr("Which voices are replaced when the polyphony limit is reached."));
+    row3RightLayout->addWidget(_voiceStealingCombo, 0);
+    row3RightLayout->addStretch(1);
+    settingsGrid->addLayout(row3RightLayout, 3, 4);
+
+    // ========================================================================
+    // ROW 4
+    // ========================================================================
+
+    // (4,0): Render Speed Label
+    settingsGrid->addWidget(new QLabel(tr("Render Speed:"), _fluidSynthSettingsGroup), 4, 0);
+
+    // (4,1): Measured factor + Measure button
+    QHBoxLayout *row4Layout = new QHBoxLayout();
+    row4Layout->setContentsMargins(0, 0, 0, 0);
+    row4Layout->setSpacing(8);
+    _renderSpeedLabel = new QLabel(tr("Not measured"), _fluidSynthSettingsGroup);
+    row4Layout->addWidget(_renderSpeedLabel, 1);
+    _measureSpeedBtn = new QPushButton(tr("Measure"), _fluidSynthSettingsGroup);
+    _measureSpeedBtn->setToolTip(tr("Renders a dense passage with the current settings and shows how much faster than real time it is."));
+    row4Layout->addWidget(_measureSpeedBtn, 0);
+    settingsGrid->addLayout(row4Layout, 4, 1);
+
     // ========================================================================
     // Connections
     // ========================================================================
@@ -780,14 +898,21 @@ MidiSettingsWidget::MidiSettingsWidget(MainWindow *mainWindow, QWidget *parent)
     connect(_gainResetBtn, SIGNAL(clicked()), this, SLOT(onGainReset()));
     connect(_reverbCheckBox, SIGNAL(toggled(bool)), this, SLOT(onReverbToggled(bool)));
     connect(_chorusCheckBox, SIGNAL(toggled(bool)), this, SLOT(onChorusToggled(bool)));
+    connect(_cpuCoresSpin, SIGNAL(valueChanged(int)), this, SLOT(onCpuCoresChanged(int)));
+    connect(_periodSizeCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(onPeriodSizeChanged(int)));
+    connect(_periodsCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(onPeriodsChanged(int)));
+    connect(_voiceStealingCombo, SIGNAL(currentIndexChanged(int)), this, SLOT(onVoiceStealingChanged(int)));
+    connect(_measureSpeedBtn, SIGNAL(clicked()), this, SLOT(onMeasureRenderSpeed()));
+    connect(engine, SIGNAL(renderSpeedMeasured(double)), this, SLOT(onRenderSpeedMeasured(double)));
 
     fsLayout->addLayout(settingsGrid);
 
-    layout->addWidget(_fluidSynthSettingsGroup, 3, 0, 1, 6);
+    layout->addWidget(_fluidSynthSettingsGroup, 4, 0, 1, 6);
 
     // Populate SoundFont list from engine
     refreshSoundFontList();
     connect(engine, SIGNAL(soundFontsChanged()), this, SLOT(refreshSoundFontList()));
+    connect(engine, SIGNAL(soundFontLoadProgress(int, int)), this, SLOT(onSoundFontLoadProgress(int, int)));
     connect(engine, SIGNAL(engineRestarted()), this, SLOT(refreshSoundFontList()));
 
     // Set initial enabled state
@@ -889,6 +1014,22 @@ void MidiSettingsWidget::refreshColors() {
     update();
 }
 
+void MidiSettingsWidget::updateThruLatency() {
+    if (!isVisible() && !_thruLatencyLabel->text().isEmpty()) {
+        return;
+    }
+    MidiThru *thru = MidiThru::instance();
+    _thruLatencyLabel->setText(tr("MIDI thru latency: last %1 ms, average %2 ms, max %3 ms")
+                                       .arg(thru->lastLatency() / 1000.0, 0, 'f', 2)
+                                       .arg(thru->averageLatency() / 1000.0, 0, 'f', 2)
+                                       .arg(thru->maxLatency() / 1000.0, 0, 'f', 2));
+}
+
+void MidiSettingsWidget::resetThruLatency() {
+    MidiThru::instance()->resetLatency();
+    updateThruLatency();
+}
+
 #ifdef FLUIDSYNTH_SUPPORT
 void MidiSettingsWidget::updateFluidSynthSettingsEnabled() {
     bool fsOutput = MidiOutput::isFluidSynthOutput();
@@ -1190,6 +1331,43 @@ void MidiSettingsWidget::onPolyphonyChanged(int index) {
     }
 }
 
+void MidiSettingsWidget::onCpuCoresChanged(int cores) {
+    FluidSynthEngine::instance()->setCpuCores(cores);
+}
+
+void MidiSettingsWidget::onPeriodSizeChanged(int index) {
+    FluidSynthEngine::instance()->setPeriodSize(_periodSizeCombo->itemData(index).toInt());
+}
+
+void MidiSettingsWidget::onPeriodsChanged(int index) {
+    FluidSynthEngine::instance()->setPeriods(_periodsCombo->itemData(index).toInt());
+}
+
+void MidiSettingsWidget::onVoiceStealingChanged(int index) {
+    FluidSynthEngine::instance()->setVoiceStealing(_voiceStealingCombo->itemData(index).toString());
+}
+
+void MidiSettingsWidget::onMeasureRenderSpeed() {
+    _measureSpeedBtn->setEnabled(false);
+    _renderSpeedLabel->setText(tr("Measuring..."));
+    FluidSynthEngine::instance()->measureRenderSpeed();
+}
+
+void MidiSettingsWidget::onRenderSpeedMeasured(double factor) {
+    _measureSpeedBtn->setEnabled(true);
+    if (factor <= 0) {
+        _renderSpeedLabel->setText(tr("Measurement failed"));
+        return;
+    }
+    _renderSpeedLabel->setText(tr("%1x real time").arg(factor, 0, 'f', 1));
+}
+
+void MidiSettingsWidget::onSoundFontLoadProgress(int loaded, int total) {
+    _soundFontLoadBar->setMaximum(total);
+    _soundFontLoadBar->setValue(loaded);
+    _soundFontLoadBar->setVisible(loaded < total);
+}
+
 void MidiSettingsWidget::onGainChanged(int value) {
     // Snap to nearest 5 (0.05 step units) to ensure consistent behavior during drag
     int snappedValue = (value + 2) / 5 * 5;
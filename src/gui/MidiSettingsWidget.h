@@ -112,6 +112,12 @@ public slots:
      */
     void setTextEncoding(int index);
 
+    /**
+     * \brief Sets the memory budget of the undo history.
+     * \param megabytes The budget in MB, 0 for no limit
+     */
+    void setUndoMemoryBudget(int megabytes);
+
     /**
      * \brief Resets TPQ to default 192.
      */
@@ -154,6 +160,12 @@ private:
     
     /** \brief Text encoding info box */
     QWidget *_textEncodingInfoBox;
+
+    /** \brief Undo history memory budget spin box */
+    QSpinBox *_undoBudgetBox;
+
+    /** \brief Undo history memory budget info box */
+    QWidget *_undoBudgetInfoBox;
 };
 
 /**
@@ -211,6 +223,16 @@ public slots:
      */
     void refreshColors();
 
+    /**
+     * \brief Shows the current MIDI thru latency measurements.
+     */
+    void updateThruLatency();
+
+    /**
+     * \brief Clears the MIDI thru latency measurements.
+     */
+    void resetThruLatency();
+
 private:
     /** \brief Lists of available ports */
     QStringList *_inputPorts, *_outputPorts;
@@ -221,6 +243,9 @@ private:
     /** \brief Player mode info box */
     QWidget *_playerModeInfoBox;
 
+    /** \brief MIDI thru latency display */
+    QLabel *_thruLatencyLabel;
+
     /** \brief Main window reference */
     MainWindow *_mainWindow;
 
@@ -230,6 +255,7 @@ private:
     // FluidSynth settings UI widgets (greyed out unless FluidSynth selected)
     QGroupBox *_fluidSynthSettingsGroup;
     QTableWidget *_soundFontList;
+    QProgressBar *_soundFontLoadBar;
     SoundFontDragController *_dragController;
     SoundFontSeparatorDelegate *_separatorDelegate;
     int _separatorRow;
@@ -248,6 +274,12 @@ private:
     QCheckBox *_chorusCheckBox;
     QComboBox *_sampleFormatCombo;
     QComboBox *_polyphonyCombo;
+    QSpinBox *_cpuCoresSpin;
+    QComboBox *_periodSizeCombo;
+    QComboBox *_periodsCombo;
+    QComboBox *_voiceStealingCombo;
+    QLabel *_renderSpeedLabel;
+    QPushButton *_measureSpeedBtn;
     QPushButton *_exportWavBtn;
 
 private slots:
@@ -267,7 +299,14 @@ private slots:
     void onChorusToggled(bool enabled);
     void onSampleFormatChanged(int index);
     void onPolyphonyChanged(int index);
+    void onCpuCoresChanged(int cores);
+    void onPeriodSizeChanged(int index);
+    void onPeriodsChanged(int index);
+    void onVoiceStealingChanged(int index);
+    void onMeasureRenderSpeed();
+    void onRenderSpeedMeasured(double factor);
     void refreshSoundFontList();
+    void onSoundFontLoadProgress(int loaded, int total);
     void reorderSoundFont(int fromRow, int toRow);
     void showDownloadSoundFontDialog();
 
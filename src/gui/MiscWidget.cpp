@@ -996,8 +996,8 @@ QList<QPair<int, int> > MiscWidget::getTrack(QList<MidiEvent *> *accordingEvents
 
     // get all events before the start tick to find out value before start
     int startTick = matrixWidget->minVisibleMidiTime();
-    QMultiMap<int, MidiEvent *> *channelEvents = matrixWidget->midiFile()->channel(channelToUse)->eventMap();
-    QMultiMap<int, MidiEvent *>::iterator it = channelEvents->upperBound(startTick);
+    EventMap *channelEvents = matrixWidget->midiFile()->channel(channelToUse)->eventMap();
+    EventMap::iterator it = channelEvents->upperBound(startTick);
 
     bool ok = false;
     int valueBefore = _default;
@@ -165,7 +165,7 @@ void RecordDialog::enter() {
         // first enlarge the file ( last event + 1000 ms)
         QMultiMap<int, MidiEvent *>::iterator it = _data.end();
         it--;
-        int minLength = it.key() + 1000;
+        int minLength = _file->msOfTick(it.key()) + 1000;
         if (minLength > _file->maxTime()) {
             _file->setMaxLengthMs(minLength);
         }
@@ -219,7 +219,7 @@ void RecordDialog::enter() {
                 toAdd->setFile(_file);
                 toAdd->setChannel(currentChannel, false);
                 toAdd->setTrack(track, false);
-                _file->channel(toAdd->channel())->insertEvent(toAdd, _file->tick(it.key()));
+                _file->channel(toAdd->channel())->insertEvent(toAdd, it.key());
             }
             it++;
         }
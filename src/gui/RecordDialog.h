@@ -54,7 +54,7 @@ public:
     /**
      * \brief Creates a new RecordDialog.
      * \param file The MidiFile to add recorded events to
-     * \param data The recorded MIDI event data
+     * \param data The recorded MIDI events by tick
      * \param settings QSettings instance for storing preferences
      * \param parent The parent widget
      */
@@ -76,7 +76,7 @@ private:
     /** \brief The target MIDI file */
     MidiFile *_file;
 
-    /** \brief The recorded MIDI event data */
+    /** \brief The recorded MIDI events by tick */
     QMultiMap<int, MidiEvent *> _data;
 
     /** \brief Channel and track selection combo boxes */
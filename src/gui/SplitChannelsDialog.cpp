@@ -302,7 +302,7 @@ void SplitChannelsDialog::analyzeTrack(MidiTrack *track) {
 
     QList<ChannelInfo> activeChannels;
     for (int ch = 0; ch < 16; ++ch) {
-        QMultiMap<int, MidiEvent *> *emap = _file->channel(ch)->eventMap();
+        EventMap *emap = _file->channel(ch)->eventMap();
         int eventCount = 0;
         int noteCount = 0;
         int prog = -1;
@@ -57,8 +57,8 @@ TempoDialog::TempoDialog(MidiFile *file, int startTick, int endTick, QWidget *pa
     }
 
     // identify tempo at start tick
-    QMap<int, MidiEvent *> *events = file->tempoEvents();
-    QMap<int, MidiEvent *>::iterator it = events->begin();
+    EventMap *events = file->tempoEvents();
+    EventMap::iterator it = events->begin();
     int tick = -1;
     MidiEvent *ev = 0;
     while (it != events->end()) {
@@ -128,8 +128,8 @@ void TempoDialog::accept() {
 
     // Delete all events in range
     QList<MidiEvent *> toRemove;
-    QMap<int, MidiEvent *> *events = _file->tempoEvents();
-    QMap<int, MidiEvent *>::iterator it = events->begin();
+    EventMap *events = _file->tempoEvents();
+    EventMap::iterator it = events->begin();
     int fromTick = _startTick;
     int toTick = _startTick;
     if (_endTick > -1) {
@@ -29,42 +29,49 @@
 #include "../MidiEvent/OnEvent.h"
 #include "../MidiEvent/PitchBendEvent.h"
 #include "../MidiEvent/TempoChangeEvent.h"
+#include "../midi/EventEditBatch.h"
 #include "../midi/MidiFile.h"
 #include "../protocol/Protocol.h"
 #include "../tool/Selection.h"
 
-static int getDivNumberForTime(QList<QPair<int, int> > divs, int time) {
-    for (int divNumber = divs.size() - 1; divNumber >= 0; divNumber--) {
-        if (divs.at(divNumber).second <= time) return divNumber;
+static int getDivStartTime(const QuantizationGrid &grid, int time) {
+    int divStartTime = grid.floor(time);
+    if (divStartTime < 0) {
+        divStartTime = grid.next(time);
     }
-
-    return 0;
+    return divStartTime;
 }
 
-static int getTimeOneDivEarlier(QList<QPair<int, int> > divs, int time) {
-    int divNumber = getDivNumberForTime(divs, time);
-    int divStartTime = divs.at(divNumber).second;
-    int previousDivStartTime;
+static int getTimeOneDivEarlier(const QuantizationGrid &grid, int time) {
+    int divStartTime = getDivStartTime(grid, time);
+    if (divStartTime < 0) {
+        return time;
+    }
+    int previousDivStartTime = grid.previous(divStartTime);
 
-    if (divNumber > 0) {
-        previousDivStartTime = divs.at(divNumber - 1).second;
-    } else {
-        int nextDivStartTime = divs.at(divNumber + 1).second;
+    if (previousDivStartTime < 0) {
+        int nextDivStartTime = grid.next(divStartTime);
+        if (nextDivStartTime < 0) {
+            return time;
+        }
         previousDivStartTime = divStartTime - (nextDivStartTime - divStartTime);
     }
 
     return previousDivStartTime + (time - divStartTime);
 }
 
-static int getTimeOneDivLater(QList<QPair<int, int> > divs, int time) {
-    int divNumber = getDivNumberForTime(divs, time);
-    int divStartTime = divs.at(divNumber).second;
-    int nextDivStartTime;
+static int getTimeOneDivLater(const QuantizationGrid &grid, int time) {
+    int divStartTime = getDivStartTime(grid, time);
+    if (divStartTime < 0) {
+        return time;
+    }
+    int nextDivStartTime = grid.next(divStartTime);
 
-    if (divNumber + 1 < divs.size()) {
-        nextDivStartTime = divs.at(divNumber + 1).second;
-    } else {
-        int previousDivStartTime = divs.at(divNumber - 1).second;
+    if (nextDivStartTime < 0) {
+        int previousDivStartTime = grid.previous(divStartTime);
+        if (previousDivStartTime < 0) {
+            return time;
+        }
         nextDivStartTime = divStartTime + (divStartTime - previousDivStartTime);
     }
 
@@ -84,21 +91,23 @@ void TimeTweakTarget::offset(int amount) {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
+            EventEditBatch batch(file);
 
             foreach(MidiEvent* e, selectedEvents) {
                 int newTime = e->midiTime() + amount;
 
                 if (newTime >= 0) {
-                    e->setMidiTime(newTime);
+                    batch.setMidiTime(e, newTime);
 
                     OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
                     if (onEvent) {
                         MidiEvent *offEvent = onEvent->offEvent();
-                        offEvent->setMidiTime(offEvent->midiTime() + amount);
+                        batch.setMidiTime(offEvent, offEvent->midiTime() + amount);
                     }
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -129,23 +138,25 @@ void TimeTweakTarget::largeDecrease() {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
-            QList<QPair<int, int> > divs = mainWindow->matrixWidget()->divs();
+            EventEditBatch batch(file);
+            QuantizationGrid grid = mainWindow->matrixWidget()->divGrid();
 
             foreach(MidiEvent* e, selectedEvents) {
                 int time = e->midiTime();
-                int newTime = getTimeOneDivEarlier(divs, time);
+                int newTime = getTimeOneDivEarlier(grid, time);
                 if (newTime >= 0) {
-                    e->setMidiTime(newTime);
+                    batch.setMidiTime(e, newTime);
 
                     OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
                     if (onEvent) {
                         MidiEvent *offEvent = onEvent->offEvent();
                         int newOffTime = offEvent->midiTime() + (newTime - time);
-                        offEvent->setMidiTime(newOffTime);
+                        batch.setMidiTime(offEvent, newOffTime);
                     }
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -160,21 +171,23 @@ void TimeTweakTarget::largeIncrease() {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
-            QList<QPair<int, int> > divs = mainWindow->matrixWidget()->divs();
+            EventEditBatch batch(file);
+            QuantizationGrid grid = mainWindow->matrixWidget()->divGrid();
 
             foreach(MidiEvent* e, selectedEvents) {
                 int time = e->midiTime();
-                int newTime = getTimeOneDivLater(divs, time);
-                e->setMidiTime(newTime);
+                int newTime = getTimeOneDivLater(grid, time);
+                batch.setMidiTime(e, newTime);
 
                 OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
                 if (onEvent) {
                     MidiEvent *offEvent = onEvent->offEvent();
                     int newOffTime = offEvent->midiTime() + (newTime - time);
-                    offEvent->setMidiTime(newOffTime);
+                    batch.setMidiTime(offEvent, newOffTime);
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -193,12 +206,14 @@ void StartTimeTweakTarget::offset(int amount) {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
+            EventEditBatch batch(file);
 
             foreach(MidiEvent* e, selectedEvents) {
                 int newTime = e->midiTime() + amount;
-                if (newTime >= 0) e->setMidiTime(newTime);
+                if (newTime >= 0) batch.setMidiTime(e, newTime);
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -229,13 +244,15 @@ void StartTimeTweakTarget::largeDecrease() {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
-            QList<QPair<int, int> > divs = mainWindow->matrixWidget()->divs();
+            EventEditBatch batch(file);
+            QuantizationGrid grid = mainWindow->matrixWidget()->divGrid();
 
             foreach(MidiEvent* e, selectedEvents) {
-                int newTime = getTimeOneDivEarlier(divs, e->midiTime());
-                if (newTime >= 0) e->setMidiTime(newTime);
+                int newTime = getTimeOneDivEarlier(grid, e->midiTime());
+                if (newTime >= 0) batch.setMidiTime(e, newTime);
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -250,19 +267,21 @@ void StartTimeTweakTarget::largeIncrease() {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
-            QList<QPair<int, int> > divs = mainWindow->matrixWidget()->divs();
+            EventEditBatch batch(file);
+            QuantizationGrid grid = mainWindow->matrixWidget()->divGrid();
 
             foreach(MidiEvent* e, selectedEvents) {
-                int newTime = getTimeOneDivLater(divs, e->midiTime());
-                e->setMidiTime(newTime);
+                int newTime = getTimeOneDivLater(grid, e->midiTime());
+                batch.setMidiTime(e, newTime);
 
                 OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
                 if (onEvent) {
                     MidiEvent *offEvent = onEvent->offEvent();
-                    if (newTime > offEvent->midiTime()) offEvent->setMidiTime(newTime);
+                    if (newTime > offEvent->midiTime()) batch.setMidiTime(offEvent, newTime);
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -281,6 +300,7 @@ void EndTimeTweakTarget::offset(int amount) {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
+            EventEditBatch batch(file);
 
             foreach(MidiEvent* e, selectedEvents) {
                 OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
@@ -288,15 +308,16 @@ void EndTimeTweakTarget::offset(int amount) {
                     MidiEvent *offEvent = onEvent->offEvent();
                     int newTime = offEvent->midiTime() + amount;
                     if (newTime >= 0) {
-                        offEvent->setMidiTime(newTime);
-                        if (newTime < onEvent->midiTime()) onEvent->setMidiTime(newTime);
+                        batch.setMidiTime(offEvent, newTime);
+                        if (newTime < onEvent->midiTime()) batch.setMidiTime(onEvent, newTime);
                     }
                 } else {
                     int newTime = e->midiTime() + amount;
-                    if (newTime >= 0) e->setMidiTime(newTime);
+                    if (newTime >= 0) batch.setMidiTime(e, newTime);
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -327,23 +348,25 @@ void EndTimeTweakTarget::largeDecrease() {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
-            QList<QPair<int, int> > divs = mainWindow->matrixWidget()->divs();
+            EventEditBatch batch(file);
+            QuantizationGrid grid = mainWindow->matrixWidget()->divGrid();
 
             foreach(MidiEvent* e, selectedEvents) {
                 OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
                 if (onEvent) {
                     MidiEvent *offEvent = onEvent->offEvent();
-                    int newTime = getTimeOneDivEarlier(divs, offEvent->midiTime());
+                    int newTime = getTimeOneDivEarlier(grid, offEvent->midiTime());
                     if (newTime >= 0) {
-                        offEvent->setMidiTime(newTime);
-                        if (newTime < onEvent->midiTime()) onEvent->setMidiTime(newTime);
+                        batch.setMidiTime(offEvent, newTime);
+                        if (newTime < onEvent->midiTime()) batch.setMidiTime(onEvent, newTime);
                     }
                 } else {
-                    int newTime = getTimeOneDivEarlier(divs, e->midiTime());
-                    if (newTime >= 0) e->setMidiTime(newTime);
+                    int newTime = getTimeOneDivEarlier(grid, e->midiTime());
+                    if (newTime >= 0) batch.setMidiTime(e, newTime);
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -358,20 +381,22 @@ void EndTimeTweakTarget::largeIncrease() {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
-            QList<QPair<int, int> > divs = mainWindow->matrixWidget()->divs();
+            EventEditBatch batch(file);
+            QuantizationGrid grid = mainWindow->matrixWidget()->divGrid();
 
             foreach(MidiEvent* e, selectedEvents) {
                 OnEvent *onEvent = dynamic_cast<OnEvent *>(e);
                 if (onEvent) {
                     MidiEvent *offEvent = onEvent->offEvent();
-                    int newTime = getTimeOneDivLater(divs, offEvent->midiTime());
-                    offEvent->setMidiTime(newTime);
+                    int newTime = getTimeOneDivLater(grid, offEvent->midiTime());
+                    batch.setMidiTime(offEvent, newTime);
                 } else {
-                    int newTime = getTimeOneDivLater(divs, e->midiTime());
-                    e->setMidiTime(newTime);
+                    int newTime = getTimeOneDivLater(grid, e->midiTime());
+                    batch.setMidiTime(e, newTime);
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -390,15 +415,17 @@ void NoteTweakTarget::offset(int amount) {
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction(QObject::tr("Tweak"));
+            EventEditBatch batch(file);
 
             foreach(MidiEvent* e, selectedEvents) {
                 NoteOnEvent *noteOnEvent = dynamic_cast<NoteOnEvent *>(e);
                 if (noteOnEvent) {
                     int newNote = noteOnEvent->note() + amount;
-                    if (newNote >= 0) noteOnEvent->setNote(newNote);
+                    if (newNote >= 0) batch.setNote(noteOnEvent, newNote);
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
@@ -442,12 +469,13 @@ void ValueTweakTarget::offset(int amount, int pitchBendAmount, int tempoAmount)
         if (selectedEvents.size() > 0) {
             Protocol *protocol = file->protocol();
             protocol->startNewAction("Tweak");
+            EventEditBatch batch(file);
 
             foreach(MidiEvent* e, selectedEvents) {
                 NoteOnEvent *noteOnEvent = dynamic_cast<NoteOnEvent *>(e);
                 if (noteOnEvent) {
                     int newVelocity = noteOnEvent->velocity() + amount;
-                    if (newVelocity >= 0) noteOnEvent->setVelocity(newVelocity);
+                    if (newVelocity >= 0) batch.setVelocity(noteOnEvent, newVelocity);
                 }
 
                 ControlChangeEvent *controlChangeEvent = dynamic_cast<ControlChangeEvent *>(e);
@@ -481,6 +509,7 @@ void ValueTweakTarget::offset(int amount, int pitchBendAmount, int tempoAmount)
                 }
             }
 
+            batch.commit();
             protocol->endAction();
         }
     }
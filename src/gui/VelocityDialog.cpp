@@ -26,6 +26,7 @@
 #include <QSpinBox>
 
 #include "../MidiEvent/NoteOnEvent.h"
+#include "../midi/EventEditBatch.h"
 #include "../midi/MidiFile.h"
 #include "../protocol/Protocol.h"
 
@@ -68,9 +69,11 @@ void VelocityDialog::accept() {
 
     if (!_toUpdate.isEmpty()) {
         _file->protocol()->startNewAction(tr("Set Velocity"));
+        EventEditBatch batch(_file);
         foreach(NoteOnEvent* e, _toUpdate) {
-            e->setVelocity(velocity);
+            batch.setVelocity(e, velocity);
         }
+        batch.commit();
         _file->protocol()->endAction();
     }
     hide();
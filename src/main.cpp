@@ -25,6 +25,7 @@
 #include "gui/Appearance.h"
 #include "midi/MidiInput.h"
 #include "midi/MidiOutput.h"
+#include "midi/MidiThru.h"
 
 #include <QFile>
 #include <QFileInfo>
@@ -225,5 +226,8 @@ int main(int argc, char *argv[]) {
     else
         w = new MainWindow();
     w->showMaximized();
-    return a.exec();
+    int result = a.exec();
+
+    MidiThru::instance()->stop();
+    return result;
 }
@@ -0,0 +1,127 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AudioExportSchedule.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/NoteOnEvent.h"
+#include "MidiFile.h"
+#include "TempoMap.h"
+
+AudioExportSchedule::AudioExportSchedule() {
+    _durationMs = 0;
+    _noteCount = 0;
+}
+
+void AudioExportSchedule::build(MidiFile *file, int startTick, int endTick, MidiTrack *track, int channel) {
+    _messages.clear();
+    _sysexData.clear();
+    _noteCount = 0;
+
+    int actualEnd = (endTick == -1) ? file->endTick() : endTick;
+    if (actualEnd < startTick) {
+        actualEnd = startTick;
+    }
+
+    TempoMap tempo = file->tempoMap();
+    double startMs = tempo.msOfTick(startTick);
+    _durationMs = tempo.msOfTick(actualEnd) - startMs;
+
+    QList<MidiEvent *> events = file->exportEvents(startTick, endTick);
+    _messages.reserve(events.size());
+
+    // channels the track plays notes on
+    bool trackChannels[16];
+    for (int ch = 0; ch < 16; ch++) {
+        trackChannels[ch] = !track;
+    }
+    if (track) {
+        for (MidiEvent *event : events) {
+            if (event->track() == track && event->channel() < 16 && dynamic_cast<NoteOnEvent *>(event)) {
+                trackChannels[event->channel()] = true;
+            }
+        }
+    }
+
+    for (MidiEvent *event : events) {
+        // the state injected from before the range starts with the range
+        int tick = qMax(event->midiTime(), startTick);
+
+        Message message;
+        message.ms = tempo.msOfTick(tick) - startMs;
+        message.length = 0;
+        message.sysexOffset = -1;
+        message.sysexLength = 0;
+
+        if (event->line() == MidiEvent::SYSEX_LINE) {
+            QByteArray data = event->save();
+            message.sysexOffset = _sysexData.size();
+            message.sysexLength = data.size();
+            _sysexData.append(data);
+            _messages.append(message);
+            continue;
+        }
+
+        int ch = event->channel();
+        if (ch > 15 || (channel >= 0 && ch != channel) || !trackChannels[ch]) {
+            continue;
+        }
+        QByteArray data = event->save();
+        if (data.size() < 1 || data.size() > 3) {
+            continue;
+        }
+        message.length = data.size();
+        for (int i = 0; i < data.size(); i++) {
+            message.data[i] = (quint8) data.at(i);
+        }
+
+        // notes (and their key pressure) belong to their own track only
+        quint8 type = message.data[0] & 0xF0;
+        bool note = type == 0x80 || type == 0x90 || type == 0xA0;
+        if (note && track && event->track() != track) {
+            continue;
+        }
+        if (type == 0x90 && message.length == 3 && message.data[2] > 0) {
+            _noteCount++;
+        }
+        _messages.append(message);
+    }
+}
+
+int AudioExportSchedule::size() const {
+    return _messages.size();
+}
+
+const AudioExportSchedule::Message &AudioExportSchedule::at(int i) const {
+    return _messages.at(i);
+}
+
+const quint8 *AudioExportSchedule::sysexData(const Message &message) const {
+    if (message.sysexOffset < 0) {
+        return 0;
+    }
+    return reinterpret_cast<const quint8 *>(_sysexData.constData()) + message.sysexOffset;
+}
+
+double AudioExportSchedule::durationMs() const {
+    return _durationMs;
+}
+
+bool AudioExportSchedule::hasNotes() const {
+    return _noteCount > 0;
+}
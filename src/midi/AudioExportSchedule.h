@@ -0,0 +1,132 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIOEXPORTSCHEDULE_H_
+#define AUDIOEXPORTSCHEDULE_H_
+
+// Qt includes
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+// Forward declarations
+class MidiFile;
+class MidiTrack;
+
+/**
+ * \class AudioExportSchedule
+ *
+ * \brief Time-sorted, pre-encoded MIDI messages of an audio export.
+ *
+ * The schedule is a snapshot of MidiFile::exportEvents(): every message is
+ * encoded once and stamped with its time in milliseconds relative to the
+ * start of the exported range. It does not reference the file's events, so
+ * it can be rendered on a worker thread while the file is edited.
+ *
+ * Channel messages are stored inline (length and up to 3 data bytes), SysEx
+ * messages in a side buffer (see sysexData()), as in PlaybackSchedule. Meta
+ * events are not stored; their timing is already part of the message times.
+ *
+ * A schedule can be restricted to a single track or channel to render it as
+ * a stem. SysEx messages are part of every stem, as they usually configure
+ * the whole synth.
+ */
+class AudioExportSchedule {
+public:
+    /**
+     * \brief One MIDI message of the export.
+     */
+    struct Message {
+        /** \brief Time in milliseconds from the start of the range */
+        double ms;
+
+        /** \brief Length of the short message (0 for SysEx) */
+        quint8 length;
+
+        /** \brief Encoded channel message */
+        quint8 data[3];
+
+        /** \brief Offset of the SysEx message in the side buffer (-1 if none) */
+        int sysexOffset;
+
+        /** \brief Length of the SysEx message in bytes */
+        int sysexLength;
+    };
+
+    /**
+     * \brief Creates an empty schedule.
+     */
+    AudioExportSchedule();
+
+    /**
+     * \brief Builds the schedule for a range of the file.
+     *
+     * With a track, the notes of that track are scheduled together with the
+     * other channel messages (programs, controllers, pitch bend) of all
+     * tracks on the channels the track plays on, so the stem sounds as it
+     * does in the full mix.
+     *
+     * \param file The MidiFile to export
+     * \param startTick First tick of the range
+     * \param endTick Last tick of the range (-1 for the end of the file)
+     * \param track Only schedule this track (0 for all tracks)
+     * \param channel Only schedule this channel (-1 for all channels)
+     */
+    void build(MidiFile *file, int startTick, int endTick, MidiTrack *track = 0, int channel = -1);
+
+    /**
+     * \brief Gets the number of messages.
+     */
+    int size() const;
+
+    /**
+     * \brief Gets the message at index i.
+     */
+    const Message &at(int i) const;
+
+    /**
+     * \brief Gets the SysEx message of a message (sysexLength bytes).
+     * \return The message, or 0 if it is a short message
+     */
+    const quint8 *sysexData(const Message &message) const;
+
+    /**
+     * \brief Gets the length of the range in milliseconds.
+     */
+    double durationMs() const;
+
+    /**
+     * \brief Returns true if the schedule contains at least one note.
+     */
+    bool hasNotes() const;
+
+private:
+    /** \brief All messages sorted by time */
+    QVector<Message> _messages;
+
+    /** \brief Side buffer for the SysEx messages */
+    QByteArray _sysexData;
+
+    /** \brief Length of the range */
+    double _durationMs;
+
+    /** \brief Number of scheduled note ons */
+    int _noteCount;
+};
+
+#endif // AUDIOEXPORTSCHEDULE_H_
@@ -0,0 +1,132 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EventEditBatch.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/NoteOnEvent.h"
+#include "../protocol/EventBatchProtocolItem.h"
+#include "../protocol/Protocol.h"
+#include "MidiChannel.h"
+#include "MidiFile.h"
+
+EventEditBatch::EventEditBatch(MidiFile *file) {
+    _file = file;
+    _committed = false;
+}
+
+EventEditBatch::~EventEditBatch() {
+    if (!_committed) {
+        commit();
+    }
+}
+
+EventEditBatch::State EventEditBatch::stateOf(MidiEvent *event) {
+    NoteOnEvent *noteOn = dynamic_cast<NoteOnEvent *>(event);
+    State state;
+    state.event = event;
+    state.tick = event->timePos;
+    state.note = noteOn ? noteOn->note() : -1;
+    state.velocity = noteOn ? noteOn->velocity() : -1;
+    return state;
+}
+
+void EventEditBatch::remember(MidiEvent *event) {
+    if (!_index.contains(event)) {
+        _index.insert(event, _oldStates.size());
+        _oldStates.append(stateOf(event));
+    }
+}
+
+void EventEditBatch::setMidiTime(MidiEvent *event, int tick) {
+    int channel = event->channel();
+    // if its once TimeSig / TempoChange at 0, dont move the event
+    if ((channel == 18 || channel == 17) && event->midiTime() == 0
+        && _file->channel(channel)->eventMap()->count(0) == 1) {
+        return;
+    }
+    remember(event);
+    event->timePos = tick;
+}
+
+void EventEditBatch::setNote(NoteOnEvent *event, int note) {
+    remember(event);
+    event->setNote(note, false);
+}
+
+void EventEditBatch::setVelocity(NoteOnEvent *event, int velocity) {
+    remember(event);
+    event->setVelocity(velocity, false);
+}
+
+int EventEditBatch::size() {
+    return _oldStates.size();
+}
+
+void EventEditBatch::commit() {
+    _committed = true;
+    if (_oldStates.isEmpty()) {
+        return;
+    }
+
+    // the maps still contain the events at their old ticks
+    int maxTick = 0;
+    for (const State &old : _oldStates) {
+        MidiEvent *event = old.event;
+        int tick = event->timePos;
+        if (tick != old.tick) {
+            EventMap *map = _file->channelEvents(event->channel());
+            map->remove(old.tick, event);
+            map->insert(tick, event);
+            maxTick = qMax(maxTick, tick);
+        }
+    }
+    finish(_file, maxTick);
+
+    if (_file->protocol()) {
+        _file->protocol()->enterUndoStep(new EventBatchProtocolItem(_file, _oldStates));
+    }
+    _oldStates.clear();
+    _index.clear();
+}
+
+void EventEditBatch::apply(MidiFile *file, const QVector<State> &states) {
+    int maxTick = 0;
+    for (const State &state : states) {
+        MidiEvent *event = state.event;
+        if (event->timePos != state.tick) {
+            EventMap *map = file->channelEvents(event->channel());
+            map->remove(event->timePos, event);
+            event->timePos = state.tick;
+            map->insert(state.tick, event);
+            maxTick = qMax(maxTick, state.tick);
+        }
+        NoteOnEvent *noteOn = dynamic_cast<NoteOnEvent *>(event);
+        if (noteOn && state.note >= 0) {
+            noteOn->setNote(state.note, false);
+            noteOn->setVelocity(state.velocity, false);
+        }
+    }
+    finish(file, maxTick);
+}
+
+void EventEditBatch::finish(MidiFile *file, int maxTick) {
+    if (maxTick > file->endTick()) {
+        file->setMaxLengthMs(file->msOfTick(maxTick) + 100);
+    }
+}
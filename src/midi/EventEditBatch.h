@@ -0,0 +1,140 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENTEDITBATCH_H_
+#define EVENTEDITBATCH_H_
+
+// Qt includes
+#include <QHash>
+#include <QVector>
+
+// Forward declarations
+class MidiFile;
+class MidiEvent;
+class NoteOnEvent;
+
+/**
+ * \class EventEditBatch
+ *
+ * \brief Transaction for changing the time, note or velocity of many events.
+ *
+ * Calling MidiEvent::setMidiTime() or NoteOnEvent::setNote() for every
+ * selected event copies each event for the protocol and notifies the
+ * protocol once per event. EventEditBatch changes the event fields at once,
+ * but moves the events inside the channel maps and enters a single
+ * EventBatchProtocolItem (a list of the events' previous states) when the
+ * batch is committed:
+ *
+ * \code
+ * EventEditBatch batch(file);
+ * foreach (MidiEvent *e, events) {
+ *     batch.setMidiTime(e, e->midiTime() + 10);
+ * }
+ * batch.commit();
+ * \endcode
+ *
+ * Between the first change and commit() the channel maps still use the old
+ * ticks, so the maps must not be searched for changed events. The batch is
+ * committed on destruction if commit() has not been called.
+ */
+class EventEditBatch {
+public:
+    /**
+     * \brief The fields of an event that can be changed by the batch.
+     */
+    struct State {
+        MidiEvent *event;
+        int tick;
+        int note;     ///< -1 for events that are no NoteOnEvents
+        int velocity; ///< -1 for events that are no NoteOnEvents
+    };
+
+    /**
+     * \brief Creates an empty batch for file.
+     */
+    EventEditBatch(MidiFile *file);
+
+    /**
+     * \brief Commits the batch if it has not been committed.
+     */
+    ~EventEditBatch();
+
+    /**
+     * \brief Sets the tick of event.
+     *
+     * Like MidiEvent::setMidiTime(), the only tempo or time signature
+     * event at tick 0 is not moved.
+     */
+    void setMidiTime(MidiEvent *event, int tick);
+
+    /**
+     * \brief Sets the note of event.
+     */
+    void setNote(NoteOnEvent *event, int note);
+
+    /**
+     * \brief Sets the velocity of event (clamped to 0-127).
+     */
+    void setVelocity(NoteOnEvent *event, int velocity);
+
+    /**
+     * \brief Gets the number of changed events.
+     */
+    int size();
+
+    /**
+     * \brief Moves the changed events in the channel maps and protocols
+     * the batch as one ProtocolItem.
+     */
+    void commit();
+
+    /**
+     * \brief Gets the current state of event.
+     */
+    static State stateOf(MidiEvent *event);
+
+    /**
+     * \brief Restores the given states, moving the events in the channel maps.
+     */
+    static void apply(MidiFile *file, const QVector<State> &states);
+
+private:
+    /**
+     * \brief Stores the state of event before its first change.
+     */
+    void remember(MidiEvent *event);
+
+    /**
+     * \brief Updates the file after events have been moved.
+     */
+    static void finish(MidiFile *file, int maxTick);
+
+    /** \brief The file the events belong to */
+    MidiFile *_file;
+
+    /** \brief The states before the first change, in order of the changes */
+    QVector<State> _oldStates;
+
+    /** \brief Events already stored in _oldStates */
+    QHash<MidiEvent *, int> _index;
+
+    /** \brief True after commit() */
+    bool _committed;
+};
+
+#endif // EVENTEDITBATCH_H_
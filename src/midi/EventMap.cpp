@@ -0,0 +1,429 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EventMap.h"
+
+#include <QSet>
+
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// last stamp given to a map
+std::atomic<quint64> s_lastStamp(0);
+
+bool entryBeforeKey(const EventMap::Entry &entry, int key) {
+    return entry.key < key;
+}
+
+bool keyBeforeEntry(int key, const EventMap::Entry &entry) {
+    return key < entry.key;
+}
+
+}
+
+EventMap::const_iterator::const_iterator() {
+    _map = 0;
+    _leaf = 0;
+    _pos = 0;
+}
+
+EventMap::const_iterator::const_iterator(const EventMap *map, int leaf, int pos) {
+    _map = map;
+    _leaf = leaf;
+    _pos = pos;
+}
+
+const EventMap::Entry &EventMap::const_iterator::entry() const {
+    return _map->_leaves.at(_leaf).at(_pos);
+}
+
+int EventMap::const_iterator::key() const {
+    return entry().key;
+}
+
+MidiEvent *EventMap::const_iterator::value() const {
+    return entry().value;
+}
+
+EventMap::const_iterator::reference EventMap::const_iterator::operator*() const {
+    return entry().value;
+}
+
+EventMap::const_iterator::pointer EventMap::const_iterator::operator->() const {
+    return &entry().value;
+}
+
+EventMap::const_iterator &EventMap::const_iterator::operator++() {
+    _pos++;
+    if (_pos >= _map->_leaves.at(_leaf).size()) {
+        _leaf++;
+        _pos = 0;
+    }
+    return *this;
+}
+
+EventMap::const_iterator EventMap::const_iterator::operator++(int) {
+    const_iterator previous = *this;
+    ++(*this);
+    return previous;
+}
+
+EventMap::const_iterator &EventMap::const_iterator::operator--() {
+    if (_pos > 0) {
+        _pos--;
+    } else {
+        _leaf--;
+        _pos = _map->_leaves.at(_leaf).size() - 1;
+    }
+    return *this;
+}
+
+EventMap::const_iterator EventMap::const_iterator::operator--(int) {
+    const_iterator previous = *this;
+    --(*this);
+    return previous;
+}
+
+bool EventMap::const_iterator::operator==(const const_iterator &other) const {
+    return _map == other._map && _leaf == other._leaf && _pos == other._pos;
+}
+
+bool EventMap::const_iterator::operator!=(const const_iterator &other) const {
+    return !(*this == other);
+}
+
+EventMap::EventMap() {
+    _size = 0;
+    _stamp = 0;
+}
+
+int EventMap::size() const {
+    return _size;
+}
+
+int EventMap::count() const {
+    return _size;
+}
+
+int EventMap::count(int key) const {
+    int n = 0;
+    for (const_iterator it = lowerBound(key); it != constEnd() && it.key() == key; ++it) {
+        n++;
+    }
+    return n;
+}
+
+bool EventMap::isEmpty() const {
+    return _size == 0;
+}
+
+bool EventMap::contains(int key) const {
+    return find(key) != constEnd();
+}
+
+EventMap::const_iterator EventMap::begin() const {
+    return const_iterator(this, 0, 0);
+}
+
+EventMap::const_iterator EventMap::end() const {
+    return const_iterator(this, _leaves.size(), 0);
+}
+
+EventMap::const_iterator EventMap::constBegin() const {
+    return begin();
+}
+
+EventMap::const_iterator EventMap::constEnd() const {
+    return end();
+}
+
+EventMap::const_iterator EventMap::cbegin() const {
+    return begin();
+}
+
+EventMap::const_iterator EventMap::cend() const {
+    return end();
+}
+
+int EventMap::findLeaf(int key, bool upper) const {
+    int low = 0;
+    int high = _leaves.size();
+    while (low < high) {
+        int mid = (low + high) / 2;
+        int last = _leaves.at(mid).constLast().key;
+        if (upper ? last > key : last >= key) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+EventMap::const_iterator EventMap::lowerBound(int key) const {
+    int leaf = findLeaf(key, false);
+    if (leaf >= _leaves.size()) {
+        return end();
+    }
+    const QVector<Entry> &entries = _leaves.at(leaf);
+    int pos = std::lower_bound(entries.constBegin(), entries.constEnd(), key, entryBeforeKey) - entries.constBegin();
+    return const_iterator(this, leaf, pos);
+}
+
+EventMap::const_iterator EventMap::upperBound(int key) const {
+    int leaf = findLeaf(key, true);
+    if (leaf >= _leaves.size()) {
+        return end();
+    }
+    const QVector<Entry> &entries = _leaves.at(leaf);
+    int pos = std::upper_bound(entries.constBegin(), entries.constEnd(), key, keyBeforeEntry) - entries.constBegin();
+    return const_iterator(this, leaf, pos);
+}
+
+std::pair<EventMap::const_iterator, EventMap::const_iterator> EventMap::equal_range(int key) const {
+    return std::make_pair(lowerBound(key), upperBound(key));
+}
+
+EventMap::const_iterator EventMap::find(int key) const {
+    const_iterator it = lowerBound(key);
+    if (it != constEnd() && it.key() == key) {
+        return it;
+    }
+    return constEnd();
+}
+
+EventMap::const_iterator EventMap::find(int key, MidiEvent *value) const {
+    for (const_iterator it = lowerBound(key); it != constEnd() && it.key() == key; ++it) {
+        if (it.value() == value) {
+            return it;
+        }
+    }
+    return constEnd();
+}
+
+EventMap::const_iterator EventMap::constFind(int key) const {
+    return find(key);
+}
+
+MidiEvent *EventMap::value(int key, MidiEvent *defaultValue) const {
+    const_iterator it = find(key);
+    return it != constEnd() ? it.value() : defaultValue;
+}
+
+QList<MidiEvent *> EventMap::values() const {
+    QList<MidiEvent *> result;
+    result.reserve(_size);
+    for (const QVector<Entry> &entries : _leaves) {
+        for (const Entry &entry : entries) {
+            result.append(entry.value);
+        }
+    }
+    return result;
+}
+
+QList<MidiEvent *> EventMap::values(int key) const {
+    QList<MidiEvent *> result;
+    for (const_iterator it = lowerBound(key); it != constEnd() && it.key() == key; ++it) {
+        result.append(it.value());
+    }
+    return result;
+}
+
+QList<int> EventMap::keys() const {
+    QList<int> result;
+    result.reserve(_size);
+    for (const QVector<Entry> &entries : _leaves) {
+        for (const Entry &entry : entries) {
+            result.append(entry.key);
+        }
+    }
+    return result;
+}
+
+QList<int> EventMap::uniqueKeys() const {
+    QList<int> result;
+    for (const QVector<Entry> &entries : _leaves) {
+        for (const Entry &entry : entries) {
+            if (result.isEmpty() || result.constLast() != entry.key) {
+                result.append(entry.key);
+            }
+        }
+    }
+    return result;
+}
+
+int EventMap::firstKey() const {
+    return _leaves.constFirst().constFirst().key;
+}
+
+int EventMap::lastKey() const {
+    return _leaves.constLast().constLast().key;
+}
+
+MidiEvent *EventMap::first() const {
+    return _leaves.constFirst().constFirst().value;
+}
+
+MidiEvent *EventMap::last() const {
+    return _leaves.constLast().constLast().value;
+}
+
+EventMap::const_iterator EventMap::insertAt(int leaf, int pos, int key, MidiEvent *value) {
+    Entry entry = {key, value};
+    _size++;
+    touch();
+    if (_leaves.isEmpty()) {
+        _leaves.append(QVector<Entry>(1, entry));
+        return const_iterator(this, 0, 0);
+    }
+
+    QVector<Entry> &entries = _leaves[leaf];
+    entries.insert(pos, entry);
+    if (entries.size() > MAX_LEAF_SIZE) {
+        int half = entries.size() / 2;
+        QVector<Entry> right(entries.constBegin() + half, entries.constEnd());
+        entries.resize(half);
+        _leaves.insert(leaf + 1, right);
+        if (pos >= half) {
+            leaf++;
+            pos -= half;
+        }
+    }
+    return const_iterator(this, leaf, pos);
+}
+
+EventMap::const_iterator EventMap::insert(int key, MidiEvent *value) {
+    if (_leaves.isEmpty()) {
+        return insertAt(0, 0, key, value);
+    }
+    int leaf = findLeaf(key, false);
+    if (leaf >= _leaves.size()) {
+        leaf = _leaves.size() - 1;
+        return insertAt(leaf, _leaves.at(leaf).size(), key, value);
+    }
+    const QVector<Entry> &entries = _leaves.at(leaf);
+    int pos = std::lower_bound(entries.constBegin(), entries.constEnd(), key, entryBeforeKey) - entries.constBegin();
+    return insertAt(leaf, pos, key, value);
+}
+
+EventMap::const_iterator EventMap::insert(const_iterator pos, int key, MidiEvent *value) {
+    if (pos._map != this) {
+        return insert(key, value);
+    }
+    bool fitsBefore = pos == constEnd() || pos.key() >= key;
+    bool fitsAfter = pos == constBegin() || std::prev(pos).key() <= key;
+    if (!fitsBefore || !fitsAfter) {
+        return insert(key, value);
+    }
+    if (pos == constEnd() && !_leaves.isEmpty()) {
+        int leaf = _leaves.size() - 1;
+        return insertAt(leaf, _leaves.at(leaf).size(), key, value);
+    }
+    return insertAt(pos._leaf, pos._pos, key, value);
+}
+
+EventMap::const_iterator EventMap::erase(const_iterator pos) {
+    int leaf = pos._leaf;
+    int index = pos._pos;
+    QVector<Entry> &entries = _leaves[leaf];
+    entries.remove(index);
+    _size--;
+    touch();
+
+    if (entries.isEmpty()) {
+        _leaves.remove(leaf);
+        return const_iterator(this, leaf, 0);
+    }
+
+    // keep the leaves from fragmenting when many entries are removed
+    if (entries.size() < MIN_LEAF_SIZE) {
+        if (leaf + 1 < _leaves.size() && entries.size() + _leaves.at(leaf + 1).size() <= MAX_LEAF_SIZE) {
+            entries.append(_leaves.at(leaf + 1));
+            _leaves.remove(leaf + 1);
+        } else if (leaf > 0 && _leaves.at(leaf - 1).size() + entries.size() <= MAX_LEAF_SIZE) {
+            QVector<Entry> merged = entries;
+            _leaves.remove(leaf);
+            leaf--;
+            index += _leaves.at(leaf).size();
+            _leaves[leaf].append(merged);
+        }
+    }
+
+    if (index >= _leaves.at(leaf).size()) {
+        leaf++;
+        index = 0;
+    }
+    return const_iterator(this, leaf, index);
+}
+
+int EventMap::remove(int key) {
+    int removed = 0;
+    const_iterator it = lowerBound(key);
+    while (it != constEnd() && it.key() == key) {
+        it = erase(it);
+        removed++;
+    }
+    return removed;
+}
+
+int EventMap::remove(int key, MidiEvent *value) {
+    int removed = 0;
+    const_iterator it = lowerBound(key);
+    while (it != constEnd() && it.key() == key) {
+        if (it.value() == value) {
+            it = erase(it);
+            removed++;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+void EventMap::clear() {
+    _leaves.clear();
+    _size = 0;
+    touch();
+}
+
+qint64 EventMap::memoryCost(const EventMap *shared) const {
+    // the leaf list plus the entries and allocation header of every leaf
+    qint64 cost = qint64(_leaves.size()) * sizeof(QVector<Entry>);
+    QSet<const Entry *> sharedLeaves;
+    if (shared) {
+        for (const QVector<Entry> &leaf : shared->_leaves) {
+            sharedLeaves.insert(leaf.constData());
+        }
+    }
+    for (const QVector<Entry> &leaf : _leaves) {
+        if (!sharedLeaves.contains(leaf.constData())) {
+            cost += qint64(leaf.size()) * sizeof(Entry) + 16;
+        }
+    }
+    return cost;
+}
+
+quint64 EventMap::stamp() const {
+    return _stamp;
+}
+
+void EventMap::touch() {
+    _stamp = ++s_lastStamp;
+}
@@ -0,0 +1,312 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENTMAP_H_
+#define EVENTMAP_H_
+
+// Qt includes
+#include <QList>
+#include <QVector>
+
+// Standard includes
+#include <iterator>
+#include <utility>
+
+// Forward declarations
+class MidiEvent;
+
+/**
+ * \class EventMap
+ *
+ * \brief Flat, tick ordered container of the events of a channel.
+ *
+ * EventMap replaces the QMultiMap<int, MidiEvent*> a MidiChannel used to
+ * keep its events in. A tree map allocates one node per event and every
+ * step of an iteration follows a pointer to another place in memory; with
+ * files of a million events, walking a channel or a tick range is dominated
+ * by cache misses.
+ *
+ * EventMap stores (tick, event) entries in sorted leaves of at most
+ * MAX_LEAF_SIZE entries, like the bottom level of a B+tree. Iterating and
+ * range queries read packed arrays; inserting or removing an entry moves at
+ * most one leaf. Leaves are implicitly shared, so copying a map (as the
+ * protocol does for every snapshot of a channel) is cheap and a modification
+ * after the copy duplicates only the leaf it touches.
+ *
+ * The interface is the subset of QMultiMap the editor uses, with the same
+ * semantics: entries with equal ticks keep their order, insert() places a new
+ * entry in front of the entries with the same tick and value() returns the
+ * first entry of a tick. Unlike QMultiMap, every modification invalidates
+ * all iterators of the map.
+ */
+class EventMap {
+public:
+    /** \brief Maximum number of entries in a leaf */
+    static const int MAX_LEAF_SIZE = 512;
+
+    /** \brief A leaf below this size is merged with a neighbour */
+    static const int MIN_LEAF_SIZE = MAX_LEAF_SIZE / 4;
+
+    /**
+     * \brief One event and its tick.
+     */
+    struct Entry {
+        int key;
+        MidiEvent *value;
+    };
+
+    /**
+     * \class const_iterator
+     *
+     * \brief Bidirectional iterator over the entries of an EventMap.
+     *
+     * Events are modified through the map, not through the iterator, so
+     * iterator and const_iterator are the same type.
+     */
+    class const_iterator {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef qptrdiff difference_type;
+        typedef MidiEvent *value_type;
+        typedef MidiEvent *const *pointer;
+        typedef MidiEvent *const &reference;
+
+        /**
+         * \brief Creates an iterator that does not point into a map.
+         */
+        const_iterator();
+
+        /** \brief Gets the tick of the entry */
+        int key() const;
+
+        /** \brief Gets the event of the entry */
+        MidiEvent *value() const;
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        const_iterator &operator--();
+        const_iterator operator--(int);
+
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+
+    private:
+        friend class EventMap;
+
+        const_iterator(const EventMap *map, int leaf, int pos);
+
+        /** \brief The entry the iterator points to */
+        const Entry &entry() const;
+
+        /** \brief The iterated map */
+        const EventMap *_map;
+
+        /** \brief Leaf and position in the leaf; end() is (leaf count, 0) */
+        int _leaf, _pos;
+    };
+
+    typedef const_iterator iterator;
+    typedef const_iterator Iterator;
+    typedef const_iterator ConstIterator;
+
+    /**
+     * \brief Creates an empty map.
+     */
+    EventMap();
+
+    // === Size ===
+
+    /** \brief Gets the number of entries */
+    int size() const;
+
+    /** \brief Gets the number of entries */
+    int count() const;
+
+    /** \brief Gets the number of entries at tick key */
+    int count(int key) const;
+
+    /** \brief Returns true if the map holds no entries */
+    bool isEmpty() const;
+
+    /** \brief Returns true if there is an entry at tick key */
+    bool contains(int key) const;
+
+    // === Iteration ===
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator constBegin() const;
+    const_iterator constEnd() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    /**
+     * \brief Gets the first entry at or after tick key.
+     */
+    const_iterator lowerBound(int key) const;
+
+    /**
+     * \brief Gets the first entry after tick key.
+     */
+    const_iterator upperBound(int key) const;
+
+    /**
+     * \brief Gets the range of entries at tick key.
+     */
+    std::pair<const_iterator, const_iterator> equal_range(int key) const;
+
+    /**
+     * \brief Gets the first entry at tick key, or end().
+     */
+    const_iterator find(int key) const;
+
+    /**
+     * \brief Gets the entry of value at tick key, or end().
+     */
+    const_iterator find(int key, MidiEvent *value) const;
+
+    /** \brief Same as find() */
+    const_iterator constFind(int key) const;
+
+    // === Access ===
+
+    /**
+     * \brief Gets the first event at tick key, or defaultValue.
+     */
+    MidiEvent *value(int key, MidiEvent *defaultValue = 0) const;
+
+    /**
+     * \brief Gets all events in iteration order.
+     */
+    QList<MidiEvent *> values() const;
+
+    /**
+     * \brief Gets the events at tick key in iteration order.
+     */
+    QList<MidiEvent *> values(int key) const;
+
+    /**
+     * \brief Gets the tick of every entry, ascending.
+     */
+    QList<int> keys() const;
+
+    /**
+     * \brief Gets every used tick once, ascending.
+     */
+    QList<int> uniqueKeys() const;
+
+    /** \brief Gets the smallest tick; the map must not be empty */
+    int firstKey() const;
+
+    /** \brief Gets the largest tick; the map must not be empty */
+    int lastKey() const;
+
+    /** \brief Gets the first event; the map must not be empty */
+    MidiEvent *first() const;
+
+    /** \brief Gets the last event; the map must not be empty */
+    MidiEvent *last() const;
+
+    // === Modification ===
+
+    /**
+     * \brief Inserts value in front of the entries at tick key.
+     * \return Iterator to the new entry
+     */
+    const_iterator insert(int key, MidiEvent *value);
+
+    /**
+     * \brief Inserts value directly in front of pos.
+     *
+     * If pos is not a valid place for tick key, the entry is inserted as by
+     * insert(key, value).
+     *
+     * \return Iterator to the new entry
+     */
+    const_iterator insert(const_iterator pos, int key, MidiEvent *value);
+
+    /**
+     * \brief Removes the entry at pos.
+     * \return Iterator to the entry after the removed one
+     */
+    const_iterator erase(const_iterator pos);
+
+    /**
+     * \brief Removes all entries at tick key.
+     * \return The number of removed entries
+     */
+    int remove(int key);
+
+    /**
+     * \brief Removes all entries of value at tick key.
+     * \return The number of removed entries
+     */
+    int remove(int key, MidiEvent *value);
+
+    /**
+     * \brief Removes all entries.
+     */
+    void clear();
+
+    /**
+     * \brief Gets the approximate number of bytes used by the entries.
+     * \param shared If given, leaves shared with this map are not counted
+     */
+    qint64 memoryCost(const EventMap *shared = 0) const;
+
+    /**
+     * \brief Gets a value that changes with every modification of the map.
+     *
+     * Stamps are unique across all maps and a copy keeps the stamp of its
+     * source until one of them is modified, so two equal stamps mean equal
+     * contents. Caches built from maps compare stamps to detect changes.
+     */
+    quint64 stamp() const;
+
+private:
+    /**
+     * \brief Gets the first leaf whose last key is not less than key (if
+     * upper is false) or greater than key (if upper is true).
+     */
+    int findLeaf(int key, bool upper) const;
+
+    /**
+     * \brief Inserts an entry at position pos of a leaf, splitting the leaf
+     * if it grows too large.
+     */
+    const_iterator insertAt(int leaf, int pos, int key, MidiEvent *value);
+
+    /**
+     * \brief Gives the map a new stamp.
+     */
+    void touch();
+
+    /** \brief Sorted leaves; none of them is empty */
+    QVector<QVector<Entry>> _leaves;
+
+    /** \brief Number of entries */
+    int _size;
+
+    /** \brief Stamp of the last modification, 0 if never modified */
+    quint64 _stamp;
+};
+
+#endif // EVENTMAP_H_
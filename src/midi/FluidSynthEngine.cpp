@@ -20,12 +20,15 @@
 
 #ifdef FLUIDSYNTH_SUPPORT
 #include "FluidSynthEngine.h"
+#include "AudioExportSchedule.h"
+#include "SoundFontCache.h"
 
 #include <fluidsynth.h>
 
 #include <QDebug>
 #include <QCoreApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QLibrary>
 #include <QMutexLocker>
@@ -33,8 +36,14 @@
 #include <QScopedPointer>
 #include <QThreadPool>
 #include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
 #include <QtConcurrent/QtConcurrentRun>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 // ============================================================================
 // Singleton
 // ============================================================================
@@ -58,8 +67,23 @@ FluidSynthEngine::FluidSynthEngine()
       _reverbEnabled(true),
       _chorusEnabled(true),
       _polyphony(256),
+      _cpuCores(1),
+      _periodSize(0),
+      _periods(0),
+      _voiceStealing("default"),
       _isStackUpdatePending(false),
-      _isEngineRestartPending(false) {
+      _isStackWorkerRunning(false),
+      _stackGeneration(0),
+      _isEngineRestartPending(false),
+      _liveQueue(4096),
+      _feeder(nullptr) {
+    for (int ch = 0; ch < 16; ch++) {
+        _programs[ch] = -1;
+        _pitchBends[ch] = -1;
+        for (int ctrl = 0; ctrl < 128; ctrl++) {
+            _controllers[ch][ctrl] = -1;
+        }
+    }
 }
 
 FluidSynthEngine::~FluidSynthEngine() {
@@ -78,29 +102,12 @@ bool FluidSynthEngine::initialize() {
     }
 
     // Create FluidSynth settings
-    _settings = new_fluid_settings();
+    _settings = createSettings();
     if (!_settings) {
         emit initializationFailed(tr("Failed to create FluidSynth settings"));
         return false;
     }
 
-    // Apply audio settings
-    if (!_audioDriverName.isEmpty()) {
-        fluid_settings_setstr(_settings, "audio.driver", _audioDriverName.toUtf8().constData());
-    }
-    fluid_settings_setnum(_settings, "synth.gain", _gain);
-    fluid_settings_setnum(_settings, "synth.sample-rate", _sampleRate);
-    fluid_settings_setint(_settings, "synth.reverb.active", _reverbEnabled ? 1 : 0);
-    fluid_settings_setint(_settings, "synth.chorus.active", _chorusEnabled ? 1 : 0);
-    fluid_settings_setint(_settings, "synth.polyphony", _polyphony);
-    fluid_settings_setstr(_settings, "synth.reverb.engine", _reverbEngine.toUtf8().constData());
-
-    // Audio Driver Settings
-    fluid_settings_setstr(_settings, "audio.sample-format", _sampleFormat.toUtf8().constData());
-
-    // Enable dynamic sample loading to prevent massive upfront decompresion lag for SF3
-    fluid_settings_setint(_settings, "synth.dynamic-sample-loading", 1);
-
     // Create the synthesizer
     _synth = new_fluid_synth(_settings);
     if (!_synth) {
@@ -109,6 +116,7 @@ bool FluidSynthEngine::initialize() {
         emit initializationFailed(tr("Failed to create FluidSynth synthesizer"));
         return false;
     }
+    SoundFontCache::instance()->install(_synth);
 
     // Create the audio driver
     _audioDriver = new_fluid_audio_driver(_settings, _synth);
@@ -122,12 +130,14 @@ bool FluidSynthEngine::initialize() {
     }
 
     _initialized = true;
+    startFeeder();
     qDebug() << "FluidSynth engine initialized successfully";
     qDebug() << "  Audio Driver:"    << _audioDriverName;
     qDebug() << "  Sample Rate:"     << _sampleRate;
     qDebug() << "  Sample Format:"   << _sampleFormat;
     qDebug() << "  Gain:"            << _gain;
     qDebug() << "  Polyphony:"       << _polyphony;
+    qDebug() << "  CPU Cores:"       << _cpuCores;
 
     // Load the active SoundFont collection into the engine
     QStringList enabledPaths;
@@ -137,32 +147,66 @@ bool FluidSynthEngine::initialize() {
         }
     }
     
-    if (!enabledPaths.isEmpty() && !_isStackUpdatePending) {
-        _isStackUpdatePending = true;
-        _pendingStackUpdate = enabledPaths;
-        QThreadPool::globalInstance()->start([this]() {
-            while (true) {
-                QStringList currentPaths;
-                {
-                    QMutexLocker lock(&_engineMutex);
-                    if (!_isStackUpdatePending) break;
-                    currentPaths = _pendingStackUpdate;
-                    _isStackUpdatePending = false;
-                }
-                
-                unloadAllSoundFonts();
-                for (int i = currentPaths.size() - 1; i >= 0; --i) {
-                    loadSoundFont(currentPaths[i]);
-                }
-                
-                QMetaObject::invokeMethod(this, "soundFontsChanged", Qt::QueuedConnection);
-            }
-        });
+    if (!enabledPaths.isEmpty()) {
+        setSoundFontStack(enabledPaths);
     }
 
     return true;
 }
 
+fluid_settings_t *FluidSynthEngine::createSettings() const {
+    fluid_settings_t *settings = new_fluid_settings();
+    if (!settings) {
+        return nullptr;
+    }
+
+    // Apply audio settings
+    if (!_audioDriverName.isEmpty()) {
+        fluid_settings_setstr(settings, "audio.driver", _audioDriverName.toUtf8().constData());
+    }
+    fluid_settings_setnum(settings, "synth.sample-rate", _sampleRate);
+    applySynthSettings(settings);
+
+    // Audio Driver Settings
+    fluid_settings_setstr(settings, "audio.sample-format", _sampleFormat.toUtf8().constData());
+    if (_periodSize > 0) {
+        fluid_settings_setint(settings, "audio.period-size", _periodSize);
+    }
+    if (_periods > 0) {
+        fluid_settings_setint(settings, "audio.periods", _periods);
+    }
+
+    // Enable dynamic sample loading to prevent massive upfront decompresion lag for SF3
+    fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1);
+
+    return settings;
+}
+
+void FluidSynthEngine::applySynthSettings(fluid_settings_t *settings) const {
+    fluid_settings_setnum(settings, "synth.gain", _gain);
+    fluid_settings_setint(settings, "synth.reverb.active", _reverbEnabled ? 1 : 0);
+    fluid_settings_setint(settings, "synth.chorus.active", _chorusEnabled ? 1 : 0);
+    fluid_settings_setint(settings, "synth.polyphony", _polyphony);
+    fluid_settings_setstr(settings, "synth.reverb.engine", _reverbEngine.toUtf8().constData());
+    fluid_settings_setint(settings, "synth.cpu-cores", _cpuCores);
+    applyVoiceStealing(settings, _voiceStealing);
+}
+
+void FluidSynthEngine::applyVoiceStealing(fluid_settings_t *settings, const QString &mode) {
+    if (mode == "newest") {
+        // Dense files: released and sustained voices go first, and the age
+        // bonus keeps freshly started notes alive
+        fluid_settings_setnum(settings, "synth.overflow.released", -10000.0);
+        fluid_settings_setnum(settings, "synth.overflow.sustained", -5000.0);
+        fluid_settings_setnum(settings, "synth.overflow.age", 5000.0);
+    } else {
+        // FluidSynth defaults
+        fluid_settings_setnum(settings, "synth.overflow.released", -2000.0);
+        fluid_settings_setnum(settings, "synth.overflow.sustained", -1000.0);
+        fluid_settings_setnum(settings, "synth.overflow.age", 1000.0);
+    }
+}
+
 void FluidSynthEngine::shutdown() {
     QMutexLocker locker(&_engineMutex);
     
@@ -170,12 +214,16 @@ void FluidSynthEngine::shutdown() {
         return;
     }
 
+    stopFeeder();
+
     if (_audioDriver) {
         delete_fluid_audio_driver(_audioDriver);
         _audioDriver = nullptr;
     }
 
     if (_synth) {
+        QMutexLocker live(&_liveMutex);
+
         // Unload all SoundFonts
         for (const auto &pair : _loadedFonts) {
             fluid_synth_sfunload(_synth, pair.first, 1);
@@ -335,59 +383,181 @@ void FluidSynthEngine::setSoundFontStack(const QStringList &paths) {
     }
 
     _pendingStackUpdate = paths;
-    if (!_isStackUpdatePending) {
-        _isStackUpdatePending = true;
-        
-        QThreadPool::globalInstance()->start([this]() {
-            while (true) {
-                // Wait briefly to allow rapid UI toggles/scrolls to buffer
-                QThread::msleep(150);
-                
-                QStringList currentPaths;
-                {
-                    QMutexLocker lock(&_engineMutex);
-                    if (!_isStackUpdatePending) break;
-                    currentPaths = _pendingStackUpdate;
-                    _isStackUpdatePending = false;
-                }
-                
-                QMutexLocker lock(&_engineMutex);
-                if (!_initialized || !_synth) break;
-                
-                // Convert top-down UI order to bottom-up engine stack order
-                QStringList targetLoadOrder;
-                for (int i = currentPaths.size() - 1; i >= 0; --i) {
-                    targetLoadOrder.append(currentPaths[i]);
-                }
-                
-                // Find untouched common prefix
-                int commonPrefix = 0;
-                while (commonPrefix < _loadedFonts.size() && commonPrefix < targetLoadOrder.size()) {
-                    if (QFileInfo(_loadedFonts[commonPrefix].second).canonicalFilePath() == 
-                        QFileInfo(targetLoadOrder[commonPrefix]).canonicalFilePath()) {
-                        commonPrefix++;
-                    } else {
-                        break;
-                    }
+    _isStackUpdatePending = true;
+    _stackGeneration++;
+
+    // A single worker applies the requests one after another; a request made
+    // while it loads is picked up by its next iteration
+    if (!_isStackWorkerRunning) {
+        _isStackWorkerRunning = true;
+        QThreadPool::globalInstance()->start([this]() { applySoundFontStacks(); });
+    }
+}
+
+void FluidSynthEngine::applySoundFontStacks() {
+    while (true) {
+        // Wait briefly to allow rapid UI toggles/scrolls to buffer
+        QThread::msleep(150);
+
+        QStringList currentPaths;
+        quint64 generation;
+        {
+            QMutexLocker lock(&_engineMutex);
+            if (!_isStackUpdatePending || !_initialized || !_synth) {
+                _isStackUpdatePending = false;
+                _isStackWorkerRunning = false;
+                return;
+            }
+            currentPaths = _pendingStackUpdate;
+            generation = _stackGeneration;
+            _isStackUpdatePending = false;
+        }
+
+        // Convert top-down UI order to bottom-up engine stack order
+        QStringList targetLoadOrder;
+        for (int i = currentPaths.size() - 1; i >= 0; --i) {
+            targetLoadOrder.append(currentPaths[i]);
+        }
+
+        // Parse the layers before taking any lock. Layers the cache cannot
+        // serve are read completely by FluidSynth's loader, which must not
+        // happen on the live synth.
+        QList<bool> cached;
+        for (const QString &path : targetLoadOrder) {
+            cached.append(SoundFontCache::instance()->prepare(path));
+        }
+
+        fluid_settings_t *settings = nullptr;
+        int liveFrom = -1;
+        {
+            QMutexLocker lock(&_engineMutex);
+            if (!_initialized || !_synth) {
+                continue;
+            }
+
+            // Find untouched common prefix
+            int commonPrefix = 0;
+            while (commonPrefix < _loadedFonts.size() && commonPrefix < targetLoadOrder.size()) {
+                if (QFileInfo(_loadedFonts[commonPrefix].second).canonicalFilePath() ==
+                    QFileInfo(targetLoadOrder[commonPrefix]).canonicalFilePath()) {
+                    commonPrefix++;
+                } else {
+                    break;
                 }
-                
-                // Unload top layers that diverge
+            }
+
+            // Removing or adding top layers keeps all loaded layers and is
+            // done on the live synth, without touching the audio driver
+            bool addCached = commonPrefix == _loadedFonts.size();
+            for (int i = commonPrefix; addCached && i < targetLoadOrder.size(); i++) {
+                addCached = cached.at(i);
+            }
+            if (commonPrefix == targetLoadOrder.size() || addCached) {
                 for (int i = _loadedFonts.size() - 1; i >= commonPrefix; --i) {
                     fluid_synth_sfunload(_synth, _loadedFonts[i].first, 1);
                 }
-                // Cleanup removed layers from tracking
                 while (_loadedFonts.size() > commonPrefix) {
                     _loadedFonts.removeLast();
                 }
-                
-                // Load missing layers in the correct order
-                for (int i = commonPrefix; i < targetLoadOrder.size(); ++i) {
-                    loadSoundFont(targetLoadOrder[i]);
+                liveFrom = commonPrefix;
+            } else {
+                settings = createSettings();
+                if (!settings) {
+                    continue;
                 }
-                
-                QMetaObject::invokeMethod(this, "soundFontsChanged", Qt::QueuedConnection);
             }
-        });
+        }
+
+        if (liveFrom >= 0) {
+            int count = targetLoadOrder.size() - liveFrom;
+            for (int i = liveFrom; i < targetLoadOrder.size(); i++) {
+                // a newer request replaces the remaining layers anyway
+                {
+                    QMutexLocker lock(&_engineMutex);
+                    if (_stackGeneration != generation) {
+                        break;
+                    }
+                }
+                emit soundFontLoadProgress(i - liveFrom, count);
+                loadSoundFont(targetLoadOrder.at(i));
+            }
+            emit soundFontLoadProgress(count, count);
+            SoundFontCache::instance()->retain(targetLoadOrder);
+            QMetaObject::invokeMethod(this, "soundFontsChanged", Qt::QueuedConnection);
+            continue;
+        }
+
+        // A lower layer changed, so every layer has to be reloaded. This can
+        // take seconds; the new stack is loaded into a synth of its own
+        // without holding any lock, while the live synth keeps playing. The
+        // synths are swapped when loading is done.
+        fluid_synth_t *synth = new_fluid_synth(settings);
+        if (!synth) {
+            delete_fluid_settings(settings);
+            continue;
+        }
+        SoundFontCache::instance()->install(synth);
+        QList<QPair<int, QString>> fonts;
+        for (int i = 0; i < targetLoadOrder.size(); i++) {
+            const QString &path = targetLoadOrder.at(i);
+            emit soundFontLoadProgress(i, targetLoadOrder.size());
+            QFileInfo fi(path);
+            if (!fi.exists() || !fi.isReadable()) {
+                qWarning() << "FluidSynth: SoundFont file not found or not readable:" << path;
+                continue;
+            }
+            bool duplicate = false;
+            for (const auto &pair : fonts) {
+                duplicate = duplicate || QFileInfo(pair.second).canonicalFilePath() == fi.canonicalFilePath();
+            }
+            if (duplicate) {
+                continue;
+            }
+            int sfontId = fluid_synth_sfload(synth, path.toUtf8().constData(), 1);
+            if (sfontId == FLUID_FAILED) {
+                qWarning() << "FluidSynth: Failed to load SoundFont:" << path;
+                continue;
+            }
+            fonts.append(qMakePair(sfontId, path));
+        }
+        emit soundFontLoadProgress(targetLoadOrder.size(), targetLoadOrder.size());
+
+        QMutexLocker lock(&_engineMutex);
+        // The engine was restarted or a newer stack was requested while
+        // loading: this stack is outdated and must not replace the live one
+        if (!_initialized || !_synth || _stackGeneration != generation) {
+            delete_fluid_synth(synth);
+            delete_fluid_settings(settings);
+            continue;
+        }
+
+        // The audio driver is bound to its synth and is recreated
+        if (_audioDriver) {
+            delete_fluid_audio_driver(_audioDriver);
+        }
+        fluid_synth_t *oldSynth;
+        {
+            QMutexLocker live(&_liveMutex);
+            restoreChannelState(synth);
+            oldSynth = _synth;
+            _synth = synth;
+        }
+        fluid_settings_t *oldSettings = _settings;
+        _settings = settings;
+        _audioDriver = new_fluid_audio_driver(_settings, _synth);
+        if (!_audioDriver) {
+            qWarning() << "FluidSynth: Failed to recreate audio driver after SoundFont update";
+        }
+        _loadedFonts = fonts;
+        delete_fluid_synth(oldSynth);
+        delete_fluid_settings(oldSettings);
+        SoundFontCache::instance()->retain(targetLoadOrder);
+
+        for (const auto &pair : fonts) {
+            qDebug() << "FluidSynth: Loaded SoundFont" << pair.second << "with id" << pair.first;
+            emit soundFontLoaded(pair.first, pair.second);
+        }
+        QMetaObject::invokeMethod(this, "soundFontsChanged", Qt::QueuedConnection);
     }
 }
 
@@ -396,275 +566,252 @@ void FluidSynthEngine::setSoundFontStack(const QStringList &paths) {
 // ============================================================================
 
 void FluidSynthEngine::sendMidiData(const QByteArray &data) {
-    QMutexLocker locker(&_engineMutex);
-    if (!_initialized || !_synth || data.isEmpty()) {
+    sendMidiData(reinterpret_cast<const quint8 *>(data.constData()), data.size());
+}
+
+void FluidSynthEngine::sendMidiData(const quint8 *data, int length) {
+    if (length <= 0 || !_live.load(std::memory_order_acquire)) {
         return;
     }
 
-    unsigned char status = static_cast<unsigned char>(data[0]);
-    unsigned char type = status & 0xF0;
-    int channel = status & 0x0F;
-
-    // Handle SysEx
-    if (status == 0xF0) {
-        fluid_synth_sysex(_synth,
-                          data.constData() + 1,
-                          data.size() - 1,
-                          nullptr, nullptr, nullptr, 0);
+    // SysEx is rare and not timing critical; it is sent directly and may
+    // overtake short messages still waiting in the queue
+    if (data[0] == 0xF0) {
+        QMutexLocker live(&_liveMutex);
+        if (_synth) {
+            sendToSynth(_synth, data, length);
+        }
         return;
     }
 
-    // System real-time messages (single byte) — ignore
-    if (status >= 0xF8) {
+    if (_liveQueue.push(data, length)) {
+        _livePending.release();
         return;
     }
 
-    // Channel messages
-    switch (type) {
-    case 0x90: // Note On
-        if (data.size() >= 3) {
-            int key = static_cast<unsigned char>(data[1]);
-            int vel = static_cast<unsigned char>(data[2]);
-            if (vel == 0) {
-                fluid_synth_noteoff(_synth, channel, key);
-            } else {
-                fluid_synth_noteon(_synth, channel, key, vel);
+    // The queue is full. Note-offs and all-notes/all-sounds-off must never be
+    // lost, or notes hang: they are sent directly. The queued messages are
+    // drained first, so the note-off cannot overtake the note it ends
+    // (pop() is serialized by _liveMutex, like in feed()).
+    unsigned char type = data[0] & 0xF0;
+    bool release = type == 0x80
+                   || (type == 0x90 && length >= 3 && data[2] == 0)
+                   || (type == 0xB0 && length >= 3 && (data[1] == 120 || data[1] == 123));
+    if (release) {
+        QMutexLocker live(&_liveMutex);
+        quint8 queued[3];
+        int queuedLength;
+        while (_liveQueue.pop(queued, &queuedLength)) {
+            if (_synth) {
+                dispatch(_synth, queued, queuedLength);
             }
         }
-        break;
-
-    case 0x80: // Note Off
-        if (data.size() >= 3) {
-            int key = static_cast<unsigned char>(data[1]);
-            fluid_synth_noteoff(_synth, channel, key);
+        if (_synth) {
+            dispatch(_synth, data, length);
         }
-        break;
+    }
+}
 
-    case 0xC0: // Program Change
-        if (data.size() >= 2) {
-            int program = static_cast<unsigned char>(data[1]);
-            fluid_synth_program_change(_synth, channel, program);
-        }
-        break;
+void FluidSynthEngine::startFeeder() {
+    // drop messages queued while the engine was down
+    quint8 data[3];
+    int length;
+    while (_liveQueue.pop(data, &length)) {
+    }
+    while (_livePending.tryAcquire()) {
+    }
 
-    case 0xB0: // Control Change
-        if (data.size() >= 3) {
-            int ctrl = static_cast<unsigned char>(data[1]);
-            int value = static_cast<unsigned char>(data[2]);
-            fluid_synth_cc(_synth, channel, ctrl, value);
-        }
-        break;
+    _feederStopped = false;
+    _feeder = QThread::create([this]() { feed(); });
+    _feeder->start(QThread::TimeCriticalPriority);
+    _live = true;
+}
 
-    case 0xE0: // Pitch Bend
-        if (data.size() >= 3) {
-            int lsb = static_cast<unsigned char>(data[1]);
-            int msb = static_cast<unsigned char>(data[2]);
-            int value = (msb << 7) | lsb;
-            fluid_synth_pitch_bend(_synth, channel, value);
-        }
-        break;
+void FluidSynthEngine::stopFeeder() {
+    _live = false;
+    if (!_feeder) {
+        return;
+    }
+    _feederStopped = true;
+    _livePending.release();
+    _feeder->wait();
+    delete _feeder;
+    _feeder = nullptr;
+}
 
-    case 0xD0: // Channel Pressure (Aftertouch)
-        if (data.size() >= 2) {
-            int pressure = static_cast<unsigned char>(data[1]);
-            fluid_synth_channel_pressure(_synth, channel, pressure);
+void FluidSynthEngine::feed() {
+    quint8 data[3];
+    int length;
+    forever {
+        _livePending.acquire();
+        if (_feederStopped) {
+            return;
         }
-        break;
 
-    case 0xA0: // Key Pressure (Polyphonic Aftertouch)
-        if (data.size() >= 3) {
-            int key = static_cast<unsigned char>(data[1]);
-            int pressure = static_cast<unsigned char>(data[2]);
-            fluid_synth_key_pressure(_synth, channel, key, pressure);
+        int sent = 0;
+        {
+            QMutexLocker live(&_liveMutex);
+            while (_liveQueue.pop(data, &length)) {
+                if (_synth) {
+                    dispatch(_synth, data, length);
+                }
+                sent++;
+            }
         }
-        break;
 
-    default:
-        break;
+        // every message released the semaphore once; permits of messages
+        // which were not published yet only cause an empty wakeup
+        if (sent > 1) {
+            _livePending.tryAcquire(sent - 1);
+        }
     }
 }
 
-// ============================================================================
-// Export
-// ============================================================================
-
-bool FluidSynthEngine::needsTranscode(const AudioExportSettings &settings) {
-    // All formats now go through transcoding to ensure maximum compatibility and precision.
-    Q_UNUSED(settings);
-    return true;
+void FluidSynthEngine::restoreChannelState(fluid_synth_t *synth) {
+    for (int ch = 0; ch < 16; ch++) {
+        // bank select before the program change
+        for (int ctrl : {0, 32}) {
+            if (_controllers[ch][ctrl] >= 0) {
+                fluid_synth_cc(synth, ch, ctrl, _controllers[ch][ctrl]);
+            }
+        }
+        if (_programs[ch] >= 0) {
+            fluid_synth_program_change(synth, ch, _programs[ch]);
+        }
+        // channel mode messages (120 and above) are not state
+        for (int ctrl = 1; ctrl < 120; ctrl++) {
+            if (ctrl != 32 && _controllers[ch][ctrl] >= 0) {
+                fluid_synth_cc(synth, ch, ctrl, _controllers[ch][ctrl]);
+            }
+        }
+        if (_pitchBends[ch] >= 0) {
+            fluid_synth_pitch_bend(synth, ch, _pitchBends[ch]);
+        }
+    }
 }
 
-void FluidSynthEngine::exportAudio(const QString &midiFilePath, const QString &outputPath,
-                                   const AudioExportSettings &settings, int totalTicks) {
-    _exportCancelled.store(false);
+void FluidSynthEngine::dispatch(fluid_synth_t *synth, const quint8 *data, int length) {
+    unsigned char status = data[0];
+    int channel = status & 0x0F;
 
-    if (!_initialized) {
-        emit exportFinished(false, outputPath);
+    // System messages — ignore
+    if (status >= 0xF0) {
         return;
     }
 
-    // Transcode-All Model: render to a temporary high-precision WAV first, 
-    // then transcode via libsndfile to the final destination.
-    const bool transcode = true; 
-    QString renderPath =
-        QDir::tempPath() + "/MidiEditor_render_" +
-        QString::number(QCoreApplication::applicationPid()) + ".wav";
-
-    fluid_settings_t* expSettings = new_fluid_settings();
-    fluid_settings_setstr(expSettings, "audio.driver", "file");
-    fluid_settings_setstr(expSettings, "audio.file.name", renderPath.toUtf8().constData());
-
-    QString fileType = "wav";
-    double sampleRate = settings.sampleRate();
-    QString fileFormat = "float"; // Intermediate render is always high-precision float
-
-    // Opus strictly requires 48kHz.
-    if (settings.format == AudioExportSettings::OPUS) {
-        sampleRate = 48000.0;
-    }
-
-    fluid_settings_setstr(expSettings, "audio.file.type", fileType.toUtf8().constData());
-    fluid_settings_setstr(expSettings, "audio.file.format", fileFormat.toUtf8().constData());
-    fluid_settings_setstr(expSettings, "audio.sample-format", "float"); // Internal processing always float
-    fluid_settings_setnum(expSettings, "synth.sample-rate", sampleRate);
+    // Remember the channel state for restoreChannelState()
+    switch (status & 0xF0) {
+    case 0xC0: // Program Change
+        if (length >= 2) {
+            _programs[channel] = data[1];
+        }
+        break;
 
-    qDebug() << "FluidSynthEngine::exportAudio: Rendering at" << sampleRate << "Hz";
-    qDebug() << "FluidSynthEngine::exportAudio: Starting export to" << outputPath << "Format:" << settings.format << "Transcode:" << transcode;
-    qDebug() << "FluidSynthEngine::exportAudio: MIDI total ticks:" << totalTicks;
-    // Copy synth settings from the live engine
-    _engineMutex.lock();
-    fluid_settings_setint(expSettings, "synth.reverb.active", _reverbEnabled ? 1 : 0);
-    fluid_settings_setint(expSettings, "synth.chorus.active", _chorusEnabled ? 1 : 0);
-    fluid_settings_setnum(expSettings, "synth.gain", _gain);
-    fluid_settings_setint(expSettings, "synth.polyphony", _polyphony);
+    case 0xB0: // Control Change
+        if (length >= 3) {
+            _controllers[channel][data[1]] = data[2];
+        }
+        break;
 
-    fluid_settings_setstr(expSettings, "synth.reverb.engine", _reverbEngine.toUtf8().constData());
+    case 0xE0: // Pitch Bend
+        if (length >= 3) {
+            _pitchBends[channel] = (data[2] << 7) | data[1];
+        }
+        break;
 
-    // Get loaded font paths while holding lock
-    QStringList fontsToLoad;
-    for (int i = 0; i < _loadedFonts.size(); ++i) {
-        fontsToLoad.append(_loadedFonts[i].second);
+    default:
+        break;
     }
-    _engineMutex.unlock();
 
-    fluid_synth_t* synth = new_fluid_synth(expSettings);
-    if (!synth) {
-        delete_fluid_settings(expSettings);
-        emit exportFinished(false, outputPath);
-        return;
-    }
+    sendToSynth(synth, data, length);
+}
 
-    for (const QString &f : fontsToLoad) {
-        fluid_synth_sfload(synth, f.toUtf8().constData(), 1);
-    }
+void FluidSynthEngine::sendToSynth(fluid_synth_t *synth, const quint8 *data, int length) {
+    unsigned char status = data[0];
+    unsigned char type = status & 0xF0;
+    int channel = status & 0x0F;
 
-    fluid_player_t* player = new_fluid_player(synth);
-    if (fluid_player_add(player, midiFilePath.toUtf8().constData()) != FLUID_OK) {
-        delete_fluid_player(player);
-        delete_fluid_synth(synth);
-        delete_fluid_settings(expSettings);
-        emit exportFinished(false, outputPath);
+    // SysEx
+    if (status == 0xF0) {
+        fluid_synth_sysex(synth,
+                          reinterpret_cast<const char *>(data) + 1,
+                          length - 1,
+                          nullptr, nullptr, nullptr, 0);
         return;
     }
 
-    fluid_player_play(player);
-    fluid_file_renderer_t* renderer = new_fluid_file_renderer(synth);
-    if (!renderer) {
-        delete_fluid_player(player);
-        delete_fluid_synth(synth);
-        delete_fluid_settings(expSettings);
-        emit exportFinished(false, outputPath);
+    // Other system messages — ignore
+    if (status > 0xF0) {
         return;
     }
 
-    // Use the provided total ticks for progress reporting
-    if (totalTicks <= 0) totalTicks = 1;
-
-    int lastPercent = -1;
-    bool cancelled = false;
-
-    // Render the MIDI content
-    while (fluid_player_get_status(player) == FLUID_PLAYER_PLAYING) {
-        if (_exportCancelled.load()) {
-            cancelled = true;
-            break;
-        }
-        if (fluid_file_renderer_process_block(renderer) != FLUID_OK) {
-            break;
+    // Channel messages
+    switch (type) {
+    case 0x90: // Note On
+        if (length >= 3) {
+            int key = data[1];
+            int vel = data[2];
+            if (vel == 0) {
+                fluid_synth_noteoff(synth, channel, key);
+            } else {
+                fluid_synth_noteon(synth, channel, key, vel);
+            }
         }
-        int curTick = fluid_player_get_current_tick(player);
-        
-        // Scale progress: MIDI rendering phase is 0-80% if transcoding, 0-100% if not.
-        double midiScale = transcode ? 80.0 : 100.0;
-        int stagePercent = transcode ? 80 : 100;
-        int percent = static_cast<int>(midiScale * static_cast<double>(curTick) / totalTicks);
-        
-        // CAP the progress to the stage mark!
-        if (percent > stagePercent) percent = stagePercent;
+        break;
 
-        if (percent != lastPercent) {
-            lastPercent = percent;
-            emit exportProgress(percent);
+    case 0x80: // Note Off
+        if (length >= 3) {
+            int key = data[1];
+            fluid_synth_noteoff(synth, channel, key);
         }
-    }
-
-    // Render reverb tail: 2 seconds of silence so reverb/sustain fades naturally
-    if (!cancelled && settings.includeReverbTail) {
-        int tailFrames = static_cast<int>(settings.sampleRate() * 2.0);
-        int framesPerBlock = 64; // FluidSynth default block size
-        fluid_settings_getint(expSettings, "audio.period-size", &framesPerBlock);
-        if (framesPerBlock <= 0) framesPerBlock = 64;
-        int totalBlocks = tailFrames / framesPerBlock;
-        if (totalBlocks <= 0) totalBlocks = 1;
+        break;
 
-        for (int i = 0; i < totalBlocks; ++i) {
-            if (_exportCancelled.load()) {
-                cancelled = true;
-                break;
-            }
-            fluid_file_renderer_process_block(renderer);
+    case 0xC0: // Program Change
+        if (length >= 2) {
+            int program = data[1];
+            fluid_synth_program_change(synth, channel, program);
         }
-    }
+        break;
 
-    delete_fluid_file_renderer(renderer);
-    delete_fluid_player(player);
-    delete_fluid_synth(synth);
-    delete_fluid_settings(expSettings);
+    case 0xB0: // Control Change
+        if (length >= 3) {
+            int ctrl = data[1];
+            int value = data[2];
+            fluid_synth_cc(synth, channel, ctrl, value);
+        }
+        break;
 
-    if (cancelled) {
-        QFile::remove(outputPath);
-        emit exportCancelled();
-        return;
-    }
+    case 0xE0: // Pitch Bend
+        if (length >= 3) {
+            int lsb = data[1];
+            int msb = data[2];
+            int value = (msb << 7) | lsb;
+            fluid_synth_pitch_bend(synth, channel, value);
+        }
+        break;
 
-    // Stage 2: Transcode if needed
-    if (transcode) {
-        bool ok = transcodeWavTo(renderPath, outputPath, settings);
-        QFile::remove(renderPath); // clean up temp file
-        if (!ok) {
-            emit exportFinished(false, outputPath);
-            return;
+    case 0xD0: // Channel Pressure (Aftertouch)
+        if (length >= 2) {
+            int pressure = data[1];
+            fluid_synth_channel_pressure(synth, channel, pressure);
         }
-    } else {
-        // For WAV/FLAC/OGG, FluidSynth rendered to the temp file, now move it
-        if (QFile::exists(outputPath)) QFile::remove(outputPath);
-        if (!QFile::copy(renderPath, outputPath)) {
-            qWarning() << "FluidSynthEngine::exportAudio: failed to copy file to" << outputPath;
-            QFile::remove(renderPath);
-            emit exportFinished(false, outputPath);
-            return;
+        break;
+
+    case 0xA0: // Key Pressure (Polyphonic Aftertouch)
+        if (length >= 3) {
+            int key = data[1];
+            int pressure = data[2];
+            fluid_synth_key_pressure(synth, channel, key, pressure);
         }
-    }
-    QFile::remove(renderPath); // clean up temp file
-    emit exportFinished(true, outputPath);
-}
+        break;
 
-void FluidSynthEngine::cancelExport() {
-    _exportCancelled.store(true);
+    default:
+        break;
+    }
 }
 
 // ============================================================================
-// Transcode helper — dynamically loads libsndfile to convert WAV → Opus/MP3
+// Export
 // ============================================================================
 
 // Minimal libsndfile types needed for dynamic loading (avoids sndfile.h header dependency)
@@ -698,13 +845,11 @@ constexpr int SF_FORMAT_OPUS           = 0x0064;
 constexpr int SF_FORMAT_MPEG_LAYER_III = 0x0082;
 
 // Open modes
-constexpr int SFM_READ                 = 0x10;
 constexpr int SFM_WRITE                = 0x20;
 
 // Function pointer types
 using fn_sf_open         = SNDFILE_HANDLE (*)(const char*, int, SF_INFO*);
 using fn_sf_close        = int            (*)(SNDFILE_HANDLE);
-using fn_sf_readf_float  = sf_count_t     (*)(SNDFILE_HANDLE, float*, sf_count_t);
 using fn_sf_writef_float = sf_count_t     (*)(SNDFILE_HANDLE, const float*, sf_count_t);
 using fn_sf_strerror     = const char*    (*)(SNDFILE_HANDLE);
 
@@ -715,47 +860,55 @@ using fn_sf_strerror     = const char*    (*)(SNDFILE_HANDLE);
 using fn_sf_wchar_open   = SNDFILE_HANDLE   (*)(const wchar_t*, int, SF_INFO*);
 #endif
 
-} // namespace sndfile_dyn
+/**
+ * \brief libsndfile, loaded at runtime — it ships alongside the app as
+ * sndfile.dll / libsndfile.so.
+ */
+struct Library {
+    QLibrary lib;
+    fn_sf_open sf_open = nullptr;
+    fn_sf_close sf_close = nullptr;
+    fn_sf_writef_float sf_writef_float = nullptr;
+    fn_sf_strerror sf_strerror = nullptr;
+#ifdef Q_OS_WIN
+    fn_sf_wchar_open sf_wchar_open = nullptr;
+#endif
 
-bool FluidSynthEngine::transcodeWavTo(const QString &wavPath, const QString &outputPath,
-                                       const AudioExportSettings &settings) {
-    // Load libsndfile dynamically — it ships alongside the app as sndfile.dll / libsndfile.so
-    QLibrary sndLib;
-    QStringList candidates = {"sndfile", "libsndfile", "libsndfile-1", "sndfile-1"};
-    bool loaded = false;
-    for (const QString &name : candidates) {
-        sndLib.setFileName(name);
-        if (sndLib.load()) { loaded = true; break; }
-        // Also try from the app directory explicitly
-        QString appDir = QCoreApplication::applicationDirPath();
-        sndLib.setFileName(appDir + "/" + name);
-        if (sndLib.load()) { loaded = true; break; }
-    }
-    if (!loaded) {
-        qWarning() << "FluidSynthEngine::transcodeWavTo: could not load libsndfile:"
-                    << sndLib.errorString();
-        return false;
-    }
-
-    // Resolve function pointers
-    auto sf_open         = reinterpret_cast<sndfile_dyn::fn_sf_open>(sndLib.resolve("sf_open"));
-    auto sf_close        = reinterpret_cast<sndfile_dyn::fn_sf_close>(sndLib.resolve("sf_close"));
-    auto sf_readf_float  = reinterpret_cast<sndfile_dyn::fn_sf_readf_float>(sndLib.resolve("sf_readf_float"));
-    auto sf_writef_float = reinterpret_cast<sndfile_dyn::fn_sf_writef_float>(sndLib.resolve("sf_writef_float"));
-    auto sf_strerror     = reinterpret_cast<sndfile_dyn::fn_sf_strerror>(sndLib.resolve("sf_strerror"));
+    /// Loads the library and resolves the functions. Returns true on success.
+    bool load() {
+        QStringList candidates = {"sndfile", "libsndfile", "libsndfile-1", "sndfile-1"};
+        bool loaded = false;
+        for (const QString &name : candidates) {
+            lib.setFileName(name);
+            if (lib.load()) { loaded = true; break; }
+            // Also try from the app directory explicitly
+            QString appDir = QCoreApplication::applicationDirPath();
+            lib.setFileName(appDir + "/" + name);
+            if (lib.load()) { loaded = true; break; }
+        }
+        if (!loaded) {
+            qWarning() << "sndfile_dyn::Library: could not load libsndfile:" << lib.errorString();
+            return false;
+        }
 
+        sf_open         = reinterpret_cast<fn_sf_open>(lib.resolve("sf_open"));
+        sf_close        = reinterpret_cast<fn_sf_close>(lib.resolve("sf_close"));
+        sf_writef_float = reinterpret_cast<fn_sf_writef_float>(lib.resolve("sf_writef_float"));
+        sf_strerror     = reinterpret_cast<fn_sf_strerror>(lib.resolve("sf_strerror"));
 #ifdef Q_OS_WIN
-    auto sf_wchar_open   = reinterpret_cast<sndfile_dyn::fn_sf_wchar_open>(sndLib.resolve("sf_wchar_open"));
+        sf_wchar_open   = reinterpret_cast<fn_sf_wchar_open>(lib.resolve("sf_wchar_open"));
 #endif
 
-    if (!sf_open || !sf_close || !sf_readf_float || !sf_writef_float) {
-        qWarning() << "FluidSynthEngine::transcodeWavTo: failed to resolve libsndfile symbols";
-        return false;
+        if (!sf_open || !sf_close || !sf_writef_float) {
+            qWarning() << "sndfile_dyn::Library: failed to resolve libsndfile symbols";
+            return false;
+        }
+        return true;
     }
 
-    // Helper lambda: open a file using the best available function for the platform.
-    // On Windows, prefer sf_wchar_open for proper Unicode path support.
-    auto openSndFile = [&](const QString &path, int mode, sndfile_dyn::SF_INFO *info) -> sndfile_dyn::SNDFILE_HANDLE {
+    /// Opens a file using the best available function for the platform.
+    /// On Windows, prefer sf_wchar_open for proper Unicode path support.
+    SNDFILE_HANDLE open(const QString &path, int mode, SF_INFO *info) const {
 #ifdef Q_OS_WIN
         if (sf_wchar_open) {
             std::wstring wpath = path.toStdWString();
@@ -763,102 +916,699 @@ bool FluidSynthEngine::transcodeWavTo(const QString &wavPath, const QString &out
         }
 #endif
         return sf_open(path.toUtf8().constData(), mode, info);
-    };
+    }
 
-    // Open the source WAV
-    sndfile_dyn::SF_INFO srcInfo = {};
-    auto srcFile = openSndFile(wavPath, sndfile_dyn::SFM_READ, &srcInfo);
-    if (!srcFile) {
-        qWarning() << "FluidSynthEngine::transcodeWavTo: failed to open source WAV" << wavPath
-                    << "Error:" << (sf_strerror ? sf_strerror(nullptr) : "unknown error");
-        return false;
+    /// Opens a stereo encoder for the export settings, nullptr on failure.
+    SNDFILE_HANDLE openEncoder(const QString &path, const AudioExportSettings &settings, double sampleRate) const {
+        SF_INFO info = {};
+        info.samplerate = static_cast<int>(sampleRate);
+        info.channels   = 2;
+        info.format     = formatOf(settings);
+        if (!info.format) {
+            return nullptr;
+        }
+
+        SNDFILE_HANDLE file = open(path, SFM_WRITE, &info);
+        if (!file) {
+            qWarning() << "sndfile_dyn::Library: failed to open output file" << path
+                        << "Format:" << QString::number(info.format, 16)
+                        << "Error:" << (sf_strerror ? sf_strerror(nullptr) : "unknown error");
+        }
+        return file;
+    }
+
+    /// Returns the libsndfile format of the export settings, 0 if unsupported.
+    static int formatOf(const AudioExportSettings &settings) {
+        bool isFloat = (settings.sampleFormat == "float");
+
+        switch (settings.format) {
+            case AudioExportSettings::WAV:
+                return SF_FORMAT_WAV | (isFloat ? SF_FORMAT_FLOAT : SF_FORMAT_PCM_16);
+            case AudioExportSettings::FLAC:
+                // Map "Float" to 24-bit PCM for FLAC (highest supported lossless standard)
+                return SF_FORMAT_FLAC | (isFloat ? SF_FORMAT_PCM_24 : SF_FORMAT_PCM_16);
+            case AudioExportSettings::OGG_VORBIS:
+                return SF_FORMAT_OGG | SF_FORMAT_VORBIS;
+            case AudioExportSettings::OPUS:
+                return SF_FORMAT_OGG | SF_FORMAT_OPUS;
+            case AudioExportSettings::MP3:
+                return SF_FORMAT_MPEG | SF_FORMAT_MPEG_LAYER_III;
+            default:
+                return 0;
+        }
     }
-    qDebug() << "FluidSynthEngine::transcodeWavTo: source WAV opened. Channels:" << srcInfo.channels << "Rate:" << srcInfo.samplerate << "Frames:" << srcInfo.frames;
+};
 
-    // Determine target format (source is always float WAV)
-    int dstFormat = 0;
-    bool isFloat = (settings.sampleFormat == "float");
+} // namespace sndfile_dyn
 
-    switch (settings.format) {
-        case AudioExportSettings::WAV:
-            dstFormat = sndfile_dyn::SF_FORMAT_WAV | (isFloat ? sndfile_dyn::SF_FORMAT_FLOAT : sndfile_dyn::SF_FORMAT_PCM_16);
-            break;
-        case AudioExportSettings::FLAC:
-            // Map "Float" to 24-bit PCM for FLAC (highest supported lossless standard)
-            dstFormat = sndfile_dyn::SF_FORMAT_FLAC | (isFloat ? sndfile_dyn::SF_FORMAT_PCM_24 : sndfile_dyn::SF_FORMAT_PCM_16);
-            break;
-        case AudioExportSettings::OGG_VORBIS:
-            dstFormat = sndfile_dyn::SF_FORMAT_OGG | sndfile_dyn::SF_FORMAT_VORBIS;
-            break;
-        case AudioExportSettings::OPUS:
-            dstFormat = sndfile_dyn::SF_FORMAT_OGG | sndfile_dyn::SF_FORMAT_OPUS;
-            break;
-        case AudioExportSettings::MP3:
-            dstFormat = sndfile_dyn::SF_FORMAT_MPEG | sndfile_dyn::SF_FORMAT_MPEG_LAYER_III;
-            break;
-        default:
-            sf_close(srcFile);
-            return false;
+/**
+ * \brief Sample rate an export is rendered at.
+ */
+static double renderRateOf(const AudioExportSettings &settings) {
+    // Opus strictly requires 48kHz.
+    if (settings.format == AudioExportSettings::OPUS) {
+        return 48000.0;
+    }
+    return settings.sampleRate();
+}
+
+/**
+ * \brief Length of the time slices of a parallel export in seconds.
+ */
+static const double SLICE_SECONDS = 30.0;
+
+/**
+ * \brief Largest RMS difference between a sliced and a serial render that
+ * the verification mode accepts (-60 dBFS).
+ */
+static const double SLICE_RMS_TOLERANCE = 0.001;
+
+/**
+ * \brief Renders an AudioExportSchedule on an offline synth.
+ *
+ * Every message is sent to the synth when rendering reaches its sample
+ * offset, so the size of the rendered blocks does not change the timing.
+ */
+class FluidSynthEngine::OfflineRender {
+public:
+    OfflineRender(fluid_synth_t *synth, const AudioExportSchedule *schedule, double sampleRate) {
+        _synth = synth;
+        _schedule = schedule;
+        _sampleRate = sampleRate;
+        _next = 0;
+        _position = 0;
+    }
+
+    /// Renders the next frames as interleaved stereo into buffer.
+    void render(float *buffer, int frames) {
+        while (frames > 0) {
+            while (_next < _schedule->size() && frameOf(_schedule->at(_next).ms) <= _position) {
+                send(_schedule->at(_next++));
+            }
+
+            qint64 until = _position + frames;
+            if (_next < _schedule->size()) {
+                until = qMin(until, frameOf(_schedule->at(_next).ms));
+            }
+            int count = static_cast<int>(until - _position);
+            fluid_synth_write_float(_synth, count, buffer, 0, 2, buffer, 1, 2);
+            buffer += 2 * count;
+            frames -= count;
+            _position = until;
+        }
+    }
+
+    /**
+     * Moves to frame without rendering. Channel state (programs,
+     * controllers, pitch bend, SysEx) before frame is replayed; notes still
+     * held at frame are started again, so a pre-roll can bring them into
+     * their sustain phase. Notes released while the sustain pedal (CC64)
+     * is down are started and released again, so the pedal keeps them.
+     */
+    void seek(qint64 frame) {
+        quint8 held[16][128];
+        quint8 sustained[16][128];
+        bool pedal[16];
+        memset(held, 0, sizeof(held));
+        memset(sustained, 0, sizeof(sustained));
+        memset(pedal, 0, sizeof(pedal));
+
+        while (_next < _schedule->size() && frameOf(_schedule->at(_next).ms) < frame) {
+            const AudioExportSchedule::Message &message = _schedule->at(_next++);
+            if (message.sysexOffset >= 0) {
+                send(message);
+                continue;
+            }
+            if (message.length < 1) {
+                continue;
+            }
+            quint8 type = message.data[0] & 0xF0;
+            int channel = message.data[0] & 0x0F;
+            if (type == 0x90 && message.length == 3 && message.data[2] > 0) {
+                held[channel][message.data[1] & 0x7F] = message.data[2];
+                sustained[channel][message.data[1] & 0x7F] = 0;
+            } else if ((type == 0x80 || type == 0x90) && message.length == 3) {
+                int key = message.data[1] & 0x7F;
+                if (pedal[channel] && held[channel][key] > 0) {
+                    sustained[channel][key] = held[channel][key];
+                }
+                held[channel][key] = 0;
+            } else if (type != 0xA0) {
+                if (type == 0xB0 && message.length == 3) {
+                    int controller = message.data[1];
+                    if (controller == 64) {
+                        pedal[channel] = message.data[2] >= 64;
+                    } else if (controller == 121) {
+                        pedal[channel] = false;
+                    }
+                    if (controller == 120 || controller == 123) {
+                        // notes off keeps sustained notes, sound off ends all
+                        for (int key = 0; key < 128; key++) {
+                            if (controller == 123 && pedal[channel] && held[channel][key] > 0) {
+                                sustained[channel][key] = held[channel][key];
+                            } else if (controller == 120) {
+                                sustained[channel][key] = 0;
+                            }
+                            held[channel][key] = 0;
+                        }
+                    }
+                    if (!pedal[channel]) {
+                        memset(sustained[channel], 0, sizeof(sustained[channel]));
+                    }
+                }
+                send(message);
+            }
+        }
+
+        // The pedal state was sent with the controllers above, so the
+        // released notes go on sounding until it is lifted
+        for (int channel = 0; channel < 16; channel++) {
+            for (int key = 0; key < 128; key++) {
+                if (held[channel][key] > 0) {
+                    fluid_synth_noteon(_synth, channel, key, held[channel][key]);
+                } else if (sustained[channel][key] > 0) {
+                    fluid_synth_noteon(_synth, channel, key, sustained[channel][key]);
+                    fluid_synth_noteoff(_synth, channel, key);
+                }
+            }
+        }
+        _position = frame;
+    }
+
+    /// Gets the frame of a time in milliseconds.
+    qint64 frameOf(double ms) const {
+        return qRound64(ms * _sampleRate / 1000.0);
     }
 
-    // Setup destination file info
-    sndfile_dyn::SF_INFO dstInfo = {};
-    dstInfo.samplerate = srcInfo.samplerate;
-    dstInfo.channels   = srcInfo.channels;
-    dstInfo.format     = dstFormat;
+private:
+    void send(const AudioExportSchedule::Message &message) {
+        if (message.sysexOffset >= 0) {
+            sendToSynth(_synth, _schedule->sysexData(message), message.sysexLength);
+        } else if (message.length > 0) {
+            sendToSynth(_synth, message.data, message.length);
+        }
+    }
 
-    auto dstFile = openSndFile(outputPath, sndfile_dyn::SFM_WRITE, &dstInfo);
+    fluid_synth_t *_synth;
+    const AudioExportSchedule *_schedule;
+    double _sampleRate;
+    int _next;
+    qint64 _position;
+};
+
+fluid_synth_t *FluidSynthEngine::createOfflineSynth(double sampleRate, bool pooled) {
+    // No audio driver; blocks are pulled with fluid_synth_write_float()
+    fluid_settings_t* expSettings = new_fluid_settings();
+    fluid_settings_setnum(expSettings, "synth.sample-rate", sampleRate);
+
+    // Copy synth settings from the live engine
+    _engineMutex.lock();
+    applySynthSettings(expSettings);
+
+    // Pooled synths already run one per core; their own voice threads
+    // would only oversubscribe the CPU
+    if (pooled) {
+        fluid_settings_setint(expSettings, "synth.cpu-cores", 1);
+    }
+
+    // Only the samples of the presets a render actually uses are read
+    fluid_settings_setint(expSettings, "synth.dynamic-sample-loading", 1);
+
+    // Get loaded font paths while holding lock
+    QStringList fontsToLoad;
+    for (int i = 0; i < _loadedFonts.size(); ++i) {
+        fontsToLoad.append(_loadedFonts[i].second);
+    }
+    _engineMutex.unlock();
+
+    fluid_synth_t* synth = new_fluid_synth(expSettings);
+    if (!synth) {
+        delete_fluid_settings(expSettings);
+        return nullptr;
+    }
+    SoundFontCache::instance()->install(synth);
+
+    for (const QString &f : fontsToLoad) {
+        fluid_synth_sfload(synth, f.toUtf8().constData(), 1);
+    }
+    return synth;
+}
+
+void FluidSynthEngine::deleteOfflineSynth(fluid_synth_t *synth) {
+    if (!synth) {
+        return;
+    }
+    fluid_settings_t *settings = fluid_synth_get_settings(synth);
+    delete_fluid_synth(synth);
+    delete_fluid_settings(settings);
+}
+
+void FluidSynthEngine::exportAudio(const AudioExportSchedule *schedule, const QString &outputPath,
+                                   const AudioExportSettings &settings) {
+    _exportCancelled.store(false);
+
+    if (!_initialized || !schedule) {
+        emit exportFinished(false, outputPath);
+        return;
+    }
+
+    double sampleRate = renderRateOf(settings);
+
+    // Open the encoder first, so a missing codec fails before rendering
+    sndfile_dyn::Library sndfile;
+    if (!sndfile.load()) {
+        emit exportFinished(false, outputPath);
+        return;
+    }
+    sndfile_dyn::SNDFILE_HANDLE dstFile = sndfile.openEncoder(outputPath, settings, sampleRate);
     if (!dstFile) {
-        qWarning() << "FluidSynthEngine::transcodeWavTo: failed to open output file"
-                    << outputPath
-                    << "Format:" << QString::number(dstFormat, 16)
-                    << "Error:" << (sf_strerror ? sf_strerror(nullptr) : "unknown error");
-        sf_close(srcFile);
-        return false;
+        emit exportFinished(false, outputPath);
+        return;
     }
-    qDebug() << "FluidSynthEngine::transcodeWavTo: output file opened successfully.";
 
-    // Copy audio data in blocks, emitting progress for the transcode phase (80-100%)
+    qDebug() << "FluidSynthEngine::exportAudio: Rendering at" << sampleRate << "Hz";
+    qDebug() << "FluidSynthEngine::exportAudio: Starting export to" << outputPath << "Format:" << settings.format;
+
+    // Render the range, then 2 seconds so reverb/sustain fades naturally
+    qint64 endFrame = qRound64(schedule->durationMs() * sampleRate / 1000.0);
+    if (settings.includeReverbTail) {
+        endFrame += static_cast<qint64>(sampleRate * 2.0);
+    }
+
+    int lastPercent = -1;
+    bool failed = false;
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+
+    // Stream the interleaved stereo blocks straight into the encoder
+    auto write = [&](const float *audio, int frames, qint64 renderedFrames) -> bool {
+        if (sndfile.sf_writef_float(dstFile, audio, frames) != frames) {
+            qWarning() << "FluidSynthEngine::exportAudio: failed to write to" << outputPath;
+            return false;
+        }
+        int percent = static_cast<int>(100.0 * static_cast<double>(renderedFrames) / endFrame);
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit exportProgress(percent);
+        }
+        return true;
+    };
+
+    bool sliced = settings.parallelRender && QThread::idealThreadCount() > 1
+                  && endFrame > static_cast<qint64>(SLICE_SECONDS * sampleRate);
+    if (sliced) {
+        // Verification mode: every spliced block is compared with a serial
+        // render of the same frames
+        fluid_synth_t *reference = nullptr;
+        QScopedPointer<OfflineRender> referenceRender;
+        if (qEnvironmentVariableIsSet("MIDIEDITOR_VERIFY_PARALLEL_RENDER")) {
+            reference = createOfflineSynth(sampleRate);
+            if (reference) {
+                referenceRender.reset(new OfflineRender(reference, schedule, sampleRate));
+            }
+        }
+        double peakError = 0.0;
+        double squaredError = 0.0;
+        qint64 comparedFrames = 0;
+        std::vector<float> expected;
+        auto verifiedWrite = [&](const float *audio, int frames, qint64 renderedFrames) -> bool {
+            if (referenceRender) {
+                expected.resize(frames * 2);
+                referenceRender->render(expected.data(), frames);
+                for (int i = 0; i < 2 * frames; i++) {
+                    double error = std::fabs(double(audio[i]) - double(expected[i]));
+                    peakError = qMax(peakError, error);
+                    squaredError += error * error;
+                }
+                comparedFrames += frames;
+            }
+            return write(audio, frames, renderedFrames);
+        };
+
+        failed = !renderSliced(schedule, sampleRate, endFrame, settings.preRollSeconds, verifiedWrite);
+
+        if (referenceRender) {
+            double rmsError = std::sqrt(squaredError / qMax(qint64(1), 2 * comparedFrames));
+            if (rmsError > SLICE_RMS_TOLERANCE) {
+                qWarning() << "FluidSynthEngine::exportAudio: sliced render differs from serial render, RMS"
+                           << rmsError << "peak" << peakError << "(pre-roll" << settings.preRollSeconds << "s)";
+            } else {
+                qDebug() << "FluidSynthEngine::exportAudio: sliced render matches serial render, RMS"
+                         << rmsError << "peak" << peakError;
+            }
+            referenceRender.reset();
+        }
+        deleteOfflineSynth(reference);
+    } else {
+        fluid_synth_t* synth = createOfflineSynth(sampleRate);
+        if (!synth) {
+            failed = true;
+        } else {
+            OfflineRender render(synth, schedule, sampleRate);
+            constexpr int BLOCK_FRAMES = 4096;
+            std::vector<float> buffer(BLOCK_FRAMES * 2);
+            for (qint64 position = 0; position < endFrame; position += BLOCK_FRAMES) {
+                if (_exportCancelled.load()) {
+                    break;
+                }
+                int frames = static_cast<int>(qMin(qint64(BLOCK_FRAMES), endFrame - position));
+                render.render(buffer.data(), frames);
+                if (!write(buffer.data(), frames, position + frames)) {
+                    failed = true;
+                    break;
+                }
+            }
+            deleteOfflineSynth(synth);
+        }
+    }
+
+    sndfile.sf_close(dstFile);
+    bool cancelled = _exportCancelled.load();
+
+    if (cancelled) {
+        QFile::remove(outputPath);
+        emit exportCancelled();
+        return;
+    }
+    if (failed) {
+        QFile::remove(outputPath);
+        emit exportFinished(false, outputPath);
+        return;
+    }
+
+    double renderSeconds = qMax(qint64(1), renderTimer.nsecsElapsed()) / 1e9;
+    qDebug() << "FluidSynthEngine::exportAudio: successfully exported to" << outputPath
+             << "at" << (endFrame / sampleRate) / renderSeconds << "x real time";
+    emit exportFinished(true, outputPath);
+}
+
+bool FluidSynthEngine::renderSliced(const AudioExportSchedule *schedule, double sampleRate, qint64 endFrame,
+                                    double preRollSeconds, const SliceWriter &write) {
+    // Consecutive slices overlap by FADE_FRAMES and are crossfaded there
+    constexpr int FADE_FRAMES = 256;
     constexpr int BLOCK_FRAMES = 4096;
-    std::vector<float> buffer(BLOCK_FRAMES * srcInfo.channels);
-    sndfile_dyn::sf_count_t readCount;
-    sndfile_dyn::sf_count_t totalFrames = srcInfo.frames;
-    sndfile_dyn::sf_count_t framesProcessed = 0;
-    int lastTranscodePercent = -1;
 
-    while ((readCount = sf_readf_float(srcFile, buffer.data(), BLOCK_FRAMES)) > 0) {
+    qint64 sliceFrames = static_cast<qint64>(SLICE_SECONDS * sampleRate);
+    qint64 preRollFrames = qMax(qint64(0), static_cast<qint64>(preRollSeconds * sampleRate));
+    int sliceCount = static_cast<int>((endFrame + sliceFrames - 1) / sliceFrames);
+    int workers = qMax(1, qMin(QThread::idealThreadCount(), sliceCount));
+
+    /// One worker: a synth reused for a slice of every wave.
+    struct Lane {
+        fluid_synth_t *synth = nullptr;
+        std::vector<float> audio;
+        qint64 start = 0;
+        int frames = 0;
+        bool failed = false;
+    };
+    QVector<Lane> lanes(workers);
+
+    // The export thread joins the pool while it waits for a wave
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, workers - 1));
+
+    QtConcurrent::blockingMap(&pool, lanes, [this, sampleRate, sliceFrames](Lane &lane) {
+        lane.synth = createOfflineSynth(sampleRate, true);
+        lane.failed = !lane.synth;
+        lane.audio.resize((sliceFrames + FADE_FRAMES) * 2);
+    });
+
+    bool ok = true;
+    for (const Lane &lane : lanes) {
+        ok = ok && !lane.failed;
+    }
+
+    std::vector<float> carry(FADE_FRAMES * 2);
+    int carryFrames = 0;
+
+    for (int first = 0; ok && first < sliceCount; first += workers) {
+        int wave = qMin(workers, sliceCount - first);
+        for (int i = 0; i < wave; i++) {
+            Lane &lane = lanes[i];
+            lane.start = (first + i) * sliceFrames;
+            qint64 end = qMin(lane.start + sliceFrames, endFrame);
+            lane.frames = static_cast<int>(qMin(end + FADE_FRAMES, endFrame) - lane.start);
+        }
+
+        // Every slice starts from a reset synth: the state before the
+        // pre-roll is replayed, the pre-roll is rendered and discarded
+        QtConcurrent::blockingMap(&pool, lanes.begin(), lanes.begin() + wave,
+                                  [this, schedule, sampleRate, preRollFrames](Lane &lane) {
+            fluid_synth_system_reset(lane.synth);
+            OfflineRender render(lane.synth, schedule, sampleRate);
+            qint64 from = qMax(qint64(0), lane.start - preRollFrames);
+            render.seek(from);
+            for (qint64 position = from; position < lane.start; position += BLOCK_FRAMES) {
+                if (_exportCancelled.load()) {
+                    return;
+                }
+                render.render(lane.audio.data(), static_cast<int>(qMin(qint64(BLOCK_FRAMES), lane.start - position)));
+            }
+            for (int position = 0; position < lane.frames; position += BLOCK_FRAMES) {
+                if (_exportCancelled.load()) {
+                    return;
+                }
+                render.render(lane.audio.data() + 2 * position, qMin(BLOCK_FRAMES, lane.frames - position));
+            }
+        });
         if (_exportCancelled.load()) {
-            sf_close(dstFile);
-            sf_close(srcFile);
-            QFile::remove(outputPath);
-            return false;
+            ok = false;
+            break;
         }
-        sf_writef_float(dstFile, buffer.data(), readCount);
-        framesProcessed += readCount;
 
-        // Report progress: transcode phase maps to 80-100%
-        if (totalFrames > 0) {
-            int transcodePercent = 80 + static_cast<int>(20.0 * static_cast<double>(framesProcessed) / totalFrames);
-            if (transcodePercent > 100) transcodePercent = 100;
-            
-            if (transcodePercent != lastTranscodePercent) {
-                lastTranscodePercent = transcodePercent;
-                emit exportProgress(transcodePercent);
+        // Splice the wave in order
+        for (int i = 0; ok && i < wave; i++) {
+            Lane &lane = lanes[i];
+            float *audio = lane.audio.data();
+            for (int f = 0; f < carryFrames; f++) {
+                float t = (f + 0.5f) / carryFrames;
+                audio[2 * f] = carry[2 * f] * (1.0f - t) + audio[2 * f] * t;
+                audio[2 * f + 1] = carry[2 * f + 1] * (1.0f - t) + audio[2 * f + 1] * t;
             }
+
+            qint64 end = qMin(lane.start + sliceFrames, endFrame);
+            int length = static_cast<int>(end - lane.start);
+            ok = write(audio, length, end);
+
+            carryFrames = lane.frames - length;
+            std::copy(audio + 2 * length, audio + 2 * lane.frames, carry.begin());
+        }
+    }
+
+    for (Lane &lane : lanes) {
+        deleteOfflineSynth(lane.synth);
+    }
+    return ok;
+}
+
+void FluidSynthEngine::exportStems(const QList<const AudioExportSchedule *> &stems, const QStringList &stemPaths,
+                                   const QString &masterPath, const AudioExportSettings &settings) {
+    _exportCancelled.store(false);
+
+    QString resultPath = masterPath.isEmpty() ? stemPaths.value(0) : masterPath;
+    if (!_initialized || stems.isEmpty() || stems.size() != stemPaths.size()) {
+        emit exportFinished(false, resultPath);
+        return;
+    }
+
+    double sampleRate = renderRateOf(settings);
+
+    sndfile_dyn::Library sndfile;
+    if (!sndfile.load()) {
+        emit exportFinished(false, resultPath);
+        return;
+    }
+
+    /// One stem: its own synth, renderer, encoder and round buffer.
+    struct Stem {
+        const AudioExportSchedule *schedule = nullptr;
+        fluid_synth_t *synth = nullptr;
+        OfflineRender *render = nullptr;
+        sndfile_dyn::SNDFILE_HANDLE file = nullptr;
+        std::vector<float> buffer;
+        bool failed = false;
+    };
+
+    // Stems are rendered in rounds: all stems render the same frames in
+    // parallel, then the blocks are mixed. Memory stays at one round per stem.
+    constexpr int ROUND_FRAMES = 16384;
+
+    QVector<Stem> jobs(stems.size());
+    QStringList openedPaths;
+    bool failed = false;
+    for (int i = 0; i < stems.size() && !failed; i++) {
+        jobs[i].schedule = stems.at(i);
+        jobs[i].buffer.resize(ROUND_FRAMES * 2);
+        jobs[i].file = sndfile.openEncoder(stemPaths.at(i), settings, sampleRate);
+        if (jobs[i].file) {
+            openedPaths.append(stemPaths.at(i));
+        } else {
+            failed = true;
+        }
+    }
+    sndfile_dyn::SNDFILE_HANDLE masterFile = nullptr;
+    if (!failed && !masterPath.isEmpty()) {
+        masterFile = sndfile.openEncoder(masterPath, settings, sampleRate);
+        if (masterFile) {
+            openedPaths.append(masterPath);
         } else {
-            // If totalFrames is not available, just emit 99% to show activity
-            if (lastTranscodePercent < 100) {
-                lastTranscodePercent = 100;
-                emit exportProgress(100);
+            failed = true;
+        }
+    }
+
+    qDebug() << "FluidSynthEngine::exportStems: Rendering" << stems.size() << "stems at" << sampleRate << "Hz";
+
+    // The export thread joins the pool while it waits for a round
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
+
+    // SoundFonts are loaded concurrently as well
+    if (!failed) {
+        QtConcurrent::blockingMap(&pool, jobs, [this, sampleRate](Stem &stem) {
+            stem.synth = createOfflineSynth(sampleRate, true);
+            if (stem.synth) {
+                stem.render = new OfflineRender(stem.synth, stem.schedule, sampleRate);
+            } else {
+                stem.failed = true;
             }
+        });
+        for (const Stem &stem : jobs) {
+            failed = failed || stem.failed;
         }
     }
 
-    sf_close(dstFile);
-    sf_close(srcFile);
+    qint64 endFrame = qRound64(stems.first()->durationMs() * sampleRate / 1000.0);
+    if (settings.includeReverbTail) {
+        endFrame += static_cast<qint64>(sampleRate * 2.0);
+    }
 
-    qDebug() << "FluidSynthEngine::transcodeWavTo: successfully transcoded to" << outputPath;
-    return true;
+    std::vector<float> mix(ROUND_FRAMES * 2);
+    int lastPercent = -1;
+    bool cancelled = false;
+
+    for (qint64 position = 0; !failed && position < endFrame; position += ROUND_FRAMES) {
+        if (_exportCancelled.load()) {
+            cancelled = true;
+            break;
+        }
+        int frames = static_cast<int>(qMin(qint64(ROUND_FRAMES), endFrame - position));
+
+        QtConcurrent::blockingMap(&pool, jobs, [&sndfile, frames](Stem &stem) {
+            stem.render->render(stem.buffer.data(), frames);
+            if (sndfile.sf_writef_float(stem.file, stem.buffer.data(), frames) != frames) {
+                stem.failed = true;
+            }
+        });
+
+        if (masterFile) {
+            std::fill(mix.begin(), mix.begin() + 2 * frames, 0.0f);
+            for (const Stem &stem : jobs) {
+                for (int j = 0; j < 2 * frames; j++) {
+                    mix[j] += stem.buffer[j];
+                }
+            }
+            if (sndfile.sf_writef_float(masterFile, mix.data(), frames) != frames) {
+                failed = true;
+            }
+        }
+        for (const Stem &stem : jobs) {
+            failed = failed || stem.failed;
+        }
+
+        int percent = static_cast<int>(100.0 * static_cast<double>(position + frames) / endFrame);
+        if (percent != lastPercent) {
+            lastPercent = percent;
+            emit exportProgress(percent);
+        }
+    }
+
+    for (Stem &stem : jobs) {
+        if (stem.file) {
+            sndfile.sf_close(stem.file);
+        }
+        delete stem.render;
+        deleteOfflineSynth(stem.synth);
+    }
+    if (masterFile) {
+        sndfile.sf_close(masterFile);
+    }
+
+    if (cancelled || failed) {
+        for (const QString &path : openedPaths) {
+            QFile::remove(path);
+        }
+        if (cancelled) {
+            emit exportCancelled();
+        } else {
+            qWarning() << "FluidSynthEngine::exportStems: export failed";
+            emit exportFinished(false, resultPath);
+        }
+        return;
+    }
+
+    qDebug() << "FluidSynthEngine::exportStems: successfully exported" << stems.size() << "stems";
+    emit exportFinished(true, resultPath);
+}
+
+void FluidSynthEngine::cancelExport() {
+    _exportCancelled.store(true);
+}
+
+void FluidSynthEngine::measureRenderSpeed() {
+    if (!_initialized) {
+        emit renderSpeedMeasured(0.0);
+        return;
+    }
+
+    QThreadPool::globalInstance()->start([this]() {
+        double sampleRate;
+        {
+            QMutexLocker locker(&_engineMutex);
+            sampleRate = _sampleRate;
+        }
+
+        // SoundFont loading is not part of the measurement
+        fluid_synth_t *synth = createOfflineSynth(sampleRate);
+        if (!synth) {
+            emit renderSpeedMeasured(0.0);
+            return;
+        }
+
+        constexpr double SECONDS = 5.0;
+        constexpr int BLOCK_FRAMES = 4096;
+        constexpr int NOTES_PER_CHANNEL = 8;
+        std::vector<float> buffer(BLOCK_FRAMES * 2);
+        qint64 totalFrames = static_cast<qint64>(SECONDS * sampleRate);
+        qint64 strikeFrames = static_cast<qint64>(sampleRate / 2.0);
+        qint64 nextStrike = 0;
+        int strike = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // Chords on all channels every half second without note offs, so
+        // the polyphony limit is reached and voices are stolen
+        for (qint64 position = 0; position < totalFrames; position += BLOCK_FRAMES) {
+            if (position >= nextStrike) {
+                for (int channel = 0; channel < 16; channel++) {
+                    for (int i = 0; i < NOTES_PER_CHANNEL; i++) {
+                        int key = 36 + (strike * 7 + channel * 3 + i * 5) % 60;
+                        fluid_synth_noteon(synth, channel, key, 100);
+                    }
+                }
+                strike++;
+                nextStrike += strikeFrames;
+            }
+            int frames = static_cast<int>(qMin(qint64(BLOCK_FRAMES), totalFrames - position));
+            fluid_synth_write_float(synth, frames, buffer.data(), 0, 2, buffer.data(), 1, 2);
+        }
+
+        double elapsed = qMax(qint64(1), timer.nsecsElapsed()) / 1e9;
+        deleteOfflineSynth(synth);
+
+        qDebug() << "FluidSynthEngine::measureRenderSpeed:" << SECONDS / elapsed << "x real time";
+        emit renderSpeedMeasured(SECONDS / elapsed);
+    });
 }
 
 // ============================================================================
@@ -900,16 +1650,7 @@ void FluidSynthEngine::setSampleRate(double rate) {
     _sampleRate = rate;
     if (_initialized) {
         // Sample rate requires recreating synth and reloading soundfonts
-        if (!_isEngineRestartPending) {
-            _isEngineRestartPending = true;
-            QThreadPool::globalInstance()->start([this]() {
-                QMutexLocker locker(&_engineMutex);
-                _isEngineRestartPending = false;
-                shutdown();
-                initialize();
-                QMetaObject::invokeMethod(this, "engineRestarted", Qt::QueuedConnection);
-            });
-        }
+        scheduleRestart();
     }
     save(); // Persist immediately
 }
@@ -955,21 +1696,73 @@ void FluidSynthEngine::setPolyphony(int polyphony) {
     }
 }
 
+void FluidSynthEngine::setCpuCores(int cores) {
+    QMutexLocker locker(&_engineMutex);
+    cores = qBound(1, cores, 256);
+    if (_cpuCores == cores) return;
+
+    _cpuCores = cores;
+    if (_initialized) {
+        // synth.cpu-cores is only read when the synth is created
+        scheduleRestart();
+    }
+    save(); // Persist immediately
+}
+
+void FluidSynthEngine::setPeriodSize(int frames) {
+    QMutexLocker locker(&_engineMutex);
+    if (_periodSize == frames) return;
+
+    _periodSize = frames;
+    if (_initialized) {
+        scheduleRestart();
+    }
+    save(); // Persist immediately
+}
+
+void FluidSynthEngine::setPeriods(int periods) {
+    QMutexLocker locker(&_engineMutex);
+    if (_periods == periods) return;
+
+    _periods = periods;
+    if (_initialized) {
+        scheduleRestart();
+    }
+    save(); // Persist immediately
+}
+
+void FluidSynthEngine::setVoiceStealing(const QString &mode) {
+    QMutexLocker locker(&_engineMutex);
+    if (_voiceStealing == mode) return;
+
+    _voiceStealing = mode;
+    if (_initialized && _settings) {
+        // The overflow priorities are read on every voice allocation
+        applyVoiceStealing(_settings, _voiceStealing);
+    }
+    save(); // Persist immediately
+}
+
+void FluidSynthEngine::scheduleRestart() {
+    if (_isEngineRestartPending) {
+        return;
+    }
+    _isEngineRestartPending = true;
+    QThreadPool::globalInstance()->start([this]() {
+        QMutexLocker locker(&_engineMutex);
+        _isEngineRestartPending = false;
+        shutdown();
+        initialize();
+        QMetaObject::invokeMethod(this, "engineRestarted", Qt::QueuedConnection);
+    });
+}
+
 void FluidSynthEngine::setSampleFormat(const QString &format) {
     QMutexLocker locker(&_engineMutex);
     if (_sampleFormat != format) {
         _sampleFormat = format;
         if (_initialized) {
-            if (!_isEngineRestartPending) {
-                _isEngineRestartPending = true;
-                QThreadPool::globalInstance()->start([this]() {
-                    QMutexLocker locker(&_engineMutex);
-                    _isEngineRestartPending = false;
-                    shutdown();
-                    initialize();
-                    QMetaObject::invokeMethod(this, "engineRestarted", Qt::QueuedConnection);
-                });
-            }
+            scheduleRestart();
         }
         save(); // Persist immediately
     }
@@ -1003,6 +1796,22 @@ int FluidSynthEngine::polyphony() const {
     return _polyphony;
 }
 
+int FluidSynthEngine::cpuCores() const {
+    return _cpuCores;
+}
+
+int FluidSynthEngine::periodSize() const {
+    return _periodSize;
+}
+
+int FluidSynthEngine::periods() const {
+    return _periods;
+}
+
+QString FluidSynthEngine::voiceStealing() const {
+    return _voiceStealing;
+}
+
 QString FluidSynthEngine::sampleFormat() const {
     return _sampleFormat;
 }
@@ -1094,6 +1903,10 @@ void FluidSynthEngine::saveSettings(QSettings *settings) {
     settings->setValue("polyphony", _polyphony);
     settings->setValue("reverbEnabled", _reverbEnabled);
     settings->setValue("chorusEnabled", _chorusEnabled);
+    settings->setValue("cpuCores", _cpuCores);
+    settings->setValue("periodSize", _periodSize);
+    settings->setValue("periods", _periods);
+    settings->setValue("voiceStealing", _voiceStealing);
 
     // Save SoundFont collection
     // Uses soundFontCollection() which works even when the engine is shut down
@@ -1124,6 +1937,10 @@ void FluidSynthEngine::loadSettings(QSettings *settings) {
     _reverbEnabled = settings->value("reverbEnabled", true).toBool();
     _chorusEnabled = settings->value("chorusEnabled", true).toBool();
     _polyphony = settings->value("polyphony", 256).toInt();
+    _cpuCores = qBound(1, settings->value("cpuCores", 1).toInt(), 256);
+    _periodSize = settings->value("periodSize", 0).toInt();
+    _periods = settings->value("periods", 0).toInt();
+    _voiceStealing = settings->value("voiceStealing", "default").toString();
 
     int sfCount = settings->beginReadArray("soundFontCollection");
     QList<QPair<QString, bool>> collection;
@@ -21,16 +21,24 @@
 
 #ifdef FLUIDSYNTH_SUPPORT
 
+#include "SynthMessageQueue.h"
+
 #include <QObject>
 #include <QList>
+#include <QMutex>
 #include <QPair>
 #include <QRecursiveMutex>
+#include <QSemaphore>
 #include <QString>
 #include <QStringList>
 #include <atomic>
+#include <functional>
 
 #include <fluidsynth.h>
 
+class AudioExportSchedule;
+class QThread;
+
 /**
  * \brief Configuration for audio export operations.
  */
@@ -41,6 +49,8 @@ struct AudioExportSettings {
     int rate = 48000;
     QString sampleFormat = "16bits";
     bool includeReverbTail = true;  ///< Add 2s after last note for reverb/sustain fade
+    bool parallelRender = false;    ///< Render long exports in time slices on all cores (opt-in, see renderSliced())
+    double preRollSeconds = 4.0;    ///< Rendered and discarded before every time slice
 
     double sampleRate() const { return static_cast<double>(rate); }
 
@@ -199,6 +209,13 @@ public:
      * (loaded last). The UI presents top = highest priority, so this method
      * loads items in reverse order.
      *
+     * The new stack is loaded on a background thread; soundFontLoadProgress
+     * is emitted before each file and once all files are loaded. Layers
+     * added on top of or removed from the top of the loaded stack are
+     * changed on the live synth. If a lower layer changes, the whole stack
+     * is loaded into a new synth which replaces the live one, unless a newer
+     * stack was requested in the meantime.
+     *
      * \param paths List of SF2/SF3/DLS file paths, top = highest priority
      */
     void setSoundFontStack(const QStringList &paths);
@@ -217,22 +234,54 @@ public:
      */
     void sendMidiData(const QByteArray &data);
 
+    /**
+     * \brief Routes raw MIDI bytes to the FluidSynth synthesizer.
+     *
+     * Short messages are pushed into a lock-free queue which the feeder
+     * thread drains into the synth, so the caller never waits for
+     * configuration work or SoundFont loading. SysEx messages are sent
+     * directly, and so are note-offs and all-notes/all-sounds-off if the
+     * queue is full; other messages are dropped in that case.
+     * \param data Raw MIDI message bytes
+     * \param length Number of bytes
+     */
+    void sendMidiData(const quint8 *data, int length);
+
     // === Export ===
 
     /**
      * \brief Multi-format audio export. Supports WAV, FLAC, Opus, OGG Vorbis, MP3.
      *
-     * Creates an offline FluidSynth instance, renders the MIDI file to
-     * the specified output path using the given settings.
+     * Creates an offline FluidSynth instance and renders the schedule
+     * without intermediate files: every message is sent to the synth at
+     * its sample offset, the audio is pulled in blocks with
+     * fluid_synth_write_float() and streamed into the libsndfile encoder.
      * Emits exportProgress/exportFinished/exportCancelled signals.
      *
-     * \param midiFilePath Path to the temporary MIDI file to render
+     * \param schedule The messages to render; must stay valid during the export
      * \param outputPath Path for the output audio file
      * \param settings Export configuration (format, quality, reverb tail)
-     * \param totalTicks Used for progress reporting
      */
-    void exportAudio(const QString &midiFilePath, const QString &outputPath,
-                     const AudioExportSettings &settings, int totalTicks);
+    void exportAudio(const AudioExportSchedule *schedule, const QString &outputPath,
+                     const AudioExportSettings &settings);
+
+    /**
+     * \brief Renders stems concurrently, one synth per stem.
+     *
+     * Every stem gets its own offline FluidSynth instance with the current
+     * SoundFont stack and settings. The stems are rendered in rounds on a
+     * thread pool; after every round the blocks are written to the stem
+     * files and, if masterPath is set, summed into the master mix.
+     * Emits the aggregate progress through exportProgress and finishes
+     * with exportFinished(success, masterPath or the first stem path).
+     *
+     * \param stems Schedules of the stems (same range); must stay valid during the export
+     * \param stemPaths Output path of every stem
+     * \param masterPath Output path of the mix, empty for no mix
+     * \param settings Export configuration (format, quality, reverb tail)
+     */
+    void exportStems(const QList<const AudioExportSchedule *> &stems, const QStringList &stemPaths,
+                     const QString &masterPath, const AudioExportSettings &settings);
 
     /**
      * \brief Requests cancellation of a running export.
@@ -248,6 +297,10 @@ public:
     void setReverbEnabled(bool enabled);
     void setChorusEnabled(bool enabled);
     void setPolyphony(int polyphony);
+    void setCpuCores(int cores);
+    void setPeriodSize(int frames);
+    void setPeriods(int periods);
+    void setVoiceStealing(const QString &mode);
 
     QString audioDriver() const;
     double gain() const;
@@ -258,6 +311,29 @@ public:
     bool chorusEnabled() const;
     int polyphony() const;
 
+    /// Worker threads FluidSynth renders voices with (synth.cpu-cores)
+    int cpuCores() const;
+
+    /// Audio driver buffer size in frames (audio.period-size), 0 for the driver default
+    int periodSize() const;
+
+    /// Number of audio driver buffers (audio.periods), 0 for the driver default
+    int periods() const;
+
+    /// Voice stealing priorities: "default" or "newest" (new notes replace old ones first)
+    QString voiceStealing() const;
+
+    /**
+     * \brief Measures how fast the current settings render a dense passage.
+     *
+     * Renders a few seconds of sustained chords on all channels with an
+     * offline synth using the current SoundFonts, polyphony and core count,
+     * on a background thread. Emits renderSpeedMeasured with the rendered
+     * audio duration divided by the time it took (above 1 is faster than
+     * real time).
+     */
+    void measureRenderSpeed();
+
     QStringList availableAudioDrivers() const;
 
     /**
@@ -291,11 +367,13 @@ signals:
     void soundFontLoaded(int sfontId, const QString &path);
     void soundFontUnloaded(int sfontId);
     void soundFontsChanged();
+    void soundFontLoadProgress(int loaded, int total);
     void initializationFailed(const QString &error);
     void engineRestarted();
     void exportProgress(int percent);
     void exportFinished(bool success, const QString &path);
     void exportCancelled();
+    void renderSpeedMeasured(double factor);
 
 private:
     FluidSynthEngine();
@@ -311,8 +389,25 @@ private:
     bool _initialized;
 
     // Mutex protecting all fluid_* calls and engine state changes cross-thread
+    // (except the live MIDI messages, see _liveMutex)
     mutable QRecursiveMutex _engineMutex;
 
+    // Live MIDI messages, drained into the synth by the feeder thread
+    SynthMessageQueue _liveQueue;
+    QSemaphore _livePending;
+    QThread *_feeder;
+    std::atomic<bool> _feederStopped{false};
+    std::atomic<bool> _live{false};
+
+    // Guards _synth against a swap while the feeder uses it; held only briefly
+    QMutex _liveMutex;
+
+    // Last program, controller values and pitch bend per channel (-1 if not
+    // set), replayed on a new synth after a swap
+    int _programs[16];
+    int _controllers[16][128];
+    int _pitchBends[16];
+
     // SoundFont tracking: sfont_id → file path (in load order, last = highest priority)
     QList<QPair<int, QString>> _loadedFonts;
 
@@ -328,22 +423,79 @@ private:
     bool _chorusEnabled;
     int _polyphony;
     QString _sampleFormat;
+    int _cpuCores;
+    int _periodSize;
+    int _periods;
+    QString _voiceStealing;
     
     // Background task debouncing
     bool _isStackUpdatePending;
     QStringList _pendingStackUpdate;
+
+    // Set while the SoundFont stack worker runs; only one worker at a time
+    bool _isStackWorkerRunning;
+
+    // Incremented by every setSoundFontStack() call, so a stack loaded for an
+    // older request is discarded instead of replacing a newer one
+    quint64 _stackGeneration;
     bool _isEngineRestartPending;
 
     // Export cancellation flag
     std::atomic<bool> _exportCancelled{false};
 
-    /// Returns true for formats that FluidSynth can't render directly (Opus, MP3)
-    static bool needsTranscode(const AudioExportSettings &settings);
+    /// Creates FluidSynth settings from the cached settings values.
+    fluid_settings_t *createSettings() const;
+
+    /// Applies the cached synth settings shared by the live and offline synths.
+    void applySynthSettings(fluid_settings_t *settings) const;
+
+    /// Applies the voice stealing priorities to settings.
+    static void applyVoiceStealing(fluid_settings_t *settings, const QString &mode);
+
+    /// SoundFont stack worker: applies pending setSoundFontStack() requests in order.
+    void applySoundFontStacks();
+
+    /// Restarts the engine on a worker thread (once, even if requested repeatedly).
+    void scheduleRestart();
+
+    /// Starts the feeder thread, dropping messages queued before.
+    void startFeeder();
+
+    /// Stops the feeder thread.
+    void stopFeeder();
+
+    /// Feeder thread loop: drains _liveQueue into the current synth.
+    void feed();
+
+    /// Sends a short message to synth and records the channel state.
+    void dispatch(fluid_synth_t *synth, const quint8 *data, int length);
+
+    /// Replays the recorded channel state on a new synth.
+    void restoreChannelState(fluid_synth_t *synth);
+
+    /// Sends a MIDI message (including SysEx) to synth without recording state.
+    static void sendToSynth(fluid_synth_t *synth, const quint8 *data, int length);
+
+    /// Renders an export schedule on an offline synth (see FluidSynthEngine.cpp).
+    class OfflineRender;
+
+    /// Creates a driverless synth with the live settings and SoundFont stack.
+    /// Pooled synths (one of several rendering in parallel) use one core each.
+    fluid_synth_t *createOfflineSynth(double sampleRate, bool pooled = false);
+
+    /// Deletes a synth created by createOfflineSynth() and its settings.
+    static void deleteOfflineSynth(fluid_synth_t *synth);
+
+    /// Receives rendered audio (interleaved stereo, frames, frames rendered so far).
+    typedef std::function<bool(const float *, int, qint64)> SliceWriter;
 
-    /// Transcodes a rendered WAV file to the target format using libsndfile.
-    /// Returns true on success.
-    bool transcodeWavTo(const QString &wavPath, const QString &outputPath,
-                        const AudioExportSettings &settings);
+    /// Renders the schedule in time slices on all cores and passes the
+    /// spliced audio to write in order. Returns false on failure or cancel.
+    /// Slices only approximate a serial render (effect and LFO state restart
+    /// at every pre-roll); with MIDIEDITOR_VERIFY_PARALLEL_RENDER set in the
+    /// environment, exportAudio() compares both and logs the difference.
+    bool renderSliced(const AudioExportSchedule *schedule, double sampleRate, qint64 endFrame,
+                      double preRollSeconds, const SliceWriter &write);
 };
 
 #endif // FLUIDSYNTH_SUPPORT
@@ -0,0 +1,135 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MeterMap.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/TimeSignatureEvent.h"
+
+#include <algorithm>
+
+MeterMap::MeterMap() {
+}
+
+void MeterMap::rebuild(const QList<MidiEvent *> &sortedEvents) {
+    _segments.clear();
+    _segments.reserve(sortedEvents.size());
+
+    int measure = 1;
+    for (MidiEvent *event : sortedEvents) {
+        TimeSignatureEvent *ev = dynamic_cast<TimeSignatureEvent *>(event);
+        if (!ev) {
+            qWarning("unknown eventtype in the List [2]");
+            continue;
+        }
+        if (!_segments.isEmpty()) {
+            const Segment &last = _segments.last();
+            measure += (ev->midiTime() - last.tick) / last.ticksPerMeasure;
+        }
+        Segment segment;
+        segment.tick = ev->midiTime();
+        segment.measure = measure;
+        segment.ticksPerMeasure = qMax(1, ev->ticksPerMeasure());
+        segment.num = ev->num();
+        segment.denom = ev->denom();
+        segment.event = ev;
+        _segments.append(segment);
+    }
+}
+
+bool MeterMap::isEmpty() const {
+    return _segments.isEmpty();
+}
+
+int MeterMap::size() const {
+    return _segments.size();
+}
+
+int MeterMap::segmentAtTick(int tick) const {
+    if (_segments.isEmpty()) {
+        return -1;
+    }
+    // last segment starting at or before tick
+    auto it = std::upper_bound(_segments.constBegin(), _segments.constEnd(), tick,
+                               [](int t, const Segment &s) { return t < s.tick; });
+    if (it == _segments.constBegin()) {
+        return 0;
+    }
+    return int(it - _segments.constBegin()) - 1;
+}
+
+int MeterMap::segmentOfMeasure(int measure) const {
+    if (_segments.isEmpty()) {
+        return -1;
+    }
+    auto it = std::upper_bound(_segments.constBegin(), _segments.constEnd(), measure,
+                               [](int m, const Segment &s) { return m < s.measure; });
+    if (it == _segments.constBegin()) {
+        return 0;
+    }
+    return int(it - _segments.constBegin()) - 1;
+}
+
+int MeterMap::measure(int tick, int *ticksInMeasure) const {
+    int i = segmentAtTick(tick);
+    if (i < 0) {
+        if (ticksInMeasure) {
+            *ticksInMeasure = 0;
+        }
+        return 1;
+    }
+    const Segment &s = _segments.at(i);
+    int ticks = tick - s.tick;
+    if (ticksInMeasure) {
+        *ticksInMeasure = ticks % s.ticksPerMeasure;
+    }
+    return s.measure + ticks / s.ticksPerMeasure;
+}
+
+int MeterMap::startTickOfMeasure(int measure) const {
+    int i = segmentOfMeasure(measure);
+    if (i < 0) {
+        return 0;
+    }
+    const Segment &s = _segments.at(i);
+    return s.tick + (measure - s.measure) * s.ticksPerMeasure;
+}
+
+int MeterMap::startTick(int segment) const {
+    return _segments.at(segment).tick;
+}
+
+int MeterMap::startMeasure(int segment) const {
+    return _segments.at(segment).measure;
+}
+
+int MeterMap::ticksPerMeasure(int segment) const {
+    return _segments.at(segment).ticksPerMeasure;
+}
+
+int MeterMap::num(int segment) const {
+    return _segments.at(segment).num;
+}
+
+int MeterMap::denom(int segment) const {
+    return _segments.at(segment).denom;
+}
+
+TimeSignatureEvent *MeterMap::event(int segment) const {
+    return _segments.at(segment).event;
+}
@@ -0,0 +1,150 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef METERMAP_H_
+#define METERMAP_H_
+
+// Qt includes
+#include <QList>
+#include <QVector>
+
+// Forward declarations
+class MidiEvent;
+class TimeSignatureEvent;
+
+/**
+ * \class MeterMap
+ *
+ * \brief Precomputed time signature segment table for tick <-> measure conversion.
+ *
+ * Every TimeSignatureEvent of channel 18 starts a segment. For each segment the
+ * table stores its start tick, the number of the measure starting there and the
+ * segment's ticks per measure. Conversions in both directions are binary
+ * searches over this table, so they cost O(log S) for S time signatures instead
+ * of a full rescan of the time signature channel.
+ *
+ * Measures are counted from 1 at the first time signature. A time signature
+ * that does not fall on a bar line starts a new measure; the incomplete measure
+ * before it is not counted.
+ *
+ * MeterMap is a value type backed by an implicitly shared QVector, so copies
+ * are cheap and can be used as immutable snapshots outside of MidiFile's lock.
+ */
+class MeterMap {
+public:
+    /**
+     * \brief Creates an empty MeterMap.
+     */
+    MeterMap();
+
+    /**
+     * \brief Rebuilds the table from the time signature channel.
+     * \param sortedEvents Events of channel 18 in playback order (as returned
+     *        by MidiChannel::sortedEvents())
+     */
+    void rebuild(const QList<MidiEvent *> &sortedEvents);
+
+    /**
+     * \brief Returns true if the table contains no time signatures.
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief Returns the number of time signature segments.
+     */
+    int size() const;
+
+    /**
+     * \brief Returns the index of the segment active at the given tick.
+     *
+     * Ticks before the first time signature map to segment 0.
+     * \return Segment index, or -1 if the table is empty
+     */
+    int segmentAtTick(int tick) const;
+
+    /**
+     * \brief Returns the index of the segment the given measure belongs to.
+     *
+     * Measures before the first time signature map to segment 0.
+     * \return Segment index, or -1 if the table is empty
+     */
+    int segmentOfMeasure(int measure) const;
+
+    /**
+     * \brief Converts a tick to a measure number.
+     * \param tick Time in MIDI ticks
+     * \param ticksInMeasure If given, receives the ticks since the start of the measure
+     * \return The measure containing tick (1 if the table is empty)
+     */
+    int measure(int tick, int *ticksInMeasure = 0) const;
+
+    /**
+     * \brief Converts a measure number to the tick it starts at.
+     * \param measure Measure number
+     * \return Start tick of the measure (0 if the table is empty)
+     */
+    int startTickOfMeasure(int measure) const;
+
+    /**
+     * \brief Gets the start tick of a segment.
+     */
+    int startTick(int segment) const;
+
+    /**
+     * \brief Gets the number of the measure starting at a segment's start.
+     */
+    int startMeasure(int segment) const;
+
+    /**
+     * \brief Gets the ticks per measure of a segment.
+     */
+    int ticksPerMeasure(int segment) const;
+
+    /**
+     * \brief Gets the numerator of a segment's time signature.
+     */
+    int num(int segment) const;
+
+    /**
+     * \brief Gets the denominator exponent of a segment's time signature.
+     */
+    int denom(int segment) const;
+
+    /**
+     * \brief Gets the TimeSignatureEvent that starts a segment.
+     */
+    TimeSignatureEvent *event(int segment) const;
+
+private:
+    /**
+     * \brief One row of the time signature table.
+     */
+    struct Segment {
+        int tick;
+        int measure;
+        int ticksPerMeasure;
+        int num;
+        int denom;
+        TimeSignatureEvent *event;
+    };
+
+    /** \brief Segments sorted by tick (and therefore by measure) */
+    QVector<Segment> _segments;
+};
+
+#endif // METERMAP_H_
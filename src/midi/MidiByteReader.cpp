@@ -0,0 +1,140 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MidiByteReader.h"
+
+#include <cstring>
+
+MidiByteReader::MidiByteReader(const char *data, qint64 size) {
+    _data = reinterpret_cast<const uchar *>(data);
+    _size = data ? qMax(qint64(0), size) : 0;
+    _pos = 0;
+}
+
+bool MidiByteReader::atEnd() const {
+    return _pos >= _size;
+}
+
+qint64 MidiByteReader::pos() const {
+    return _pos;
+}
+
+qint64 MidiByteReader::size() const {
+    return _size;
+}
+
+qint64 MidiByteReader::bytesLeft() const {
+    return _size - _pos;
+}
+
+void MidiByteReader::seek(qint64 pos) {
+    _pos = qBound(qint64(0), pos, _size);
+}
+
+const char *MidiByteReader::current() const {
+    return reinterpret_cast<const char *>(_data + _pos);
+}
+
+quint8 MidiByteReader::readByte() {
+    if (_pos >= _size) {
+        return 0;
+    }
+    return _data[_pos++];
+}
+
+quint16 MidiByteReader::readUInt16() {
+    if (_size - _pos < 2) {
+        _pos = _size;
+        return 0;
+    }
+    quint16 value = (quint16(_data[_pos]) << 8) | _data[_pos + 1];
+    _pos += 2;
+    return value;
+}
+
+quint32 MidiByteReader::readUInt32() {
+    if (_size - _pos < 4) {
+        _pos = _size;
+        return 0;
+    }
+    quint32 value = (quint32(_data[_pos]) << 24) | (quint32(_data[_pos + 1]) << 16)
+                    | (quint32(_data[_pos + 2]) << 8) | _data[_pos + 3];
+    _pos += 4;
+    return value;
+}
+
+QByteArray MidiByteReader::readBytes(qint64 length) {
+    if (length <= 0 || _size - _pos < length) {
+        return QByteArray();
+    }
+    QByteArray array(reinterpret_cast<const char *>(_data + _pos), length);
+    _pos += length;
+    return array;
+}
+
+int MidiByteReader::variableLengthValue() {
+    quint32 v = 0;
+    quint8 byte = 0;
+    int bytesRead = 0;
+    const int MAX_VARIABLE_LENGTH_BYTES = 4; // MIDI standard allows max 4 bytes for variable length values
+
+    do {
+        // Safety check: prevent infinite loops from malformed MIDI data
+        if (bytesRead >= MAX_VARIABLE_LENGTH_BYTES) {
+            return 0;
+        }
+        if (_pos >= _size) {
+            return 0;
+        }
+
+        byte = _data[_pos++];
+        bytesRead++;
+
+        v <<= 7;
+        v |= (byte & 0x7F);
+    } while (byte & (1 << 7));
+
+    // Additional safety check for unreasonably large values
+    if (v > 0x0FFFFFFF) { // MIDI standard maximum
+        return 0;
+    }
+    return (int) v;
+}
+
+qint64 MidiByteReader::indexOf(const char *tag, qint64 from) const {
+    for (qint64 i = qMax(qint64(0), from); i + 4 <= _size; i++) {
+        const void *found = std::memchr(_data + i, tag[0], _size - i);
+        if (!found) {
+            return -1;
+        }
+        i = static_cast<const uchar *>(found) - _data;
+        if (i + 4 <= _size && std::memcmp(_data + i, tag, 4) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool MidiByteReader::hasTag(qint64 pos, const char *tag) const {
+    return pos >= 0 && pos + 4 <= _size && std::memcmp(_data + pos, tag, 4) == 0;
+}
+
+MidiByteReader MidiByteReader::from(qint64 pos) const {
+    pos = qBound(qint64(0), pos, _size);
+    return MidiByteReader(reinterpret_cast<const char *>(_data + pos), _size - pos);
+}
@@ -0,0 +1,130 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDIBYTEREADER_H_
+#define MIDIBYTEREADER_H_
+
+// Qt includes
+#include <QByteArray>
+#include <QtGlobal>
+
+/**
+ * \class MidiByteReader
+ *
+ * \brief Bounds-checked big-endian reader over a span of bytes.
+ *
+ * MidiByteReader decodes Standard MIDI File data directly from memory (a
+ * mapped file or a QByteArray) without going through a QIODevice for every
+ * byte. It does not own the data; the memory has to stay valid while the
+ * reader is used.
+ *
+ * Reading past the end behaves like QDataStream: the read returns 0 and the
+ * position stays at the end.
+ */
+class MidiByteReader {
+public:
+    /**
+     * \brief Creates a reader over size bytes starting at data.
+     */
+    MidiByteReader(const char *data, qint64 size);
+
+    /**
+     * \brief Returns true if all bytes have been read.
+     */
+    bool atEnd() const;
+
+    /**
+     * \brief Gets the current read position.
+     */
+    qint64 pos() const;
+
+    /**
+     * \brief Gets the size of the span.
+     */
+    qint64 size() const;
+
+    /**
+     * \brief Gets the number of bytes left to read.
+     */
+    qint64 bytesLeft() const;
+
+    /**
+     * \brief Moves the read position (clamped to the span).
+     */
+    void seek(qint64 pos);
+
+    /**
+     * \brief Gets a pointer to the byte at the current position.
+     */
+    const char *current() const;
+
+    /**
+     * \brief Reads one byte, 0 if at the end.
+     */
+    quint8 readByte();
+
+    /**
+     * \brief Reads a big-endian 16 bit value.
+     */
+    quint16 readUInt16();
+
+    /**
+     * \brief Reads a big-endian 32 bit value.
+     */
+    quint32 readUInt32();
+
+    /**
+     * \brief Reads length bytes.
+     * \return The bytes, or an empty array if less than length bytes are left
+     *         (the position is not moved in this case)
+     */
+    QByteArray readBytes(qint64 length);
+
+    /**
+     * \brief Reads a MIDI variable-length value.
+     *
+     * Malformed values (more than 4 bytes or larger than 0x0FFFFFFF) and
+     * values cut off by the end of the span are returned as 0.
+     */
+    int variableLengthValue();
+
+    /**
+     * \brief Gets the position of the next occurrence of a 4 byte tag.
+     * \return The position of the tag, or -1 if it does not occur
+     */
+    qint64 indexOf(const char *tag, qint64 from) const;
+
+    /**
+     * \brief Returns true if the 4 byte tag is found at pos.
+     */
+    bool hasTag(qint64 pos, const char *tag) const;
+
+    /**
+     * \brief Creates a reader over the bytes from pos to the end of the span.
+     */
+    MidiByteReader from(qint64 pos) const;
+
+private:
+    /** \brief The span */
+    const uchar *_data;
+
+    /** \brief Size of the span and read position */
+    qint64 _size, _pos;
+};
+
+#endif // MIDIBYTEREADER_H_
@@ -32,8 +32,12 @@
 #include "../MidiEvent/OffEvent.h"
 #include "../MidiEvent/ProgChangeEvent.h"
 #include "../gui/EventWidget.h"
+#include "../protocol/ChannelProtocolItem.h"
+#include "../protocol/Protocol.h"
 #include "MidiFile.h"
 #include "MidiTrack.h"
+#include "NoteSpanIndex.h"
+#include "NoteStore.h"
 
 MidiChannel::MidiChannel(MidiFile *f, int num) {
     _midiFile = f;
@@ -43,7 +47,15 @@ MidiChannel::MidiChannel(MidiFile *f, int num) {
     _mute = false;
     _solo = false;
 
-    _events = new QMultiMap<int, MidiEvent *>;
+    _events = new EventMap;
+
+    _noteSpans = 0;
+    _noteSpansBuild = -1;
+
+    _noteStore = 0;
+    _noteStoreStamp = 0;
+    _noteStoreDirty = true;
+    _noteStoreBuild = 0;
 }
 
 MidiChannel::MidiChannel(MidiChannel &other) {
@@ -51,12 +63,22 @@ MidiChannel::MidiChannel(MidiChannel &other) {
     _visible = other._visible;
     _mute = other._mute;
     _solo = other._solo;
-    _events = new QMultiMap<int, MidiEvent *>(*(other._events));
+    _events = new EventMap(*(other._events));
     _num = other._num;
+
+    _noteSpans = 0;
+    _noteSpansBuild = -1;
+
+    _noteStore = 0;
+    _noteStoreStamp = 0;
+    _noteStoreDirty = true;
+    _noteStoreBuild = 0;
 }
 
 MidiChannel::~MidiChannel() {
     delete _events;
+    delete _noteSpans;
+    delete _noteStore;
 }
 
 ProtocolEntry *MidiChannel::copy() {
@@ -83,13 +105,15 @@ void MidiChannel::reloadState(ProtocolEntry *entry) {
     // Sync Pass: Ensure events' internal properties (channel and tick) stay perfectly
     // consistent with the channel they're restored to. This prevents the graphics
     // engine from accessing corrupted/inconsistent state during Undo.
+    // Moving an event modifies the map, so the moves are applied after the pass.
+    QList<QPair<int, MidiEvent *>> moved;
     for (auto it = _events->begin(); it != _events->end(); ++it) {
         MidiEvent *ev = it.value();
         if (!ev) continue;
 
         // Force internal tick to match map key
         if (ev->midiTime() != it.key()) {
-            ev->setMidiTime(it.key(), false);
+            moved.append(QPair<int, MidiEvent *>(it.key(), ev));
         }
 
         // Force internal channel to match this channel number
@@ -97,6 +121,21 @@ void MidiChannel::reloadState(ProtocolEntry *entry) {
             ev->setChannel(_num, false);
         }
     }
+    for (const QPair<int, MidiEvent *> &move : moved) {
+        // setMidiTime() inserts the event again at its new tick
+        _events->remove(move.first, move.second);
+        move.second->setMidiTime(move.first, false);
+    }
+}
+
+qint64 MidiChannel::memoryCost() {
+    // a snapshot shares the leaves of its event map with the channel it was
+    // copied from; only the leaves that were modified since are its own
+    MidiChannel *live = _midiFile ? _midiFile->channel(_num) : 0;
+    if (live == this) {
+        live = 0;
+    }
+    return sizeof(MidiChannel) + _events->memoryCost(live ? live->_events : 0);
 }
 
 MidiFile *MidiChannel::file() {
@@ -120,8 +159,7 @@ void MidiChannel::setVisible(bool b) {
         _visible = b;
 
         // Protocol handling
-        ProtocolEntry *toCopy = copy();
-        protocol(toCopy, this);
+        protocolItem(new ChannelProtocolItem(this));
     } catch (...) {
         // If we can't access _num, we can't update visibility
         // But at least we don't crash...
@@ -133,9 +171,9 @@ bool MidiChannel::mute() {
 }
 
 void MidiChannel::setMute(bool b) {
-    ProtocolEntry *toCopy = copy();
+    ChannelProtocolItem *item = new ChannelProtocolItem(this);
     _mute = b;
-    protocol(toCopy, this);
+    protocolItem(item);
 }
 
 bool MidiChannel::solo() {
@@ -143,9 +181,9 @@ bool MidiChannel::solo() {
 }
 
 void MidiChannel::setSolo(bool b) {
-    ProtocolEntry *toCopy = copy();
+    ChannelProtocolItem *item = new ChannelProtocolItem(this);
     _solo = b;
-    protocol(toCopy, this);
+    protocolItem(item);
 }
 
 int MidiChannel::number() {
@@ -166,7 +204,7 @@ int MidiChannel::number() {
     }
 }
 
-QMultiMap<int, MidiEvent *> *MidiChannel::eventMap() {
+EventMap *MidiChannel::eventMap() {
     return _events;
 }
 
@@ -186,22 +224,54 @@ QList<MidiEvent *> MidiChannel::sortedEvents() {
     return events;
 }
 
+NoteSpanIndex *MidiChannel::noteSpans() {
+    // the index is built from the note store and outdated exactly when it is
+    NoteStore *notes = noteStore();
+    if (!_noteSpans) {
+        _noteSpans = new NoteSpanIndex();
+    } else if (_noteSpansBuild == _noteStoreBuild) {
+        return _noteSpans;
+    }
+    _noteSpans->build(notes);
+    _noteSpansBuild = _noteStoreBuild;
+    return _noteSpans;
+}
+
+NoteStore *MidiChannel::noteStore() {
+    if (!_noteStore) {
+        _noteStore = new NoteStore();
+    } else if (!_noteStoreDirty && _events->stamp() == _noteStoreStamp) {
+        return _noteStore;
+    }
+    _noteStore->build(_events);
+    _noteStoreStamp = _events->stamp();
+    _noteStoreDirty = false;
+    _noteStoreBuild++;
+    return _noteStore;
+}
+
+void MidiChannel::invalidateNotes() {
+    _noteStoreDirty = true;
+}
+
 QColor *MidiChannel::color() {
     return Appearance::channelColor(number());
 }
 
 NoteOnEvent *MidiChannel::insertNote(int note, int startTick, int endTick, int velocity, MidiTrack *track) {
-    ProtocolEntry *toCopy = copy();
-    NoteOnEvent *onEvent = new NoteOnEvent(note, velocity, number(), track);
+    ChannelProtocolItem *item = new ChannelProtocolItem(this);
+    NoteOnEvent *onEvent = new (file()) NoteOnEvent(note, velocity, number(), track);
 
-    OffEvent *off = new OffEvent(number(), 127 - note, track);
+    OffEvent *off = new (file()) OffEvent(number(), 127 - note, track);
 
     off->setFile(file());
     off->setMidiTime(endTick, false);
+    item->recordInsert(endTick, off);
     onEvent->setFile(file());
     onEvent->setMidiTime(startTick, false);
+    item->recordInsert(startTick, onEvent);
 
-    protocol(toCopy, this);
+    protocolItem(item);
 
     return onEvent;
 }
@@ -219,17 +289,21 @@ bool MidiChannel::removeEvent(MidiEvent *event, bool toProtocol) {
         event->track()->setNameEvent(0);
     }
 
-    ProtocolEntry *toCopy = nullptr;
+    ChannelProtocolItem *item = nullptr;
     if (toProtocol) {
-        toCopy = copy();
+        item = new ChannelProtocolItem(this);
+        item->recordRemove(event->midiTime(), event);
     }
     _events->remove(event->midiTime(), event);
     OnEvent *on = dynamic_cast<OnEvent *>(event);
     if (on && on->offEvent()) {
+        if (item) {
+            item->recordRemove(on->offEvent()->midiTime(), on->offEvent());
+        }
         _events->remove(on->offEvent()->midiTime(), on->offEvent());
     }
-    if (toProtocol) {
-        protocol(toCopy, this);
+    if (item) {
+        protocolItem(item);
     }
 
     //if(MidiEvent::eventWidget()->events().contains(event)){
@@ -239,29 +313,45 @@ bool MidiChannel::removeEvent(MidiEvent *event, bool toProtocol) {
 }
 
 void MidiChannel::insertEvent(MidiEvent *event, int tick, bool toProtocol) {
-    ProtocolEntry *toCopy = nullptr;
+    ChannelProtocolItem *item = nullptr;
     if (toProtocol) {
-        toCopy = copy();
+        item = new ChannelProtocolItem(this);
+        // the event may already be in this channel at another tick
+        if (event->channel() == number()) {
+            item->recordRemove(event->midiTime(), event);
+        }
     }
     event->setFile(file());
     event->setMidiTime(tick, false);
 
-    if (toProtocol) {
-        protocol(toCopy, this);
+    if (item) {
+        if (event->channel() == number()) {
+            item->recordInsert(tick, event);
+        }
+        protocolItem(item);
     }
 }
 
 void MidiChannel::deleteAllEvents() {
-    ProtocolEntry *toCopy = copy();
+    ChannelProtocolItem *item = new ChannelProtocolItem(this);
+    item->recordClear();
     _events->clear();
-    protocol(toCopy, this);
+    protocolItem(item);
+}
+
+void MidiChannel::protocolItem(ChannelProtocolItem *item) {
+    if (file() && file()->protocol() && !item->isEmpty()) {
+        file()->protocol()->enterUndoStep(item);
+    } else {
+        delete item;
+    }
 }
 
 int MidiChannel::progAtTick(int tick) {
     if (_events->count() == 0)
         return 0;
     // search for the last ProgChangeEvent in the channel
-    QMultiMap<int, MidiEvent *>::iterator it = _events->upperBound(tick);
+    EventMap::iterator it = _events->upperBound(tick);
     if (it == _events->end()) {
         it--;
     }
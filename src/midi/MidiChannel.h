@@ -21,9 +21,7 @@
 
 // Project includes
 #include "../protocol/ProtocolEntry.h"
-
-// Qt includes
-#include <QMultiMap>
+#include "EventMap.h"
 
 // Forward declarations
 class MidiFile;
@@ -31,6 +29,9 @@ class MidiEvent;
 class QColor;
 class MidiTrack;
 class NoteOnEvent;
+class ChannelProtocolItem;
+class NoteSpanIndex;
+class NoteStore;
 
 /**
  * \class MidiChannel
@@ -54,8 +55,9 @@ class NoteOnEvent;
  * - **Program tracking**: Maintains current instrument program
  * - **Note insertion**: Convenient methods for adding notes
  *
- * Events are stored in a QMultiMap organized by MIDI tick time, allowing
- * efficient time-based access and manipulation.
+ * Events are stored in an EventMap organized by MIDI tick time, allowing
+ * efficient time-based access and manipulation. Edits are protocolled as
+ * ChannelProtocolItems that only record the changed entries.
  */
 class MidiChannel : public ProtocolEntry {
 public:
@@ -105,9 +107,9 @@ public:
 
     /**
      * \brief Gets the event map containing all channel events.
-     * \return Pointer to QMultiMap organized by MIDI tick time
+     * \return Pointer to the EventMap organized by MIDI tick time
      */
-    QMultiMap<int, MidiEvent *> *eventMap();
+    EventMap *eventMap();
 
     /**
      * \brief Gets a list of all events in chronological order.
@@ -115,6 +117,29 @@ public:
      */
     QList<MidiEvent *> sortedEvents();
 
+    /**
+     * \brief Gets the interval index over the notes of this channel.
+     * \return The index, rebuilt if the note store was rebuilt since the
+     *         last call
+     */
+    NoteSpanIndex *noteSpans();
+
+    /**
+     * \brief Gets the notes of this channel as parallel arrays.
+     * \return The store, rebuilt if the channel's events have changed since
+     *         the last call
+     */
+    NoteStore *noteStore();
+
+    /**
+     * \brief Marks the note store as outdated.
+     *
+     * Inserting, moving and removing events changes the event map and is
+     * detected by its stamp. Edits that change a note without touching the
+     * map (pitch, velocity, track) have to call this.
+     */
+    void invalidateNotes();
+
     /**
      * \brief Inserts a new note into this channel.
      * \param note MIDI note number (0-127)
@@ -208,7 +233,21 @@ public:
      */
     void reloadState(ProtocolEntry *entry);
 
+    /**
+     * \brief Gets the approximate memory used by this channel and its event map.
+     *
+     * For a snapshot, leaves of the event map that are still shared with the
+     * channel of the file are not counted.
+     */
+    qint64 memoryCost();
+
 protected:
+    /**
+     * \brief Enters item into the protocol, or deletes it if there is no
+     * protocol or the item is empty.
+     */
+    void protocolItem(ChannelProtocolItem *item);
+
     /** \brief The parent MIDI file */
     MidiFile *_midiFile;
 
@@ -216,10 +255,24 @@ protected:
     bool _visible, _mute, _solo;
 
     /** \brief Event map organized by MIDI tick time */
-    QMultiMap<int, MidiEvent *> *_events;
+    EventMap *_events;
 
     /** \brief The channel number (0-18) */
     int _num;
+
+    /** \brief Note index and the note store build it was built from */
+    NoteSpanIndex *_noteSpans;
+    int _noteSpansBuild;
+
+    /** \brief Note store, the map stamp it was built for and whether an in-place edit outdated it */
+    NoteStore *_noteStore;
+    quint64 _noteStoreStamp;
+    bool _noteStoreDirty;
+
+    /** \brief Counts the rebuilds of the note store */
+    int _noteStoreBuild;
+
+    friend class ChannelProtocolItem;
 };
 
 #endif // MIDICHANNEL_H_
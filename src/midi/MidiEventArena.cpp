@@ -0,0 +1,238 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MidiEventArena.h"
+
+#include "../MidiEvent/MidiEvent.h"
+
+namespace {
+
+/**
+ * \brief Header in front of every event block.
+ */
+struct alignas(16) BlockHeader {
+    /** \brief Size of the block including the header */
+    quint32 size;
+
+    /** \brief BLOCK_* flags */
+    quint32 flags;
+
+    /** \brief Arena the block belongs to, 0 for heap blocks not owned by an arena */
+    MidiEventArena *arena;
+};
+
+enum {
+    BLOCK_IN_ARENA = 1,
+    BLOCK_LIVE = 2,
+    BLOCK_OWNED = 4
+};
+
+/**
+ * \brief Gets the link to the next free block, stored in a free block's payload.
+ */
+void *&nextFree(void *block) {
+    return *reinterpret_cast<void **>(static_cast<BlockHeader *>(block) + 1);
+}
+
+const std::size_t CHUNK_SIZE = 256 * 1024;
+
+std::size_t blockSize(std::size_t size) {
+    return (sizeof(BlockHeader) + size + alignof(BlockHeader) - 1) & ~(alignof(BlockHeader) - 1);
+}
+
+// arena activated on this thread by a Scope
+thread_local MidiEventArena *s_scopeArena = 0;
+thread_local bool s_scopeActive = false;
+
+}
+
+MidiEventArena::MidiEventArena() {
+}
+
+MidiEventArena::~MidiEventArena() {
+    release();
+}
+
+void MidiEventArena::release() {
+    for (const Chunk &chunk : _chunks) {
+        std::size_t offset = 0;
+        while (offset < chunk.used) {
+            BlockHeader *header = reinterpret_cast<BlockHeader *>(chunk.data + offset);
+            offset += header->size;
+            if (header->flags & BLOCK_LIVE) {
+                header->flags &= ~BLOCK_LIVE;
+                MidiEvent *event = static_cast<MidiEvent *>(static_cast<void *>(header + 1));
+                event->~MidiEvent();
+            }
+        }
+    }
+    // owned heap events; their destructors do not delete other events
+    QSet<void *> owned = _ownedBlocks;
+    _ownedBlocks.clear();
+    for (void *block : owned) {
+        BlockHeader *header = static_cast<BlockHeader *>(block);
+        header->flags = 0;
+        MidiEvent *event = static_cast<MidiEvent *>(static_cast<void *>(header + 1));
+        event->~MidiEvent();
+        ::operator delete(header);
+    }
+    for (const Chunk &chunk : _chunks) {
+        ::operator delete(chunk.data);
+    }
+    _chunks.clear();
+    _freeBlocks.clear();
+}
+
+void MidiEventArena::adopt(MidiEventArena *other) {
+    if (other == this || other->_chunks.isEmpty()) {
+        return;
+    }
+    // other's partly filled last chunk goes in front, this arena keeps
+    // filling its own last chunk
+    // the blocks now belong to this arena, free ones go on its free lists
+    for (const Chunk &chunk : other->_chunks) {
+        std::size_t offset = 0;
+        while (offset < chunk.used) {
+            BlockHeader *header = reinterpret_cast<BlockHeader *>(chunk.data + offset);
+            offset += header->size;
+            header->arena = this;
+            if (!(header->flags & BLOCK_LIVE)) {
+                recycle(header, header->size);
+            }
+        }
+    }
+    for (void *block : other->_ownedBlocks) {
+        static_cast<BlockHeader *>(block)->arena = this;
+        _ownedBlocks.insert(block);
+    }
+    other->_ownedBlocks.clear();
+    other->_freeBlocks.clear();
+
+    if (_chunks.isEmpty()) {
+        _chunks = other->_chunks;
+    } else {
+        Chunk last = _chunks.takeLast();
+        _chunks.append(other->_chunks);
+        _chunks.append(last);
+    }
+    other->_chunks.clear();
+}
+
+qint64 MidiEventArena::reservedBytes() const {
+    qint64 bytes = 0;
+    for (const Chunk &chunk : _chunks) {
+        bytes += chunk.size;
+    }
+    return bytes;
+}
+
+void MidiEventArena::own(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    BlockHeader *header = static_cast<BlockHeader *>(ptr) - 1;
+    if (header->flags & (BLOCK_IN_ARENA | BLOCK_OWNED)) {
+        return;
+    }
+    header->flags |= BLOCK_OWNED;
+    header->arena = this;
+    _ownedBlocks.insert(header);
+}
+
+void MidiEventArena::recycle(void *block, std::size_t size) {
+    nextFree(block) = _freeBlocks.value(quint32(size), 0);
+    _freeBlocks.insert(quint32(size), block);
+}
+
+void *MidiEventArena::take(std::size_t size) {
+    auto freeBlock = _freeBlocks.find(quint32(size));
+    if (freeBlock != _freeBlocks.end()) {
+        void *block = freeBlock.value();
+        if (nextFree(block)) {
+            freeBlock.value() = nextFree(block);
+        } else {
+            _freeBlocks.erase(freeBlock);
+        }
+        return block;
+    }
+    if (size > CHUNK_SIZE / 4) {
+        // a large block gets a chunk of its own, in front of the chunk being filled
+        Chunk own;
+        own.data = static_cast<char *>(::operator new(size));
+        own.size = size;
+        own.used = size;
+        _chunks.insert(qMax(0, int(_chunks.size()) - 1), own);
+        return own.data;
+    }
+    if (_chunks.isEmpty() || _chunks.last().size - _chunks.last().used < size) {
+        Chunk chunk;
+        chunk.data = static_cast<char *>(::operator new(CHUNK_SIZE));
+        chunk.size = CHUNK_SIZE;
+        chunk.used = 0;
+        _chunks.append(chunk);
+    }
+    Chunk &chunk = _chunks.last();
+    void *ptr = chunk.data + chunk.used;
+    chunk.used += size;
+    return ptr;
+}
+
+void *MidiEventArena::allocate(std::size_t size, MidiEventArena *fallback) {
+    MidiEventArena *arena = s_scopeActive ? s_scopeArena : fallback;
+    std::size_t total = blockSize(size);
+    BlockHeader *header;
+    if (arena) {
+        header = static_cast<BlockHeader *>(arena->take(total));
+        header->flags = BLOCK_IN_ARENA | BLOCK_LIVE;
+    } else {
+        header = static_cast<BlockHeader *>(::operator new(total));
+        header->flags = BLOCK_LIVE;
+    }
+    header->arena = arena;
+    header->size = quint32(total);
+    return header + 1;
+}
+
+void MidiEventArena::deallocate(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    BlockHeader *header = static_cast<BlockHeader *>(ptr) - 1;
+    if (header->flags & BLOCK_IN_ARENA) {
+        // the block is reused by the next allocation of its size
+        header->flags &= ~BLOCK_LIVE;
+        header->arena->recycle(header, header->size);
+    } else {
+        if (header->flags & BLOCK_OWNED) {
+            header->arena->_ownedBlocks.remove(header);
+        }
+        ::operator delete(header);
+    }
+}
+
+MidiEventArena::Scope::Scope(MidiEventArena *arena) {
+    _previous = s_scopeArena;
+    _previousActive = s_scopeActive;
+    s_scopeArena = arena;
+    s_scopeActive = true;
+}
+
+MidiEventArena::Scope::~Scope() {
+    s_scopeArena = _previous;
+    s_scopeActive = _previousActive;
+}
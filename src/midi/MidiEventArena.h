@@ -0,0 +1,162 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDIEVENTARENA_H_
+#define MIDIEVENTARENA_H_
+
+// Qt includes
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QtGlobal>
+
+#include <cstddef>
+
+/**
+ * \class MidiEventArena
+ *
+ * \brief Bump allocator for the MidiEvents of one MidiFile.
+ *
+ * MidiEvent allocates itself through MidiEventArena (see
+ * MidiEvent::operator new). Events created into an arena are carved from
+ * large chunks; deleting such an event runs its destructor and puts its
+ * block on a free list of its size, where the next allocation of that size
+ * takes it from. Undo copies that are created and deleted during editing
+ * therefore reuse the same memory. Releasing the arena destroys every event
+ * in it that is still alive, so a file can free its events and the copies
+ * held by its undo history in one step, whoever still holds pointers to them
+ * in the protocol.
+ *
+ * Events go into the arena of the Scope active on the calling thread; with
+ * no Scope they go into the arena passed to allocate(), and with neither
+ * onto the heap. Heap events carry the same block header, so delete works
+ * for both kinds. A heap event can be handed to an arena with own(); it is
+ * then destroyed with the arena unless it has been deleted before.
+ *
+ * An arena is used by one thread at a time. Events loaded on worker threads
+ * are created into arenas of their own, which are then moved into the file's
+ * arena with adopt().
+ */
+class MidiEventArena {
+public:
+    /**
+     * \brief Creates an empty arena.
+     */
+    MidiEventArena();
+
+    /**
+     * \brief Releases the arena.
+     */
+    ~MidiEventArena();
+
+    /**
+     * \brief Destroys all events still alive in the arena and frees its memory.
+     */
+    void release();
+
+    /**
+     * \brief Moves all chunks of other into this arena; other is empty afterwards.
+     */
+    void adopt(MidiEventArena *other);
+
+    /**
+     * \brief Gets the number of bytes reserved by the arena.
+     */
+    qint64 reservedBytes() const;
+
+    /**
+     * \brief Makes the arena destroy a heap event when it is released.
+     *
+     * Does nothing for events allocated in an arena.
+     * \param ptr The event's memory as returned by allocate()
+     */
+    void own(void *ptr);
+
+    /**
+     * \brief Allocates memory for an event.
+     * \param size Size of the event
+     * \param fallback Arena used if no Scope is active on this thread, 0 for the heap
+     */
+    static void *allocate(std::size_t size, MidiEventArena *fallback);
+
+    /**
+     * \brief Frees the memory of an event allocated with allocate().
+     */
+    static void deallocate(void *ptr);
+
+    /**
+     * \class Scope
+     *
+     * \brief Makes events created on the calling thread go into an arena for
+     * its lifetime.
+     *
+     * A Scope with arena 0 makes events go onto the heap, e.g. copies that
+     * must outlive the file they were copied from.
+     */
+    class Scope {
+    public:
+        /**
+         * \brief Activates arena on the calling thread.
+         */
+        explicit Scope(MidiEventArena *arena);
+
+        /**
+         * \brief Restores the previously active scope.
+         */
+        ~Scope();
+
+    private:
+        MidiEventArena *_previous;
+        bool _previousActive;
+    };
+
+private:
+    // Non-copyable
+    MidiEventArena(const MidiEventArena &) = delete;
+    MidiEventArena &operator=(const MidiEventArena &) = delete;
+
+    /**
+     * \brief A block of memory events are carved from.
+     */
+    struct Chunk {
+        char *data;
+        std::size_t size;
+        std::size_t used;
+    };
+
+    /**
+     * \brief Returns memory for a block of size bytes.
+     */
+    void *take(std::size_t size);
+
+    /**
+     * \brief Puts a deleted block on the free list of its size.
+     */
+    void recycle(void *block, std::size_t size);
+
+    /** \brief The chunks, the last one is filled */
+    QVector<Chunk> _chunks;
+
+    /** \brief First free block of every block size; a free block holds the next one */
+    QHash<quint32, void *> _freeBlocks;
+
+    /** \brief Heap blocks handed to the arena with own() */
+    QSet<void *> _ownedBlocks;
+};
+
+#endif // MIDIEVENTARENA_H_
@@ -18,9 +18,12 @@
 
 #include "MidiFile.h"
 
-#include <QDataStream>
 #include <QFile>
+#include <QHash>
+#include <QMultiMap>
+#include <QMutexLocker>
 #include <QSet>
+#include <QtConcurrent/QtConcurrentMap>
 
 #include "../MidiEvent/ControlChangeEvent.h"
 #include "../MidiEvent/KeySignatureEvent.h"
@@ -34,34 +37,87 @@
 #include "../MidiEvent/TextEvent.h"
 #include "../MidiEvent/TimeSignatureEvent.h"
 #include "../protocol/Protocol.h"
+#include "MidiByteReader.h"
 #include "MidiChannel.h"
+#include "MidiEventArena.h"
+#include "MidiParseContext.h"
 #include "MidiTrack.h"
+#include "PlaybackSchedule.h"
+#include "QuantizationGrid.h"
+#include "TrackEventIndex.h"
 #include "InstrumentDefinitions.h"
 #include "math.h"
 #include <algorithm>
+#include <numeric>
 
-static QList<MidiEvent *> getSortedEvents(QMultiMap<int, MidiEvent *> *map) {
-    QList<MidiEvent *> events = map->values();
+// map order has the last inserted event of a tick first; reversing the
+// runs of equal ticks restores insertion order
+static void reverseEqualTicks(QList<MidiEvent *> *events) {
     int start = 0;
-    while (start < events.length()) {
+    while (start < events->length()) {
         int end = start + 1;
-        while (end < events.length() && events.at(start)->midiTime() == events.at(end)->midiTime()) {
+        while (end < events->length() && events->at(start)->midiTime() == events->at(end)->midiTime()) {
             end++;
         }
         if (end - start > 1) {
-            std::reverse(events.begin() + start, events.begin() + end);
+            std::reverse(events->begin() + start, events->begin() + end);
         }
         start = end;
     }
+}
+
+static QList<MidiEvent *> getSortedEvents(EventMap *map) {
+    QList<MidiEvent *> events = map->values();
+    reverseEqualTicks(&events);
     return events;
 }
 
+/**
+ * \brief A track decoded by MidiFile::parseTrack().
+ */
+struct MidiFile::ParsedTrack {
+    ParsedTrack() : content(0, 0) {
+    }
+
+    /** \brief Track number and the track the events belong to */
+    int num;
+    MidiTrack *track;
+
+    /** \brief Reader starting at the track's "MTrk" tag */
+    MidiByteReader content;
+
+    /** \brief Running status and note pairing of this track */
+    MidiParseContext context;
+
+    /** \brief Arena the events are decoded into, adopted by the file */
+    MidiEventArena arena;
+
+    /** \brief Decoded events with their absolute ticks, in file order */
+    QList<QPair<int, MidiEvent *> > events;
+
+    /** \brief Messages created while decoding */
+    QStringList log;
+
+    /** \brief Decoding state: end event found, track ended correctly */
+    bool ended, ok;
+
+    /** \brief Tick of the end event */
+    int endPosition;
+};
+
 int MidiFile::defaultTimePerQuarter = 192;
 
 MidiFile::MidiFile() {
+    _tempoMapDirty = true;
+    _tempoMapStamp = 0;
+    _trackIndex = 0;
+    _meterMapDirty = true;
+    _meterMapStamp = 0;
     _saved = true;
     midiTicks = 0;
     _cursorTick = 0;
+    _eventArena = new MidiEventArena();
+    MidiEventArena::Scope arenaScope(_eventArena);
     prot = new Protocol(this);
     prot->addEmptyAction("New File");
     _path = "";
@@ -97,7 +153,9 @@ MidiFile::MidiFile() {
     tempoEv->setFile(this);
     channel(17)->eventMap()->insert(0, tempoEv);
 
-    playerMap = new QMultiMap<int, MidiEvent *>;
+    playerSchedule = new PlaybackSchedule();
+    _playerDataRevision = 0;
+    _playerDataDirty = true;
 
     midiTicks = 7680;
     calcMaxTime();
@@ -110,14 +168,24 @@ MidiFile::MidiFile(QString path, bool *ok, QStringList *log) {
         deleteLog = true;
     }
 
+    _tempoMapDirty = true;
+    _tempoMapStamp = 0;
+    _trackIndex = 0;
+    _meterMapDirty = true;
+    _meterMapStamp = 0;
     _pauseTick = -1;
     _saved = true;
     midiTicks = 0;
     _cursorTick = 0;
+    _eventArena = new MidiEventArena();
     prot = new Protocol(this);
     prot->addEmptyAction(tr("File Opened"));
     _path = path;
     _tracks = new QList<MidiTrack *>();
+    playerSchedule = 0;
+    for (int i = 0; i < 19; i++) {
+        channels[i] = 0;
+    }
     QFile *f = new QFile(path);
 
     if (!f->open(QIODevice::ReadOnly)) {
@@ -135,24 +203,38 @@ MidiFile::MidiFile(QString path, bool *ok, QStringList *log) {
         channels[i] = new MidiChannel(this, i);
     }
 
-    QDataStream *stream = new QDataStream(f);
-    stream->setByteOrder(QDataStream::BigEndian);
-    if (!readMidiFile(stream, log)) {
+    // Map the whole file; if mapping is not possible, read it into one buffer
+    QByteArray buffer;
+    const char *data = reinterpret_cast<const char *>(f->map(0, f->size()));
+    qint64 size = f->size();
+    if (!data) {
+        buffer = f->readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    MidiByteReader reader(data, size);
+    bool read;
+    {
+        MidiEventArena::Scope arenaScope(_eventArena);
+        read = readMidiFile(&reader, log);
+    }
+
+    delete f; // Also unmaps the file
+
+    if (!read) {
         *ok = false;
         printLog(log);
         if (deleteLog) {
             delete log;
         }
-        delete stream; // Clean up stream on error
-        delete f;
         return;
     }
 
-    delete stream; // Clean up stream
-    delete f;
-
     *ok = true;
-    playerMap = new QMultiMap<int, MidiEvent *>;
+    playerSchedule = new PlaybackSchedule();
+    _playerDataRevision = 0;
+    _playerDataDirty = true;
     calcMaxTime();
     printLog(log);
 
@@ -163,74 +245,72 @@ MidiFile::MidiFile(QString path, bool *ok, QStringList *log) {
 }
 
 MidiFile::MidiFile(int ticks, Protocol *p) {
+    _eventArena = 0;
+    _tempoMapDirty = true;
+    _tempoMapStamp = 0;
+    _trackIndex = 0;
+    _meterMapDirty = true;
+    _meterMapStamp = 0;
+    playerSchedule = 0;
+    _playerDataRevision = 0;
+    _playerDataDirty = true;
     midiTicks = ticks;
     prot = p;
 }
 
 MidiFile::~MidiFile() {
-    // Conservative cleanup - only delete containers, not the complex
-    // protocol-managed objects to avoid crashes
-
-    // Note: We intentionally do NOT delete the protocol or events here
-    // The original system was designed to leak these rather than crash
-    // This is a compromise between memory usage and stability
-
-    // Clean up tracks (these should be safe)
-    if (_tracks) {
-        qDeleteAll(*_tracks);
-        delete _tracks;
+    // Copies made for the protocol share the tracks, channels and protocol of
+    // the file they were copied from and own nothing
+    if (!_eventArena) {
+        return;
     }
 
-    // Clean up player map (this should be safe)
-    if (playerMap) {
-        delete playerMap;
-    }
+    // The undo history owns copies of events, channels and the selection
+    delete prot;
 
-    // Clean up channels (only the containers, not the protocol or events)
+    // Events still in the channels are deleted first; heap events that were
+    // added to the file and removed again are owned by the arena (see
+    // MidiEvent::setFile())
+    QSet<MidiEvent *> events;
     for (int i = 0; i < 19; i++) {
         if (channels[i]) {
-            delete channels[i];
+            for (MidiEvent *event : *channels[i]->eventMap()) {
+                events.insert(event);
+            }
         }
     }
-}
+    qDeleteAll(events);
 
-bool MidiFile::readMidiFile(QDataStream *content, QStringList *log) {
-    OffEvent::clearOnEvents();
-    MidiEvent::resetTextEncodingCache();
+    qDeleteAll(*_tracks);
+    delete _tracks;
 
-    quint8 tempByte;
+    delete playerSchedule;
+    delete _trackIndex;
 
-    QString badHeader = tr("Error: Bad format in file header (Expected MThd).");
-    (*content) >> tempByte;
-    if (tempByte != 'M') {
-        log->append(badHeader);
-        return false;
-    }
-    (*content) >> tempByte;
-    if (tempByte != 'T') {
-        log->append(badHeader);
-        return false;
-    }
-    (*content) >> tempByte;
-    if (tempByte != 'h') {
-        log->append(badHeader);
-        return false;
+    for (int i = 0; i < 19; i++) {
+        delete channels[i];
     }
-    (*content) >> tempByte;
-    if (tempByte != 'd') {
+
+    // Frees the loaded events, the undo copies and everything removed from
+    // the channels since the file was opened, in the arena or on the heap
+    delete _eventArena;
+}
+
+bool MidiFile::readMidiFile(MidiByteReader *content, QStringList *log) {
+    QString badHeader = tr("Error: Bad format in file header (Expected MThd).");
+    if (!content->hasTag(0, "MThd")) {
         log->append(badHeader);
         return false;
     }
+    content->seek(4);
 
-    quint32 MThdTrackLength;
-    (*content) >> MThdTrackLength;
+    quint32 MThdTrackLength = content->readUInt32();
     if (MThdTrackLength != 6) {
         log->append(tr("Error: MThdTrackLength wrong (expected 6)."));
         return false;
     }
 
-    quint16 midiFormat;
-    (*content) >> midiFormat;
+    quint16 midiFormat = content->readUInt16();
     if (midiFormat > 1) {
         log->append(tr("Error: MidiFormat v. 2 cannot be loaded with this Editor."));
         return false;
@@ -238,48 +318,76 @@ bool MidiFile::readMidiFile(QDataStream *content, QStringList *log) {
 
     _midiFormat = midiFormat;
 
-    quint16 numTracks;
-    (*content) >> numTracks;
+    quint16 numTracks = content->readUInt16();
 
-    quint16 basisVelocity;
-    (*content) >> basisVelocity;
+    quint16 basisVelocity = content->readUInt16();
     timePerQuarter = (int) basisVelocity;
 
-    bool ok;
+    // Locate all track chunks up front. A chunk normally ends where its
+    // length says; if no chunk (or the end of the file) follows there, the
+    // length is wrong and the next "MTrk" is searched instead.
+    QList<qint64> chunks;
+    qint64 chunkPos = content->indexOf("MTrk", content->pos());
+    while (chunkPos >= 0 && chunks.size() < numTracks) {
+        chunks.append(chunkPos);
+        content->seek(chunkPos + 4);
+        qint64 next = chunkPos + 8 + content->readUInt32();
+        if (content->hasTag(next, "MTrk")) {
+            chunkPos = next;
+        } else if (next == content->size()) {
+            chunkPos = -1;
+        } else {
+            chunkPos = content->indexOf("MTrk", chunkPos + 4);
+        }
+    }
+
+    // The tracks are decoded independently (each with its own parse context
+    // for running status and note pairing) and then added to the channels
+    // in file order.
+    QList<ParsedTrack *> parsedTracks;
+    for (int num = 0; num < chunks.size(); num++) {
+        MidiTrack *track = new MidiTrack(this);
+        track->setNumber(num);
+
+        _tracks->append(track);
+        connect(track, SIGNAL(trackChanged()), this, SIGNAL(trackChanged()));
+
+        ParsedTrack *parsed = new ParsedTrack();
+        parsed->num = num;
+        parsed->track = track;
+        // a track may run over its declared length, so only the file end
+        // bounds it
+        parsed->content = content->from(chunks.at(num));
+        parsedTracks.append(parsed);
+    }
+    if (parsedTracks.size() > 1) {
+        QtConcurrent::blockingMap(parsedTracks, &MidiFile::parseTrack);
+    } else {
+        for (ParsedTrack *parsed : parsedTracks) {
+            parseTrack(parsed);
+        }
+    }
+    for (ParsedTrack *parsed : parsedTracks) {
+        _eventArena->adopt(&parsed->arena);
+    }
+
     for (int num = 0; num < numTracks; num++) {
-        ok = readTrack(content, num, log);
+        bool ok = false;
+        if (num < parsedTracks.size()) {
+            ok = addParsedTrack(parsedTracks.at(num), log);
+        } else {
+            log->append(tr("Error: Bad format in track header (Track ") + QString::number(num) + tr(", Expected MTrk)."));
+        }
         if (!ok) {
+            // Essential: don't fail completely on one bad track, the next
+            // track continues at the next located chunk
             log->append(tr("Error in Track ") + QString::number(num));
-            // Essential: don't fail completely on one bad track
-            // Try to skip to next track
-            while (!content->atEnd()) {
-                quint8 searchByte;
-                (*content) >> searchByte;
-                if (searchByte == 'M') {
-                    // Check if this is start of "MTrk"
-                    qint64 pos = content->device()->pos();
-                    quint8 t, r, k;
-                    if (!content->atEnd()) (*content) >> t;
-                    if (!content->atEnd()) (*content) >> r;
-                    if (!content->atEnd()) (*content) >> k;
-
-                    if (t == 'T' && r == 'r' && k == 'k') {
-                        // Found next track, rewind to start of "MTrk"
-                        content->device()->seek(pos - 1);
-                        break;
-                    } else {
-                        // Not "MTrk", continue searching
-                        content->device()->seek(pos);
-                    }
-                }
-            }
         }
     }
 
     // find corrupted OnEvents (without OffEvent)
-    QList<OnEvent*> corruptedEvents = OffEvent::corruptedOnEvents();
-    if (!corruptedEvents.isEmpty()) {
-        foreach(OnEvent* onevent, corruptedEvents) {
+    for (ParsedTrack *parsed : parsedTracks) {
+        foreach(OnEvent* onevent, parsed->context.openOnEvents()->values()) {
             if (onevent) {
                 int eventChannel = onevent->channel();
                 if (eventChannel >= 0 && eventChannel < 19) {
@@ -298,84 +406,81 @@ bool MidiFile::readMidiFile(QDataStream *content, QStringList *log) {
         }
     }
 
-    OffEvent::clearOnEvents();
+    qDeleteAll(parsedTracks);
 
     return true;
 }
 
-bool MidiFile::readTrack(QDataStream *content, int num, QStringList *log) {
-    quint8 tempByte;
+void MidiFile::parseTrack(ParsedTrack *parsed) {
+    MidiParseContext::Scope scope(&parsed->context);
+    MidiEventArena::Scope arenaScope(&parsed->arena);
+    MidiByteReader *content = &parsed->content;
 
-    QString badHeader = tr("Error: Bad format in track header (Track ") + QString::number(num) + tr(", Expected MTrk).");
-    (*content) >> tempByte;
-    if (tempByte != 'M') {
-        while (!content->atEnd()) {
-            (*content) >> tempByte;
-            if (tempByte == 'M')
-                break;
-        }
-        if (content->atEnd()) {
-            log->append(badHeader);
-            return false;
-        }
-    }
-    (*content) >> tempByte;
-    if (tempByte != 'T') {
-        log->append(badHeader);
-        return false;
-    }
-    (*content) >> tempByte;
-    if (tempByte != 'r') {
-        log->append(badHeader);
-        return false;
-    }
-    (*content) >> tempByte;
-    if (tempByte != 'k') {
-        log->append(badHeader);
-        return false;
-    }
+    parsed->ok = false;
+    parsed->ended = false;
+    parsed->endPosition = 0;
 
-    quint32 numBytes;
-    (*content) >> numBytes;
+    // the reader starts at the located "MTrk" tag; skip it and the length,
+    // the track is read until its end event
+    content->seek(8);
 
     bool ok = true;
     bool endEvent = false;
     int position = 0;
 
-    MidiTrack *track = new MidiTrack(this);
-    track->setNumber(num);
-
-    _tracks->append(track);
-    connect(track, SIGNAL(trackChanged()), this, SIGNAL(trackChanged()));
-
-    int channelFrequency[16];
-    for (int i = 0; i < 16; i++) {
-        channelFrequency[i] = 0;
-    }
-
     while (!endEvent) {
         // Essential safety: prevent infinite loops from corrupted data
         if (content->atEnd()) {
             break;
         }
 
-        position += deltaTime(content);
+        position += content->variableLengthValue();
 
-        MidiEvent *event = MidiEvent::loadMidiEvent(content, &ok, &endEvent, track);
+        MidiEvent *event = MidiEvent::loadMidiEvent(content, &ok, &endEvent, parsed->track);
         if (!ok) {
-            return false;
+            return;
         }
 
         OffEvent *offEvent = dynamic_cast<OffEvent *>(event);
         if (offEvent && !offEvent->onEvent()) {
-            log->append(tr("Warning: detected offEvent without prior onEvent. Skipping!"));
+            parsed->log.append(tr("Warning: detected offEvent without prior onEvent. Skipping!"));
             // Clean up the orphaned OffEvent to prevent memory leaks
             delete offEvent;
             continue;
         }
 
+        if (endEvent) {
+            parsed->ended = true;
+            parsed->endPosition = position;
+            break;
+        }
+        if (!event) {
+            return;
+        }
+
+        parsed->events.append(qMakePair(position, event));
+    }
+
+    // end of track
+    parsed->ok = content->readByte() == 0x00;
+}
+
+bool MidiFile::addParsedTrack(ParsedTrack *parsed, QStringList *log) {
+    MidiTrack *track = parsed->track;
+    int num = parsed->num;
+
+    log->append(parsed->log);
+
+    int channelFrequency[16];
+    for (int i = 0; i < 16; i++) {
+        channelFrequency[i] = 0;
+    }
+
+    for (const QPair<int, MidiEvent *> &entry : parsed->events) {
+        MidiEvent *event = entry.second;
+
         // check whether its the tracks name
-        if (event && event->line() == MidiEvent::TEXT_EVENT_LINE) {
+        if (event->line() == MidiEvent::TEXT_EVENT_LINE) {
             TextEvent *textEvent = dynamic_cast<TextEvent *>(event);
             if (textEvent) {
                 if (textEvent->type() == TextEvent::TRACKNAME) {
@@ -384,34 +489,30 @@ bool MidiFile::readTrack(QDataStream *content, int num, QStringList *log) {
             }
         }
 
-        if (endEvent) {
-            if (midiTicks < position) {
-                midiTicks = position;
-            }
-            break;
-        }
-        if (!event) {
-            return false;
-        }
-
         event->setFile(this);
 
         // also inserts to the Map of the channel
-        event->setMidiTime(position, false);
+        event->setMidiTime(entry.first, false);
 
         if (event->channel() < 16) {
             channelFrequency[event->channel()]++;
         }
     }
 
-    // end of track
-    (*content) >> tempByte;
+    if (parsed->ended && midiTicks < parsed->endPosition) {
+        midiTicks = parsed->endPosition;
+    }
+
+    if (!parsed->ended && !parsed->ok) {
+        // decoding error
+        return false;
+    }
+
     QString errorText = tr("Error: track ") + QString::number(num) + tr("not ended as expected. ");
-    if (tempByte != 0x00) {
+    if (!parsed->ok) {
         log->append(errorText);
         return false;
     }
-
     // check whether TimeSignature at tick 0 is given. If not, create one.
     // this will be done after reading the first track
     if (!channel(18)->eventMap()->contains(0)) {
@@ -443,57 +544,15 @@ bool MidiFile::readTrack(QDataStream *content, int num, QStringList *log) {
     return true;
 }
 
-int MidiFile::deltaTime(QDataStream *content) {
-    return variableLengthvalue(content);
-}
-
-int MidiFile::variableLengthvalue(QDataStream *content) {
-    quint32 v = 0;
-    quint8 byte = 0;
-    int bytesRead = 0;
-    const int MAX_VARIABLE_LENGTH_BYTES = 4; // MIDI standard allows max 4 bytes for variable length values
-
-    do {
-        // Safety check: prevent infinite loops from malformed MIDI data
-        if (bytesRead >= MAX_VARIABLE_LENGTH_BYTES) {
-            return 0; // Return 0 as safe fallback
-        }
-
-        // Check if stream has data available
-        if (content->atEnd()) {
-            return 0;
-        }
-
-        (*content) >> byte;
-        bytesRead++;
-
-        // Check for potential overflow before shifting
-        if (v > (UINT32_MAX >> 7)) {
-            return 0;
-        }
-
-        v <<= 7;
-        v |= (byte & 0x7F);
-    } while (byte & (1 << 7));
-
-    // Additional safety check for unreasonably large values
-    if (v > 0x0FFFFFFF) { // MIDI standard maximum
-        return 0;
-    }
-    return (int) v;
-}
-
-QMap<int, MidiEvent *> *MidiFile::timeSignatureEvents() {
-    return reinterpret_cast<QMap<int, MidiEvent *> *>(channels[18]->eventMap());
+EventMap *MidiFile::timeSignatureEvents() {
+    return channels[18]->eventMap();
 }
 
-QMap<int, MidiEvent *> *MidiFile::tempoEvents() {
-    return reinterpret_cast<QMap<int, MidiEvent *> *>(channels[17]->eventMap());
+EventMap *MidiFile::tempoEvents() {
+    return channels[17]->eventMap();
 }
 
 void MidiFile::calcMaxTime() {
-    double time = 0;
-    QList<MidiEvent *> events = getSortedEvents(channels[17]->eventMap());
     // Find the actual end tick by scanning all channels
     // Start with midiTicks to ensure the set file length is respected
     int actualEndTick = midiTicks;
@@ -503,20 +562,10 @@ void MidiFile::calcMaxTime() {
         if (last > actualEndTick) actualEndTick = last;
     }
 
-    for (int i = 0; i < events.length(); i++) {
-        TempoChangeEvent *ev = dynamic_cast<TempoChangeEvent *>(events.at(i));
-        if (!ev) {
-            continue;
-        }
-        int ticks = 0;
-        if (i < events.length() - 1) {
-            ticks = events.at(i + 1)->midiTime() - ev->midiTime();
-        } else {
-            ticks = actualEndTick - ev->midiTime();
-        }
-        time += ticks * ev->msPerTick();
-    }
-    maxTimeMS = time;
+    // No tempo change lies after actualEndTick, so this is the sum of all
+    // tempo segments with the last one extending to the end
+    TempoMap map = tempoMap();
+    maxTimeMS = map.isEmpty() ? 0 : map.msOfTick(actualEndTick);
     emit recalcWidgetSize();
 }
 
@@ -543,50 +592,13 @@ int MidiFile::timeMS(int midiTime) {
 }
 
 int MidiFile::tick(int ms) {
-    double time = 0;
-
-    QList<MidiEvent *> events = getSortedEvents(channels[17]->eventMap());
-    TempoChangeEvent *event = 0;
-
-    double timeMsNextEvent = 0;
-
-    for (int i = 0; i < events.length(); i++) {
-        TempoChangeEvent *ev = dynamic_cast<TempoChangeEvent *>(events.at(i));
-        if (!ev) {
-            qWarning("unknown eventtype in the List [3]");
-            continue;
-        }
-        event = ev;
-        time = timeMsNextEvent;
-
-        int ticks = 0;
-        if (i < events.length() - 1) {
-            ticks = events.at(i + 1)->midiTime() - ev->midiTime();
-        } else {
-            break;
-        }
-
-        timeMsNextEvent += ticks * ev->msPerTick();
-        if (timeMsNextEvent > ms) {
-            break;
-        }
-    }
-
-    if (!event) {
-        return 0;
-    }
-
-    int startTick = (ms - time) / event->msPerTick() + event->midiTime();
-    return startTick;
+    return tempoMap().tick(ms);
 }
 
 int MidiFile::msOfTick(int tick, QList<MidiEvent *> *events, int
                        msOfFirstEventInList) {
     if (!events) {
-        events = new QList<MidiEvent *>(getSortedEvents(channels[17]->eventMap()));
-        if (!events) {
-            return 0;
-        }
+        return (int) tempoMap().msOfTick(tick);
     }
 
     // timeMs holds the time of the current tick
@@ -622,87 +634,81 @@ int MidiFile::msOfTick(int tick, QList<MidiEvent *> *events, int
     return (int) timeMs;
 }
 
-int MidiFile::tick(int startms, int endms, QList<MidiEvent *> **eventList,
-                   int *endTick, int *msOfFirstEvent) {
-    // holds the time of the current event
-    double time = 0;
-
-    // delete old eventList, create a new
-    if ((*eventList)) {
-        delete (*eventList);
+TempoMap MidiFile::tempoMap() {
+    QMutexLocker locker(&_tempoMapMutex);
+    quint64 stamp = channels[17]->eventMap()->stamp();
+    if (_tempoMapDirty || stamp != _tempoMapStamp) {
+        _tempoMap.rebuild(getSortedEvents(channels[17]->eventMap()));
+        _tempoMapStamp = stamp;
+        _tempoMapDirty = false;
     }
-    *eventList = new QList<MidiEvent *>;
-
-    // TempoChangeEvents
-    QList<MidiEvent *> events = getSortedEvents(channels[17]->eventMap());
-
-    // event is the previous Event in events, ev the current
-    TempoChangeEvent *event = 0;
+    return _tempoMap;
+}
 
-    // necessary for the end condition
-    double timeMsNextEvent = 0;
+void MidiFile::invalidateTempoMap() {
+    QMutexLocker locker(&_tempoMapMutex);
+    _tempoMapDirty = true;
+}
 
-    // find the startEvent and the firstTick
-    int i = 0;
-    for (; i < events.length(); i++) {
-        TempoChangeEvent *ev = dynamic_cast<TempoChangeEvent *>(events.at(i));
-        if (!ev) {
-            qWarning("unknown eventtype in the List [1]");
-            continue;
-        }
-        event = ev;
-        time = timeMsNextEvent;
+MeterMap MidiFile::meterMap() {
+    QMutexLocker locker(&_meterMapMutex);
+    quint64 stamp = channels[18]->eventMap()->stamp();
+    if (_meterMapDirty || stamp != _meterMapStamp) {
+        _meterMap.rebuild(getSortedEvents(channels[18]->eventMap()));
+        _meterMapStamp = stamp;
+        _meterMapDirty = false;
+    }
+    return _meterMap;
+}
 
-        int ticks = 0;
-        if (i < events.length() - 1) {
-            ticks = events.at(i + 1)->midiTime() - ev->midiTime();
-        } else {
-            break;
-        }
+void MidiFile::invalidateMeterMap() {
+    QMutexLocker locker(&_meterMapMutex);
+    _meterMapDirty = true;
+}
 
-        timeMsNextEvent += ticks * ev->msPerTick();
-        if (timeMsNextEvent > startms) {
-            break;
-        }
+TrackEventIndex *MidiFile::trackIndex() {
+    if (!_trackIndex) {
+        _trackIndex = new TrackEventIndex();
     }
-    int startTick = (startms - time) / event->msPerTick() + event->midiTime();
-    *msOfFirstEvent = time;
-    (*eventList)->append(event);
-
-    i++;
+    _trackIndex->update(this);
+    return _trackIndex;
+}
 
-    // find the endEvent, save all events between start and end in the list and
-    // get the endTick
-    for (; i < events.length() && timeMsNextEvent < endms; i++) {
-        TempoChangeEvent *ev = dynamic_cast<TempoChangeEvent *>(events.at(i));
-        if (!ev) {
-            continue;
-        }
-        event = ev;
-        if (!(*eventList)->contains(event)) {
-            (*eventList)->append(event);
-        }
+void MidiFile::invalidateTrackIndex(int channel) {
+    if (_trackIndex) {
+        _trackIndex->invalidate(channel);
+    }
+}
 
-        time = timeMsNextEvent;
+int MidiFile::tick(int startms, int endms, QList<MidiEvent *> **eventList,
+                   int *endTick, int *msOfFirstEvent) {
+    // delete old eventList, create a new
+    if ((*eventList)) {
+        delete (*eventList);
+    }
+    *eventList = new QList<MidiEvent *>;
 
-        int ticks = 0;
-        if (i < events.length() - 1) {
-            ticks = events.at(i + 1)->midiTime() - ev->midiTime();
-        } else {
-            break;
-        }
+    TempoMap map = tempoMap();
 
-        timeMsNextEvent += ticks * ev->msPerTick();
-        if (timeMsNextEvent > endms) {
-            break;
-        }
+    // find the startEvent and the firstTick
+    int first = map.segmentAtMs(startms);
+    if (first < 0) {
+        *endTick = 0;
+        *msOfFirstEvent = 0;
+        return 0;
     }
+    int startTick = (startms - map.startMs(first)) / map.msPerTick(first) + map.startTick(first);
+    *msOfFirstEvent = map.startMs(first);
 
-    if (!event) {
-        return 0;
+    // save all events starting before endms in the list and get the endTick
+    int last = first;
+    (*eventList)->append(map.event(first));
+    while (last + 1 < map.size() && map.startMs(last + 1) < endms) {
+        last++;
+        (*eventList)->append(map.event(last));
     }
 
-    *endTick = (endms - time) / event->msPerTick() + event->midiTime();
+    *endTick = (endms - map.startMs(last)) / map.msPerTick(last) + map.startTick(last);
     return startTick;
 }
 
@@ -716,86 +722,27 @@ int MidiFile::measure(int startTick, int endTick,
         delete (*eventList);
     }
     *eventList = new QList<TimeSignatureEvent *>;
-    QList<MidiEvent *> events = getSortedEvents(channels[18]->eventMap());
-    TimeSignatureEvent *event = 0;
-    int i = 0;
-    int measure = 1;
-
-    // find the startEvent and the firstTick
-    for (; i < events.length(); i++) {
-        TimeSignatureEvent *ev = dynamic_cast<TimeSignatureEvent *>(events.at(i));
-        if (!ev) {
-            qWarning("unknown eventtype in the List [2]");
-            continue;
-        }
-        if (!event) {
-            event = ev;
-            measure = 1;
-            continue;
-        } else {
-            if (ev->midiTime() <= startTick) {
-                int ticks = ev->midiTime() - event->midiTime();
-                measure += event->measures(ticks);
-                event = ev;
-            } else {
-                break;
-            }
-        }
-    }
-    int ticks = startTick - event->midiTime();
-    measure += event->measures(ticks, ticksInmeasure);
-    (*eventList)->append(event);
-
-    // find the endEvent, save all events between start and end in the list and
-    // get the endTick
-    for (; i < events.length(); i++) {
-        TimeSignatureEvent *ev = dynamic_cast<TimeSignatureEvent *>(events.at(i));
+    MeterMap meters = meterMap();
 
-        if (!ev) {
-            qWarning("unknown eventtype in the List [2]");
-            continue;
-        }
-        if (ev->midiTime() <= endTick) {
-            (*eventList)->append(ev);
-        } else {
-            break;
+    // the time signature active at startTick and all following ones up to
+    // endTick
+    int segment = meters.segmentAtTick(startTick);
+    if (segment >= 0) {
+        (*eventList)->append(meters.event(segment));
+        for (int i = segment + 1; i < meters.size() && meters.startTick(i) <= endTick; i++) {
+            (*eventList)->append(meters.event(i));
         }
     }
-    return measure;
+    return meters.measure(startTick, ticksInmeasure);
 }
 
 int MidiFile::measure(int startTick, int *startTickOfMeasure, int *endTickOfMeasure) {
-    QList<MidiEvent *> events = getSortedEvents(channels[18]->eventMap());
-    TimeSignatureEvent *event = 0;
-    int i = 0;
-    int measure = 1;
-
-    // find the startEvent and the firstTick
-    for (; i < events.length(); i++) {
-        TimeSignatureEvent *ev = dynamic_cast<TimeSignatureEvent *>(events.at(i));
-        if (!ev) {
-            qWarning("unknown eventtype in the List [2]");
-            continue;
-        }
-        if (!event) {
-            event = ev;
-            measure = 1;
-            continue;
-        } else {
-            if (ev->midiTime() <= startTick) {
-                int ticks = ev->midiTime() - event->midiTime();
-                measure += event->measures(ticks);
-                event = ev;
-            } else {
-                break;
-            }
-        }
-    }
-    int ticks = startTick - event->midiTime();
+    MeterMap meters = meterMap();
     int ticksInmeasure;
-    measure += event->measures(ticks, &ticksInmeasure);
+    int measure = meters.measure(startTick, &ticksInmeasure);
+    int segment = meters.segmentAtTick(startTick);
     *(startTickOfMeasure) = startTick - ticksInmeasure;
-    *(endTickOfMeasure) = *startTickOfMeasure + event->ticksPerMeasure();
+    *(endTickOfMeasure) = *startTickOfMeasure + (segment < 0 ? 0 : meters.ticksPerMeasure(segment));
     return measure;
 }
 
@@ -803,7 +750,7 @@ int MidiFile::ticksPerQuarter() {
     return timePerQuarter;
 }
 
-QMultiMap<int, MidiEvent *> *MidiFile::channelEvents(int channel) {
+EventMap *MidiFile::channelEvents(int channel) {
     // Add bounds checking to prevent crashes
     if (channel < 0 || channel >= 19) {
         return channels[0]->eventMap(); // Return a safe default
@@ -821,6 +768,10 @@ Protocol *MidiFile::protocol() {
     return prot;
 }
 
+MidiEventArena *MidiFile::eventArena() {
+    return _eventArena;
+}
+
 MidiChannel *MidiFile::channel(int i) {
     // Add bounds checking to prevent crashes
     if (i < 0 || i >= 19) {
@@ -1475,9 +1426,9 @@ QString MidiFile::controlChangeName(int control) {
 QList<MidiEvent *> *MidiFile::eventsBetween(int start, int end) {
     QList<MidiEvent *> *eventList = new QList<MidiEvent *>;
     for (int i = 0; i < 19; i++) {
-        QMultiMap<int, MidiEvent *> *events = channels[i]->eventMap();
-        QMultiMap<int, MidiEvent *>::iterator current = events->lowerBound(start);
-        QMultiMap<int, MidiEvent *>::iterator upperBound = events->upperBound(end);
+        EventMap *events = channels[i]->eventMap();
+        EventMap::iterator current = events->lowerBound(start);
+        EventMap::iterator upperBound = events->upperBound(end);
         while (current != upperBound) {
             eventList->append(current.value());
             current++;
@@ -1503,58 +1454,22 @@ bool MidiFile::channelMuted(int ch) {
 }
 
 void MidiFile::preparePlayerData(int tickFrom) {
-    playerMap->clear();
-    QList<MidiEvent *> *prgList;
-
-    for (int i = 0; i < 19; i++) {
-        if (channelMuted(i)) {
-            continue;
-        }
-
-        // prgList saves all ProgramChangeEvents before cursorPosition. The last
-        // will be sent when playing
-        prgList = new QList<MidiEvent *>;
-
-        QMultiMap<int, MidiEvent *> *channelEvents = channels[i]->eventMap();
-        QMultiMap<int, MidiEvent *>::iterator it = channelEvents->begin();
-
-        while (it != channelEvents->end()) {
-            int tick = it.key();
-            MidiEvent *event = it.value();
-            if (tick >= tickFrom) {
-                // all Events after cursorTick are added
-                int ms = msOfTick(tick);
-                if (!event->track()->muted()) {
-                    playerMap->insert(ms, event);
-                }
-            } else {
-                ProgChangeEvent *prg = dynamic_cast<ProgChangeEvent *>(event);
-                if (prg) {
-                    // save ProgramChenges in the list, the last will be added
-                    // to the playerMap later
-                    prgList->append(prg);
-                }
-                ControlChangeEvent *ctrl = dynamic_cast<ControlChangeEvent *>(event);
-                if (ctrl) {
-                    // insert all ControlChanges on first position
-                    // playerMap->insert(msOfTick(cursorTick())-1, ctrl);
-                }
-            }
-            it++;
-        }
-
-        if (prgList->count() > 0) {
-            // set the program of the channel
-            playerMap->insert(msOfTick(tickFrom) - 1, prgList->last());
-        }
+    if (!playerSchedule) {
+        playerSchedule = new PlaybackSchedule();
+    }
 
-        delete prgList;
-        prgList = 0;
+    // rebuild only if the file has been edited since the last playback
+    int revision = prot ? prot->revision() : 0;
+    if (_playerDataDirty || revision != _playerDataRevision) {
+        playerSchedule->build(this);
+        _playerDataRevision = revision;
+        _playerDataDirty = false;
     }
+    playerSchedule->setStartTick(tickFrom);
 }
 
-QMultiMap<int, MidiEvent *> *MidiFile::playerData() {
-    return playerMap;
+PlaybackSchedule *MidiFile::playerData() {
+    return playerSchedule;
 }
 
 int MidiFile::cursorTick() {
@@ -1575,131 +1490,39 @@ void MidiFile::setPauseTick(int tick) {
 }
 
 bool MidiFile::save(QString path) {
-    QFile *f = new QFile(path);
-
-    if (!f->open(QIODevice::WriteOnly)) {
-        return false;
-    }
-
-    QDataStream *stream = new QDataStream(f);
-    stream->setByteOrder(QDataStream::BigEndian);
-
-    // All Events are stored in allEvents. This is because the data has to be
-    // saved by tracks and not by channels
-    QMultiMap<int, MidiEvent *> allEvents = QMultiMap<int, MidiEvent *>();
-    for (int i = 0; i < 19; i++) {
-        QMultiMap<int, MidiEvent *>::iterator it = channels[i]->eventMap()->begin();
-        while (it != channels[i]->eventMap()->end()) {
-            allEvents.insert(it.key(), it.value());
-            it++;
-        }
-    }
-
-    QByteArray data = QByteArray();
-    data.append('M');
-    data.append('T');
-    data.append('h');
-    data.append('d');
-
-    int trackL = 6;
-    for (int i = 3; i >= 0; i--) {
-        data.append((qint8) ((trackL & (0xFF << 8 * i)) >> 8 * i));
-    }
-
-    for (int i = 1; i >= 0; i--) {
-        data.append((qint8) ((_midiFormat & (0xFF << 8 * i)) >> 8 * i));
-    }
-
-    for (int i = 1; i >= 0; i--) {
-        data.append((qint8) ((numTracks() & (0xFF << 8 * i)) >> 8 * i));
-    }
-
-    for (int i = 1; i >= 0; i--) {
-        data.append((qint8) ((timePerQuarter & (0xFF << 8 * i)) >> 8 * i));
-    }
-
+    // The data has to be saved by tracks and not by channels. Ordering the
+    // channels of a track from 18 down to 0 and sorting stably by tick keeps
+    // the order events had in a single map of all channels: on the same tick
+    // higher channels first, events of one channel in insertion order.
+    TrackEventIndex *index = trackIndex();
+    QVector<QList<MidiEvent *> > trackEvents(numTracks());
     for (int num = 0; num < numTracks(); num++) {
-        data.append('M');
-        data.append('T');
-        data.append('r');
-        data.append('k');
-
-        int trackLengthPos = data.size();
-
-        data.append('\0');
-        data.append('\0');
-        data.append('\0');
-        data.append('\0');
-
-        int numBytes = 0;
-        int currentTick = 0;
-        QMultiMap<int, MidiEvent *>::iterator it = allEvents.begin();
-        while (it != allEvents.end()) {
-            MidiEvent *event = it.value();
-            int tick = it.key();
-
-            if (_tracks->at(num) == event->track()) {
-                // write the deltaTime before the event
-                int time = tick - currentTick;
-                QByteArray deltaTime = writeDeltaTime(time);
-                numBytes += deltaTime.size();
-                data.append(deltaTime);
-
-                // write the events data
-                QByteArray eventData = event->save();
-                numBytes += eventData.size();
-                data.append(eventData);
-
-                // save this tick as last time
-                currentTick = tick;
-            }
-
-            it++;
-        }
-
-        // write the endEvent
-        int time = endTick() - currentTick;
-        QByteArray deltaTime = writeDeltaTime(time);
-        numBytes += deltaTime.size();
-        data.append(deltaTime);
-        data.append(char(0xFF));
-        data.append(char(0x2F));
-        data.append('\0');
-        numBytes += 3;
-
-        // write numBytes
-        for (int i = 3; i >= 0; i--) {
-            data[trackLengthPos + 3 - i] = ((qint8) ((numBytes & (0xFF << 8 * i)) >> 8 * i));
+        QList<MidiEvent *> &events = trackEvents[num];
+        events.reserve(index->count(_tracks->at(num)));
+        for (int i = 18; i >= 0; i--) {
+            QList<MidiEvent *> channelEvents = index->events(_tracks->at(num), i);
+            reverseEqualTicks(&channelEvents);
+            events.append(channelEvents);
         }
+        std::stable_sort(events.begin(), events.end(), [](MidiEvent *a, MidiEvent *b) {
+            return a->midiTime() < b->midiTime();
+        });
     }
 
-    // write data to the filestream
-    for (int i = 0; i < data.size(); i++) {
-        (*stream) << (qint8) (data.at(i));
+    if (!writeMidiFile(path, trackEvents, 0, endTick())) {
+        return false;
     }
 
-    // close the file
-    f->close();
-
     _saved = true;
 
     return true;
 }
 
-bool MidiFile::saveForExport(QString path, int startTick, int endTick) {
-    QFile *f = new QFile(path);
-
-    if (!f->open(QIODevice::WriteOnly)) {
-        return false;
-    }
-
-    QDataStream *stream = new QDataStream(f);
-    stream->setByteOrder(QDataStream::BigEndian);
-
+QList<MidiEvent *> MidiFile::exportEvents(int startTick, int endTick) {
     int actualEnd = (endTick == -1) ? this->endTick() : endTick;
 
     // Collect all events, filtering by range and mute/solo state
-    QMultiMap<int, MidiEvent *> allEvents = QMultiMap<int, MidiEvent *>();
+    EventMap allEvents;
     QSet<MidiEvent *> skippedOnEvents;
 
     MidiEvent* lastProg[16];
@@ -1804,102 +1627,162 @@ bool MidiFile::saveForExport(QString path, int startTick, int endTick) {
         }
     }
 
+    return getSortedEvents(&allEvents);
+}
+
+bool MidiFile::saveForExport(QString path, int startTick, int endTick) {
+    int actualEnd = (endTick == -1) ? this->endTick() : endTick;
     int exportDuration = actualEnd - startTick;
     if (exportDuration < 0) exportDuration = 0;
 
-    QList<MidiEvent *> sortedExportEvents = getSortedEvents(&allEvents);
+    QList<MidiEvent *> sortedExportEvents = exportEvents(startTick, endTick);
 
-    QByteArray data = QByteArray();
-    data.append('M');
-    data.append('T');
-    data.append('h');
-    data.append('d');
+    // Meta-events (Tempo, Time Sig, Key Sig) go ONLY to Track 0, regular
+    // events to their own track
+    QHash<MidiTrack *, int> trackIndex;
+    for (int num = 0; num < numTracks(); num++) {
+        trackIndex.insert(_tracks->at(num), num);
+    }
+    QVector<QList<MidiEvent *> > trackEvents(numTracks());
+    for (MidiEvent *event : sortedExportEvents) {
+        if (event->channel() >= 16) {
+            if (numTracks() > 0) {
+                trackEvents[0].append(event);
+            }
+            continue;
+        }
+        auto it = trackIndex.constFind(event->track());
+        if (it != trackIndex.constEnd()) {
+            trackEvents[it.value()].append(event);
+        }
+    }
+
+    return writeMidiFile(path, trackEvents, startTick, exportDuration);
+}
 
-    int trackL = 6;
+/**
+ * \brief Appends a value as variable-length quantity to array.
+ */
+static void appendVariableLengthValue(QByteArray *array, int value) {
+    bool isFirst = true;
     for (int i = 3; i >= 0; i--) {
-        data.append((qint8) ((trackL & (0xFF << 8 * i)) >> 8 * i));
+        int b = value >> (7 * i);
+        qint8 byte = (qint8) b & 127;
+        if (!isFirst || byte > 0 || i == 0) {
+            isFirst = false;
+            if (i > 0) {
+                // set 8th bit
+                byte |= 128;
+            }
+            array->append(byte);
+        }
     }
+}
 
-    for (int i = 1; i >= 0; i--) {
-        data.append((qint8) ((_midiFormat & (0xFF << 8 * i)) >> 8 * i));
+/**
+ * \brief Appends a 16 or 32 bit big-endian value to array.
+ */
+static void appendBigEndian(QByteArray *array, int value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        array->append((qint8) ((value & (0xFF << 8 * i)) >> 8 * i));
     }
+}
+
+/**
+ * \brief Serializes one track chunk ("MTrk", length and events).
+ */
+static QByteArray trackChunk(const QList<MidiEvent *> &events, int startTick, int endTime) {
+    QByteArray data;
 
-    for (int i = 1; i >= 0; i--) {
-        data.append((qint8) ((numTracks() & (0xFF << 8 * i)) >> 8 * i));
+    // most events are short messages with a one or two byte delta time
+    data.reserve(8 + events.size() * 5 + 8);
+
+    data.append("MTrk", 4);
+    data.append(4, '\0');
+
+    int currentTick = 0;
+    for (MidiEvent *event : events) {
+        int tick = qMax(0, event->midiTime() - startTick);
+
+        // write the deltaTime before the event
+        appendVariableLengthValue(&data, tick - currentTick);
+
+        // write the events data
+        data.append(event->save());
+
+        // save this tick as last time
+        currentTick = tick;
     }
 
-    for (int i = 1; i >= 0; i--) {
-        data.append((qint8) ((timePerQuarter & (0xFF << 8 * i)) >> 8 * i));
+    // write the endEvent
+    appendVariableLengthValue(&data, endTime - currentTick);
+    data.append(char(0xFF));
+    data.append(char(0x2F));
+    data.append('\0');
+
+    // write numBytes
+    int numBytes = data.size() - 8;
+    for (int i = 3; i >= 0; i--) {
+        data[4 + 3 - i] = ((qint8) ((numBytes & (0xFF << 8 * i)) >> 8 * i));
     }
 
-    for (int num = 0; num < numTracks(); num++) {
-        data.append('M');
-        data.append('T');
-        data.append('r');
-        data.append('k');
-
-        int trackLengthPos = data.size();
-
-        data.append('\0');
-        data.append('\0');
-        data.append('\0');
-        data.append('\0');
-
-        int numBytes = 0;
-        int currentTick = 0;
-        for (MidiEvent *event : sortedExportEvents) {
-            int tick = qMax(0, event->midiTime() - startTick);
-
-            // Handle track assignment for export
-            bool isMeta = (event->channel() >= 16);
-            bool skip = false;
-            if (isMeta) {
-                // Meta-events (Tempo, Time Sig, Key Sig) must go ONLY to Track 0
-                if (num != 0) skip = true;
-            } else {
-                // Regular events must match the current track
-                if (_tracks->at(num) != event->track()) skip = true;
-            }
+    return data;
+}
 
-            if (!skip) {
-                int time = tick - currentTick;
-                QByteArray deltaTime = writeDeltaTime(time);
-                numBytes += deltaTime.size();
-                data.append(deltaTime);
+// number of events from which the tracks are serialized in parallel
+#define PARALLEL_SAVE_EVENTS 50000
 
-                QByteArray eventData = event->save();
-                numBytes += eventData.size();
-                data.append(eventData);
+bool MidiFile::writeMidiFile(QString path, const QVector<QList<MidiEvent *> > &trackEvents, int startTick, int endTime) {
+    QFile f(path);
 
-                currentTick = tick;
-            }
-        }
+    if (!f.open(QIODevice::WriteOnly)) {
+        return false;
+    }
 
-        // write the endEvent
-        int time = exportDuration - currentTick;
-        QByteArray deltaTime = writeDeltaTime(time);
-        numBytes += deltaTime.size();
-        data.append(deltaTime);
-        data.append(char(0xFF));
-        data.append(char(0x2F));
-        data.append('\0');
-        numBytes += 3;
+    int totalEvents = 0;
+    for (const QList<MidiEvent *> &events : trackEvents) {
+        totalEvents += events.size();
+    }
 
-        // write numBytes
-        for (int i = 3; i >= 0; i--) {
-            data[trackLengthPos + 3 - i] = ((qint8) ((numBytes & (0xFF << 8 * i)) >> 8 * i));
+    // serialize every track into its own buffer; save() of the events only
+    // reads their state, so the tracks can be written concurrently
+    QVector<QByteArray> chunks(trackEvents.size());
+    QVector<int> trackNumbers(trackEvents.size());
+    std::iota(trackNumbers.begin(), trackNumbers.end(), 0);
+    auto serialize = [&](int num) {
+        chunks[num] = trackChunk(trackEvents.at(num), startTick, endTime);
+    };
+    if (trackEvents.size() > 1 && totalEvents >= PARALLEL_SAVE_EVENTS) {
+        QtConcurrent::blockingMap(trackNumbers, serialize);
+    } else {
+        for (int num : trackNumbers) {
+            serialize(num);
         }
     }
 
-    for (int i = 0; i < data.size(); i++) {
-        (*stream) << (qint8) (data.at(i));
+    int size = 14;
+    for (const QByteArray &chunk : chunks) {
+        size += chunk.size();
     }
 
-    f->close();
-    delete stream;
-    delete f;
+    QByteArray data;
+    data.reserve(size);
+    data.append("MThd", 4);
+    appendBigEndian(&data, 6, 4);
+    appendBigEndian(&data, _midiFormat, 2);
+    appendBigEndian(&data, trackEvents.size(), 2);
+    appendBigEndian(&data, timePerQuarter, 2);
+    for (const QByteArray &chunk : chunks) {
+        data.append(chunk);
+    }
 
-    return true;
+    // write data to the file at once
+    bool ok = f.write(data) == data.size();
+
+    // close the file
+    f.close();
+
+    return ok;
 }
 
 QByteArray MidiFile::writeDeltaTime(int time) {
@@ -1908,21 +1791,7 @@ QByteArray MidiFile::writeDeltaTime(int time) {
 
 QByteArray MidiFile::writeVariableLengthValue(int value) {
     QByteArray array = QByteArray();
-
-    bool isFirst = true;
-    for (int i = 3; i >= 0; i--) {
-        int b = value >> (7 * i);
-        qint8 byte = (qint8) b & 127;
-        if (!isFirst || byte > 0 || i == 0) {
-            isFirst = false;
-            if (i > 0) {
-                // set 8th bit
-                byte |= 128;
-            }
-            array.append(byte);
-        }
-    }
-
+    appendVariableLengthValue(&array, value);
     return array;
 }
 
@@ -2013,7 +1882,7 @@ bool MidiFile::removeTrack(MidiTrack *track) {
 
     QMultiMap<int, MidiEvent *> allEvents = QMultiMap<int, MidiEvent *>();
     for (int i = 0; i < 19; i++) {
-        QMultiMap<int, MidiEvent *>::iterator it = channels[i]->eventMap()->begin();
+        EventMap::iterator it = channels[i]->eventMap()->begin();
         while (it != channels[i]->eventMap()->end()) {
             allEvents.insert(it.key(), it.value());
             it++;
@@ -2095,25 +1964,17 @@ void MidiFile::keyAt(int tick, int *tonality, bool *minor) {
 }
 
 void MidiFile::meterAt(int tick, int *num, int *denum, TimeSignatureEvent **lastTimeSigEvent) {
-    QList<MidiEvent *> meterEvents = getSortedEvents(channels[18]->eventMap());
-    TimeSignatureEvent *event = 0;
-    for (int i = 0; i < meterEvents.length(); i++) {
-        TimeSignatureEvent *timeSig = dynamic_cast<TimeSignatureEvent *>(meterEvents.at(i));
-        if (timeSig && timeSig->midiTime() <= tick) {
-            event = timeSig;
-        } else if (timeSig) {
-            break;
-        }
-    }
+    MeterMap meters = meterMap();
+    int segment = meters.segmentAtTick(tick);
 
-    if (!event) {
+    if (segment < 0 || meters.startTick(segment) > tick) {
         *num = 4;
         *denum = 4;
     } else {
-        *num = event->num();
-        *denum = event->denom();
+        *num = meters.num(segment);
+        *denum = meters.denom(segment);
         if (lastTimeSigEvent) {
-            *lastTimeSigEvent = event;
+            *lastTimeSigEvent = meters.event(segment);
         }
     }
 }
@@ -2155,95 +2016,12 @@ MidiTrack *MidiFile::getPasteTrack(MidiTrack *source, MidiFile *fileFrom) {
 }
 
 QList<int> MidiFile::quantization(int fractionSize) {
-    int fractionTicks;
-
-    if (fractionSize >= 0) {
-        // Regular divisions: same as before
-        fractionTicks = (4 * ticksPerQuarter()) / qPow(2, fractionSize);
-    } else if (fractionSize <= -100) {
-        // Extended subdivision system (same logic as MatrixWidget)
-        int subdivisionType = (-fractionSize) / 100; // 1=triplets, 2=quintuplets, etc.
-        int baseDivision = (-fractionSize) % 100; // Extract base division
-
-        double baseDiv = 4 / (double) qPow(2, baseDivision);
-
-        if (subdivisionType == 1) {
-            // Triplets: divide by 3
-            fractionTicks = (baseDiv * ticksPerQuarter()) / 3;
-        } else if (subdivisionType == 2) {
-            // Quintuplets: divide by 5
-            fractionTicks = (baseDiv * ticksPerQuarter()) / 5;
-        } else if (subdivisionType == 3) {
-            // Sextuplets: divide by 6
-            fractionTicks = (baseDiv * ticksPerQuarter()) / 6;
-        } else if (subdivisionType == 4) {
-            // Septuplets: divide by 7
-            fractionTicks = (baseDiv * ticksPerQuarter()) / 7;
-        } else if (subdivisionType == 5) {
-            // Dotted notes: multiply by 1.5
-            fractionTicks = (baseDiv * ticksPerQuarter()) * 1.5;
-        } else if (subdivisionType == 6) {
-            // Double dotted notes: multiply by 1.75
-            fractionTicks = (baseDiv * ticksPerQuarter()) * 1.75;
-        } else {
-            // Fallback to triplets for unknown types
-            fractionTicks = (baseDiv * ticksPerQuarter()) / 3;
-        }
-    } else {
-        // Fallback for unexpected values
-        fractionTicks = ticksPerQuarter(); // Default to quarter notes
-    }
-
-    QList<int> list;
-
-    QList<MidiEvent *> timeSigs = getSortedEvents(channels[18]->eventMap());
-    TimeSignatureEvent *last = 0;
-    foreach(MidiEvent* event, timeSigs) {
-        TimeSignatureEvent *t = dynamic_cast<TimeSignatureEvent *>(event);
-
-        if (last) {
-            int current = last->midiTime();
-            while (current < t->midiTime()) {
-                list.append(current);
-                current += fractionTicks;
-            }
-        }
-
-        last = t;
-    }
-
-    if (last) {
-        int current = last->midiTime();
-        while (current <= midiTicks) {
-            list.append(current);
-            current += fractionTicks;
-        }
-    }
-    return list;
+    return QuantizationGrid(this, fractionSize).ticks();
 }
 
 
 int MidiFile::startTickOfMeasure(int measure) {
-    QList<MidiEvent *> timeSigs = getSortedEvents(channels[18]->eventMap());
-
-    if (timeSigs.isEmpty()) {
-        return 0; // Fallback
-    }
-
-    // Find the time signature event the measure is in and its start measure
-    int currentMeasure = 1;
-    TimeSignatureEvent *currentEvent = dynamic_cast<TimeSignatureEvent *>(timeSigs.first());
-    
-    for (int i = 1; i < timeSigs.length(); i++) {
-        int endMeasureOfCurrentEvent = currentMeasure + ceil((timeSigs.at(i)->midiTime() - currentEvent->midiTime()) / currentEvent->ticksPerMeasure());
-        if (endMeasureOfCurrentEvent > measure) {
-            break;
-        }
-        currentEvent = dynamic_cast<TimeSignatureEvent *>(timeSigs.at(i));
-        currentMeasure = endMeasureOfCurrentEvent;
-    }
-
-    return currentEvent->midiTime() + (measure - currentMeasure) * currentEvent->ticksPerMeasure();
+    return meterMap().startTickOfMeasure(measure);
 }
 
 void MidiFile::deleteMeasures(int from, int to) {
@@ -2259,7 +2037,7 @@ void MidiFile::deleteMeasures(int from, int to) {
 
     // Delete all events. For notes, only delete if starting within the given tick range.
     for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *>::Iterator it = channel(ch)->eventMap()->begin();
+        EventMap::Iterator it = channel(ch)->eventMap()->begin();
         QList<MidiEvent *> toRemove;
         while (it != channel(ch)->eventMap()->end()) {
             if (it.key() >= tickFrom && it.key() <= tickTo) {
@@ -2288,7 +2066,7 @@ void MidiFile::deleteMeasures(int from, int to) {
     // duration.
     for (int ch = 0; ch < 19; ch++) {
         QList<MidiEvent *> toUpdate;
-        QMultiMap<int, MidiEvent *>::Iterator it = channel(ch)->eventMap()->begin();
+        EventMap::Iterator it = channel(ch)->eventMap()->begin();
         while (it != channel(ch)->eventMap()->end()) {
             if (it.key() > tickTo) {
                 toUpdate.append(it.value());
@@ -2307,7 +2085,7 @@ void MidiFile::deleteMeasures(int from, int to) {
     meterAt(tickFrom, &numAfter, &denomAfter);
     int ticksPerMeasure;
     if (denom != denomAfter || num != numAfter) {
-        TimeSignatureEvent *newEvent = new TimeSignatureEvent(18, num, denom, 24, 8, track(0));
+        TimeSignatureEvent *newEvent = new (this) TimeSignatureEvent(18, num, denom, 24, 8, track(0));
         channel(18)->insertEvent(newEvent, tickFrom);
         ticksPerMeasure = newEvent->ticksPerMeasure();
     } else {
@@ -2341,7 +2119,7 @@ void MidiFile::insertMeasures(int after, int numMeasures) {
     // Shift all ticks.
     for (int ch = 0; ch < 19; ch++) {
         QList<MidiEvent *> toUpdate;
-        QMultiMap<int, MidiEvent *>::Iterator it = channel(ch)->eventMap()->begin();
+        EventMap::Iterator it = channel(ch)->eventMap()->begin();
         while (it != channel(ch)->eventMap()->end()) {
             bool shouldShift = false;
             if (it.key() > tick) {
@@ -2385,7 +2163,7 @@ void MidiFile::trimStart(int trimTick) {
 
     // Collect all events to avoid iterator invalidation
     for (int ch = 0; ch < 19; ch++) {
-        QMultiMap<int, MidiEvent *> *map = channel(ch)->eventMap();
+        EventMap *map = channel(ch)->eventMap();
         QList<MidiEvent *> events = map->values();
 
         foreach(MidiEvent *event, events) {
@@ -2415,7 +2193,7 @@ int MidiFile::firstNoteTick() const {
     int firstTick = -1;
     for (int i = 0; i < 16; i++) {
         if (channels[i]->eventMap()->isEmpty()) continue;
-        QMultiMap<int, MidiEvent *>::const_iterator it = channels[i]->eventMap()->constBegin();
+        EventMap::const_iterator it = channels[i]->eventMap()->constBegin();
         while (it != channels[i]->eventMap()->constEnd()) {
             if (dynamic_cast<NoteOnEvent *>(it.value())) {
                 int t = it.key();
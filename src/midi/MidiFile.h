@@ -21,10 +21,15 @@
 
 // Project includes
 #include "../protocol/ProtocolEntry.h"
+#include "EventMap.h"
+#include "MeterMap.h"
+#include "TempoMap.h"
 
 // Qt includes
-#include <QMultiMap>
+#include <QMap>
+#include <QMutex>
 #include <QObject>
+#include <QVector>
 
 // Forward declarations
 class MidiEvent;
@@ -33,6 +38,10 @@ class TempoChangeEvent;
 class Protocol;
 class MidiChannel;
 class MidiTrack;
+class PlaybackSchedule;
+class MidiByteReader;
+class MidiEventArena;
+class TrackEventIndex;
 
 /**
  * \class MidiFile
@@ -112,6 +121,19 @@ public:
      */
     bool saveForExport(QString path, int startTick = 0, int endTick = -1);
 
+    /**
+     * \brief Collects the events of an audio export.
+     *
+     * Applies the same filtering as saveForExport(): events on muted
+     * channels and tracks and events outside the range are skipped. The
+     * last tempo, time signature, key signature, program, pitch bend and
+     * controller values before startTick are included, so the range starts
+     * with the correct state; their midiTime() lies before startTick.
+     *
+     * \return The events in playback order
+     */
+    QList<MidiEvent *> exportEvents(int startTick = 0, int endTick = -1);
+
     /**
      * \brief Writes a delta time value to a byte array.
      * \param time The time value to encode
@@ -153,15 +175,15 @@ public:
 
     /**
      * \brief Gets the map of tempo change events.
-     * \return Pointer to QMap containing tempo events organized by tick
+     * \return Pointer to the EventMap containing tempo events organized by tick
      */
-    QMap<int, MidiEvent *> *tempoEvents();
+    EventMap *tempoEvents();
 
     /**
      * \brief Gets the map of time signature events.
-     * \return Pointer to QMap containing time signature events organized by tick
+     * \return Pointer to the EventMap containing time signature events organized by tick
      */
-    QMap<int, MidiEvent *> *timeSignatureEvents();
+    EventMap *timeSignatureEvents();
 
     /**
      * \brief Recalculates the maximum time of all events in the file.
@@ -206,6 +228,8 @@ public:
 
     /**
      * \brief Converts MIDI ticks to milliseconds with event context.
+     *
+     * Without an event list the cached tempo map is used (O(log T)).
      * \param tick Time in MIDI ticks
      * \param events Optional list of events for timing context
      * \param msOfFirstEventInList Timing reference for first event
@@ -213,6 +237,59 @@ public:
      */
     int msOfTick(int tick, QList<MidiEvent *> *events = 0, int msOfFirstEventInList = 0);
 
+    /**
+     * \brief Gets a snapshot of the tempo segment table.
+     *
+     * The table is rebuilt lazily when channel 17 was modified or after
+     * invalidateTempoMap(). The returned copy is implicitly shared and stays
+     * valid even if the file changes.
+     * \return The current TempoMap
+     */
+    TempoMap tempoMap();
+
+    /**
+     * \brief Marks the cached tempo map as stale.
+     *
+     * Must be called whenever a TempoChangeEvent changes in place.
+     */
+    void invalidateTempoMap();
+
+    /**
+     * \brief Gets a snapshot of the time signature segment table.
+     *
+     * The table is rebuilt lazily when channel 18 was modified or after
+     * invalidateMeterMap(). The returned copy is implicitly shared and stays
+     * valid even if the file changes.
+     * \return The current MeterMap
+     */
+    MeterMap meterMap();
+
+    /**
+     * \brief Marks the cached meter map as stale.
+     *
+     * Must be called whenever a TimeSignatureEvent changes in place.
+     */
+    void invalidateMeterMap();
+
+    /**
+     * \brief Gets the events of the file grouped by track.
+     *
+     * The channels modified since the last call, or invalidated with
+     * invalidateTrackIndex(), are scanned again. The returned index is
+     * owned by the file and valid until the next modification.
+     * \return The current TrackEventIndex
+     */
+    TrackEventIndex *trackIndex();
+
+    /**
+     * \brief Marks a channel of the cached track index as stale.
+     *
+     * Must be called whenever the track or program of an event changes in
+     * place; insertions and removals are detected by the index itself.
+     * \param channel The channel of the event, or -1 for all channels
+     */
+    void invalidateTrackIndex(int channel = -1);
+
     /**
      * \brief Gets all events between two tick positions.
      * \param start Start tick position
@@ -232,9 +309,9 @@ public:
     /**
      * \brief Gets all events for a specific MIDI channel.
      * \param channel The MIDI channel number (0-15)
-     * \return Pointer to QMultiMap containing channel events organized by tick
+     * \return Pointer to the EventMap containing channel events organized by tick
      */
-    QMultiMap<int, MidiEvent *> *channelEvents(int channel);
+    EventMap *channelEvents(int channel);
 
     /**
      * \brief Gets the protocol system for undo/redo operations.
@@ -242,6 +319,14 @@ public:
      */
     Protocol *protocol();
 
+    /**
+     * \brief Gets the arena the events of this file are allocated in.
+     *
+     * The arena is released when the file is deleted.
+     * \return The arena, 0 for copies made for the protocol
+     */
+    MidiEventArena *eventArena();
+
     /**
      * \brief Gets a specific MIDI channel.
      * \param i The channel number (0-18, where 16-18 are special channels)
@@ -253,15 +338,18 @@ public:
 
     /**
      * \brief Prepares player data starting from a specific tick.
+     *
+     * The playback schedule is only rebuilt if the file has been modified
+     * since the last call; otherwise just the start position is moved.
      * \param tickFrom The starting tick position for playback preparation
      */
     void preparePlayerData(int tickFrom);
 
     /**
      * \brief Gets the prepared player data.
-     * \return Pointer to QMultiMap containing events organized for playback
+     * \return Pointer to the PlaybackSchedule organized for playback
      */
-    QMultiMap<int, MidiEvent *> *playerData();
+    PlaybackSchedule *playerData();
 
     // === Static Utility Methods ===
 
@@ -468,13 +556,6 @@ public:
 
     // === Static Utility Methods ===
 
-    /**
-     * \brief Reads a variable-length value from a MIDI data stream.
-     * \param content The data stream to read from
-     * \return The decoded variable-length value
-     */
-    static int variableLengthvalue(QDataStream *content);
-
     /**
      * \brief Encodes a value as a variable-length MIDI value.
      * \param value The value to encode
@@ -539,28 +620,34 @@ private:
     // === File Reading Methods ===
 
     /**
-     * \brief Reads a complete MIDI file from a data stream.
-     * \param content The data stream containing MIDI data
+     * \brief Reads a complete MIDI file from memory.
+     * \param content Reader over the whole file
      * \param log Optional string list to receive loading messages
      * \return True if reading was successful
      */
-    bool readMidiFile(QDataStream *content, QStringList *log);
+    bool readMidiFile(MidiByteReader *content, QStringList *log);
 
     /**
-     * \brief Reads a single MIDI track from a data stream.
-     * \param content The data stream containing track data
-     * \param num The track number being read
-     * \param log Optional string list to receive loading messages
-     * \return True if reading was successful
+     * \brief Decoded but not yet added track, see parseTrack().
      */
-    bool readTrack(QDataStream *content, int num, QStringList *log);
+    struct ParsedTrack;
 
     /**
-     * \brief Reads a delta time value from a data stream.
-     * \param content The data stream to read from
-     * \return The delta time value
+     * \brief Decodes a single MIDI track into a local event list.
+     *
+     * Uses only the track's own MidiParseContext and does not touch the
+     * file, so several tracks can be decoded concurrently.
+     * \param parsed The track with its reader starting at the "MTrk" tag
      */
-    int deltaTime(QDataStream *content);
+    static void parseTrack(ParsedTrack *parsed);
+
+    /**
+     * \brief Adds a decoded track's events to the channels.
+     * \param parsed The decoded track
+     * \param log Optional string list to receive loading messages
+     * \return True if the track was read successfully
+     */
+    bool addParsedTrack(ParsedTrack *parsed, QStringList *log);
 
     /**
      * \brief Prints log messages to debug output.
@@ -568,6 +655,21 @@ private:
      */
     void printLog(QStringList *log);
 
+    // === File Writing Methods ===
+
+    /**
+     * \brief Writes the header and the given tracks to a file.
+     *
+     * Every track is serialized into its own pre-sized buffer (in parallel
+     * for large files) and the whole file is written with a single write.
+     * \param path File path to write to
+     * \param trackEvents Events of every track in file order
+     * \param startTick Tick written as time 0, earlier events are clamped to 0
+     * \param endTime Time of the end of track events, relative to startTick
+     * \return True if the file could be written
+     */
+    bool writeMidiFile(QString path, const QVector<QList<MidiEvent *> > &trackEvents, int startTick, int endTime);
+
     // === Private Member Variables ===
 
     /** \brief Ticks per quarter note resolution */
@@ -583,13 +685,33 @@ private:
     /** \brief Protocol system for undo/redo */
     Protocol *prot;
 
+    /** \brief Memory of the file's events and their undo copies */
+    MidiEventArena *_eventArena;
+
     /** \brief Player data and state */
-    QMultiMap<int, MidiEvent *> *playerMap;
+    PlaybackSchedule *playerSchedule;
+    int _playerDataRevision;
+    bool _playerDataDirty;
     bool _saved;
 
     /** \brief Track management */
     QList<MidiTrack *> *_tracks;
     QMap<MidiFile *, QMap<MidiTrack *, MidiTrack *> > pasteTracks;
+
+    /** \brief Cached tempo segment table and the channel 17 stamp it was built from */
+    TempoMap _tempoMap;
+    quint64 _tempoMapStamp;
+    bool _tempoMapDirty;
+    QMutex _tempoMapMutex;
+
+    /** \brief Cached time signature table and the channel 18 stamp it was built from */
+    MeterMap _meterMap;
+    quint64 _meterMapStamp;
+    bool _meterMapDirty;
+    QMutex _meterMapMutex;
+
+    /** \brief Cached track index, updated channel by channel */
+    TrackEventIndex *_trackIndex;
 };
 
 #endif // MIDIFILE_H_
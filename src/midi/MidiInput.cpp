@@ -24,11 +24,17 @@
 #include "../MidiEvent/OffEvent.h"
 #include "../MidiEvent/OnEvent.h"
 
+#include "MidiFile.h"
+#include "MidiMessageRing.h"
+#include "MidiThru.h"
 #include "MidiTrack.h"
+#include "TempoMap.h"
 
 #include <QByteArray>
+#include <QMutexLocker>
 #include <QTextStream>
 
+#include <algorithm>
 #include <cstdlib>
 #include <QSettings>
 #include "../gui/Appearance.h"
@@ -37,16 +43,22 @@
 
 using namespace rt::midi;
 
-#include "MidiOutput.h"
-
 RtMidiIn *MidiInput::_midiIn = 0;
 QString MidiInput::_inPort = "";
-QMultiMap<int, std::vector<unsigned char> > *MidiInput::_messages = new QMultiMap<int, std::vector<unsigned char> >;
-int MidiInput::_currentTime = 0;
-bool MidiInput::_recording = false;
+MidiMessageRing *MidiInput::_ring = new MidiMessageRing(1 << 20);
+QList<MidiInput::Message> MidiInput::_received;
+QList<MidiInput::TimeBase> MidiInput::_timeBases;
+QMutex MidiInput::_receivedMutex;
+QElapsedTimer MidiInput::_clock;
+QAtomicInt MidiInput::_recording = 0;
 bool MidiInput::_thru = false;
 
 void MidiInput::init() {
+    _clock.start();
+    // created here so the input callback never allocates; its thread is
+    // started by setThruEnabled()
+    MidiThru::instance();
+
     // RtMidiIn constructor
     try {
         _midiIn = new RtMidiIn(RtMidi::UNSPECIFIED, QString(tr("MidiEditor input")).toStdString());
@@ -59,49 +71,13 @@ void MidiInput::init() {
 }
 
 void MidiInput::receiveMessage(double deltatime, std::vector<unsigned char> *message, void *userData) {
-    if (message->size() > 1) {
-        _messages->insert(_currentTime, *message);
+    // realtime thread: neither recording nor thru locks or allocates
+    if (message->size() > 1 && _recording.loadAcquire()) {
+        _ring->push(_clock.nsecsElapsed(), message->data(), int(message->size()));
     }
 
     if (_thru) {
-        QByteArray a;
-        for (int i = 0; i < message->size(); i++) {
-            // check channel
-            if (i == 0) {
-                switch (message->at(i) & 0xF0) {
-                    case 0x80: {
-                        a.append((char)(0x80 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                    case 0x90: {
-                        a.append((char)(0x90 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                    case 0xD0: {
-                        a.append((char)(0xD0 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                    case 0xC0: {
-                        a.append((char)(0xC0 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                    case 0xB0: {
-                        a.append((char)(0xB0 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                    case 0xA0: {
-                        a.append((char)(0xA0 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                    case 0xE0: {
-                        a.append((char)(0xE0 | MidiOutput::standardChannel()));
-                        continue;
-                    }
-                }
-            }
-            a.append(message->at(i));
-        }
-        MidiOutput::sendCommand(a);
+        MidiThru::instance()->send(message->data(), int(message->size()), false);
     }
 }
 
@@ -167,62 +143,114 @@ QString MidiInput::inputPort() {
 }
 
 void MidiInput::startInput() {
-    // clear eventlist
-    _messages->clear();
+    {
+        // clear eventlist
+        QMutexLocker locker(&_receivedMutex);
+        qint64 timestamp;
+        QByteArray message;
+        while (_ring->pop(&timestamp, &message)) {
+        }
+        _received.clear();
+        _timeBases.clear();
+    }
+
+    _recording = 1;
+}
 
-    _recording = true;
+void MidiInput::drain() {
+    QMutexLocker locker(&_receivedMutex);
+    Message message;
+    while (_ring->pop(&message.timestamp, &message.data)) {
+        _received.append(message);
+    }
+}
+
+void MidiInput::setTimeBase(double ms, double speed) {
+    QMutexLocker locker(&_receivedMutex);
+    // older time bases are only needed for the running recording
+    if (!_recording.loadAcquire()) {
+        _timeBases.clear();
+    }
+    _timeBases.append({_clock.nsecsElapsed(), ms, speed});
+}
+
+double MidiInput::msOfTimestamp(const QList<TimeBase> &timeBases, qint64 timestamp) {
+    if (timeBases.isEmpty()) {
+        return 0;
+    }
+    int i = timeBases.size() - 1;
+    while (i > 0 && timeBases.at(i).timestamp > timestamp) {
+        i--;
+    }
+    const TimeBase &base = timeBases.at(i);
+    // messages received before the player reported its first time base
+    // belong to the start of the recording
+    timestamp = qMax(timestamp, base.timestamp);
+    return qMax(0.0, base.ms + (timestamp - base.timestamp) * base.speed / 1000000.0);
 }
 
 QMultiMap<int, MidiEvent *> MidiInput::endInput(MidiTrack *track) {
     QMultiMap<int, MidiEvent *> eventList;
-    QByteArray array;
 
-    QMultiMap<int, std::vector<unsigned char> >::iterator it = _messages->begin();
+    _recording = 0;
+    drain();
+
+    QList<Message> messages;
+    QList<TimeBase> timeBases;
+    {
+        QMutexLocker locker(&_receivedMutex);
+        messages.swap(_received);
+        timeBases = _timeBases;
+    }
+
+    // injected messages are not ordered with the messages from the ring
+    std::stable_sort(messages.begin(), messages.end(), [](const Message &a, const Message &b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    MidiFile *file = track ? track->file() : 0;
+    TempoMap tempo = file ? file->tempoMap() : TempoMap();
+    auto tickOf = [&](double ms) {
+        return file ? tempo.tick(ms) : int(ms);
+    };
 
     bool ok = true;
     bool endEvent = false;
 
-    _recording = false;
-
     QMultiMap<int, OffEvent *> emptyOffEvents;
 
-    while (ok && it != _messages->end()) {
-        array.clear();
-
-        for (unsigned int i = 0; i < it.value().size(); i++) {
-            array.append(it.value().at(i));
-        }
+    for (int i = 0; ok && i < messages.size(); i++) {
+        double ms = msOfTimestamp(timeBases, messages.at(i).timestamp);
+        int tick = tickOf(ms);
 
-        QDataStream tempStream(array);
+        QDataStream tempStream(messages.at(i).data);
 
         MidiEvent *event = MidiEvent::loadMidiEvent(&tempStream, &ok, &endEvent, track);
         OffEvent *off = dynamic_cast<OffEvent *>(event);
         if (off && !off->onEvent()) {
-            emptyOffEvents.insert(it.key(), off);
-            it++;
+            emptyOffEvents.insert(tick, off);
             continue;
         }
         if (ok) {
-            eventList.insert(it.key(), event);
+            eventList.insert(tick, event);
         }
         // if on event, check whether the off event has been loaded before.
         // this occurs when RTMidi fails to send the correct order
         OnEvent *on = dynamic_cast<OnEvent *>(event);
-        if (on && emptyOffEvents.contains(it.key())) {
-            QMultiMap<int, OffEvent *>::iterator emptyIt = emptyOffEvents.lowerBound(it.key());
-            while (emptyIt != emptyOffEvents.end() && emptyIt.key() == it.key()) {
+        if (on && emptyOffEvents.contains(tick)) {
+            QMultiMap<int, OffEvent *>::iterator emptyIt = emptyOffEvents.lowerBound(tick);
+            while (emptyIt != emptyOffEvents.end() && emptyIt.key() == tick) {
                 if (emptyIt.value()->line() == on->line()) {
                     emptyIt.value()->setOnEvent(on);
                     OffEvent::removeOnEvent(on);
                     emptyOffEvents.remove(emptyIt.key(), emptyIt.value());
                     // add offEvent
-                    eventList.insert(it.key() + 100, emptyIt.value());
+                    eventList.insert(tickOf(ms + 100), emptyIt.value());
                     break;
                 }
                 emptyIt++;
             }
         }
-        it++;
     }
     QMultiMap<int, MidiEvent *>::iterator it2 = eventList.begin();
     while (it2 != eventList.end()) {
@@ -232,9 +260,6 @@ QMultiMap<int, MidiEvent *> MidiInput::endInput(MidiTrack *track) {
         }
         it2++;
     }
-    _messages->clear();
-
-    _currentTime = 0;
 
     // perform consistency check
     QMultiMap<int, MidiEvent *> toRemove;
@@ -329,12 +354,8 @@ QMultiMap<int, MidiEvent *> MidiInput::endInput(MidiTrack *track) {
     return eventList;
 }
 
-void MidiInput::setTime(int ms) {
-    _currentTime = ms;
-}
-
 bool MidiInput::recording() {
-    return _recording;
+    return _recording.loadAcquire() != 0;
 }
 
 QList<int> MidiInput::toUnique(QList<int> in) {
@@ -348,7 +369,13 @@ QList<int> MidiInput::toUnique(QList<int> in) {
 }
 
 void MidiInput::setThruEnabled(bool b) {
+    if (b) {
+        MidiThru::instance()->startThread();
+    }
     _thru = b;
+    if (!b) {
+        MidiThru::instance()->stop();
+    }
     // Persist immediately
     QScopedPointer<QSettings> settings(Appearance::settings());
     settings->setValue("thru", _thru);
@@ -368,6 +395,14 @@ void MidiInput::injectMessage(int status, int data1, int data2) {
     message.push_back((unsigned char)status);
     if (data1 >= 0) message.push_back((unsigned char)data1);
     if (data2 >= 0) message.push_back((unsigned char)data2);
-    
-    receiveMessage(0.0, &message);
+
+    // not called from the input callback, so it is recorded directly
+    if (message.size() > 1 && recording()) {
+        QMutexLocker locker(&_receivedMutex);
+        _received.append({_clock.nsecsElapsed(), QByteArray(reinterpret_cast<const char *>(message.data()), int(message.size()))});
+    }
+
+    if (_thru) {
+        MidiThru::instance()->send(message.data(), int(message.size()), true);
+    }
 }
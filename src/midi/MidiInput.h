@@ -20,7 +20,10 @@
 #define MIDIINPUT_H_
 
 // Qt includes
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QMultiMap>
+#include <QMutex>
 #include <QProcess>
 
 // Standard includes
@@ -31,6 +34,7 @@ class MidiEvent;
 inline namespace rt { inline namespace midi { class RtMidiIn; class RtMidiOut; } }
 
 class MidiTrack;
+class MidiMessageRing;
 
 /**
  * \class MidiInput
@@ -57,6 +61,13 @@ class MidiTrack;
  *
  * The class uses RtMidi for cross-platform MIDI input handling
  * and provides a simplified interface for the rest of the application.
+ *
+ * While recording, the RtMidi callback only timestamps each message on a
+ * monotonic clock and pushes it into a preallocated lock-free ring
+ * (MidiMessageRing). The ring is drained by the player thread (drain()) and
+ * finally by endInput(), which converts the timestamps to file time with the
+ * time bases reported by the player (setTimeBase()) and to ticks with the
+ * file's tempo map.
  */
 class MidiInput : public QObject {
 public:
@@ -112,13 +123,17 @@ public:
 
     /**
      * \brief Starts MIDI input recording.
+     *
+     * Clears the received messages and the time bases of earlier
+     * recordings, so it must be called before the player is started.
      */
     static void startInput();
 
     /**
      * \brief Ends MIDI input recording and returns captured events.
      * \param track The MidiTrack to associate with recorded events
-     * \return QMultiMap of recorded events organized by time
+     * \return QMultiMap of recorded events organized by tick (by ms if
+     *         track is 0)
      */
     static QMultiMap<int, MidiEvent *> endInput(MidiTrack *track);
 
@@ -131,10 +146,21 @@ public:
     static void receiveMessage(double deltatime, std::vector<unsigned char> *message, void *userData = 0);
 
     /**
-     * \brief Sets the current recording time reference.
-     * \param ms Time in milliseconds
+     * \brief Sets the file time of the input clock's current time.
+     *
+     * Messages received later are placed at ms plus their distance to this
+     * call, scaled by speed (the playback speed).
+     * \param ms File time in milliseconds
+     * \param speed Playback speed
+     */
+    static void setTimeBase(double ms, double speed);
+
+    /**
+     * \brief Moves the received messages from the input ring to the recording.
+     *
+     * Called regularly during recording, so the ring does not overflow.
      */
-    static void setTime(int ms);
+    static void drain();
 
     /**
      * \brief Checks if currently recording MIDI input.
@@ -146,6 +172,8 @@ public:
 
     /**
      * \brief Enables or disables MIDI thru functionality.
+     *
+     * Starts or stops the MidiThru thread.
      * \param b True to enable thru, false to disable
      */
     static void setThruEnabled(bool b);
@@ -171,14 +199,40 @@ private:
     /** \brief RtMidi input interface */
     static rt::midi::RtMidiIn *_midiIn;
 
-    /** \brief Map of recorded MIDI messages by time */
-    static QMultiMap<int, std::vector<unsigned char> > *_messages;
+    /**
+     * \brief A recorded message with its input clock timestamp in ns.
+     */
+    struct Message {
+        qint64 timestamp;
+        QByteArray data;
+    };
+
+    /**
+     * \brief File time ms and playback speed from the input clock time timestamp on.
+     */
+    struct TimeBase {
+        qint64 timestamp;
+        double ms;
+        double speed;
+    };
+
+    /** \brief Messages pushed by the input callback */
+    static MidiMessageRing *_ring;
+
+    /** \brief Recorded messages taken from the ring or injected */
+    static QList<Message> _received;
+
+    /** \brief Time bases of the current recording */
+    static QList<TimeBase> _timeBases;
 
-    /** \brief Current recording time reference */
-    static int _currentTime;
+    /** \brief Guards _received, _timeBases and the consumer side of _ring */
+    static QMutex _receivedMutex;
+
+    /** \brief Monotonic input clock */
+    static QElapsedTimer _clock;
 
     /** \brief Recording state flag */
-    static bool _recording;
+    static QAtomicInt _recording;
 
     /** \brief MIDI thru enabled flag */
     static bool _thru;
@@ -189,6 +243,13 @@ private:
      * \return List with unique values only
      */
     static QList<int> toUnique(QList<int> in);
+
+    /**
+     * \brief Gets the file time of an input clock timestamp.
+     *
+     * Timestamps before the first time base are placed at that base.
+     */
+    static double msOfTimestamp(const QList<TimeBase> &timeBases, qint64 timestamp);
 };
 
 #endif // MIDIINPUT_H_
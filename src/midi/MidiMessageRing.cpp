@@ -0,0 +1,90 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MidiMessageRing.h"
+
+#include <cstring>
+
+// a record is the timestamp, the length and the message bytes
+#define RECORD_HEADER_SIZE int(sizeof(qint64) + sizeof(qint32))
+
+MidiMessageRing::MidiMessageRing(int capacity) {
+    quint32 size = 64;
+    while (size < quint32(capacity) && size < (1u << 30)) {
+        size <<= 1;
+    }
+    _buffer.resize(size);
+    _data = _buffer.data();
+    _mask = size - 1;
+    _head = 0;
+    _tail = 0;
+    _dropped = 0;
+}
+
+bool MidiMessageRing::push(qint64 timestamp, const quint8 *data, int length) {
+    quint32 head = _head.loadRelaxed();
+    quint32 tail = _tail.loadAcquire();
+    quint32 recordSize = RECORD_HEADER_SIZE + length;
+    if (length < 0 || recordSize > quint32(_buffer.size()) - (head - tail)) {
+        _dropped.fetchAndAddRelaxed(1);
+        return false;
+    }
+    qint32 size = length;
+    write(head, &timestamp, sizeof(timestamp));
+    write(head + sizeof(timestamp), &size, sizeof(size));
+    write(head + RECORD_HEADER_SIZE, data, length);
+    _head.storeRelease(head + recordSize);
+    return true;
+}
+
+bool MidiMessageRing::pop(qint64 *timestamp, QByteArray *message) {
+    quint32 tail = _tail.loadRelaxed();
+    quint32 head = _head.loadAcquire();
+    if (head == tail) {
+        return false;
+    }
+    qint32 size = 0;
+    read(tail, timestamp, sizeof(*timestamp));
+    read(tail + sizeof(*timestamp), &size, sizeof(size));
+    message->resize(size);
+    read(tail + RECORD_HEADER_SIZE, message->data(), size);
+    _tail.storeRelease(tail + RECORD_HEADER_SIZE + size);
+    return true;
+}
+
+bool MidiMessageRing::isEmpty() const {
+    return _head.loadAcquire() == _tail.loadAcquire();
+}
+
+int MidiMessageRing::dropped() const {
+    return _dropped.loadRelaxed();
+}
+
+void MidiMessageRing::write(quint32 pos, const void *data, int length) {
+    quint32 start = pos & _mask;
+    quint32 first = qMin(quint32(length), quint32(_buffer.size()) - start);
+    std::memcpy(_data + start, data, first);
+    std::memcpy(_data, static_cast<const quint8 *>(data) + first, length - first);
+}
+
+void MidiMessageRing::read(quint32 pos, void *data, int length) const {
+    quint32 start = pos & _mask;
+    quint32 first = qMin(quint32(length), quint32(_buffer.size()) - start);
+    std::memcpy(data, _data + start, first);
+    std::memcpy(static_cast<quint8 *>(data) + first, _data, length - first);
+}
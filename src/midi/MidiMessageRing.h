@@ -0,0 +1,100 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDIMESSAGERING_H_
+#define MIDIMESSAGERING_H_
+
+// Qt includes
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+/**
+ * \class MidiMessageRing
+ *
+ * \brief Preallocated single-producer/single-consumer queue of timestamped
+ * MIDI messages.
+ *
+ * MidiMessageRing hands MIDI messages from a realtime thread (e.g. the RtMidi
+ * input callback) to another thread without locks and without allocating on
+ * the producer side. Each message is stored as a record of its timestamp,
+ * its length and its bytes in a fixed ring of bytes; messages of any length
+ * (including SysEx) fit as long as the ring has room.
+ *
+ * push() may only be called from one thread and pop() from one other thread
+ * at a time. If the ring is full, push() drops the message and counts it
+ * (see dropped()).
+ */
+class MidiMessageRing {
+public:
+    /**
+     * \brief Creates a ring of at least capacity bytes.
+     * \param capacity Size of the ring, rounded up to a power of two
+     */
+    explicit MidiMessageRing(int capacity);
+
+    /**
+     * \brief Appends a message (producer side).
+     * \param timestamp Timestamp of the message
+     * \param data Message bytes
+     * \param length Number of bytes
+     * \return False if the ring has no room and the message was dropped
+     */
+    bool push(qint64 timestamp, const quint8 *data, int length);
+
+    /**
+     * \brief Takes the oldest message (consumer side).
+     * \param timestamp Receives the timestamp of the message
+     * \param message Receives the message bytes
+     * \return False if the ring is empty
+     */
+    bool pop(qint64 *timestamp, QByteArray *message);
+
+    /**
+     * \brief Returns true if no message is waiting.
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief Gets the number of messages dropped because the ring was full.
+     */
+    int dropped() const;
+
+private:
+    /** \brief Copies length bytes to the ring at pos (wrapping) */
+    void write(quint32 pos, const void *data, int length);
+
+    /** \brief Copies length bytes from the ring at pos (wrapping) */
+    void read(quint32 pos, void *data, int length) const;
+
+    /** \brief The ring and its data, which is never reallocated */
+    QVector<quint8> _buffer;
+    quint8 *_data;
+
+    /** \brief Capacity - 1 */
+    quint32 _mask;
+
+    /** \brief Free running write (producer) and read (consumer) positions */
+    QAtomicInteger<quint32> _head, _tail;
+
+    /** \brief Number of dropped messages */
+    QAtomicInteger<int> _dropped;
+};
+
+#endif // MIDIMESSAGERING_H_
@@ -25,8 +25,6 @@
 #include <QSettings>
 #include "../gui/Appearance.h"
 
-#include <vector>
-
 #include "rtmidi/RtMidi.h"
 
 #ifdef FLUIDSYNTH_SUPPORT
@@ -35,9 +33,6 @@
 
 using namespace rt::midi;
 
-#include "../MidiEvent/NoteOnEvent.h"
-#include "../MidiEvent/OffEvent.h"
-
 RtMidiOut *MidiOutput::_midiOut = 0;
 QString MidiOutput::_outPort = "";
 QMap<int, QList<int> > MidiOutput::playedNotes = QMap<int, QList<int> >();
@@ -65,23 +60,24 @@ void MidiOutput::sendCommand(QByteArray array) {
 
 void MidiOutput::sendCommand(MidiEvent *e) {
     if (e->channel() >= 0 && e->channel() < 16 || e->line() == MidiEvent::SYSEX_LINE) {
-        sendEnqueuedCommand(e->save());
-
-        if (isAlternativePlayer) {
-            NoteOnEvent *n = dynamic_cast<NoteOnEvent *>(e);
-            if (n && n->velocity() > 0) {
-                playedNotes[n->channel()].append(n->note());
-            } else if (n && n->velocity() == 0) {
-                playedNotes[n->channel()].removeOne(n->note());
-            } else {
-                OffEvent *o = dynamic_cast<OffEvent *>(e);
-                if (o) {
-                    n = dynamic_cast<NoteOnEvent *>(o->onEvent());
-                    if (n) {
-                        playedNotes[n->channel()].removeOne(n->note());
-                    }
-                }
-            }
+        QByteArray array = e->save();
+        sendMessage(reinterpret_cast<const quint8 *>(array.constData()), array.size());
+    }
+}
+
+void MidiOutput::sendMessage(const quint8 *data, int length) {
+    if (length <= 0) {
+        return;
+    }
+    sendRaw(data, length);
+
+    if (isAlternativePlayer && length == 3) {
+        int type = data[0] & 0xF0;
+        int channel = data[0] & 0x0F;
+        if (type == 0x90 && data[2] > 0) {
+            playedNotes[channel].append(data[1]);
+        } else if (type == 0x90 || type == 0x80) {
+            playedNotes[channel].removeOne(data[1]);
         }
     }
 }
@@ -183,23 +179,21 @@ QString MidiOutput::outputPort() {
 }
 
 void MidiOutput::sendEnqueuedCommand(QByteArray array) {
-    if (_outPort != "") {
+    sendRaw(reinterpret_cast<const quint8 *>(array.constData()), array.size());
+}
+
+void MidiOutput::sendRaw(const quint8 *data, int length) {
+    if (_outPort != "" && length > 0) {
 #ifdef FLUIDSYNTH_SUPPORT
         // Route to FluidSynth if it's the active output
         if (_outPort == FLUIDSYNTH_PORT_NAME) {
-            FluidSynthEngine::instance()->sendMidiData(array);
+            FluidSynthEngine::instance()->sendMidiData(data, length);
             return;
         }
 #endif
 
-        // convert data to std::vector
-        std::vector<unsigned char> message;
-
-        foreach(char byte, array) {
-            message.push_back(byte);
-        }
         try {
-            _midiOut->sendMessage(&message);
+            _midiOut->sendMessage(data, length);
         } catch (RtMidiError &error) {
             error.printMessage();
         }
@@ -215,10 +209,8 @@ int MidiOutput::standardChannel() {
 }
 
 void MidiOutput::sendProgram(int channel, int prog) {
-    QByteArray array = QByteArray();
-    array.append((char)(0xC0 | channel));
-    array.append((char)prog);
-    sendCommand(array);
+    quint8 message[2] = {quint8(0xC0 | channel), quint8(prog)};
+    sendRaw(message, 2);
 }
 
 void MidiOutput::resetChannelPrograms()
@@ -83,6 +83,24 @@ public:
      */
     static void sendEnqueuedCommand(QByteArray array);
 
+    /**
+     * \brief Sends a pre-encoded MIDI message immediately.
+     *
+     * Unlike sendCommand(), no event is encoded and nothing is allocated;
+     * note ons and offs are still tracked in playedNotes for the
+     * alternative player.
+     * \param data Raw MIDI message bytes
+     * \param length Number of bytes
+     */
+    static void sendMessage(const quint8 *data, int length);
+
+    /**
+     * \brief Sends raw bytes to the active output port without note tracking.
+     * \param data Raw MIDI message bytes
+     * \param length Number of bytes
+     */
+    static void sendRaw(const quint8 *data, int length);
+
     // === Port Management ===
 
     /**
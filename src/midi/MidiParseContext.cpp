@@ -0,0 +1,70 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MidiParseContext.h"
+
+// context activated on this thread, 0 for the default context
+static thread_local MidiParseContext *s_currentContext = 0;
+
+MidiParseContext::MidiParseContext() {
+    _runningStatus = 0;
+}
+
+quint8 MidiParseContext::runningStatus() const {
+    return _runningStatus;
+}
+
+void MidiParseContext::setRunningStatus(quint8 status) {
+    _runningStatus = status;
+}
+
+QMultiMap<int, OnEvent *> *MidiParseContext::openOnEvents() {
+    return &_openOnEvents;
+}
+
+QByteArray *MidiParseContext::accumulatedTextData() {
+    return &_accumulatedTextData;
+}
+
+QString *MidiParseContext::cachedEncoding() {
+    return &_cachedEncoding;
+}
+
+void MidiParseContext::reset() {
+    _runningStatus = 0;
+    _openOnEvents.clear();
+    _accumulatedTextData.clear();
+    _cachedEncoding.clear();
+}
+
+MidiParseContext *MidiParseContext::current() {
+    if (s_currentContext) {
+        return s_currentContext;
+    }
+    static MidiParseContext defaultContext;
+    return &defaultContext;
+}
+
+MidiParseContext::Scope::Scope(MidiParseContext *context) {
+    _previous = s_currentContext;
+    s_currentContext = context;
+}
+
+MidiParseContext::Scope::~Scope() {
+    s_currentContext = _previous;
+}
@@ -0,0 +1,120 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDIPARSECONTEXT_H_
+#define MIDIPARSECONTEXT_H_
+
+// Qt includes
+#include <QByteArray>
+#include <QMultiMap>
+#include <QString>
+
+// Forward declarations
+class OnEvent;
+
+/**
+ * \class MidiParseContext
+ *
+ * \brief State that is carried from one decoded MIDI message to the next.
+ *
+ * Decoding MIDI data needs some state beyond the current message: the
+ * running status byte, the OnEvents still waiting for their OffEvent and the
+ * text data used for encoding detection. MidiParseContext keeps this state
+ * together, so independent byte streams (e.g. the tracks of a file) can be
+ * decoded on different threads at the same time.
+ *
+ * Every thread has a current context. It is a process wide default context
+ * unless a context has been activated with a Scope; MidiEvent::loadMidiEvent()
+ * and the OnEvent/OffEvent pairing always use the current context.
+ */
+class MidiParseContext {
+public:
+    /**
+     * \brief Creates an empty context.
+     */
+    MidiParseContext();
+
+    /**
+     * \brief Gets the running status byte (0 if none).
+     */
+    quint8 runningStatus() const;
+
+    /**
+     * \brief Sets the running status byte.
+     */
+    void setRunningStatus(quint8 status);
+
+    /**
+     * \brief Gets the OnEvents waiting for their OffEvents, keyed by line.
+     */
+    QMultiMap<int, OnEvent *> *openOnEvents();
+
+    /**
+     * \brief Gets the accumulated non UTF-8 text used for encoding detection.
+     */
+    QByteArray *accumulatedTextData();
+
+    /**
+     * \brief Gets the last detected text encoding.
+     */
+    QString *cachedEncoding();
+
+    /**
+     * \brief Clears all state.
+     */
+    void reset();
+
+    /**
+     * \brief Gets the context active on the calling thread.
+     */
+    static MidiParseContext *current();
+
+    /**
+     * \class Scope
+     *
+     * \brief Activates a context on the calling thread for its lifetime.
+     */
+    class Scope {
+    public:
+        /**
+         * \brief Makes context the current context of this thread.
+         */
+        explicit Scope(MidiParseContext *context);
+
+        /**
+         * \brief Restores the previously current context.
+         */
+        ~Scope();
+
+    private:
+        MidiParseContext *_previous;
+    };
+
+private:
+    /** \brief Running status byte */
+    quint8 _runningStatus;
+
+    /** \brief Opened and not closed OnEvents */
+    QMultiMap<int, OnEvent *> _openOnEvents;
+
+    /** \brief Text encoding detection state */
+    QByteArray _accumulatedTextData;
+    QString _cachedEncoding;
+};
+
+#endif // MIDIPARSECONTEXT_H_
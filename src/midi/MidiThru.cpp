@@ -0,0 +1,136 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MidiThru.h"
+
+#include "MidiOutput.h"
+
+#include <cstring>
+
+MidiThru *MidiThru::_instance = 0;
+
+MidiThru::MidiThru()
+    : QThread(), _input(1 << 16), _injected(1 << 12) {
+    _lastLatency = 0;
+    _maxLatency = 0;
+    _totalLatency = 0;
+    _sent = 0;
+    _stopped = false;
+    _clock.start();
+}
+
+MidiThru *MidiThru::instance() {
+    if (!_instance) {
+        _instance = new MidiThru();
+    }
+    return _instance;
+}
+
+void MidiThru::startThread() {
+    if (isRunning()) {
+        return;
+    }
+    // drop messages queued while the thread was stopped
+    QByteArray message;
+    qint64 timestamp;
+    while (_input.pop(&timestamp, &message) || _injected.pop(&timestamp, &message)) {
+    }
+    while (_pending.tryAcquire()) {
+    }
+
+    _stopped.storeRelease(false);
+    start(QThread::TimeCriticalPriority);
+}
+
+void MidiThru::stop() {
+    if (!isRunning()) {
+        return;
+    }
+    _stopped.storeRelease(true);
+    _pending.release();
+    wait();
+}
+
+void MidiThru::send(const quint8 *data, int length, bool injected) {
+    if (length <= 0) {
+        return;
+    }
+    qint64 timestamp = _clock.nsecsElapsed();
+    MidiMessageRing *ring = injected ? &_injected : &_input;
+
+    bool queued;
+    if (length <= 3) {
+        // channel messages are played on the standard channel
+        quint8 message[3];
+        std::memcpy(message, data, length);
+        int type = message[0] & 0xF0;
+        if (type >= 0x80 && type <= 0xE0) {
+            message[0] = quint8(type | MidiOutput::standardChannel());
+        }
+        queued = ring->push(timestamp, message, length);
+    } else {
+        queued = ring->push(timestamp, data, length);
+    }
+
+    if (queued) {
+        _pending.release();
+    }
+}
+
+void MidiThru::run() {
+    QByteArray message;
+    qint64 timestamp;
+    forever {
+        _pending.acquire();
+        if (_stopped.loadAcquire()) {
+            return;
+        }
+        if (!_input.pop(&timestamp, &message) && !_injected.pop(&timestamp, &message)) {
+            continue;
+        }
+        MidiOutput::sendRaw(reinterpret_cast<const quint8 *>(message.constData()), message.size());
+
+        qint64 latency = (_clock.nsecsElapsed() - timestamp) / 1000;
+        _lastLatency.storeRelaxed(latency);
+        if (latency > _maxLatency.loadRelaxed()) {
+            _maxLatency.storeRelaxed(latency);
+        }
+        _totalLatency.fetchAndAddRelaxed(latency);
+        _sent.fetchAndAddRelaxed(1);
+    }
+}
+
+qint64 MidiThru::lastLatency() const {
+    return _lastLatency.loadRelaxed();
+}
+
+qint64 MidiThru::maxLatency() const {
+    return _maxLatency.loadRelaxed();
+}
+
+qint64 MidiThru::averageLatency() const {
+    qint64 sent = _sent.loadRelaxed();
+    return sent > 0 ? _totalLatency.loadRelaxed() / sent : 0;
+}
+
+void MidiThru::resetLatency() {
+    _lastLatency.storeRelaxed(0);
+    _maxLatency.storeRelaxed(0);
+    _totalLatency.storeRelaxed(0);
+    _sent.storeRelaxed(0);
+}
@@ -0,0 +1,129 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIDITHRU_H_
+#define MIDITHRU_H_
+
+// Project includes
+#include "MidiMessageRing.h"
+
+// Qt includes
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+
+/**
+ * \class MidiThru
+ *
+ * \brief Forwards incoming MIDI messages to the output (MIDI thru).
+ *
+ * MidiThru keeps the output off the input callback: send() remaps the
+ * channel of a short message in place to MidiOutput::standardChannel(),
+ * stamps it and pushes it into a lock-free ring. The MidiThru thread takes
+ * the messages and sends them to the output port or the synthesizer.
+ *
+ * There is one ring for the RtMidi callback and one for injected messages
+ * (the piano emulation on the GUI thread), so each ring has a single
+ * producer.
+ *
+ * The thread only runs while thru is enabled (startThread() and stop());
+ * messages sent while it is stopped are dropped when it starts again.
+ *
+ * The time from send() until the message has been passed to the output is
+ * measured for every message (see lastLatency(), maxLatency() and
+ * averageLatency()).
+ */
+class MidiThru : public QThread {
+public:
+    /**
+     * \brief Gets the MidiThru instance, creating it on first use.
+     */
+    static MidiThru *instance();
+
+    /**
+     * \brief Starts the thread if it is not running.
+     */
+    void startThread();
+
+    /**
+     * \brief Stops the thread and waits until it has finished.
+     */
+    void stop();
+
+    /**
+     * \brief Queues a received message for the output.
+     * \param data Message bytes
+     * \param length Number of bytes
+     * \param injected True if called from the GUI thread, false if called
+     *        from the MIDI input callback
+     */
+    void send(const quint8 *data, int length, bool injected);
+
+    /**
+     * \brief Gets the input-to-output latency of the last message in microseconds.
+     */
+    qint64 lastLatency() const;
+
+    /**
+     * \brief Gets the largest input-to-output latency in microseconds.
+     */
+    qint64 maxLatency() const;
+
+    /**
+     * \brief Gets the average input-to-output latency in microseconds.
+     */
+    qint64 averageLatency() const;
+
+    /**
+     * \brief Clears the latency measurements.
+     */
+    void resetLatency();
+
+protected:
+    /**
+     * \brief Sends the queued messages.
+     */
+    void run() override;
+
+private:
+    /**
+     * \brief Creates the thru queues.
+     */
+    MidiThru();
+
+    /** \brief The instance */
+    static MidiThru *_instance;
+
+    /** \brief Messages from the input callback and injected messages */
+    MidiMessageRing _input, _injected;
+
+    /** \brief Number of queued messages */
+    QSemaphore _pending;
+
+    /** \brief Set by stop() to end run() */
+    QAtomicInteger<bool> _stopped;
+
+    /** \brief Clock for the latency measurement */
+    QElapsedTimer _clock;
+
+    /** \brief Latency statistics in microseconds */
+    QAtomicInteger<qint64> _lastLatency, _maxLatency, _totalLatency, _sent;
+};
+
+#endif // MIDITHRU_H_
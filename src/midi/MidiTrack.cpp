@@ -20,9 +20,9 @@
 
 #include "../gui/Appearance.h"
 #include "../MidiEvent/TextEvent.h"
-#include "../MidiEvent/ProgChangeEvent.h"
 #include "MidiChannel.h"
 #include "MidiFile.h"
+#include "TrackEventIndex.h"
 
 MidiTrack::MidiTrack(MidiFile *file)
     : ProtocolEntry() {
@@ -61,7 +61,7 @@ QString MidiTrack::name() {
 
 void MidiTrack::setName(QString name) {
     if (!_nameEvent) {
-        _nameEvent = new TextEvent(16, this);
+        _nameEvent = new (_file) TextEvent(16, this);
         _nameEvent->setType(TextEvent::TRACKNAME);
         _file->channel(16)->insertEvent(_nameEvent, 0);
     }
@@ -78,6 +78,13 @@ void MidiTrack::setNumber(int number) {
     ProtocolEntry *toCopy = copy();
     _number = number;
     protocol(toCopy, this);
+
+    // note stores keep track numbers
+    if (_file) {
+        for (int i = 0; i < 19; i++) {
+            _file->channel(i)->invalidateNotes();
+        }
+    }
 }
 
 void MidiTrack::setNameEvent(TextEvent *nameEvent) {
@@ -165,48 +172,7 @@ int MidiTrack::assignedChannel() {
 int MidiTrack::progAtTick(int tick) {
     if (!_file) return 0;
 
-    // Scan all 16 MIDI channels for ProgChangeEvents belonging to this track
-    int bestProg = -1;
-    int bestTick = -1;
-
-    for (int ch = 0; ch < 16; ch++) {
-        MidiChannel *channel = _file->channel(ch);
-        if (!channel) continue;
-
-        QMultiMap<int, MidiEvent *> *events = channel->eventMap();
-        if (!events || events->isEmpty()) continue;
-
-        // Walk backwards from the target tick to find the latest ProgChangeEvent on this track
-        QMultiMap<int, MidiEvent *>::iterator it = events->upperBound(tick);
-        while (it != events->begin()) {
-            --it;
-            if (it.key() > tick) continue;
-            ProgChangeEvent *ev = dynamic_cast<ProgChangeEvent *>(it.value());
-            if (ev && ev->track() == this && it.key() > bestTick) {
-                bestProg = ev->program();
-                bestTick = it.key();
-                break; // found the latest one in this channel at or before tick
-            }
-        }
-    }
-
-    if (bestProg >= 0) return bestProg;
-
-    // Fallback: find the very first ProgChangeEvent on this track anywhere
-    for (int ch = 0; ch < 16; ch++) {
-        MidiChannel *channel = _file->channel(ch);
-        if (!channel) continue;
-
-        QMultiMap<int, MidiEvent *> *events = channel->eventMap();
-        if (!events || events->isEmpty()) continue;
-
-        for (auto it = events->begin(); it != events->end(); ++it) {
-            ProgChangeEvent *ev = dynamic_cast<ProgChangeEvent *>(it.value());
-            if (ev && ev->track() == this) {
-                return ev->program();
-            }
-        }
-    }
-
-    return 0;
+    // the track index keeps a sorted timeline of the track's program changes
+    int prog = _file->trackIndex()->programAt(this, tick);
+    return prog >= 0 ? prog : 0;
 }
@@ -0,0 +1,94 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NoteSpanIndex.h"
+
+#include "NoteStore.h"
+
+#include <algorithm>
+#include <climits>
+
+NoteSpanIndex::NoteSpanIndex() {
+    for (Line &line : _lines) {
+        line.leaves = 0;
+    }
+}
+
+void NoteSpanIndex::build(const NoteStore *notes) {
+    for (Line &line : _lines) {
+        line.spans.clear();
+        line.maxOff.clear();
+        line.leaves = 0;
+    }
+
+    // the notes are ordered by start, so the spans are appended ordered by on
+    const int *starts = notes->startTicks();
+    const int *ends = notes->endTicks();
+    const quint8 *pitches = notes->pitches();
+    for (int i = 0; i < notes->size(); i++) {
+        _lines[127 - pitches[i]].spans.append({starts[i], ends[i], notes->event(i)});
+    }
+
+    for (Line &line : _lines) {
+        int n = line.spans.size();
+        if (n == 0) {
+            continue;
+        }
+        line.leaves = 1;
+        while (line.leaves < n) {
+            line.leaves *= 2;
+        }
+        line.maxOff.fill(INT_MIN, 2 * line.leaves);
+        for (int i = 0; i < n; i++) {
+            line.maxOff[line.leaves + i] = line.spans.at(i).off;
+        }
+        for (int node = line.leaves - 1; node > 0; node--) {
+            line.maxOff[node] = qMax(line.maxOff.at(2 * node), line.maxOff.at(2 * node + 1));
+        }
+    }
+}
+
+void NoteSpanIndex::query(int startTick, int endTick, int startLine, int endLine, QList<NoteOnEvent *> *result) const {
+    startLine = qMax(0, startLine);
+    endLine = qMin(127, endLine);
+    for (int l = startLine; l <= endLine; l++) {
+        const Line &line = _lines[l];
+        if (line.spans.isEmpty()) {
+            continue;
+        }
+        // spans before end start at or before endTick
+        auto byOn = [](int tick, const Span &span) { return tick < span.on; };
+        int end = std::upper_bound(line.spans.constBegin(), line.spans.constEnd(), endTick, byOn) - line.spans.constBegin();
+        if (end > 0) {
+            collect(line, 1, 0, line.leaves, end, startTick, result);
+        }
+    }
+}
+
+void NoteSpanIndex::collect(const Line &line, int node, int from, int to, int end, int startTick, QList<NoteOnEvent *> *result) {
+    if (from >= end || line.maxOff.at(node) < startTick) {
+        return;
+    }
+    if (node >= line.leaves) {
+        result->append(line.spans.at(from).note);
+        return;
+    }
+    int middle = (from + to) / 2;
+    collect(line, 2 * node, from, middle, end, startTick, result);
+    collect(line, 2 * node + 1, middle, to, end, startTick, result);
+}
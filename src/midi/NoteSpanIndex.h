@@ -0,0 +1,98 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTESPANINDEX_H_
+#define NOTESPANINDEX_H_
+
+// Qt includes
+#include <QList>
+#include <QVector>
+
+// Forward declarations
+class NoteOnEvent;
+class NoteStore;
+
+/**
+ * \class NoteSpanIndex
+ *
+ * \brief Interval index over the notes of a channel.
+ *
+ * A channel's event map is ordered by tick, so a note that starts before a
+ * tick range and ends behind it can not be found by looking at the range
+ * alone. NoteSpanIndex stores the [on, off] spans of all notes per line,
+ * ordered by their start, together with a max-tree of the end ticks. A
+ * query visits only the lines in question and only the subtrees that
+ * contain notes ending inside or behind the range, so its cost depends on
+ * the number of notes found instead of the size of the channel.
+ */
+class NoteSpanIndex {
+public:
+    /**
+     * \brief Creates an empty index.
+     */
+    NoteSpanIndex();
+
+    /**
+     * \brief Rebuilds the index from a channel's notes.
+     */
+    void build(const NoteStore *notes);
+
+    /**
+     * \brief Collects the notes overlapping a tick and line range.
+     * \param startTick First tick of the range
+     * \param endTick Last tick of the range
+     * \param startLine First line of the range
+     * \param endLine Last line of the range
+     * \param result Receives the NoteOnEvents with on <= endTick and
+     *        off >= startTick, line by line, each line ordered by start
+     */
+    void query(int startTick, int endTick, int startLine, int endLine, QList<NoteOnEvent *> *result) const;
+
+private:
+    /**
+     * \brief A note from its NoteOnEvent to its OffEvent.
+     */
+    struct Span {
+        int on;
+        int off;
+        NoteOnEvent *note;
+    };
+
+    /**
+     * \brief The notes of one line.
+     */
+    struct Line {
+        /** \brief Spans ordered by on */
+        QVector<Span> spans;
+
+        /** \brief Max-tree of the off ticks, leaves start at index leaves */
+        QVector<int> maxOff;
+        int leaves;
+    };
+
+    /**
+     * \brief Collects the spans below node that start before index end and
+     * end at or after startTick.
+     */
+    static void collect(const Line &line, int node, int from, int to, int end, int startTick, QList<NoteOnEvent *> *result);
+
+    /** \brief One entry for every note line (127 - note) */
+    Line _lines[128];
+};
+
+#endif // NOTESPANINDEX_H_
@@ -0,0 +1,89 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NoteStore.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/NoteOnEvent.h"
+#include "../MidiEvent/OffEvent.h"
+#include "EventMap.h"
+#include "MidiTrack.h"
+
+#include <algorithm>
+
+NoteStore::NoteStore() {
+}
+
+void NoteStore::build(EventMap *events) {
+    _startTicks.clear();
+    _endTicks.clear();
+    _pitches.clear();
+    _velocities.clear();
+    _tracks.clear();
+    _events.clear();
+
+    // the map is ordered by tick, so the notes are appended ordered by start
+    for (auto it = events->constBegin(); it != events->constEnd(); ++it) {
+        NoteOnEvent *note = dynamic_cast<NoteOnEvent *>(it.value());
+        if (!note || !note->offEvent() || note->note() < 0 || note->note() > 127) {
+            continue;
+        }
+        _startTicks.append(it.key());
+        _endTicks.append(note->offEvent()->midiTime());
+        _pitches.append(quint8(note->note()));
+        _velocities.append(quint8(qBound(0, note->velocity(), 127)));
+        _tracks.append(note->track() ? note->track()->number() : -1);
+        _events.append(note);
+    }
+}
+
+int NoteStore::size() const {
+    return _startTicks.size();
+}
+
+bool NoteStore::isEmpty() const {
+    return _startTicks.isEmpty();
+}
+
+int NoteStore::lowerBound(int tick) const {
+    return std::lower_bound(_startTicks.constBegin(), _startTicks.constEnd(), tick) - _startTicks.constBegin();
+}
+
+const int *NoteStore::startTicks() const {
+    return _startTicks.constData();
+}
+
+const int *NoteStore::endTicks() const {
+    return _endTicks.constData();
+}
+
+const quint8 *NoteStore::pitches() const {
+    return _pitches.constData();
+}
+
+const quint8 *NoteStore::velocities() const {
+    return _velocities.constData();
+}
+
+const int *NoteStore::tracks() const {
+    return _tracks.constData();
+}
+
+NoteOnEvent *NoteStore::event(int i) const {
+    return _events.at(i);
+}
@@ -0,0 +1,106 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOTESTORE_H_
+#define NOTESTORE_H_
+
+// Qt includes
+#include <QVector>
+
+// Forward declarations
+class EventMap;
+class MidiEvent;
+class NoteOnEvent;
+
+/**
+ * \class NoteStore
+ *
+ * \brief Column store of the notes of a channel.
+ *
+ * A note in the object model is a NoteOnEvent and an OffEvent, each a
+ * polymorphic heap object referenced from the channel's EventMap. Code that
+ * only reads notes (painting, analysis, export ranges) walks the map and
+ * casts every event.
+ * NoteStore keeps the notes of one channel in parallel arrays of start tick,
+ * end tick, pitch, velocity and track number, ordered by start tick, so such
+ * code scans packed memory instead. The NoteOnEvent of every note is kept as
+ * well for callers that have to edit it.
+ *
+ * The store is a read-only snapshot; MidiChannel::noteStore() rebuilds it
+ * when the stamp of the channel's EventMap changed or an in-place note edit
+ * called MidiChannel::invalidateNotes().
+ */
+class NoteStore {
+public:
+    /**
+     * \brief Creates an empty store.
+     */
+    NoteStore();
+
+    /**
+     * \brief Rebuilds the store from a channel's event map.
+     *
+     * Notes without an OffEvent or outside the note range are left out.
+     */
+    void build(EventMap *events);
+
+    /**
+     * \brief Gets the number of notes.
+     */
+    int size() const;
+
+    /**
+     * \brief Returns true if the store holds no notes.
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief Gets the index of the first note starting at or after tick.
+     */
+    int lowerBound(int tick) const;
+
+    /** \brief Start ticks, ascending */
+    const int *startTicks() const;
+
+    /** \brief End ticks (the ticks of the OffEvents) */
+    const int *endTicks() const;
+
+    /** \brief Note numbers (0-127) */
+    const quint8 *pitches() const;
+
+    /** \brief Velocities (0-127) */
+    const quint8 *velocities() const;
+
+    /** \brief Track numbers, -1 for notes without a track */
+    const int *tracks() const;
+
+    /**
+     * \brief Gets the NoteOnEvent of note i.
+     */
+    NoteOnEvent *event(int i) const;
+
+private:
+    QVector<int> _startTicks;
+    QVector<int> _endTicks;
+    QVector<quint8> _pitches;
+    QVector<quint8> _velocities;
+    QVector<int> _tracks;
+    QVector<NoteOnEvent *> _events;
+};
+
+#endif // NOTESTORE_H_
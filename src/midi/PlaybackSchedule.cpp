@@ -0,0 +1,268 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PlaybackSchedule.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/NoteOnEvent.h"
+#include "../MidiEvent/ProgChangeEvent.h"
+#include "MidiChannel.h"
+#include "MidiFile.h"
+#include "MidiTrack.h"
+#include "TempoMap.h"
+
+#include <QHash>
+#include <algorithm>
+#include <queue>
+#include <vector>
+
+namespace {
+
+/**
+ * \brief Read position inside one channel's sorted event list.
+ */
+struct ChannelCursor {
+    int tick;
+    int channel;
+};
+
+/**
+ * \brief Heap order: earliest tick first, on equal ticks the higher channel
+ * first (meta channels before their notes, as the former player map did).
+ */
+struct CursorLater {
+    bool operator()(const ChannelCursor &a, const ChannelCursor &b) const {
+        if (a.tick != b.tick) {
+            return a.tick > b.tick;
+        }
+        return a.channel < b.channel;
+    }
+};
+
+/**
+ * \brief First program change of a track in MidiTrack::progAtTick() fallback order.
+ */
+struct FirstProgram {
+    int channel;
+    int program;
+};
+
+}
+
+PlaybackSchedule::PlaybackSchedule() {
+    _startTick = 0;
+    _startIndex = 0;
+    for (int i = 0; i < 16; i++) {
+        _channelMuted[i] = false;
+    }
+}
+
+void PlaybackSchedule::encode(Entry *entry) {
+    entry->length = 0;
+    entry->sysexOffset = -1;
+    entry->sysexLength = 0;
+    if (entry->line == MidiEvent::SYSEX_LINE) {
+        QByteArray message = entry->event->save();
+        entry->sysexOffset = _sysexData.size();
+        entry->sysexLength = message.size();
+        _sysexData.append(message);
+        return;
+    }
+    if (entry->event->channel() > 15) {
+        return;
+    }
+    QByteArray message = entry->event->save();
+    if (message.size() < 1 || message.size() > 3) {
+        return;
+    }
+    entry->length = message.size();
+    for (int i = 0; i < message.size(); i++) {
+        entry->data[i] = (quint8) message.at(i);
+    }
+}
+
+void PlaybackSchedule::build(MidiFile *file) {
+    _entries.clear();
+    _startPrograms.clear();
+    _sysexData.clear();
+
+    // with a solo channel, the meta channels are muted as well
+    bool muted[19];
+    for (int i = 0; i < 19; i++) {
+        muted[i] = file->channelMuted(i);
+    }
+    for (int i = 0; i < 16; i++) {
+        _programChanges[i].clear();
+        _channelMuted[i] = muted[i];
+    }
+
+    QList<MidiEvent *> channelEvents[19];
+    int positions[19];
+    int total = 0;
+
+    std::priority_queue<ChannelCursor, std::vector<ChannelCursor>, CursorLater> heads;
+    for (int ch = 0; ch < 19; ch++) {
+        channelEvents[ch] = file->channel(ch)->sortedEvents();
+        positions[ch] = 0;
+        total += channelEvents[ch].size();
+        if (!channelEvents[ch].isEmpty()) {
+            heads.push({channelEvents[ch].first()->midiTime(), ch});
+        }
+    }
+    _entries.reserve(total);
+
+    TempoMap tempo = file->tempoMap();
+    int segment = tempo.isEmpty() ? -1 : 0;
+
+    QHash<MidiTrack *, int> trackProgram;
+    QHash<MidiTrack *, FirstProgram> firstTrackProgram;
+    QVector<int> unresolved;
+
+    // entries of the current tick are collected first, because a program
+    // change at the same tick as a note applies to that note
+    QVector<Entry> group;
+    int groupTick = 0;
+
+    auto flushGroup = [&]() {
+        for (Entry &entry : group) {
+            if (entry.line == MidiEvent::PROG_CHANGE_LINE && entry.event->channel() < 16) {
+                ProgChangeEvent *prog = dynamic_cast<ProgChangeEvent *>(entry.event);
+                if (prog) {
+                    int ch = prog->channel();
+                    _programChanges[ch].append(entry);
+                    trackProgram.insert(prog->track(), prog->program());
+                    auto first = firstTrackProgram.find(prog->track());
+                    if (first == firstTrackProgram.end()) {
+                        firstTrackProgram.insert(prog->track(), {ch, prog->program()});
+                    } else if (ch < first->channel) {
+                        *first = {ch, prog->program()};
+                    }
+                }
+            }
+        }
+        for (Entry &entry : group) {
+            int ch = entry.event->channel();
+            if (muted[ch] || (entry.event->track() && entry.event->track()->muted())) {
+                continue;
+            }
+            if (ch < 16 && entry.onEvent && entry.event->track() && dynamic_cast<NoteOnEvent *>(entry.event)) {
+                auto prog = trackProgram.constFind(entry.event->track());
+                if (prog != trackProgram.constEnd()) {
+                    entry.trackProgram = prog.value();
+                } else {
+                    unresolved.append(_entries.size());
+                }
+            }
+            _entries.append(entry);
+        }
+        group.clear();
+    };
+
+    while (!heads.empty()) {
+        ChannelCursor head = heads.top();
+        heads.pop();
+
+        MidiEvent *event = channelEvents[head.channel].at(positions[head.channel]++);
+        if (positions[head.channel] < channelEvents[head.channel].size()) {
+            heads.push({channelEvents[head.channel].at(positions[head.channel])->midiTime(), head.channel});
+        }
+
+        int tick = head.tick;
+        if (!group.isEmpty() && tick != groupTick) {
+            flushGroup();
+        }
+        groupTick = tick;
+
+        // sweep the tempo map forward
+        while (segment >= 0 && segment + 1 < tempo.size() && tempo.startTick(segment + 1) <= tick) {
+            segment++;
+        }
+
+        Entry entry;
+        entry.tick = tick;
+        entry.ms = segment < 0 ? 0 : tempo.startMs(segment) + tempo.msPerTick(segment) * (tick - tempo.startTick(segment));
+        entry.event = event;
+        entry.line = event->line();
+        entry.trackProgram = -1;
+        entry.onEvent = event->isOnEvent();
+        encode(&entry);
+        group.append(entry);
+    }
+    flushGroup();
+
+    // notes before the first program change of their track use the track's
+    // first program change, as MidiTrack::progAtTick() does
+    for (int index : unresolved) {
+        Entry &entry = _entries[index];
+        auto first = firstTrackProgram.constFind(entry.event->track());
+        entry.trackProgram = first != firstTrackProgram.constEnd() ? first->program : 0;
+    }
+
+    setStartTick(_startTick);
+}
+
+void PlaybackSchedule::setStartTick(int tickFrom) {
+    _startTick = tickFrom;
+
+    auto byTick = [](const Entry &entry, int tick) { return entry.tick < tick; };
+    _startIndex = std::lower_bound(_entries.constBegin(), _entries.constEnd(), tickFrom, byTick) - _entries.constBegin();
+
+    _startPrograms.clear();
+    for (int ch = 0; ch < 16; ch++) {
+        if (_channelMuted[ch]) {
+            continue;
+        }
+        const QVector<Entry> &programs = _programChanges[ch];
+        auto it = std::lower_bound(programs.constBegin(), programs.constEnd(), tickFrom, byTick);
+        if (it != programs.constBegin()) {
+            _startPrograms.append(*(it - 1));
+        }
+    }
+}
+
+int PlaybackSchedule::startTick() const {
+    return _startTick;
+}
+
+int PlaybackSchedule::startIndex() const {
+    return _startIndex;
+}
+
+int PlaybackSchedule::size() const {
+    return _entries.size();
+}
+
+const PlaybackSchedule::Entry &PlaybackSchedule::at(int i) const {
+    return _entries.at(i);
+}
+
+int PlaybackSchedule::indexOfMs(double ms) const {
+    auto byMs = [](const Entry &entry, double t) { return entry.ms < t; };
+    return std::lower_bound(_entries.constBegin(), _entries.constEnd(), ms, byMs) - _entries.constBegin();
+}
+
+const QVector<PlaybackSchedule::Entry> &PlaybackSchedule::startPrograms() const {
+    return _startPrograms;
+}
+
+const quint8 *PlaybackSchedule::sysexData(const Entry &entry) const {
+    if (entry.sysexOffset < 0) {
+        return 0;
+    }
+    return reinterpret_cast<const quint8 *>(_sysexData.constData()) + entry.sysexOffset;
+}
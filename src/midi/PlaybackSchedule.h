@@ -0,0 +1,171 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLAYBACKSCHEDULE_H_
+#define PLAYBACKSCHEDULE_H_
+
+// Qt includes
+#include <QByteArray>
+#include <QVector>
+#include <QtGlobal>
+
+// Forward declarations
+class MidiEvent;
+class MidiFile;
+
+/**
+ * \class PlaybackSchedule
+ *
+ * \brief Flat, time-sorted list of everything the player has to send.
+ *
+ * The schedule is built in a single pass: the 19 channel maps are merged by
+ * tick and the tempo map is swept forward alongside, so every entry gets its
+ * playback time without a per-event tempo lookup. Muted channels and tracks
+ * are left out, but their program changes still take part in the program
+ * resolution.
+ *
+ * For every channel the program changes are indexed as well, so moving the
+ * start tick (setStartTick()) only needs a binary search per channel and no
+ * rebuild. For note on events the program of the event's track at the note's
+ * tick is resolved during the sweep (see MidiTrack::progAtTick()).
+ *
+ * Every entry carries its MIDI message pre-encoded, so playback sends raw
+ * bytes without calling MidiEvent::save(): channel messages are stored inline
+ * in the entry (length and up to 3 data bytes), SysEx messages are appended
+ * to a side buffer of the schedule (see sysexData()).
+ */
+class PlaybackSchedule {
+public:
+    /**
+     * \brief One scheduled MIDI message.
+     */
+    struct Entry {
+        /** \brief Playback time in milliseconds */
+        double ms;
+
+        /** \brief Position in MIDI ticks */
+        int tick;
+
+        /** \brief The scheduled event */
+        MidiEvent *event;
+
+        /** \brief Cached MidiEvent::line() */
+        int line;
+
+        /** \brief Program of the event's track at tick (note ons only, else -1) */
+        int trackProgram;
+
+        /** \brief Cached MidiEvent::isOnEvent() */
+        bool onEvent;
+
+        /** \brief Length of the pre-encoded short message (0 if not a short message) */
+        quint8 length;
+
+        /** \brief Pre-encoded channel message */
+        quint8 data[3];
+
+        /** \brief Offset of the SysEx message in the side buffer (-1 if none) */
+        int sysexOffset;
+
+        /** \brief Length of the SysEx message in bytes */
+        int sysexLength;
+    };
+
+    /**
+     * \brief Creates an empty schedule.
+     */
+    PlaybackSchedule();
+
+    /**
+     * \brief Rebuilds the schedule from the file's channels and tempo map.
+     * \param file The MidiFile to schedule
+     */
+    void build(MidiFile *file);
+
+    /**
+     * \brief Moves the playback start without rebuilding.
+     *
+     * Updates startIndex() and the program changes that have to be sent
+     * before playback starts.
+     * \param tickFrom The start tick
+     */
+    void setStartTick(int tickFrom);
+
+    /**
+     * \brief Gets the tick set with setStartTick().
+     */
+    int startTick() const;
+
+    /**
+     * \brief Gets the index of the first entry at or after the start tick.
+     */
+    int startIndex() const;
+
+    /**
+     * \brief Gets the number of entries.
+     */
+    int size() const;
+
+    /**
+     * \brief Gets the entry at index i.
+     */
+    const Entry &at(int i) const;
+
+    /**
+     * \brief Gets the index of the first entry with a time of at least ms.
+     */
+    int indexOfMs(double ms) const;
+
+    /**
+     * \brief Gets the last program change of every unmuted channel before the start tick.
+     *
+     * These have to be sent before playback so every channel starts with
+     * its correct instrument.
+     */
+    const QVector<Entry> &startPrograms() const;
+
+    /**
+     * \brief Gets the SysEx message of an entry (sysexLength bytes).
+     * \return The message, or 0 if the entry has no SysEx message
+     */
+    const quint8 *sysexData(const Entry &entry) const;
+
+private:
+    /** \brief Encodes the event's message into the entry or the SysEx buffer */
+    void encode(Entry *entry);
+
+    /** \brief All playable entries sorted by tick */
+    QVector<Entry> _entries;
+
+    /** \brief Program changes per channel (including muted tracks), sorted by tick */
+    QVector<Entry> _programChanges[16];
+
+    /** \brief Channels which are muted at build time */
+    bool _channelMuted[16];
+
+    /** \brief Side buffer for the SysEx messages of the entries */
+    QByteArray _sysexData;
+
+    /** \brief Program changes sent before playback */
+    QVector<Entry> _startPrograms;
+
+    /** \brief Start position */
+    int _startTick, _startIndex;
+};
+
+#endif // PLAYBACKSCHEDULE_H_
@@ -23,23 +23,34 @@
 #include "../MidiEvent/KeySignatureEvent.h"
 #include "../MidiEvent/OffEvent.h"
 #include "../MidiEvent/TimeSignatureEvent.h"
+#include "MeterMap.h"
 #include "MidiFile.h"
 #include "MidiInput.h"
 #include "MidiOutput.h"
 #include "MidiPlayer.h"
 #include "MidiTrack.h"
-#include <QMultiMap>
-#include <QElapsedTimer>
+#include "PlaybackSchedule.h"
+#include "TempoMap.h"
+
+#include <QDeadlineTimer>
+#include <QMutexLocker>
 
 #define INTERVAL_TIME 15
-#define TIMEOUTS_PER_SIGNAL 1
+
+// the last part of a wait is spun, the wakeup of a sleeping thread is too late
+#define SPIN_TIME_NS 500000
 
 PlayerThread::PlayerThread()
     : QThread() {
     file = 0;
-    timer = 0;
-    timeoutSinceLastSignal = 0;
-    time = 0;
+    events = 0;
+    nextEvent = 0;
+    interval = INTERVAL_TIME;
+    position = 0;
+    stopped.storeRelease(true);
+    anchorNs = 0;
+    anchorMs = 0;
+    speed = 1;
 }
 
 void PlayerThread::setFile(MidiFile *f) {
@@ -47,29 +58,29 @@ void PlayerThread::setFile(MidiFile *f) {
 }
 
 void PlayerThread::stop() {
-    stopped = true;
+    QMutexLocker locker(&wakeMutex);
+    stopped.storeRelease(true);
+    wakeCondition.wakeAll();
 }
 
 void PlayerThread::setInterval(int i) {
-    interval = i;
+    interval = qMax(1, i);
 }
 
 void PlayerThread::run() {
-    if (!timer) {
-        timer = new QTimer();
-    }
-    if (time) {
-        delete time;
-        time = 0;
+    {
+        QMutexLocker locker(&wakeMutex);
+        stopped.storeRelease(false);
     }
+    maxErrorUs = 0;
+    totalErrorUs = 0;
+    sentEvents = 0;
 
     events = file->playerData();
 
-    if (file->pauseTick() >= 0) {
-        position = file->msOfTick(file->pauseTick());
-    } else {
-        position = file->msOfTick(file->cursorTick());
-    }
+    int startTick = file->pauseTick() >= 0 ? file->pauseTick() : file->cursorTick();
+    anchorMs = file->tempoMap().msOfTick(startTick);
+    position = int(anchorMs);
 
     emit playerStarted();
 
@@ -88,159 +99,208 @@ void PlayerThread::run() {
         currentChannelProgram[i] = -1;
     }
 
-    // All Events before position should be sent, progChanges and ControlChanges
-    QMultiMap<int, MidiEvent *>::iterator it = events->begin();
-    while (it != events->end()) {
-        if (it.key() >= position) {
-            break;
+    // Set the program of every channel as it is at the start position
+    foreach (const PlaybackSchedule::Entry &entry, events->startPrograms()) {
+        if (entry.length == 2 && (entry.data[0] & 0xF0) == 0xC0) {
+            currentChannelProgram[entry.data[0] & 0x0F] = entry.data[1];
         }
-        
-        ProgChangeEvent *p = dynamic_cast<ProgChangeEvent *>(it.value());
-        if (p && p->channel() >= 0 && p->channel() < 16) {
-            currentChannelProgram[p->channel()] = p->program();
-        }
-        
-        MidiOutput::sendCommand(it.value());
-        it++;
+        send(&entry);
+    }
+    nextEvent = events->startIndex();
+
+    // the meter at the start position, since its time signature is not
+    // played again
+    MeterMap meters = file->meterMap();
+    int meterSegment = meters.segmentAtTick(file->cursorTick());
+    if (meterSegment >= 0) {
+        emit meterChanged(meters.num(meterSegment), meters.denom(meterSegment));
     }
-
-    setInterval(INTERVAL_TIME);
-
-    connect(timer, SIGNAL(timeout()), this, SLOT(timeout()), Qt::DirectConnection);
-    timer->start(INTERVAL_TIME);
-
-    stopped = false;
-
-    QList<TimeSignatureEvent *> *list = 0;
 
     int tickInMeasure = 0;
-    measure = file->measure(file->cursorTick(), file->cursorTick(), &list, &tickInMeasure);
+    measure = meters.measure(file->cursorTick(), &tickInMeasure);
     emit(measureChanged(measure, tickInMeasure));
 
-    if (exec() == 0) {
-        timer->stop();
-        emit playerStopped();
-    }
-}
+    clock.start();
+    anchorNs = 0;
+    speed = MidiPlayer::speedScale();
+    MidiInput::setTimeBase(anchorMs, speed);
+    qint64 nextUpdateNs = 0;
+
+    while (!stopped.loadAcquire()) {
+        // a speed change starts a new time base at the current position
+        double newSpeed = MidiPlayer::speedScale();
+        if (newSpeed != speed && newSpeed > 0) {
+            qint64 now = clock.nsecsElapsed();
+            anchorMs = msAt(now);
+            anchorNs = now;
+            speed = newSpeed;
+            MidiInput::setTimeBase(anchorMs, speed);
+        }
 
-void PlayerThread::timeout() {
-    if (!time) {
-        time = new QElapsedTimer();
-        time->start();
-    }
+        bool hasEvent = nextEvent < events->size();
+        qint64 eventNs = hasEvent ? deadlineOf(events->at(nextEvent).ms) : 0;
 
-    disconnect(timer, SIGNAL(timeout()), this, SLOT(timeout()));
-    if (stopped) {
-        disconnect(timer, SIGNAL(timeout()), this, SLOT(timeout()));
+        if (hasEvent && eventNs <= nextUpdateNs) {
+            if (!waitUntil(eventNs)) {
+                break;
+            }
+            sendNextEvents(eventNs);
+        } else {
+            if (!waitUntil(nextUpdateNs)) {
+                break;
+            }
+            updatePosition();
+            nextUpdateNs = qMax(nextUpdateNs + qint64(interval) * 1000000, clock.nsecsElapsed());
 
-        // AllNotesOff // All SoundsOff
-        for (int i = 0; i < 16; i++) {
-            // value (third number) should be 0, but doesnt work
-            QByteArray array;
-            array.append(0xB0 | i);
-            array.append(char(123));
-            array.append(char(127));
-            MidiOutput::sendCommand(array);
+            // end if it was last event, but only if not recording
+            if (nextEvent >= events->size() && !MidiInput::recording()) {
+                stop();
+            }
         }
-        if (MidiOutput::isAlternativePlayer) {
-            foreach(int channel, MidiOutput::playedNotes.keys()) {
-                foreach(int note, MidiOutput::playedNotes.value(channel)) {
-                    QByteArray array;
-                    array.append(0x80 | channel);
-                    array.append(char(note));
-                    array.append(char(0));
-                    MidiOutput::sendCommand(array);
-                }
+    }
+
+    sendNotesOff();
+    emit playerStopped();
+}
+
+bool PlayerThread::waitUntil(qint64 deadlineNs) {
+    {
+        QMutexLocker locker(&wakeMutex);
+        while (!stopped.loadAcquire()) {
+            qint64 remaining = deadlineNs - clock.nsecsElapsed() - SPIN_TIME_NS;
+            if (remaining <= 0) {
+                break;
             }
+            QDeadlineTimer deadline(Qt::PreciseTimer);
+            deadline.setPreciseRemainingTime(0, remaining, Qt::PreciseTimer);
+            wakeCondition.wait(&wakeMutex, deadline);
         }
-        quit();
-    } else {
-        int newPos = position + time->elapsed() * MidiPlayer::speedScale();
-        int tick = file->tick(newPos);
-        QList<TimeSignatureEvent *> *list = 0;
-        int ickInMeasure = 0;
+    }
+    while (!stopped.loadAcquire() && clock.nsecsElapsed() < deadlineNs) {
+        QThread::yieldCurrentThread();
+    }
+    return !stopped.loadAcquire();
+}
 
-        int new_measure = file->measure(tick, tick, &list, &ickInMeasure);
+qint64 PlayerThread::deadlineOf(double ms) {
+    return anchorNs + qint64((ms - anchorMs) * 1000000.0 / speed);
+}
 
-        // compute current pos
+double PlayerThread::msAt(qint64 ns) {
+    return anchorMs + (ns - anchorNs) * speed / 1000000.0;
+}
 
-        if (new_measure > measure) {
-            emit measureChanged(new_measure, ickInMeasure);
-            measure = new_measure;
+void PlayerThread::sendNextEvents(qint64 deadlineNs) {
+    // events at the same time are sent together, offs before ons
+    QList<const PlaybackSchedule::Entry *> onEv, offEv;
+    double sendPosition = events->at(nextEvent).ms;
+
+    do {
+        const PlaybackSchedule::Entry &entry = events->at(nextEvent);
+        if (entry.onEvent) {
+            onEv.append(&entry);
+        } else {
+            offEv.append(&entry);
         }
-        time->restart();
-        QMultiMap<int, MidiEvent *>::iterator it = events->lowerBound(position);
-
-        while (it != events->end() && it.key() < newPos) {
-            // save events for the given tick
-            QList<MidiEvent *> onEv, offEv;
-            int sendPosition = it.key();
-
-            do {
-                if (it.value()->isOnEvent()) {
-                    onEv.append(it.value());
-                } else {
-                    offEv.append(it.value());
-                }
-                it++;
-            } while (it != events->end() && it.key() == sendPosition);
-
-            foreach(MidiEvent* ev, offEv) {
-                MidiOutput::sendCommand(ev);
+        nextEvent++;
+    } while (nextEvent < events->size() && events->at(nextEvent).ms == sendPosition);
+
+    qint64 errorUs = qMax(qint64(0), (clock.nsecsElapsed() - deadlineNs) / 1000);
+    if (errorUs > maxErrorUs.loadRelaxed()) {
+        maxErrorUs.storeRelaxed(errorUs);
+    }
+    totalErrorUs.fetchAndAddRelaxed(errorUs * (onEv.size() + offEv.size()));
+    sentEvents.fetchAndAddRelaxed(onEv.size() + offEv.size());
+
+    foreach (const PlaybackSchedule::Entry *entry, offEv) {
+        send(entry);
+    }
+    foreach (const PlaybackSchedule::Entry *entry, onEv) {
+        if (entry->line == MidiEvent::KEY_SIGNATURE_EVENT_LINE) {
+            KeySignatureEvent *keySig = dynamic_cast<KeySignatureEvent *>(entry->event);
+            if (keySig) {
+                emit tonalityChanged(keySig->tonality());
             }
-            foreach(MidiEvent* ev, onEv) {
-                if (ev->line() == MidiEvent::KEY_SIGNATURE_EVENT_LINE) {
-                    KeySignatureEvent *keySig = dynamic_cast<KeySignatureEvent *>(ev);
-                    if (keySig) {
-                        emit tonalityChanged(keySig->tonality());
-                    }
-                }
-                if (ev->line() == MidiEvent::TIME_SIGNATURE_EVENT_LINE) {
-                    TimeSignatureEvent *timeSig = dynamic_cast<TimeSignatureEvent *>(ev);
-                    if (timeSig) {
-                        emit meterChanged(timeSig->num(), timeSig->denom());
-                    }
-                }
-                
-                ProgChangeEvent *p = dynamic_cast<ProgChangeEvent *>(ev);
-                if (p && p->channel() >= 0 && p->channel() < 16) {
-                    currentChannelProgram[p->channel()] = p->program();
-                }
-
-                if (AdditionalMidiSettingsWidget::trackBasedProgramChanges()) {
-                    NoteOnEvent *n = dynamic_cast<NoteOnEvent *>(ev);
-                    if (n && n->track() && n->channel() >= 0 && n->channel() < 16) {
-                        int prog = n->track()->progAtTick(n->midiTime());
-                        if (currentChannelProgram[n->channel()] != prog) {
-                            MidiOutput::sendProgram(n->channel(), prog);
-                            currentChannelProgram[n->channel()] = prog;
-                        }
-                    }
-                }
-                
-                MidiOutput::sendCommand(ev);
+        } else if (entry->line == MidiEvent::TIME_SIGNATURE_EVENT_LINE) {
+            TimeSignatureEvent *timeSig = dynamic_cast<TimeSignatureEvent *>(entry->event);
+            if (timeSig) {
+                emit meterChanged(timeSig->num(), timeSig->denom());
             }
-
-            //MidiOutput::sendCommand(it.value());
-            //it++;
+        } else if (entry->length == 2 && (entry->data[0] & 0xF0) == 0xC0) {
+            currentChannelProgram[entry->data[0] & 0x0F] = entry->data[1];
         }
 
-        // end if it was last event, but only if not recording
-        if (it == events->end() && !MidiInput::recording()) {
-            stop();
+        // the program of the note's track was resolved when the schedule was built
+        if (entry->trackProgram >= 0 && entry->length > 0 && AdditionalMidiSettingsWidget::trackBasedProgramChanges()) {
+            int channel = entry->data[0] & 0x0F;
+            if (currentChannelProgram[channel] != entry->trackProgram) {
+                MidiOutput::sendProgram(channel, entry->trackProgram);
+                currentChannelProgram[channel] = entry->trackProgram;
+            }
         }
-        position = newPos;
-        timeoutSinceLastSignal++;
-        MidiInput::setTime(position);
-        if (timeoutSinceLastSignal == TIMEOUTS_PER_SIGNAL) {
-            emit timeMsChanged(position);
-            emit measureUpdate(measure, ickInMeasure);
-            timeoutSinceLastSignal = 0;
+
+        send(entry);
+    }
+}
+
+void PlayerThread::send(const PlaybackSchedule::Entry *entry) {
+    if (entry->length > 0) {
+        MidiOutput::sendMessage(entry->data, entry->length);
+    } else if (entry->sysexOffset >= 0) {
+        MidiOutput::sendMessage(events->sysexData(*entry), entry->sysexLength);
+    }
+}
+
+void PlayerThread::updatePosition() {
+    position = int(msAt(clock.nsecsElapsed()));
+    int tick = file->tick(position);
+    int tickInMeasure = 0;
+
+    int new_measure = file->meterMap().measure(tick, &tickInMeasure);
+    if (new_measure > measure) {
+        emit measureChanged(new_measure, tickInMeasure);
+        measure = new_measure;
+    }
+
+    if (MidiInput::recording()) {
+        MidiInput::drain();
+    }
+    emit timeMsChanged(position);
+    emit measureUpdate(measure, tickInMeasure);
+}
+
+void PlayerThread::sendNotesOff() {
+    // AllNotesOff // All SoundsOff
+    for (int i = 0; i < 16; i++) {
+        // value (third number) should be 0, but doesnt work
+        QByteArray array;
+        array.append(0xB0 | i);
+        array.append(char(123));
+        array.append(char(127));
+        MidiOutput::sendCommand(array);
+    }
+    if (MidiOutput::isAlternativePlayer) {
+        foreach(int channel, MidiOutput::playedNotes.keys()) {
+            foreach(int note, MidiOutput::playedNotes.value(channel)) {
+                QByteArray array;
+                array.append(0x80 | channel);
+                array.append(char(note));
+                array.append(char(0));
+                MidiOutput::sendCommand(array);
+            }
         }
     }
-    connect(timer, SIGNAL(timeout()), this, SLOT(timeout()), Qt::DirectConnection);
 }
 
 int PlayerThread::timeMs() {
     return position;
 }
+
+qint64 PlayerThread::maxTimingError() {
+    return maxErrorUs.loadRelaxed();
+}
+
+qint64 PlayerThread::averageTimingError() {
+    qint64 count = sentEvents.loadRelaxed();
+    return count > 0 ? totalErrorUs.loadRelaxed() / count : 0;
+}
@@ -19,10 +19,15 @@
 #ifndef PLAYERTHREAD_H_
 #define PLAYERTHREAD_H_
 
+// Project includes
+#include "PlaybackSchedule.h"
+
 // Qt includes
-#include <QThread>
-#include <QTimer>
+#include <QAtomicInteger>
 #include <QElapsedTimer>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
 
 // Forward declarations
 class MidiFile;
@@ -44,8 +49,15 @@ class MidiEvent;
  * - **Playback control**: Start, stop, and position management
  * - **Status signals**: Real-time feedback to the UI
  *
+ * The thread sleeps on a monotonic clock until the deadline of the next
+ * scheduled event and sends every event at its own time (sub-millisecond,
+ * independent of the position updates). Position and measure updates for the
+ * UI are reported separately at a low rate (see setInterval()). The lateness
+ * of every sent event is measured and can be queried with maxTimingError()
+ * and averageTimingError().
+ *
  * Key features:
- * - High-precision timing using QElapsedTimer
+ * - High-precision timing using QElapsedTimer and QWaitCondition
  * - Automatic tempo and time signature tracking
  * - Measure and beat position calculation
  * - Thread-safe playback control
@@ -70,7 +82,7 @@ public:
     void setFile(MidiFile *f);
 
     /**
-     * \brief Stops playback.
+     * \brief Stops playback and wakes the sleeping thread.
      */
     void stop();
 
@@ -80,7 +92,7 @@ public:
     void run();
 
     /**
-     * \brief Sets the playback timing interval.
+     * \brief Sets the interval of the position updates sent to the UI.
      * \param i Interval in milliseconds
      */
     void setInterval(int i);
@@ -91,11 +103,17 @@ public:
      */
     int timeMs();
 
-public slots:
     /**
-     * \brief Handles timer timeout events for playback processing.
+     * \brief Gets the largest delay of a sent event behind its deadline.
+     * \return The delay of the current or last playback in microseconds
      */
-    void timeout();
+    qint64 maxTimingError();
+
+    /**
+     * \brief Gets the average delay of the sent events behind their deadlines.
+     * \return The delay of the current or last playback in microseconds
+     */
+    qint64 averageTimingError();
 
 signals:
     /**
@@ -145,20 +163,72 @@ private:
     /** \brief The MIDI file being played */
     MidiFile *file;
 
-    /** \brief Map of events organized by time */
-    QMultiMap<int, MidiEvent *> *events;
+    /** \brief Schedule of events organized by time */
+    PlaybackSchedule *events;
+
+    /** \brief Index of the next schedule entry to send */
+    int nextEvent;
+
+    /**
+     * \brief Sleeps until the clock reaches deadlineNs.
+     * \return False if playback was stopped while waiting
+     */
+    bool waitUntil(qint64 deadlineNs);
+
+    /**
+     * \brief Gets the clock time at which the file time ms is due.
+     */
+    qint64 deadlineOf(double ms);
+
+    /**
+     * \brief Gets the file time in ms at the clock time ns.
+     */
+    double msAt(qint64 ns);
+
+    /**
+     * \brief Sends all entries scheduled at the time of the next entry.
+     */
+    void sendNextEvents(qint64 deadlineNs);
 
-    /** \brief Timing and position variables */
-    int interval, position, timeoutSinceLastSignal;
+    /**
+     * \brief Sends the pre-encoded message of a schedule entry.
+     */
+    void send(const PlaybackSchedule::Entry *entry);
 
-    /** \brief Playback control flag */
-    volatile bool stopped;
+    /**
+     * \brief Reports the current position and measure.
+     */
+    void updatePosition();
 
-    /** \brief Timer for playback timing */
-    QTimer *timer;
+    /**
+     * \brief Sends AllNotesOff to all channels.
+     */
+    void sendNotesOff();
+
+    /** \brief Interval of the UI updates in ms and the current position in ms */
+    int interval, position;
+
+    /** \brief Playback control flag, also read without wakeMutex while spinning */
+    QAtomicInteger<bool> stopped;
+
+    /** \brief Orders stop() with the wait on wakeCondition */
+    QMutex wakeMutex;
+
+    /** \brief Wakes the thread when playback is stopped */
+    QWaitCondition wakeCondition;
+
+    /** \brief Monotonic playback clock */
+    QElapsedTimer clock;
+
+    /**
+     * \brief Clock time and file time of the last speed change, and the speed
+     * since then
+     */
+    qint64 anchorNs;
+    double anchorMs, speed;
 
-    /** \brief Elapsed time tracker */
-    QElapsedTimer *time;
+    /** \brief Timing error statistics in microseconds */
+    QAtomicInteger<qint64> maxErrorUs, totalErrorUs, sentEvents;
 
     /** \brief Current measure and position tracking */
     int measure, posInMeasure;
@@ -0,0 +1,186 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "QuantizationGrid.h"
+
+#include "MeterMap.h"
+#include "MidiFile.h"
+
+#include <QtMath>
+#include <algorithm>
+#include <climits>
+
+QuantizationGrid::QuantizationGrid() {
+}
+
+QuantizationGrid::QuantizationGrid(MidiFile *file, int fractionSize, bool measureGrid) {
+    int step = ticksOfFraction(fractionSize, file->ticksPerQuarter());
+    if (step < 0 && !measureGrid) {
+        // Fallback for unexpected values
+        step = file->ticksPerQuarter();
+    }
+
+    MeterMap meters = file->meterMap();
+    for (int i = 0; i < meters.size(); i++) {
+        Segment segment;
+        segment.start = meters.startTick(i);
+        segment.period = measureGrid ? meters.ticksPerMeasure(i) : 0;
+        segment.step = step > 0 ? step : qMax(1, segment.period);
+
+        int end;
+        if (i + 1 < meters.size()) {
+            end = meters.startTick(i + 1);
+        } else {
+            // measure grids continue behind the end of the file
+            end = measureGrid ? INT_MAX / 2 : file->endTick() + 1;
+        }
+        if (end <= segment.start) {
+            continue;
+        }
+        segment.last = atOrBefore(segment, end - 1);
+        _segments.append(segment);
+    }
+}
+
+QuantizationGrid::QuantizationGrid(int start, int step, int last) {
+    if (last >= start) {
+        Segment segment;
+        segment.start = start;
+        segment.step = qMax(1, step);
+        segment.period = 0;
+        segment.last = atOrBefore(segment, last);
+        _segments.append(segment);
+    }
+}
+
+int QuantizationGrid::ticksOfFraction(int fractionSize, int ticksPerQuarter) {
+    if (fractionSize >= 0) {
+        // Regular divisions: 4 / 2^fractionSize quarters per division
+        return (4 * ticksPerQuarter) / qPow(2, fractionSize);
+    }
+    if (fractionSize > -100) {
+        return -1;
+    }
+
+    int subdivisionType = (-fractionSize) / 100; // 1=triplets, 2=quintuplets, etc.
+    int baseDivision = (-fractionSize) % 100; // Extract base division
+
+    double baseDiv = 4 / (double) qPow(2, baseDivision);
+
+    switch (subdivisionType) {
+        case 2:
+            // Quintuplets: divide by 5
+            return (baseDiv * ticksPerQuarter) / 5;
+        case 3:
+            // Sextuplets: divide by 6
+            return (baseDiv * ticksPerQuarter) / 6;
+        case 4:
+            // Septuplets: divide by 7
+            return (baseDiv * ticksPerQuarter) / 7;
+        case 5:
+            // Dotted notes: multiply by 1.5
+            return (baseDiv * ticksPerQuarter) * 1.5;
+        case 6:
+            // Double dotted notes: multiply by 1.75
+            return (baseDiv * ticksPerQuarter) * 1.75;
+        default:
+            // Triplets, also the fallback for unknown types
+            return (baseDiv * ticksPerQuarter) / 3;
+    }
+}
+
+int QuantizationGrid::atOrBefore(const Segment &segment, int tick) {
+    int base = segment.start;
+    if (segment.period > 0) {
+        base += ((tick - segment.start) / segment.period) * segment.period;
+    }
+    return base + ((tick - base) / segment.step) * segment.step;
+}
+
+int QuantizationGrid::after(const Segment &segment, int tick) {
+    int tickBefore = atOrBefore(segment, tick);
+    int candidate = tickBefore + segment.step;
+    if (segment.period > 0) {
+        int measureEnd = segment.start + ((tickBefore - segment.start) / segment.period + 1) * segment.period;
+        candidate = qMin(candidate, measureEnd);
+    }
+    return candidate;
+}
+
+int QuantizationGrid::segmentOf(int tick) const {
+    auto byStart = [](int t, const Segment &segment) { return t < segment.start; };
+    return int(std::upper_bound(_segments.constBegin(), _segments.constEnd(), tick, byStart) - _segments.constBegin()) - 1;
+}
+
+bool QuantizationGrid::isEmpty() const {
+    return _segments.isEmpty();
+}
+
+int QuantizationGrid::floor(int tick) const {
+    int index = segmentOf(tick);
+    if (index < 0) {
+        return -1;
+    }
+    const Segment &segment = _segments.at(index);
+    return qMin(atOrBefore(segment, tick), segment.last);
+}
+
+int QuantizationGrid::next(int tick) const {
+    int index = segmentOf(tick);
+    if (index < 0) {
+        return _segments.isEmpty() ? -1 : _segments.first().start;
+    }
+    const Segment &segment = _segments.at(index);
+    if (tick < segment.last) {
+        return after(segment, tick);
+    }
+    return index + 1 < _segments.size() ? _segments.at(index + 1).start : -1;
+}
+
+int QuantizationGrid::previous(int tick) const {
+    if (tick <= 0) {
+        return -1;
+    }
+    return floor(tick - 1);
+}
+
+bool QuantizationGrid::contains(int tick) const {
+    return tick >= 0 && floor(tick) == tick;
+}
+
+int QuantizationGrid::snap(int tick) const {
+    int before = floor(tick);
+    int behind = before == tick ? tick : next(tick);
+    if (before < 0) {
+        return behind < 0 ? tick : behind;
+    }
+    if (behind < 0 || tick - before <= behind - tick) {
+        return before;
+    }
+    return behind;
+}
+
+QList<int> QuantizationGrid::ticks() const {
+    QList<int> list;
+    for (const Segment &segment : _segments) {
+        for (int tick = segment.start; tick <= segment.last; tick = after(segment, tick)) {
+            list.append(tick);
+        }
+    }
+    return list;
+}
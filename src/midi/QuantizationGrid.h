@@ -0,0 +1,146 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef QUANTIZATIONGRID_H_
+#define QUANTIZATIONGRID_H_
+
+// Qt includes
+#include <QList>
+#include <QVector>
+
+// Forward declarations
+class MidiFile;
+
+/**
+ * \class QuantizationGrid
+ *
+ * \brief Grid of ticks used for quantization and magnet snapping.
+ *
+ * The grid is described by one segment per time signature instead of a list
+ * of all grid ticks. Inside a segment the grid ticks are evenly spaced from
+ * the time signature's tick on; a measure grid additionally restarts the
+ * division at every measure, as the divisions drawn by the MatrixWidget do.
+ * Finding the grid ticks around a tick is a binary search over the segments
+ * followed by a division, so snapping does not depend on the length of the
+ * file.
+ */
+class QuantizationGrid {
+public:
+    /**
+     * \brief Creates an empty grid.
+     */
+    QuantizationGrid();
+
+    /**
+     * \brief Creates the grid of file for a fraction size.
+     * \param file The file providing time signatures and length
+     * \param fractionSize The division as used by the quantization settings
+     *        and MatrixWidget::div() (see ticksOfFraction())
+     * \param measureGrid If true, the division restarts at every measure
+     *        and the grid continues behind the end of the file; otherwise
+     *        the grid is the list returned by MidiFile::quantization()
+     */
+    QuantizationGrid(MidiFile *file, int fractionSize, bool measureGrid = false);
+
+    /**
+     * \brief Creates a grid with the ticks start, start + step, ... up to last.
+     */
+    QuantizationGrid(int start, int step, int last);
+
+    /**
+     * \brief Gets the length of a division in ticks.
+     * \param fractionSize 0 for whole notes, 1 for halves, 2 for quarters...;
+     *        -100 * type - base for tuplets and dotted divisions of base
+     *        (type 1: triplets, 2: quintuplets, 3: sextuplets, 4: septuplets,
+     *        5: dotted, 6: double dotted)
+     * \param ticksPerQuarter The resolution of the file
+     * \return The length in ticks, or -1 for values without divisions
+     */
+    static int ticksOfFraction(int fractionSize, int ticksPerQuarter);
+
+    /**
+     * \brief Returns true if the grid has no ticks.
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief Gets the last grid tick at or before tick, -1 if there is none.
+     */
+    int floor(int tick) const;
+
+    /**
+     * \brief Gets the first grid tick after tick, -1 if there is none.
+     */
+    int next(int tick) const;
+
+    /**
+     * \brief Gets the last grid tick before tick, -1 if there is none.
+     */
+    int previous(int tick) const;
+
+    /**
+     * \brief Returns true if tick is a grid tick.
+     */
+    bool contains(int tick) const;
+
+    /**
+     * \brief Gets the grid tick closest to tick.
+     *
+     * On equal distance the earlier grid tick is used. Returns tick if the
+     * grid is empty.
+     */
+    int snap(int tick) const;
+
+    /**
+     * \brief Gets all grid ticks.
+     *
+     * Only useful for grids that end with the file (no measure grids).
+     */
+    QList<int> ticks() const;
+
+private:
+    /**
+     * \brief The grid from one time signature to the next.
+     */
+    struct Segment {
+        int start;
+        int last;   ///< last grid tick of the segment
+        int step;
+        int period; ///< measure length for measure grids, 0 otherwise
+    };
+
+    /**
+     * \brief Gets the last grid tick of segment at or before tick (>= start).
+     */
+    static int atOrBefore(const Segment &segment, int tick);
+
+    /**
+     * \brief Gets the first grid tick of segment after tick, ignoring last.
+     */
+    static int after(const Segment &segment, int tick);
+
+    /**
+     * \brief Gets the index of the segment containing tick, -1 if before the grid.
+     */
+    int segmentOf(int tick) const;
+
+    /** \brief The segments, ordered by start */
+    QVector<Segment> _segments;
+};
+
+#endif // QUANTIZATIONGRID_H_
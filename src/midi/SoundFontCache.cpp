@@ -0,0 +1,1052 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SoundFontCache.h"
+
+#ifdef FLUIDSYNTH_SUPPORT
+
+#include <QByteArray>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QVector>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+/** \brief Number of SF2 generator types (GEN_STARTADDROFS to GEN_OVERRIDEROOTKEY) */
+const int SF_GENERATORS = GEN_OVERRIDEROOTKEY + 1;
+
+quint16 readU16(const uchar *p) {
+    return quint16(p[0] | (p[1] << 8));
+}
+
+qint16 readS16(const uchar *p) {
+    return qint16(readU16(p));
+}
+
+quint32 readU32(const uchar *p) {
+    return quint32(p[0]) | (quint32(p[1]) << 8) | (quint32(p[2]) << 16) | (quint32(p[3]) << 24);
+}
+
+/**
+ * \brief A RIFF chunk inside the mapped file.
+ */
+struct Chunk {
+    const uchar *data = nullptr;
+    quint32 size = 0;
+
+    /** \brief Gets the number of records of recordSize bytes */
+    int count(int recordSize) const {
+        return int(size / quint32(recordSize));
+    }
+
+    const uchar *record(int index, int recordSize) const {
+        return data + qint64(index) * recordSize;
+    }
+};
+
+/**
+ * \brief Finds the chunk id in a list of chunks; with listType, the LIST
+ * chunk of that type, without its type field.
+ */
+bool findChunk(const uchar *data, quint64 size, const char *id, const char *listType, Chunk *chunk) {
+    quint64 pos = 0;
+    while (pos + 8 <= size) {
+        const uchar *header = data + pos;
+        quint64 length = readU32(header + 4);
+        if (pos + 8 + length > size) {
+            return false;
+        }
+        if (std::memcmp(header, id, 4) == 0
+            && (!listType || (length >= 4 && std::memcmp(header + 8, listType, 4) == 0))) {
+            int skip = listType ? 4 : 0;
+            chunk->data = header + 8 + skip;
+            chunk->size = quint32(length - skip);
+            return true;
+        }
+        pos += 8 + length + (length & 1);
+    }
+    return false;
+}
+
+/**
+ * \brief Converts an SF2 modulator source to FluidSynth's index and flags.
+ * \return False if the source is not valid (SF2.01 8.2)
+ */
+bool modulatorSource(quint16 source, int *index, int *flags) {
+    *index = source & 127;
+    bool cc = source & (1 << 7);
+    *flags = (cc ? FLUID_MOD_CC : FLUID_MOD_GC)
+             | ((source & (1 << 8)) ? FLUID_MOD_NEGATIVE : FLUID_MOD_POSITIVE)
+             | ((source & (1 << 9)) ? FLUID_MOD_BIPOLAR : FLUID_MOD_UNIPOLAR);
+    switch ((source >> 10) & 63) {
+        case 0:
+            *flags |= FLUID_MOD_LINEAR;
+            break;
+        case 1:
+            *flags |= FLUID_MOD_CONCAVE;
+            break;
+        case 2:
+            *flags |= FLUID_MOD_CONVEX;
+            break;
+        case 3:
+            *flags |= FLUID_MOD_SWITCH;
+            break;
+        default:
+            return false;
+    }
+    if (cc) {
+        int i = *index;
+        return !(i == 0 || i == 6 || (i >= 32 && i <= 63) || (i >= 98 && i <= 101) || i >= 120);
+    }
+    switch (*index) {
+        case FLUID_MOD_NONE:
+        case FLUID_MOD_VELOCITY:
+        case FLUID_MOD_KEY:
+        case FLUID_MOD_KEYPRESSURE:
+        case FLUID_MOD_CHANNELPRESSURE:
+        case FLUID_MOD_PITCHWHEEL:
+        case FLUID_MOD_PITCHWHEELSENS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * \brief Generators a preset zone may add to its instruments (SF2.01 8.5).
+ */
+bool isPresetGenerator(int type) {
+    switch (type) {
+        case GEN_STARTADDROFS:
+        case GEN_ENDADDROFS:
+        case GEN_STARTLOOPADDROFS:
+        case GEN_ENDLOOPADDROFS:
+        case GEN_STARTADDRCOARSEOFS:
+        case GEN_ENDADDRCOARSEOFS:
+        case GEN_STARTLOOPADDRCOARSEOFS:
+        case GEN_ENDLOOPADDRCOARSEOFS:
+        case GEN_KEYNUM:
+        case GEN_VELOCITY:
+        case GEN_SAMPLEMODE:
+        case GEN_EXCLUSIVECLASS:
+        case GEN_OVERRIDEROOTKEY:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/**
+ * \brief A zone as stored in the file, before global defaults are applied.
+ */
+struct RawZone {
+    int keyLow = 0;
+    int keyHigh = 127;
+    int velLow = 0;
+    int velHigh = 127;
+    int target = -1;
+    bool set[SF_GENERATORS] = {};
+    float value[SF_GENERATORS] = {};
+    QVector<fluid_mod_t *> modulators;
+};
+
+/**
+ * \brief The bag, generator and modulator chunks of presets or instruments.
+ */
+struct ZoneChunks {
+    Chunk bags;
+    Chunk generators;
+    Chunk modulators;
+    int terminal;
+};
+
+/**
+ * \brief Reads zone bag. Modulators are created into owned.
+ * \return False if the file is corrupt; sets unsupported for modulators
+ *         FluidSynth's public API cannot express
+ */
+bool readZone(const ZoneChunks &chunks, int bag, RawZone *zone, QList<fluid_mod_t *> *owned, bool *unsupported) {
+    if (bag + 1 >= chunks.bags.count(4)) {
+        return false;
+    }
+    const uchar *first = chunks.bags.record(bag, 4);
+    const uchar *next = chunks.bags.record(bag + 1, 4);
+    int genStart = readU16(first);
+    int genEnd = readU16(next);
+    int modStart = readU16(first + 2);
+    int modEnd = readU16(next + 2);
+    if (genStart > genEnd || genEnd > chunks.generators.count(4)
+        || modStart > modEnd || modEnd > chunks.modulators.count(10)) {
+        return false;
+    }
+
+    for (int g = genStart; g < genEnd; g++) {
+        const uchar *record = chunks.generators.record(g, 4);
+        int type = readU16(record);
+        if (type == GEN_KEYRANGE) {
+            zone->keyLow = record[2];
+            zone->keyHigh = record[3];
+        } else if (type == GEN_VELRANGE) {
+            zone->velLow = record[2];
+            zone->velHigh = record[3];
+        } else if (type == chunks.terminal) {
+            // the instrument or sample ends the zone
+            zone->target = readU16(record + 2);
+            break;
+        } else if (type < SF_GENERATORS && type != GEN_INSTRUMENT && type != GEN_SAMPLEID) {
+            zone->set[type] = true;
+            zone->value[type] = readS16(record + 2);
+        }
+    }
+
+    for (int m = modStart; m < modEnd; m++) {
+        const uchar *record = chunks.modulators.record(m, 10);
+        quint16 source = readU16(record);
+        quint16 destination = readU16(record + 2);
+        qint16 amount = readS16(record + 4);
+        quint16 amountSource = readU16(record + 6);
+        quint16 transform = readU16(record + 8);
+
+        // linked modulators and transforms other than linear (SF2.04)
+        if ((destination & 0x8000) || transform != 0 || (source & 0xFF) == 127 || (amountSource & 0xFF) == 127) {
+            *unsupported = true;
+            return true;
+        }
+
+        int src1, flags1, src2, flags2;
+        if (!modulatorSource(source, &src1, &flags1) || !modulatorSource(amountSource, &src2, &flags2)
+            || (src1 == FLUID_MOD_NONE && !(flags1 & FLUID_MOD_CC)) || amount == 0 || destination >= SF_GENERATORS) {
+            // invalid or without effect; ignored like FluidSynth does
+            continue;
+        }
+
+        fluid_mod_t *mod = new_fluid_mod();
+        if (!mod) {
+            return false;
+        }
+        owned->append(mod);
+        fluid_mod_set_source1(mod, src1, flags1);
+        fluid_mod_set_source2(mod, src2, flags2);
+        fluid_mod_set_dest(mod, destination);
+        fluid_mod_set_amount(mod, amount);
+
+        // a modulator identical to an earlier one of the zone is ignored
+        bool duplicate = false;
+        for (fluid_mod_t *other : zone->modulators) {
+            duplicate = duplicate || fluid_mod_test_identity(mod, other);
+        }
+        if (!duplicate) {
+            zone->modulators.append(mod);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+/**
+ * \brief A parsed SF2 file.
+ *
+ * Immutable once parsed, so synths on any thread read it without locking.
+ * Generators and modulators of every zone already contain the defaults of
+ * the global zone; the samples point into the mapped file.
+ */
+struct SoundFontCache::Font {
+    struct Generator {
+        int type;
+        float amount;
+    };
+
+    struct Zone {
+        int keyLow, keyHigh, velLow, velHigh;
+        /** \brief Instrument of a preset zone, sample of an instrument zone */
+        int target;
+        QVector<Generator> generators;
+        QVector<fluid_mod_t *> modulators;
+
+        bool contains(int key, int velocity) const {
+            return key >= keyLow && key <= keyHigh && velocity >= velLow && velocity <= velHigh;
+        }
+    };
+
+    struct Instrument {
+        QVector<Zone> zones;
+    };
+
+    struct Preset {
+        QByteArray name;
+        int bank;
+        int program;
+        QVector<Zone> zones;
+    };
+
+    struct Sample {
+        QByteArray name;
+        /** \brief Null for samples that cannot be played (ROM, out of range) */
+        const short *data;
+        const char *data24;
+        quint32 frames;
+        quint32 loopStart;
+        quint32 loopEnd;
+        quint32 rate;
+        int rootKey;
+        int correction;
+    };
+
+    QString path;
+    QDateTime modified;
+    qint64 size;
+
+    /** \brief Keeps the mapping the samples point into */
+    Handle *handle;
+
+    QVector<Sample> samples;
+    QVector<Instrument> instruments;
+    QVector<Preset> presets;
+
+    /** \brief Preset index by bank * 256 + program */
+    QHash<int, int> presetIndex;
+
+    /** \brief All modulators of the zones, shared by zones using the same global ones */
+    QList<fluid_mod_t *> modulators;
+
+    /** \brief Number of SynthFonts using this font */
+    int users;
+};
+
+struct SoundFontCache::SynthFont {
+    Font *font;
+    Loader *loader;
+
+    /** \brief The file name the synth loaded */
+    QByteArray name;
+
+    /** \brief Sample descriptors of this synth, null where the font's sample is */
+    QVector<fluid_sample_t *> samples;
+
+    QVector<fluid_preset_t *> presets;
+    int iteration;
+};
+
+struct SoundFontCache::Loader {
+    /** \brief False once the synth deleted its loader */
+    bool alive = true;
+
+    /** \brief SynthFonts loaded by this loader and not deleted yet */
+    int fonts = 0;
+
+    /** \brief Unloaded SynthFonts; their samples may still be played by releasing voices */
+    QList<SynthFont *> retired;
+};
+
+SoundFontCache *SoundFontCache::instance() {
+    // Never deleted: synths may still close their files while static
+    // objects are destroyed at exit
+    static SoundFontCache *cache = new SoundFontCache();
+    return cache;
+}
+
+SoundFontCache::SoundFontCache() {
+}
+
+void SoundFontCache::install(fluid_synth_t *synth) {
+    if (!synth) {
+        return;
+    }
+
+    // FluidSynth's own loader reading through the mapped files, for the
+    // files the shared loader leaves to it
+    fluid_sfloader_t *loader = new_fluid_defsfloader(fluid_synth_get_settings(synth));
+    if (loader) {
+        if (fluid_sfloader_set_callbacks(loader, fileOpen, fileRead, fileSeek, fileTell, fileClose) == FLUID_OK) {
+            fluid_synth_add_sfloader(synth, loader);
+        } else {
+            delete_fluid_sfloader(loader);
+        }
+    }
+
+    // Added loaders are tried before the ones added earlier, so the shared
+    // loader comes first
+    fluid_sfloader_t *shared = new_fluid_sfloader(loadFont, freeLoader);
+    if (!shared) {
+        return;
+    }
+    fluid_sfloader_set_data(shared, new Loader);
+    fluid_synth_add_sfloader(synth, shared);
+}
+
+bool SoundFontCache::prepare(const QString &path) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // see loadFont()
+    Q_UNUSED(path);
+    return false;
+#else
+    Font *font = acquireFont(path);
+    if (!font) {
+        return false;
+    }
+    // the font stays cached until retain() drops it
+    QMutexLocker locker(&_mutex);
+    releaseFont(font);
+    return true;
+#endif
+}
+
+void SoundFontCache::retain(const QStringList &paths) {
+    QStringList keep;
+    for (const QString &path : paths) {
+        keep.append(QFileInfo(path).canonicalFilePath());
+    }
+
+    QMutexLocker locker(&_mutex);
+    // Fonts first, they hold handles of the entries
+    for (auto it = _fonts.begin(); it != _fonts.end();) {
+        if (it.value()->users == 0 && !keep.contains(it.key())) {
+            deleteFont(it.value());
+            it = _fonts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (auto it = _entries.begin(); it != _entries.end();) {
+        if (it.value()->handles == 0 && !keep.contains(it.key())) {
+            deleteEntry(it.value());
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+SoundFontCache::Handle *SoundFontCache::openHandle(const QString &path) {
+    QFileInfo fi(path);
+    QString key = fi.canonicalFilePath();
+    if (key.isEmpty() || !fi.isReadable()) {
+        return nullptr;
+    }
+
+    QMutexLocker locker(&_mutex);
+    Entry *entry = _entries.value(key, nullptr);
+    if (entry && (entry->modified != fi.lastModified() || entry->size != fi.size())) {
+        // Changed on disk; synths reading the old mapping keep it until they close it
+        _entries.remove(key);
+        if (entry->handles > 0) {
+            _stale.append(entry);
+        } else {
+            deleteEntry(entry);
+        }
+        entry = nullptr;
+    }
+
+    if (!entry) {
+        QFile *file = new QFile(key);
+        uchar *data = nullptr;
+        if (file->open(QIODevice::ReadOnly) && file->size() > 0) {
+            data = file->map(0, file->size());
+        }
+        if (data) {
+            entry = new Entry;
+            entry->path = key;
+            entry->modified = fi.lastModified();
+            entry->size = file->size();
+            entry->file = file;
+            entry->data = data;
+            entry->handles = 0;
+            _entries.insert(key, entry);
+        } else {
+            delete file;
+        }
+    }
+
+    Handle *handle = new Handle;
+    handle->entry = entry;
+    handle->fallback = nullptr;
+    handle->pos = 0;
+    if (entry) {
+        entry->handles++;
+        return handle;
+    }
+
+    // Not mappable: read through a file of this handle
+    qWarning() << "SoundFontCache: cannot map" << key << "- reading it directly";
+    handle->fallback = new QFile(key);
+    if (!handle->fallback->open(QIODevice::ReadOnly)) {
+        delete handle->fallback;
+        delete handle;
+        return nullptr;
+    }
+    return handle;
+}
+
+void SoundFontCache::closeHandle(Handle *handle) {
+    QMutexLocker locker(&_mutex);
+    releaseHandle(handle);
+}
+
+void SoundFontCache::releaseHandle(Handle *handle) {
+    // _mutex is held
+    if (handle->fallback) {
+        delete handle->fallback;
+    }
+    if (handle->entry) {
+        Entry *entry = handle->entry;
+        entry->handles--;
+        if (entry->handles == 0 && _stale.removeOne(entry)) {
+            deleteEntry(entry);
+        }
+    }
+    delete handle;
+}
+
+void SoundFontCache::deleteEntry(Entry *entry) {
+    entry->file->unmap(const_cast<uchar *>(entry->data));
+    delete entry->file;
+    delete entry;
+}
+
+SoundFontCache::Font *SoundFontCache::acquireFont(const QString &path) {
+    QFileInfo fi(path);
+    QString key = fi.canonicalFilePath();
+    if (key.isEmpty() || !fi.isReadable()) {
+        return nullptr;
+    }
+
+    {
+        QMutexLocker locker(&_mutex);
+        Font *font = _fonts.value(key, nullptr);
+        if (font && (font->modified != fi.lastModified() || font->size != fi.size())) {
+            // Changed on disk; synths using the old font keep it until they release it
+            _fonts.remove(key);
+            if (font->users > 0) {
+                _staleFonts.append(font);
+            } else {
+                deleteFont(font);
+            }
+            font = nullptr;
+        }
+        if (font) {
+            font->users++;
+            return font;
+        }
+    }
+
+    // Parsed without holding the lock; a font parsed by another synth in
+    // the meantime wins
+    Handle *handle = openHandle(key);
+    if (!handle) {
+        return nullptr;
+    }
+    if (!handle->entry) {
+        // Not mappable, so the samples cannot be used in place
+        closeHandle(handle);
+        return nullptr;
+    }
+    Font *parsed = parseFont(handle);
+    if (!parsed) {
+        closeHandle(handle);
+        return nullptr;
+    }
+
+    QMutexLocker locker(&_mutex);
+    Font *font = _fonts.value(key, nullptr);
+    if (font) {
+        deleteFont(parsed);
+    } else {
+        font = parsed;
+        _fonts.insert(key, font);
+    }
+    font->users++;
+    return font;
+}
+
+SoundFontCache::Font *SoundFontCache::parseFont(Handle *handle) {
+    const uchar *data = handle->entry->data;
+    qint64 size = handle->entry->size;
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "sfbk", 4) != 0) {
+        return nullptr;
+    }
+    const uchar *body = data + 12;
+    quint64 bodySize = qMin(quint64(readU32(data + 4)), quint64(size - 8)) - 4;
+
+    Chunk info, sdta, pdta, version, smpl, sm24;
+    if (!findChunk(body, bodySize, "LIST", "INFO", &info) || !findChunk(body, bodySize, "LIST", "sdta", &sdta)
+        || !findChunk(body, bodySize, "LIST", "pdta", &pdta)) {
+        return nullptr;
+    }
+    // SF3 stores compressed samples, those are left to FluidSynth
+    if (!findChunk(info.data, info.size, "ifil", nullptr, &version) || version.size < 4 || readU16(version.data) != 2) {
+        return nullptr;
+    }
+    // The samples are used in place, as 16 bit values
+    if (!findChunk(sdta.data, sdta.size, "smpl", nullptr, &smpl) || smpl.size < 2 || ((smpl.data - data) & 1)) {
+        return nullptr;
+    }
+    quint32 sampleFrames = smpl.size / 2;
+    bool has24 = readU16(version.data + 2) >= 4 && findChunk(sdta.data, sdta.size, "sm24", nullptr, &sm24)
+                 && sm24.size >= sampleFrames;
+
+    Chunk phdr, inst, shdr;
+    ZoneChunks presetChunks, instrumentChunks;
+    presetChunks.terminal = GEN_INSTRUMENT;
+    instrumentChunks.terminal = GEN_SAMPLEID;
+    if (!findChunk(pdta.data, pdta.size, "phdr", nullptr, &phdr)
+        || !findChunk(pdta.data, pdta.size, "pbag", nullptr, &presetChunks.bags)
+        || !findChunk(pdta.data, pdta.size, "pmod", nullptr, &presetChunks.modulators)
+        || !findChunk(pdta.data, pdta.size, "pgen", nullptr, &presetChunks.generators)
+        || !findChunk(pdta.data, pdta.size, "inst", nullptr, &inst)
+        || !findChunk(pdta.data, pdta.size, "ibag", nullptr, &instrumentChunks.bags)
+        || !findChunk(pdta.data, pdta.size, "imod", nullptr, &instrumentChunks.modulators)
+        || !findChunk(pdta.data, pdta.size, "igen", nullptr, &instrumentChunks.generators)
+        || !findChunk(pdta.data, pdta.size, "shdr", nullptr, &shdr)) {
+        return nullptr;
+    }
+    // Every list ends with a terminal record
+    int presetCount = phdr.count(38) - 1;
+    int instrumentCount = inst.count(22) - 1;
+    int sampleCount = shdr.count(46) - 1;
+    if (presetCount < 1 || instrumentCount < 1 || sampleCount < 1) {
+        return nullptr;
+    }
+
+    Font *font = new Font;
+    font->path = handle->entry->path;
+    font->modified = handle->entry->modified;
+    font->size = handle->entry->size;
+    font->handle = handle;
+    font->users = 0;
+    auto fail = [font]() -> Font * {
+        for (fluid_mod_t *mod : font->modulators) {
+            delete_fluid_mod(mod);
+        }
+        delete font;
+        return nullptr;
+    };
+
+    // Samples
+    font->samples.resize(sampleCount);
+    for (int i = 0; i < sampleCount; i++) {
+        const uchar *record = shdr.record(i, 46);
+        Font::Sample &sample = font->samples[i];
+        sample.name = QByteArray(reinterpret_cast<const char *>(record), int(qstrnlen(reinterpret_cast<const char *>(record), 20)));
+        quint32 start = readU32(record + 20);
+        quint32 end = readU32(record + 24);
+        quint32 loopStart = readU32(record + 28);
+        quint32 loopEnd = readU32(record + 32);
+        quint32 rate = readU32(record + 36);
+        int pitch = record[40];
+        int correction = qint8(record[41]);
+        quint16 type = readU16(record + 44);
+
+        sample.data = nullptr;
+        sample.data24 = nullptr;
+        if ((type & 0x8000) || end <= start || end > sampleFrames) {
+            // ROM samples and samples outside the sample data
+            continue;
+        }
+        sample.data = reinterpret_cast<const short *>(smpl.data) + start;
+        sample.data24 = has24 ? reinterpret_cast<const char *>(sm24.data) + start : nullptr;
+        sample.frames = end - start;
+        if (loopStart < start || loopEnd > end || loopEnd <= loopStart) {
+            sample.loopStart = 0;
+            sample.loopEnd = sample.frames - 1;
+        } else {
+            sample.loopStart = loopStart - start;
+            sample.loopEnd = loopEnd - start;
+        }
+        sample.rate = rate > 0 ? rate : 44100;
+        sample.rootKey = pitch <= 127 ? pitch : 60;
+        sample.correction = correction;
+    }
+
+    // Applies the global zone of a preset or instrument to its other zones
+    bool unsupported = false;
+    auto readZones = [&](const ZoneChunks &chunks, int firstBag, int lastBag, bool presetLevel, int targets,
+                         QVector<Font::Zone> *zones) -> bool {
+        RawZone global;
+        for (int bag = firstBag; bag < lastBag; bag++) {
+            RawZone raw;
+            if (!readZone(chunks, bag, &raw, &font->modulators, &unsupported)) {
+                return false;
+            }
+            if (raw.target < 0) {
+                // only the first zone can be global, other zones without
+                // an instrument or sample are ignored
+                if (bag == firstBag) {
+                    global = raw;
+                }
+                continue;
+            }
+            if (raw.target >= targets) {
+                continue;
+            }
+
+            Font::Zone zone;
+            zone.keyLow = raw.keyLow;
+            zone.keyHigh = raw.keyHigh;
+            zone.velLow = raw.velLow;
+            zone.velHigh = raw.velHigh;
+            zone.target = raw.target;
+            for (int type = 0; type < SF_GENERATORS; type++) {
+                if (presetLevel && !isPresetGenerator(type)) {
+                    continue;
+                }
+                if (raw.set[type]) {
+                    zone.generators.append({type, raw.value[type]});
+                } else if (global.set[type]) {
+                    zone.generators.append({type, global.value[type]});
+                }
+            }
+            zone.modulators = raw.modulators;
+            for (fluid_mod_t *mod : global.modulators) {
+                bool overridden = false;
+                for (fluid_mod_t *local : raw.modulators) {
+                    overridden = overridden || fluid_mod_test_identity(mod, local);
+                }
+                if (!overridden) {
+                    zone.modulators.append(mod);
+                }
+            }
+            zones->append(zone);
+        }
+        return true;
+    };
+
+    // Instruments
+    font->instruments.resize(instrumentCount);
+    for (int i = 0; i < instrumentCount; i++) {
+        int firstBag = readU16(inst.record(i, 22) + 20);
+        int lastBag = readU16(inst.record(i + 1, 22) + 20);
+        if (firstBag > lastBag || !readZones(instrumentChunks, firstBag, lastBag, false, sampleCount,
+                                             &font->instruments[i].zones)) {
+            return fail();
+        }
+    }
+
+    // Presets
+    font->presets.resize(presetCount);
+    for (int i = 0; i < presetCount; i++) {
+        const uchar *record = phdr.record(i, 38);
+        Font::Preset &preset = font->presets[i];
+        preset.name = QByteArray(reinterpret_cast<const char *>(record), int(qstrnlen(reinterpret_cast<const char *>(record), 20)));
+        preset.program = readU16(record + 20);
+        preset.bank = readU16(record + 22);
+        int firstBag = readU16(record + 24);
+        int lastBag = readU16(phdr.record(i + 1, 38) + 24);
+        if (firstBag > lastBag || !readZones(presetChunks, firstBag, lastBag, true, instrumentCount, &preset.zones)) {
+            return fail();
+        }
+        int key = preset.bank * 256 + preset.program;
+        if (!font->presetIndex.contains(key)) {
+            font->presetIndex.insert(key, i);
+        }
+    }
+
+    if (unsupported) {
+        qDebug() << "SoundFontCache:" << font->path << "uses SF2.04 modulators, loading it with FluidSynth's loader";
+        return fail();
+    }
+    return font;
+}
+
+void SoundFontCache::releaseFont(Font *font) {
+    // _mutex is held
+    font->users--;
+    if (font->users == 0 && _staleFonts.removeOne(font)) {
+        deleteFont(font);
+    }
+}
+
+void SoundFontCache::deleteFont(Font *font) {
+    // _mutex is held
+    for (fluid_mod_t *mod : font->modulators) {
+        delete_fluid_mod(mod);
+    }
+    releaseHandle(font->handle);
+    delete font;
+}
+
+void SoundFontCache::retire(SynthFont *synthFont) {
+    QMutexLocker locker(&_mutex);
+    Loader *loader = synthFont->loader;
+    if (loader->alive) {
+        loader->retired.append(synthFont);
+    } else {
+        deleteSynthFont(synthFont);
+        releaseLoader(loader);
+    }
+}
+
+void SoundFontCache::deleteSynthFont(SynthFont *synthFont) {
+    // _mutex is held
+    for (fluid_sample_t *sample : synthFont->samples) {
+        if (sample) {
+            delete_fluid_sample(sample);
+        }
+    }
+    releaseFont(synthFont->font);
+    synthFont->loader->fonts--;
+    delete synthFont;
+}
+
+void SoundFontCache::releaseLoader(Loader *loader) {
+    // _mutex is held
+    if (!loader->alive && loader->fonts == 0) {
+        delete loader;
+    }
+}
+
+void *SoundFontCache::fileOpen(const char *filename) {
+    return instance()->openHandle(QString::fromUtf8(filename));
+}
+
+int SoundFontCache::fileRead(void *buf, fluid_long_long_t count, void *handle) {
+    Handle *h = static_cast<Handle *>(handle);
+    if (count < 0) {
+        return FLUID_FAILED;
+    }
+    if (h->fallback) {
+        return h->fallback->read(static_cast<char *>(buf), count) == count ? FLUID_OK : FLUID_FAILED;
+    }
+    if (h->pos < 0 || h->entry->size - h->pos < count) {
+        return FLUID_FAILED;
+    }
+    std::memcpy(buf, h->entry->data + h->pos, size_t(count));
+    h->pos += count;
+    return FLUID_OK;
+}
+
+int SoundFontCache::fileSeek(void *handle, fluid_long_long_t offset, int origin) {
+    Handle *h = static_cast<Handle *>(handle);
+    qint64 size = h->fallback ? h->fallback->size() : h->entry->size;
+    qint64 current = h->fallback ? h->fallback->pos() : h->pos;
+    qint64 pos;
+    switch (origin) {
+        case SEEK_SET:
+            pos = offset;
+            break;
+        case SEEK_CUR:
+            pos = current + offset;
+            break;
+        case SEEK_END:
+            pos = size + offset;
+            break;
+        default:
+            return FLUID_FAILED;
+    }
+    if (pos < 0 || pos > size) {
+        return FLUID_FAILED;
+    }
+    if (h->fallback) {
+        return h->fallback->seek(pos) ? FLUID_OK : FLUID_FAILED;
+    }
+    h->pos = pos;
+    return FLUID_OK;
+}
+
+fluid_long_long_t SoundFontCache::fileTell(void *handle) {
+    Handle *h = static_cast<Handle *>(handle);
+    return h->fallback ? h->fallback->pos() : h->pos;
+}
+
+int SoundFontCache::fileClose(void *handle) {
+    instance()->closeHandle(static_cast<Handle *>(handle));
+    return FLUID_OK;
+}
+
+fluid_sfont_t *SoundFontCache::loadFont(fluid_sfloader_t *loader, const char *filename) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // SF2 samples are little endian and are used in place
+    Q_UNUSED(loader);
+    Q_UNUSED(filename);
+    return nullptr;
+#else
+    SoundFontCache *cache = instance();
+    Font *font = cache->acquireFont(QString::fromUtf8(filename));
+    if (!font) {
+        // the next loader gets the file
+        return nullptr;
+    }
+
+    SynthFont *synthFont = new SynthFont;
+    synthFont->font = font;
+    synthFont->loader = static_cast<Loader *>(fluid_sfloader_get_data(loader));
+    synthFont->name = QByteArray(filename);
+    synthFont->iteration = 0;
+    {
+        QMutexLocker locker(&cache->_mutex);
+        synthFont->loader->fonts++;
+    }
+
+    // Descriptors of this synth pointing at the shared sample data
+    synthFont->samples.reserve(font->samples.size());
+    for (const Font::Sample &sample : font->samples) {
+        fluid_sample_t *descriptor = sample.data ? new_fluid_sample() : nullptr;
+        if (descriptor) {
+            fluid_sample_set_name(descriptor, sample.name.constData());
+            if (fluid_sample_set_sound_data(descriptor, const_cast<short *>(sample.data), const_cast<char *>(sample.data24),
+                                            sample.frames, sample.rate, 0) == FLUID_OK) {
+                fluid_sample_set_loop(descriptor, sample.loopStart, sample.loopEnd);
+                fluid_sample_set_pitch(descriptor, sample.rootKey, sample.correction);
+                fluid_voice_optimize_sample(descriptor);
+            } else {
+                delete_fluid_sample(descriptor);
+                descriptor = nullptr;
+            }
+        }
+        synthFont->samples.append(descriptor);
+    }
+
+    fluid_sfont_t *sfont = new_fluid_sfont(fontName, fontPreset, fontIterationStart, fontIterationNext, freeFont);
+    if (!sfont) {
+        QMutexLocker locker(&cache->_mutex);
+        cache->deleteSynthFont(synthFont);
+        return nullptr;
+    }
+    fluid_sfont_set_data(sfont, synthFont);
+
+    synthFont->presets.reserve(font->presets.size());
+    for (const Font::Preset &preset : font->presets) {
+        fluid_preset_t *p = new_fluid_preset(sfont, presetName, presetBank, presetNumber, presetNoteOn, delete_fluid_preset);
+        if (p) {
+            fluid_preset_set_data(p, const_cast<Font::Preset *>(&preset));
+        }
+        synthFont->presets.append(p);
+    }
+    return sfont;
+#endif
+}
+
+void SoundFontCache::freeLoader(fluid_sfloader_t *loader) {
+    Loader *state = static_cast<Loader *>(fluid_sfloader_get_data(loader));
+    if (state) {
+        // The synth is being deleted and its voices are off
+        SoundFontCache *cache = instance();
+        QMutexLocker locker(&cache->_mutex);
+        state->alive = false;
+        for (SynthFont *synthFont : state->retired) {
+            cache->deleteSynthFont(synthFont);
+        }
+        state->retired.clear();
+        cache->releaseLoader(state);
+    }
+    delete_fluid_sfloader(loader);
+}
+
+const char *SoundFontCache::fontName(fluid_sfont_t *sfont) {
+    return static_cast<SynthFont *>(fluid_sfont_get_data(sfont))->name.constData();
+}
+
+fluid_preset_t *SoundFontCache::fontPreset(fluid_sfont_t *sfont, int bank, int program) {
+    const SynthFont *synthFont = static_cast<SynthFont *>(fluid_sfont_get_data(sfont));
+    int index = synthFont->font->presetIndex.value(bank * 256 + program, -1);
+    return index >= 0 ? synthFont->presets.at(index) : nullptr;
+}
+
+void SoundFontCache::fontIterationStart(fluid_sfont_t *sfont) {
+    static_cast<SynthFont *>(fluid_sfont_get_data(sfont))->iteration = 0;
+}
+
+fluid_preset_t *SoundFontCache::fontIterationNext(fluid_sfont_t *sfont) {
+    SynthFont *synthFont = static_cast<SynthFont *>(fluid_sfont_get_data(sfont));
+    while (synthFont->iteration < synthFont->presets.size()) {
+        fluid_preset_t *preset = synthFont->presets.at(synthFont->iteration++);
+        if (preset) {
+            return preset;
+        }
+    }
+    return nullptr;
+}
+
+int SoundFontCache::freeFont(fluid_sfont_t *sfont) {
+    SynthFont *synthFont = static_cast<SynthFont *>(fluid_sfont_get_data(sfont));
+    for (fluid_preset_t *preset : synthFont->presets) {
+        if (preset) {
+            delete_fluid_preset(preset);
+        }
+    }
+    synthFont->presets.clear();
+    delete_fluid_sfont(sfont);
+
+    // Voices of this font may still be releasing; the sample descriptors
+    // are deleted with the synth
+    instance()->retire(synthFont);
+    return 0;
+}
+
+const char *SoundFontCache::presetName(fluid_preset_t *preset) {
+    return static_cast<const Font::Preset *>(fluid_preset_get_data(preset))->name.constData();
+}
+
+int SoundFontCache::presetBank(fluid_preset_t *preset) {
+    return static_cast<const Font::Preset *>(fluid_preset_get_data(preset))->bank;
+}
+
+int SoundFontCache::presetNumber(fluid_preset_t *preset) {
+    return static_cast<const Font::Preset *>(fluid_preset_get_data(preset))->program;
+}
+
+int SoundFontCache::presetNoteOn(fluid_preset_t *preset, fluid_synth_t *synth, int channel, int key, int velocity) {
+    const Font::Preset *p = static_cast<const Font::Preset *>(fluid_preset_get_data(preset));
+    const SynthFont *synthFont = static_cast<SynthFont *>(fluid_sfont_get_data(fluid_preset_get_sfont(preset)));
+    const Font *font = synthFont->font;
+
+    for (const Font::Zone &presetZone : p->zones) {
+        if (!presetZone.contains(key, velocity)) {
+            continue;
+        }
+        const Font::Instrument &instrument = font->instruments.at(presetZone.target);
+        for (const Font::Zone &zone : instrument.zones) {
+            if (!zone.contains(key, velocity)) {
+                continue;
+            }
+            fluid_sample_t *sample = synthFont->samples.at(zone.target);
+            if (!sample) {
+                continue;
+            }
+            fluid_voice_t *voice = fluid_synth_alloc_voice(synth, sample, channel, key, velocity);
+            if (!voice) {
+                return FLUID_FAILED;
+            }
+
+            // Instrument generators are absolute and its modulators replace
+            // the default ones; preset generators and modulators are added
+            // on top (SF2.01 9.4, 9.5)
+            for (const Font::Generator &generator : zone.generators) {
+                fluid_voice_gen_set(voice, generator.type, generator.amount);
+            }
+            for (fluid_mod_t *mod : zone.modulators) {
+                fluid_voice_add_mod(voice, mod, FLUID_VOICE_OVERWRITE);
+            }
+            for (const Font::Generator &generator : presetZone.generators) {
+                fluid_voice_gen_incr(voice, generator.type, generator.amount);
+            }
+            for (fluid_mod_t *mod : presetZone.modulators) {
+                fluid_voice_add_mod(voice, mod, FLUID_VOICE_ADD);
+            }
+            fluid_synth_start_voice(synth, voice);
+        }
+    }
+    return FLUID_OK;
+}
+
+#endif // FLUIDSYNTH_SUPPORT
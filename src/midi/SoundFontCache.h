@@ -0,0 +1,187 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOUNDFONTCACHE_H_
+#define SOUNDFONTCACHE_H_
+
+#ifdef FLUIDSYNTH_SUPPORT
+
+// Qt includes
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <fluidsynth.h>
+
+// Forward declarations
+class QFile;
+
+/**
+ * \class SoundFontCache
+ *
+ * \brief Process wide cache of parsed SoundFonts shared by all FluidSynth synths.
+ *
+ * The live synth, the synth that loads a new SoundFont stack and every export,
+ * stem or slice synth load the same files. install() adds two SoundFont
+ * loaders to a synth:
+ *
+ * - The shared loader parses an SF2 file once per process. Presets,
+ *   instruments, zones and modulators are kept in one immutable Font that
+ *   every synth reads, and the sample data is never copied: every synth gets
+ *   a lightweight fluid_sfont_t whose samples point into the memory mapped
+ *   file (fluid_sample_set_sound_data() without copying). The mapped pages
+ *   are read on demand and held once by the operating system no matter how
+ *   many synths play them.
+ * - Files the shared loader does not handle (SF3 with compressed samples,
+ *   DLS, SF2.04 modulator features FluidSynth's public API cannot express)
+ *   go to FluidSynth's own loader, which reads them through the same
+ *   mapping, so repeated loads still do not touch the disk.
+ *
+ * Voices keep pointers to the sample descriptors of their synth; a synth's
+ * descriptors are therefore only deleted with the synth, not when one of its
+ * SoundFonts is unloaded while notes may still be releasing.
+ *
+ * Entries are keyed by canonical path and invalidated by modification time and
+ * size: a file that changed on disk is parsed and mapped again on its next
+ * load, while synths still using the old data keep it until they release it.
+ */
+class SoundFontCache {
+public:
+    /**
+     * \brief Gets the single cache instance.
+     */
+    static SoundFontCache *instance();
+
+    /**
+     * \brief Adds the cached SoundFont loader to a synth.
+     *
+     * The loader is tried before FluidSynth's default loader; files it cannot
+     * parse (e.g. DLS) still go to the loaders FluidSynth installed itself.
+     * The synth owns and deletes the loader.
+     */
+    void install(fluid_synth_t *synth);
+
+    /**
+     * \brief Parses a file into the cache ahead of loading it into a synth.
+     *
+     * Loading a prepared file only creates the synth's sample descriptors
+     * and presets, which is quick enough to be done on a playing synth.
+     * \return True if the shared loader serves the file, false if it goes
+     *         to FluidSynth's own loader, which reads all sample data
+     */
+    bool prepare(const QString &path);
+
+    /**
+     * \brief Drops the parsed fonts and mappings of all files not in paths
+     * that are not used by any synth.
+     */
+    void retain(const QStringList &paths);
+
+private:
+    SoundFontCache();
+
+    // Non-copyable
+    SoundFontCache(const SoundFontCache &) = delete;
+    SoundFontCache &operator=(const SoundFontCache &) = delete;
+
+    /**
+     * \brief A mapped file.
+     */
+    struct Entry {
+        QString path;
+        QDateTime modified;
+        qint64 size;
+        QFile *file;
+        const uchar *data;
+        int handles;
+    };
+
+    /**
+     * \brief One open file of a loader, with its own read position.
+     *
+     * Files that cannot be mapped are read through a file of their own.
+     */
+    struct Handle {
+        Entry *entry;
+        QFile *fallback;
+        qint64 pos;
+    };
+
+    /** \brief A parsed SF2 file shared by all synths (see SoundFontCache.cpp) */
+    struct Font;
+
+    /** \brief The fluid_sfont_t data of a Font loaded into one synth */
+    struct SynthFont;
+
+    /** \brief The fluid_sfloader_t data of the shared loader of one synth */
+    struct Loader;
+
+    Handle *openHandle(const QString &path);
+    void closeHandle(Handle *handle);
+    void releaseHandle(Handle *handle);
+    void deleteEntry(Entry *entry);
+
+    Font *acquireFont(const QString &path);
+    Font *parseFont(Handle *handle);
+    void releaseFont(Font *font);
+    void deleteFont(Font *font);
+    void retire(SynthFont *synthFont);
+    void deleteSynthFont(SynthFont *synthFont);
+    void releaseLoader(Loader *loader);
+
+    // fluid_sfloader file callbacks
+    static void *fileOpen(const char *filename);
+    static int fileRead(void *buf, fluid_long_long_t count, void *handle);
+    static int fileSeek(void *handle, fluid_long_long_t offset, int origin);
+    static fluid_long_long_t fileTell(void *handle);
+    static int fileClose(void *handle);
+
+    // Shared loader callbacks
+    static fluid_sfont_t *loadFont(fluid_sfloader_t *loader, const char *filename);
+    static void freeLoader(fluid_sfloader_t *loader);
+    static const char *fontName(fluid_sfont_t *sfont);
+    static fluid_preset_t *fontPreset(fluid_sfont_t *sfont, int bank, int program);
+    static void fontIterationStart(fluid_sfont_t *sfont);
+    static fluid_preset_t *fontIterationNext(fluid_sfont_t *sfont);
+    static int freeFont(fluid_sfont_t *sfont);
+    static const char *presetName(fluid_preset_t *preset);
+    static int presetBank(fluid_preset_t *preset);
+    static int presetNumber(fluid_preset_t *preset);
+    static int presetNoteOn(fluid_preset_t *preset, fluid_synth_t *synth, int channel, int key, int velocity);
+
+    QMutex _mutex;
+
+    /** \brief Current entries by canonical path */
+    QHash<QString, Entry *> _entries;
+
+    /** \brief Replaced entries still read by a synth */
+    QList<Entry *> _stale;
+
+    /** \brief Parsed fonts by canonical path */
+    QHash<QString, Font *> _fonts;
+
+    /** \brief Replaced fonts still used by a synth */
+    QList<Font *> _staleFonts;
+};
+
+#endif // FLUIDSYNTH_SUPPORT
+
+#endif // SOUNDFONTCACHE_H_
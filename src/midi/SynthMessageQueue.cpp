@@ -0,0 +1,89 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SynthMessageQueue.h"
+
+SynthMessageQueue::SynthMessageQueue(int capacity) {
+    quint32 size = 16;
+    while (size < quint32(capacity) && size < (1u << 24)) {
+        size <<= 1;
+    }
+    _slots = new Slot[size];
+    for (quint32 i = 0; i < size; i++) {
+        _slots[i].sequence = i;
+        _slots[i].length = 0;
+    }
+    _mask = size - 1;
+    _enqueuePos = 0;
+    _dequeuePos = 0;
+    _dropped = 0;
+}
+
+SynthMessageQueue::~SynthMessageQueue() {
+    delete[] _slots;
+}
+
+bool SynthMessageQueue::push(const quint8 *data, int length) {
+    if (length < 1 || length > 3) {
+        return false;
+    }
+
+    // a slot is free for position pos if its sequence is pos
+    quint32 pos = _enqueuePos.loadRelaxed();
+    Slot *slot;
+    forever {
+        slot = &_slots[pos & _mask];
+        qint32 diff = qint32(slot->sequence.loadAcquire() - pos);
+        if (diff == 0) {
+            if (_enqueuePos.testAndSetRelaxed(pos, pos + 1, pos)) {
+                break;
+            }
+        } else if (diff < 0) {
+            _dropped.fetchAndAddRelaxed(1);
+            return false;
+        } else {
+            pos = _enqueuePos.loadRelaxed();
+        }
+    }
+
+    slot->length = quint8(length);
+    for (int i = 0; i < length; i++) {
+        slot->data[i] = data[i];
+    }
+    slot->sequence.storeRelease(pos + 1);
+    return true;
+}
+
+bool SynthMessageQueue::pop(quint8 *data, int *length) {
+    Slot *slot = &_slots[_dequeuePos & _mask];
+    if (qint32(slot->sequence.loadAcquire() - (_dequeuePos + 1)) < 0) {
+        return false;
+    }
+
+    *length = slot->length;
+    for (int i = 0; i < slot->length; i++) {
+        data[i] = slot->data[i];
+    }
+    slot->sequence.storeRelease(_dequeuePos + _mask + 1);
+    _dequeuePos++;
+    return true;
+}
+
+int SynthMessageQueue::dropped() const {
+    return _dropped.loadRelaxed();
+}
@@ -0,0 +1,99 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTHMESSAGEQUEUE_H_
+#define SYNTHMESSAGEQUEUE_H_
+
+// Qt includes
+#include <QAtomicInteger>
+#include <QtGlobal>
+
+/**
+ * \class SynthMessageQueue
+ *
+ * \brief Bounded lock-free queue of MIDI short messages.
+ *
+ * Any number of threads may push() (the player, MIDI thru, the GUI), one
+ * thread pops. Every slot holds one message of up to 3 bytes and a sequence
+ * number; a producer claims a slot with a single compare-and-swap and
+ * publishes it with the sequence number, so a producer never waits for
+ * another thread or a lock. If the queue is full, push() fails and the
+ * message is counted (see dropped()); the caller decides whether to deliver
+ * it in another way.
+ */
+class SynthMessageQueue {
+public:
+    /**
+     * \brief Creates a queue of at least capacity slots.
+     * \param capacity Number of slots, rounded up to a power of two
+     */
+    explicit SynthMessageQueue(int capacity);
+
+    /**
+     * \brief Deletes the slots.
+     */
+    ~SynthMessageQueue();
+
+    /**
+     * \brief Appends a message (any thread).
+     * \param data Message bytes
+     * \param length Number of bytes (1 to 3)
+     * \return False if the queue is full or the message is not a short message
+     */
+    bool push(const quint8 *data, int length);
+
+    /**
+     * \brief Takes the oldest message (one thread at a time).
+     * \param data Receives the message bytes (3 bytes)
+     * \param length Receives the number of bytes
+     * \return False if the queue is empty
+     */
+    bool pop(quint8 *data, int *length);
+
+    /**
+     * \brief Gets the number of dropped messages.
+     */
+    int dropped() const;
+
+private:
+    /**
+     * \brief One message with the sequence number used for publishing it.
+     */
+    struct Slot {
+        QAtomicInteger<quint32> sequence;
+        quint8 length;
+        quint8 data[3];
+    };
+
+    /** \brief The slots */
+    Slot *_slots;
+
+    /** \brief Number of slots - 1 */
+    quint32 _mask;
+
+    /** \brief Next position to push */
+    QAtomicInteger<quint32> _enqueuePos;
+
+    /** \brief Next position to pop (consumer only) */
+    quint32 _dequeuePos;
+
+    /** \brief Number of dropped messages */
+    QAtomicInteger<int> _dropped;
+};
+
+#endif // SYNTHMESSAGEQUEUE_H_
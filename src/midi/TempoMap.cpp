@@ -0,0 +1,119 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TempoMap.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/TempoChangeEvent.h"
+
+#include <algorithm>
+
+TempoMap::TempoMap() {
+}
+
+void TempoMap::rebuild(const QList<MidiEvent *> &sortedEvents) {
+    _segments.clear();
+    _segments.reserve(sortedEvents.size());
+
+    // Accumulate in the same order as the former linear scans did, so the
+    // results are bit-identical to them.
+    double timeMs = 0;
+    for (MidiEvent *event : sortedEvents) {
+        TempoChangeEvent *ev = dynamic_cast<TempoChangeEvent *>(event);
+        if (!ev) {
+            continue;
+        }
+        if (!_segments.isEmpty()) {
+            const Segment &last = _segments.last();
+            timeMs += last.msPerTick * (ev->midiTime() - last.tick);
+        }
+        Segment segment;
+        segment.tick = ev->midiTime();
+        segment.ms = timeMs;
+        segment.msPerTick = ev->msPerTick();
+        segment.event = ev;
+        _segments.append(segment);
+    }
+}
+
+bool TempoMap::isEmpty() const {
+    return _segments.isEmpty();
+}
+
+int TempoMap::size() const {
+    return _segments.size();
+}
+
+int TempoMap::segmentAtTick(int tick) const {
+    if (_segments.isEmpty()) {
+        return -1;
+    }
+    // last segment starting at or before tick
+    auto it = std::upper_bound(_segments.constBegin(), _segments.constEnd(), tick,
+                               [](int t, const Segment &s) { return t < s.tick; });
+    if (it == _segments.constBegin()) {
+        return 0;
+    }
+    return int(it - _segments.constBegin()) - 1;
+}
+
+int TempoMap::segmentAtMs(double ms) const {
+    if (_segments.isEmpty()) {
+        return -1;
+    }
+    auto it = std::upper_bound(_segments.constBegin(), _segments.constEnd(), ms,
+                               [](double t, const Segment &s) { return t < s.ms; });
+    if (it == _segments.constBegin()) {
+        return 0;
+    }
+    return int(it - _segments.constBegin()) - 1;
+}
+
+double TempoMap::msOfTick(int tick) const {
+    int i = segmentAtTick(tick);
+    if (i < 0) {
+        return 0;
+    }
+    const Segment &s = _segments.at(i);
+    return s.ms + s.msPerTick * (tick - s.tick);
+}
+
+int TempoMap::tick(double ms) const {
+    int i = segmentAtMs(ms);
+    if (i < 0) {
+        return 0;
+    }
+    const Segment &s = _segments.at(i);
+    return (ms - s.ms) / s.msPerTick + s.tick;
+}
+
+int TempoMap::startTick(int segment) const {
+    return _segments.at(segment).tick;
+}
+
+double TempoMap::startMs(int segment) const {
+    return _segments.at(segment).ms;
+}
+
+double TempoMap::msPerTick(int segment) const {
+    return _segments.at(segment).msPerTick;
+}
+
+TempoChangeEvent *TempoMap::event(int segment) const {
+    return _segments.at(segment).event;
+}
@@ -0,0 +1,131 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEMPOMAP_H_
+#define TEMPOMAP_H_
+
+// Qt includes
+#include <QList>
+#include <QVector>
+
+// Forward declarations
+class MidiEvent;
+class TempoChangeEvent;
+
+/**
+ * \class TempoMap
+ *
+ * \brief Precomputed tempo segment table for tick <-> millisecond conversion.
+ *
+ * Every TempoChangeEvent of channel 17 starts a segment. For each segment the
+ * table stores its start tick, the cumulative time in milliseconds at that
+ * tick and the segment's ms per tick. Conversions in both directions are
+ * binary searches over this table, so they cost O(log T) for T tempo changes
+ * instead of a full rescan of the tempo channel.
+ *
+ * TempoMap is a value type backed by an implicitly shared QVector, so copies
+ * are cheap and can be used as immutable snapshots outside of MidiFile's lock.
+ */
+class TempoMap {
+public:
+    /**
+     * \brief Creates an empty TempoMap.
+     */
+    TempoMap();
+
+    /**
+     * \brief Rebuilds the table from the tempo channel.
+     * \param sortedEvents Events of channel 17 in playback order (same-tick
+     *        events in insertion order, as returned by MidiChannel::sortedEvents())
+     */
+    void rebuild(const QList<MidiEvent *> &sortedEvents);
+
+    /**
+     * \brief Returns true if the table contains no tempo segments.
+     */
+    bool isEmpty() const;
+
+    /**
+     * \brief Returns the number of tempo segments.
+     */
+    int size() const;
+
+    /**
+     * \brief Converts a tick to milliseconds.
+     * \param tick Time in MIDI ticks
+     * \return Time in milliseconds (unrounded)
+     */
+    double msOfTick(int tick) const;
+
+    /**
+     * \brief Converts milliseconds to a tick.
+     * \param ms Time in milliseconds
+     * \return Time in MIDI ticks
+     */
+    int tick(double ms) const;
+
+    /**
+     * \brief Returns the index of the segment active at the given tick.
+     *
+     * Ticks before the first tempo change map to segment 0.
+     * \return Segment index, or -1 if the table is empty
+     */
+    int segmentAtTick(int tick) const;
+
+    /**
+     * \brief Returns the index of the segment active at the given time.
+     * \return Segment index, or -1 if the table is empty
+     */
+    int segmentAtMs(double ms) const;
+
+    /**
+     * \brief Gets the start tick of a segment.
+     */
+    int startTick(int segment) const;
+
+    /**
+     * \brief Gets the cumulative time of a segment start in milliseconds.
+     */
+    double startMs(int segment) const;
+
+    /**
+     * \brief Gets the milliseconds per tick of a segment.
+     */
+    double msPerTick(int segment) const;
+
+    /**
+     * \brief Gets the TempoChangeEvent that starts a segment.
+     */
+    TempoChangeEvent *event(int segment) const;
+
+private:
+    /**
+     * \brief One row of the tempo table.
+     */
+    struct Segment {
+        int tick;
+        double ms;
+        double msPerTick;
+        TempoChangeEvent *event;
+    };
+
+    /** \brief Segments sorted by tick (and therefore by ms) */
+    QVector<Segment> _segments;
+};
+
+#endif // TEMPOMAP_H_
@@ -0,0 +1,153 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TrackEventIndex.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../MidiEvent/ProgChangeEvent.h"
+#include "MidiChannel.h"
+#include "MidiFile.h"
+
+#include <algorithm>
+
+TrackEventIndex::TrackEventIndex() {
+}
+
+void TrackEventIndex::update(MidiFile *file) {
+    bool programsChanged = false;
+    for (int ch = 0; ch < 19; ch++) {
+        ChannelEvents &channel = _channels[ch];
+        quint64 stamp = file->channel(ch)->eventMap()->stamp();
+        if (channel.dirty || channel.stamp != stamp) {
+            buildChannel(file, ch);
+            channel.stamp = stamp;
+            channel.dirty = false;
+            programsChanged = programsChanged || ch < 16;
+        }
+    }
+    if (programsChanged) {
+        buildPrograms();
+    }
+}
+
+void TrackEventIndex::invalidate(int channel) {
+    if (channel < 0) {
+        for (int ch = 0; ch < 19; ch++) {
+            _channels[ch].dirty = true;
+        }
+    } else if (channel < 19) {
+        _channels[channel].dirty = true;
+    }
+}
+
+void TrackEventIndex::buildChannel(MidiFile *file, int ch) {
+    ChannelEvents &channel = _channels[ch];
+    channel.tracks.clear();
+    channel.programs.clear();
+
+    MidiTrack *lastTrack = 0;
+    QList<MidiEvent *> *current = 0;
+    EventMap *map = file->channel(ch)->eventMap();
+    for (auto it = map->constBegin(); it != map->constEnd(); ++it) {
+        MidiEvent *event = it.value();
+        MidiTrack *track = event->track();
+        if (!current || track != lastTrack) {
+            current = &channel.tracks[track];
+            lastTrack = track;
+        }
+        current->append(event);
+
+        if (ch < 16 && event->line() == MidiEvent::PROG_CHANGE_LINE) {
+            ProgChangeEvent *prog = dynamic_cast<ProgChangeEvent *>(event);
+            if (prog) {
+                channel.programs[track].append({it.key(), ch, prog->program()});
+            }
+        }
+    }
+}
+
+void TrackEventIndex::buildPrograms() {
+    _programs.clear();
+    for (int ch = 0; ch < 16; ch++) {
+        const QHash<MidiTrack *, QVector<ProgramChange> > &programs = _channels[ch].programs;
+        for (auto it = programs.constBegin(); it != programs.constEnd(); ++it) {
+            TrackPrograms &track = _programs[it.key()];
+            if (track.firstProgram < 0 && !it.value().isEmpty()) {
+                track.firstProgram = it.value().first().program;
+            }
+            track.changes.append(it.value());
+        }
+    }
+
+    // the changes were collected by channel; on equal ticks the lowest
+    // channel and within a channel the last change has to end up last
+    auto before = [](const ProgramChange &a, const ProgramChange &b) {
+        if (a.tick != b.tick) {
+            return a.tick < b.tick;
+        }
+        return a.channel > b.channel;
+    };
+    for (auto it = _programs.begin(); it != _programs.end(); ++it) {
+        QVector<ProgramChange> &changes = it.value().changes;
+        std::stable_sort(changes.begin(), changes.end(), before);
+    }
+}
+
+QList<MidiEvent *> TrackEventIndex::events(MidiTrack *track) const {
+    QList<MidiEvent *> result;
+    result.reserve(count(track));
+    for (int ch = 0; ch < 19; ch++) {
+        auto it = _channels[ch].tracks.constFind(track);
+        if (it != _channels[ch].tracks.constEnd()) {
+            result.append(it.value());
+        }
+    }
+    return result;
+}
+
+QList<MidiEvent *> TrackEventIndex::events(MidiTrack *track, int channel) const {
+    if (channel < 0 || channel >= 19) {
+        return QList<MidiEvent *>();
+    }
+    return _channels[channel].tracks.value(track);
+}
+
+int TrackEventIndex::count(MidiTrack *track) const {
+    int n = 0;
+    for (int ch = 0; ch < 19; ch++) {
+        auto it = _channels[ch].tracks.constFind(track);
+        if (it != _channels[ch].tracks.constEnd()) {
+            n += it.value().size();
+        }
+    }
+    return n;
+}
+
+int TrackEventIndex::programAt(MidiTrack *track, int tick) const {
+    auto it = _programs.constFind(track);
+    if (it == _programs.constEnd()) {
+        return -1;
+    }
+    const QVector<ProgramChange> &programs = it.value().changes;
+    auto after = std::upper_bound(programs.constBegin(), programs.constEnd(), tick,
+                                  [](int t, const ProgramChange &change) { return t < change.tick; });
+    if (after == programs.constBegin()) {
+        return it.value().firstProgram;
+    }
+    return (after - 1)->program;
+}
@@ -0,0 +1,157 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACKEVENTINDEX_H_
+#define TRACKEVENTINDEX_H_
+
+// Qt includes
+#include <QHash>
+#include <QList>
+#include <QVector>
+
+// Forward declarations
+class MidiEvent;
+class MidiFile;
+class MidiTrack;
+
+/**
+ * \class TrackEventIndex
+ *
+ * \brief The events of a file grouped by their track.
+ *
+ * Events are stored by channel, but many operations work on one track:
+ * selecting, clearing, cloning or merging a track, saving (events are
+ * written track by track) and looking up the program of a track. Without an
+ * index each of them has to scan every channel and compare event->track().
+ *
+ * TrackEventIndex lists the events of every track per channel, in the order
+ * of the channel's EventMap, and keeps a timeline of the program changes of
+ * every track. The index is kept per channel: update() only rescans the
+ * channels whose EventMap changed (see EventMap::stamp()) or which were
+ * invalidated because the track or program of one of their events changed
+ * in place. An edit therefore costs one scan of the edited channel, and
+ * track-scoped code only touches the events of the track.
+ */
+class TrackEventIndex {
+public:
+    /**
+     * \brief Creates an empty index.
+     */
+    TrackEventIndex();
+
+    /**
+     * \brief Brings the index up to date with the channels of file.
+     *
+     * Channels that did not change since the last update are not scanned.
+     */
+    void update(MidiFile *file);
+
+    /**
+     * \brief Marks a channel as changed although its EventMap is unchanged.
+     * \param channel The channel, or -1 for all channels
+     */
+    void invalidate(int channel);
+
+    /**
+     * \brief Gets the events of a track, channel by channel (0 to 18), each
+     * channel in map order.
+     */
+    QList<MidiEvent *> events(MidiTrack *track) const;
+
+    /**
+     * \brief Gets the events of a track in one channel in map order.
+     */
+    QList<MidiEvent *> events(MidiTrack *track, int channel) const;
+
+    /**
+     * \brief Gets the number of events of a track.
+     */
+    int count(MidiTrack *track) const;
+
+    /**
+     * \brief Gets the program of a track at a tick.
+     *
+     * This is the last program change of the track at or before tick in
+     * channels 0-15; on equal ticks the lowest channel wins. Before its
+     * first program change, a track uses the first program change found in
+     * channel order.
+     *
+     * \return The program, or -1 if the track has no program changes
+     */
+    int programAt(MidiTrack *track, int tick) const;
+
+private:
+    /**
+     * \brief A program change on the timeline of a track.
+     */
+    struct ProgramChange {
+        int tick;
+        int channel;
+        int program;
+    };
+
+    /**
+     * \brief Everything indexed for one channel.
+     */
+    struct ChannelEvents {
+        /** \brief Events per track in map order */
+        QHash<MidiTrack *, QList<MidiEvent *> > tracks;
+
+        /** \brief Program changes per track in map order */
+        QHash<MidiTrack *, QVector<ProgramChange> > programs;
+
+        /** \brief Stamp of the EventMap the channel was scanned from */
+        quint64 stamp;
+
+        /** \brief True if the channel has to be scanned again */
+        bool dirty;
+
+        ChannelEvents() : stamp(0), dirty(true) {}
+    };
+
+    /**
+     * \brief The program timeline of one track.
+     */
+    struct TrackPrograms {
+        /** \brief Program changes ordered by tick, the winner of a tick last */
+        QVector<ProgramChange> changes;
+
+        /** \brief Program used before the first program change, -1 if none */
+        int firstProgram;
+
+        TrackPrograms() : firstProgram(-1) {}
+    };
+
+    /**
+     * \brief Scans one channel of file.
+     */
+    void buildChannel(MidiFile *file, int channel);
+
+    /**
+     * \brief Merges the program changes of channels 0-15 into timelines.
+     */
+    void buildPrograms();
+
+    /** \brief Indexed channels */
+    ChannelEvents _channels[19];
+
+    /** \brief Program timelines of the tracks with program changes */
+    QHash<MidiTrack *, TrackPrograms> _programs;
+};
+
+#endif // TRACKEVENTINDEX_H_
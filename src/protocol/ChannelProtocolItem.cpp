@@ -0,0 +1,119 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ChannelProtocolItem.h"
+
+#include "../MidiEvent/MidiEvent.h"
+#include "../midi/MidiChannel.h"
+#include "../midi/MidiFile.h"
+
+ChannelProtocolItem::ChannelProtocolItem(MidiChannel *channel) {
+    _channel = channel;
+    _visible = channel->_visible;
+    _mute = channel->_mute;
+    _solo = channel->_solo;
+}
+
+void ChannelProtocolItem::recordRemove(int tick, MidiEvent *event) {
+    int index = indexOf(_channel->_events, tick, event);
+    if (index >= 0) {
+        _changes.append({tick, index, event, false});
+    }
+}
+
+void ChannelProtocolItem::recordInsert(int tick, MidiEvent *event) {
+    int index = indexOf(_channel->_events, tick, event);
+    if (index >= 0) {
+        _changes.append({tick, index, event, true});
+    }
+}
+
+void ChannelProtocolItem::recordClear() {
+    const EventMap &events = *(_channel->_events);
+    _changes.reserve(_changes.size() + events.size());
+    // removed front to back, every entry is the first one at its tick
+    for (auto it = events.constBegin(); it != events.constEnd(); ++it) {
+        _changes.append({it.key(), 0, it.value(), false});
+    }
+}
+
+bool ChannelProtocolItem::isEmpty() {
+    return _changes.isEmpty() && _visible == _channel->_visible
+           && _mute == _channel->_mute && _solo == _channel->_solo;
+}
+
+ProtocolItem *ChannelProtocolItem::release() {
+    ChannelProtocolItem *inverse = new ChannelProtocolItem(_channel);
+    _channel->_visible = _visible;
+    _channel->_mute = _mute;
+    _channel->_solo = _solo;
+
+    EventMap *map = _channel->_events;
+    int num = _channel->number();
+
+    // revert the changes last to first; the inverse item records them in
+    // the order they are applied here
+    for (int i = _changes.size() - 1; i >= 0; i--) {
+        const Change &change = _changes.at(i);
+        MidiEvent *event = change.event;
+        if (change.inserted) {
+            int index = indexOf(map, change.tick, event);
+            if (index >= 0) {
+                map->remove(change.tick, event);
+                inverse->_changes.append({change.tick, index, event, false});
+            }
+        } else {
+            // keep the event's channel and tick consistent with the map key
+            if (event->channel() != num) {
+                event->setChannel(num, false);
+            }
+            if (event->midiTime() != change.tick) {
+                event->setMidiTime(change.tick, false);
+                map->remove(change.tick, event);
+            }
+            insertAt(map, change.tick, event, change.index);
+            inverse->_changes.append({change.tick, change.index, event, true});
+        }
+    }
+    return inverse;
+}
+
+qint64 ChannelProtocolItem::memoryCost() {
+    return sizeof(ChannelProtocolItem) + qint64(_changes.size()) * sizeof(Change);
+}
+
+int ChannelProtocolItem::indexOf(EventMap *map, int tick, MidiEvent *event) {
+    const EventMap &events = *map;
+    int index = 0;
+    for (auto it = events.lowerBound(tick); it != events.constEnd() && it.key() == tick; ++it, ++index) {
+        if (it.value() == event) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+void ChannelProtocolItem::insertAt(EventMap *map, int tick, MidiEvent *event, int index) {
+    const EventMap &events = *map;
+    auto pos = events.lowerBound(tick);
+    for (int i = 0; i < index && pos != events.constEnd() && pos.key() == tick; i++) {
+        ++pos;
+    }
+    // the hint is correct, so the entry is inserted directly in front of it
+    map->insert(pos, tick, event);
+}
@@ -0,0 +1,126 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHANNELPROTOCOLITEM_H_
+#define CHANNELPROTOCOLITEM_H_
+
+// Project includes
+#include "ProtocolItem.h"
+
+// Qt includes
+#include <QList>
+
+// Forward declarations
+class EventMap;
+class MidiChannel;
+class MidiEvent;
+
+/**
+ * \class ChannelProtocolItem
+ *
+ * \brief Undo/redo action recording the changes made to a MidiChannel.
+ *
+ * Instead of a copy of the channel's whole event map, ChannelProtocolItem
+ * stores the channel's flags (visible, mute, solo) from before the action and
+ * the list of entries inserted into or removed from the event map. The
+ * memory used and the time needed to undo the action are proportional to
+ * the number of changed events, not to the size of the channel.
+ *
+ * Every change stores the position of the event among the events with the
+ * same tick, so undo and redo restore the original order of simultaneous
+ * events.
+ */
+class ChannelProtocolItem : public ProtocolItem {
+public:
+    /**
+     * \brief Creates an item and stores the current flags of channel.
+     * \param channel The channel the changes are made to
+     */
+    ChannelProtocolItem(MidiChannel *channel);
+
+    /**
+     * \brief Records that event is about to be removed from the map at tick.
+     *
+     * Has to be called before the entry is removed. Nothing is recorded if
+     * the entry does not exist.
+     */
+    void recordRemove(int tick, MidiEvent *event);
+
+    /**
+     * \brief Records that event has been inserted into the map at tick.
+     *
+     * Has to be called after the entry has been inserted.
+     */
+    void recordInsert(int tick, MidiEvent *event);
+
+    /**
+     * \brief Records that all entries are about to be removed from the map.
+     */
+    void recordClear();
+
+    /**
+     * \brief Returns true if the item does not change anything.
+     */
+    bool isEmpty();
+
+    /**
+     * \brief Restores the recorded state of the channel.
+     * \return The inverse ChannelProtocolItem
+     */
+    ProtocolItem *release();
+
+    /**
+     * \brief Gets the approximate memory used by this item in bytes.
+     */
+    qint64 memoryCost();
+
+    /**
+     * \brief Gets the position of event among the entries at tick.
+     * \return The position, or -1 if the entry does not exist
+     */
+    static int indexOf(EventMap *map, int tick, MidiEvent *event);
+
+    /**
+     * \brief Inserts event at position index among the entries at tick.
+     *
+     * Positions behind the last entry append the event.
+     */
+    static void insertAt(EventMap *map, int tick, MidiEvent *event, int index);
+
+private:
+    /**
+     * \brief A single change of the event map.
+     */
+    struct Change {
+        int tick;
+        int index;
+        MidiEvent *event;
+        bool inserted;
+    };
+
+    /** \brief The changed channel */
+    MidiChannel *_channel;
+
+    /** \brief The channel flags from before the action */
+    bool _visible, _mute, _solo;
+
+    /** \brief The changes in the order they were made */
+    QList<Change> _changes;
+};
+
+#endif // CHANNELPROTOCOLITEM_H_
@@ -0,0 +1,38 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EventBatchProtocolItem.h"
+
+EventBatchProtocolItem::EventBatchProtocolItem(MidiFile *file, const QVector<EventEditBatch::State> &states) {
+    _file = file;
+    _states = states;
+}
+
+ProtocolItem *EventBatchProtocolItem::release() {
+    QVector<EventEditBatch::State> current;
+    current.reserve(_states.size());
+    for (const EventEditBatch::State &state : _states) {
+        current.append(EventEditBatch::stateOf(state.event));
+    }
+    EventEditBatch::apply(_file, _states);
+    return new EventBatchProtocolItem(_file, current);
+}
+
+qint64 EventBatchProtocolItem::memoryCost() {
+    return sizeof(EventBatchProtocolItem) + qint64(_states.size()) * sizeof(EventEditBatch::State);
+}
@@ -0,0 +1,67 @@
+/*
+ * MidiEditor
+ * Copyright (C) 2010  Markus Schwenk
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENTBATCHPROTOCOLITEM_H_
+#define EVENTBATCHPROTOCOLITEM_H_
+
+// Project includes
+#include "ProtocolItem.h"
+#include "../midi/EventEditBatch.h"
+
+// Qt includes
+#include <QVector>
+
+// Forward declarations
+class MidiFile;
+
+/**
+ * \class EventBatchProtocolItem
+ *
+ * \brief Undo/redo action for the changes of an EventEditBatch.
+ *
+ * Stores the tick, note and velocity every event of the batch had before
+ * the change. Releasing the item restores these states and returns an item
+ * with the states from before the release.
+ */
+class EventBatchProtocolItem : public ProtocolItem {
+public:
+    /**
+     * \brief Creates an item restoring states in file.
+     */
+    EventBatchProtocolItem(MidiFile *file, const QVector<EventEditBatch::State> &states);
+
+    /**
+     * \brief Restores the stored states.
+     * \return The inverse EventBatchProtocolItem
+     */
+    ProtocolItem *release();
+
+    /**
+     * \brief Gets the approximate memory used by this item in bytes.
+     */
+    qint64 memoryCost();
+
+private:
+    /** \brief The file of the events */
+    MidiFile *_file;
+
+    /** \brief The states to restore */
+    QVector<EventEditBatch::State> _states;
+};
+
+#endif // EVENTBATCHPROTOCOLITEM_H_
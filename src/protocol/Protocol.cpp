@@ -23,8 +23,12 @@
 #include "../midi/MidiFile.h"
 #include "ProtocolStep.h"
 
+qint64 Protocol::_memoryBudget = qint64(256) * 1024 * 1024;
+
 Protocol::Protocol(MidiFile *f) {
     _currentStep = 0;
+    _revision = 0;
+    _undoMemory = 0;
 
     _file = f;
 
@@ -32,10 +36,19 @@ Protocol::Protocol(MidiFile *f) {
     _redoSteps = new QList<ProtocolStep *>;
 }
 
+Protocol::~Protocol() {
+    delete _currentStep;
+    qDeleteAll(*_undoSteps);
+    delete _undoSteps;
+    qDeleteAll(*_redoSteps);
+    delete _redoSteps;
+}
+
 void Protocol::enterUndoStep(ProtocolItem *item) {
     if (_currentStep) {
         _currentStep->addItem(item);
     }
+    _revision++;
 
     emit protocolChanged();
 }
@@ -47,7 +60,9 @@ void Protocol::undo(bool emitChanged) {
         _undoSteps->removeLast();
 
         // release it and copy it to the redo Stack
+        _undoMemory -= step->memoryCost();
         ProtocolStep *redoAction = step->releaseStep();
+        _revision++;
         if (redoAction) {
             _redoSteps->append(redoAction);
         }
@@ -70,8 +85,11 @@ void Protocol::redo(bool emitChanged) {
 
         // release it and copy it to the undoStack
         ProtocolStep *undoAction = step->releaseStep();
+        _revision++;
         if (undoAction) {
             _undoSteps->append(undoAction);
+            _undoMemory += undoAction->memoryCost();
+            trimUndoSteps();
         }
 
         // delete the old Step
@@ -100,6 +118,8 @@ void Protocol::endAction() {
     // only create the Step when it exists and its size is bigger 0
     if (_currentStep && _currentStep->items() > 0) {
         _undoSteps->append(_currentStep);
+        _undoMemory += _currentStep->memoryCost();
+        trimUndoSteps();
     }
 
     // the action is ended so there is no currentStep
@@ -145,6 +165,40 @@ void Protocol::goTo(ProtocolStep *toGo) {
     emit actionFinished();
 }
 
+int Protocol::revision() {
+    return _revision;
+}
+
+qint64 Protocol::undoMemory() {
+    return _undoMemory;
+}
+
+qint64 Protocol::memoryBudget() {
+    return _memoryBudget;
+}
+
+void Protocol::setMemoryBudget(qint64 bytes) {
+    _memoryBudget = qMax(qint64(0), bytes);
+}
+
+void Protocol::trimUndoSteps() {
+    if (_memoryBudget <= 0) {
+        return;
+    }
+    bool trimmed = false;
+    while (_undoMemory > _memoryBudget && _undoSteps->size() > 2) {
+        ProtocolStep *step = _undoSteps->takeAt(1);
+        _undoMemory -= step->memoryCost();
+        delete step;
+        trimmed = true;
+    }
+    if (trimmed) {
+        _undoSteps->first()->setDescription(tr("History truncated"));
+    }
+}
+
 void Protocol::addEmptyAction(QString name) {
-    _undoSteps->append(new ProtocolStep(name));
+    ProtocolStep *step = new ProtocolStep(name);
+    _undoSteps->append(step);
+    _undoMemory += step->memoryCost();
 }
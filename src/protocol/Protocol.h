@@ -43,6 +43,10 @@ class QImage;
  * the ProtocolStep onto the undoStack.
  *
  * Starting a new Action will clear the redo stack.
+ *
+ * The memory used by the undo stack is limited by memoryBudget(). When the
+ * budget is exceeded, the oldest ProtocolSteps are discarded (the first
+ * step, usually "File opened", and the latest step are always kept).
  */
 class Protocol : public QObject {
     Q_OBJECT
@@ -54,6 +58,11 @@ public:
      */
     Protocol(MidiFile *f);
 
+    /**
+     * \brief Deletes all undo and redo steps.
+     */
+    ~Protocol();
+
     /**
      * \brief Undoes the first ProtocolStep on the undo stack.
      * \param emitChanged If true, emits the protocolChanged() signal
@@ -127,6 +136,34 @@ public:
 		 */
     void addEmptyAction(QString name);
 
+    /**
+		 * \brief returns a counter that changes with every modification.
+		 *
+		 * The counter is increased for every entered ProtocolItem and every
+		 * undo/redo, so caches derived from the MidiFile can compare it to
+		 * find out whether they are outdated.
+		 */
+    int revision();
+
+    /**
+		 * \brief returns the approximate memory used by the undo stack in bytes.
+		 */
+    qint64 undoMemory();
+
+    /**
+		 * \brief returns the memory budget of the undo stack in bytes.
+		 *
+		 * 0 means that the undo stack is not limited.
+		 */
+    static qint64 memoryBudget();
+
+    /**
+		 * \brief sets the memory budget of the undo stack in bytes.
+		 *
+		 * The budget applies to all Protocols, 0 disables the limit.
+		 */
+    static void setMemoryBudget(qint64 bytes);
+
 signals:
     /**
 		 * \brief This Signal will be emitted when there has been an undo/redo
@@ -152,5 +189,29 @@ private:
 		 * \brief the MidiFile this Protocol is working with.
 		 */
     MidiFile *_file;
+
+    /**
+		 * \brief the modification counter returned by revision().
+		 */
+    int _revision;
+
+    /**
+		 * \brief the approximate memory used by the undo stack.
+		 */
+    qint64 _undoMemory;
+
+    /**
+		 * \brief the budget returned by memoryBudget().
+		 */
+    static qint64 _memoryBudget;
+
+    /**
+		 * \brief discards the oldest undo steps until the undo stack fits
+		 * into the memory budget.
+		 *
+		 * The first step is kept as the oldest reachable state and renamed,
+		 * since it no longer describes the opened or new file.
+		 */
+    void trimUndoSteps();
 };
 #endif // PROTOCOL_H_
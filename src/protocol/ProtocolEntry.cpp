@@ -45,5 +45,9 @@ ProtocolEntry *ProtocolEntry::copy() {
     return 0;
 }
 
+qint64 ProtocolEntry::memoryCost() {
+    return 128;
+}
+
 ProtocolEntry::~ProtocolEntry() {
 }
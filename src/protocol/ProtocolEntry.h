@@ -19,6 +19,9 @@
 #ifndef PROTOCOLENTRY_H_
 #define PROTOCOLENTRY_H_
 
+// Qt includes
+#include <QtGlobal>
+
 // Forward declarations
 class MidiFile;
 
@@ -91,6 +94,14 @@ public:
      * \return Pointer to the MidiFile containing this entry
      */
     virtual MidiFile *file();
+
+    /**
+     * \brief Gets the approximate memory used by this entry in bytes.
+     *
+     * Used to keep the undo history within Protocol::memoryBudget(). The
+     * default is an estimate for small objects like events and tracks.
+     */
+    virtual qint64 memoryCost();
 };
 
 #endif // PROTOCOLENTRY_H_
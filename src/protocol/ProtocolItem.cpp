@@ -26,6 +26,18 @@ ProtocolItem::ProtocolItem(ProtocolEntry *oldObj, ProtocolEntry *newObj) {
     _newObject = newObj;
 }
 
+ProtocolItem::ProtocolItem() {
+    _oldObject = 0;
+    _newObject = 0;
+}
+
+ProtocolItem::~ProtocolItem() {
+    // the old state is owned by the item until it has been released
+    if (_oldObject && !dynamic_cast<MidiTrack *>(_oldObject) && _oldObject->file() != _oldObject) {
+        delete _oldObject;
+    }
+}
+
 ProtocolItem *ProtocolItem::release() {
     ProtocolEntry *entry = _newObject->copy();
     _newObject->reloadState(_oldObject);
@@ -36,5 +48,10 @@ ProtocolItem *ProtocolItem::release() {
             delete _oldObject;
         }
     }
+    _oldObject = 0;
     return new ProtocolItem(entry, _newObject);
 }
+
+qint64 ProtocolItem::memoryCost() {
+    return sizeof(ProtocolItem) + (_oldObject ? _oldObject->memoryCost() : 0);
+}
@@ -19,6 +19,9 @@
 #ifndef PROTOCOLITEM_H_
 #define PROTOCOLITEM_H_
 
+// Qt includes
+#include <QtGlobal>
+
 // Forward declarations
 class ProtocolEntry;
 
@@ -48,6 +51,11 @@ public:
      */
     ProtocolItem(ProtocolEntry *oldObj, ProtocolEntry *newObj);
 
+    /**
+     * \brief Destroys the ProtocolItem.
+     */
+    virtual ~ProtocolItem();
+
     /**
      * \brief Releases the item by restoring the old state.
      * \return A new ProtocolItem with reversed state order for redo
@@ -56,7 +64,19 @@ public:
      * and returns a new ProtocolItem with the states reversed, enabling
      * redo functionality.
      */
-    ProtocolItem *release();
+    virtual ProtocolItem *release();
+
+    /**
+     * \brief Gets the approximate memory used by this item in bytes.
+     */
+    virtual qint64 memoryCost();
+
+protected:
+    /**
+     * \brief Creates an item without entries, for subclasses that store
+     * their own description of the change.
+     */
+    ProtocolItem();
 
 private:
     /** \brief The old and new states of the object */
@@ -26,6 +26,7 @@ ProtocolStep::ProtocolStep(QString description, QImage *img) {
     _stepDescription = description;
     _itemStack = new QStack<ProtocolItem *>;
     _image = img;
+    _memoryCost = -1;
 }
 
 ProtocolStep::~ProtocolStep() {
@@ -50,6 +51,16 @@ ProtocolStep *ProtocolStep::releaseStep() {
     return step;
 }
 
+qint64 ProtocolStep::memoryCost() {
+    if (_memoryCost < 0) {
+        _memoryCost = sizeof(ProtocolStep);
+        for (ProtocolItem *item: *_itemStack) {
+            _memoryCost += item->memoryCost();
+        }
+    }
+    return _memoryCost;
+}
+
 int ProtocolStep::items() {
     return _itemStack->size();
 }
@@ -58,6 +69,10 @@ QString ProtocolStep::description() {
     return _stepDescription;
 }
 
+void ProtocolStep::setDescription(QString description) {
+    _stepDescription = description;
+}
+
 QImage *ProtocolStep::image() {
     return _image;
 }
@@ -79,6 +79,12 @@ public:
      */
     QString description();
 
+    /**
+     * \brief Sets the step's description.
+     * \param description Human-readable description of this step
+     */
+    void setDescription(QString description);
+
     /**
      * \brief Gets the step's icon image.
      * \return Pointer to the QImage icon, or nullptr if none
@@ -95,6 +101,13 @@ public:
      */
     ProtocolStep *releaseStep();
 
+    /**
+     * \brief Gets the approximate memory used by the step's items in bytes.
+     *
+     * The value is computed once; items added afterwards are not counted.
+     */
+    qint64 memoryCost();
+
 private:
     /** \brief Human-readable description of this step */
     QString _stepDescription;
@@ -104,6 +117,9 @@ private:
 
     /** \brief Stack of ProtocolItems representing individual actions */
     QStack<ProtocolItem *> *_itemStack;
+
+    /** \brief Cached result of memoryCost(), -1 if not computed */
+    qint64 _memoryCost;
 };
 
 #endif // PROTOCOLSTEP_H_
@@ -31,6 +31,7 @@
 #include "../gui/Appearance.h"
 #include "../gui/ChannelVisibilityManager.h"
 #include "../midi/MidiChannel.h"
+#include "../midi/MidiEventArena.h"
 #include "../midi/MidiFile.h"
 #include "../midi/MidiPlayer.h"
 #include "../midi/MidiTrack.h"
@@ -187,11 +188,11 @@ void EventTool::changeTick(MidiEvent *event, int shiftX) {
     // with magnet: set to div value if pixel refers to this tick
     if (magnetEnabled()) {
         int newX = matrixWidget->xPosOfMs(newMs);
-        typedef QPair<int, int> TMPPair;
-        foreach(TMPPair p, matrixWidget->divs()) {
-            int xt = p.first;
-            if (newX == xt) {
-                tick = p.second;
+        QuantizationGrid grid = matrixWidget->divGrid();
+        int candidates[2] = {grid.floor(tick), grid.next(tick)};
+        for (int divTick : candidates) {
+            if (divTick >= 0 && matrixWidget->xPosOfMs(file()->msOfTick(divTick)) == newX) {
+                tick = divTick;
                 break;
             }
         }
@@ -204,6 +205,10 @@ void EventTool::copyAction() {
         // clear old copied Events
         copiedEvents->clear();
 
+        // the copies are kept on the heap, they outlive the file they were
+        // copied from
+        MidiEventArena::Scope heap(0);
+
         foreach(MidiEvent* event, Selection::instance()->selectedEvents()) {
             // add the current Event
             MidiEvent *ev = dynamic_cast<MidiEvent *>(event->copy());
@@ -254,6 +259,7 @@ void EventTool::pasteAction() {
     // TODO what happens to TempoEvents??
 
     // copy copied events to insert unique events
+    MidiEventArena::Scope arenaScope(currentFile()->eventArena());
     QList<MidiEvent *> copiedCopiedEvents;
     foreach(MidiEvent* event, *copiedEvents) {
         // add the current Event
@@ -409,14 +415,20 @@ int EventTool::rasteredX(int x, int *tick) {
 
     // Grid snapping logic
     if (_magnetMode & SNAP_GRID) {
-        typedef QPair<int, int> TMPPair;
-        foreach(TMPPair p, matrixWidget->divs()) {
-            int xt = p.first;
+        // only the divisions left and right of x can be the closest ones
+        QuantizationGrid grid = matrixWidget->divGrid();
+        int tickAtX = _currentFile->tick(matrixWidget->msOfXPos(x));
+        int candidates[2] = {grid.floor(tickAtX), grid.next(tickAtX)};
+        for (int divTick : candidates) {
+            if (divTick < 0) {
+                continue;
+            }
+            int xt = matrixWidget->xPosOfMs(_currentFile->msOfTick(divTick));
             int dist = std::abs(xt - x);
             if (dist < bestDist) {
                 bestDist = dist;
                 bestX = xt;
-                bestTick = p.second;
+                bestTick = divTick;
             }
         }
     }
@@ -434,11 +446,11 @@ int EventTool::rasteredX(int x, int *tick) {
             if (!ChannelVisibilityManager::instance().isChannelVisible(channel)) {
                 continue;
             }
-            QMultiMap<int, MidiEvent *> *map = _currentFile->channelEvents(channel);
+            EventMap *map = _currentFile->channelEvents(channel);
             if (!map) continue;
             
-            QMultiMap<int, MidiEvent *>::iterator it = map->lowerBound(searchStartTick);
-            QMultiMap<int, MidiEvent *>::iterator endIt = map->upperBound(searchEndTick);
+            EventMap::iterator it = map->lowerBound(searchStartTick);
+            EventMap::iterator endIt = map->upperBound(searchEndTick);
             
             while (it != map->end() && it != endIt) {
                 MidiEvent* ev = it.value();
@@ -793,12 +805,12 @@ void EventTool::recalculateExistingNotesAfterTempoChange(const QList<MidiEvent *
             continue;
         }
         
-        QMultiMap<int, MidiEvent *> *channelEvents = currentFile()->channelEvents(ch);
+        EventMap *channelEvents = currentFile()->channelEvents(ch);
         if (!channelEvents) {
             continue;
         }
         
-        QMultiMap<int, MidiEvent *>::iterator it = channelEvents->lowerBound(earliestChangePosition);
+        EventMap::iterator it = channelEvents->lowerBound(earliestChangePosition);
         while (it != channelEvents->end()) {
             MidiEvent *event = it.value();
             int originalPosition = it.key();
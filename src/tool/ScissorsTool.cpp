@@ -133,7 +133,7 @@ QList<NoteOnEvent *> ScissorsTool::findNotesToSplit(int splitTick) {
         MidiChannel *channel = file()->channel(ch);
         if (!channel->visible()) continue;
 
-        QMultiMap<int, MidiEvent *> *eventMap = channel->eventMap();
+        EventMap *eventMap = channel->eventMap();
         for (auto it = eventMap->begin(); it != eventMap->end(); ++it) {
             MidiEvent *event = it.value();
             if (event->track()->hidden()) continue;
@@ -267,9 +267,9 @@ bool SelectTool::release() {
             if (!ChannelVisibilityManager::instance().isChannelVisible(i)) {
                 continue;
             }
-            QMultiMap<int, MidiEvent *> *events = file()->channel(i)->eventMap();
-            QMultiMap<int, MidiEvent *>::iterator current = events->lowerBound(start);
-            QMultiMap<int, MidiEvent *>::iterator upperBound = events->upperBound(end);
+            EventMap *events = file()->channel(i)->eventMap();
+            EventMap::iterator current = events->lowerBound(start);
+            EventMap::iterator upperBound = events->upperBound(end);
             while (current != upperBound) {
                 MidiEvent *event = current.value();
                 if (!event->track()->hidden()) {
@@ -308,9 +308,9 @@ bool SelectTool::release() {
             if (!channel) continue;
             
             // Optimization: Only scan events up to the end of the selection range
-            QMultiMap<int, MidiEvent *> *events = channel->eventMap();
-            QMultiMap<int, MidiEvent *>::iterator it = events->begin();
-            QMultiMap<int, MidiEvent *>::iterator endIt = events->upperBound(finalEnd);
+            EventMap *events = channel->eventMap();
+            EventMap::iterator it = events->begin();
+            EventMap::iterator endIt = events->upperBound(finalEnd);
             
             while (it != endIt) {
                 MidiEvent *event = it.value();
@@ -506,9 +506,9 @@ void SelectTool::selectMeasure(int tick, Qt::KeyboardModifiers modifiers) {
         if (!channel) continue;
 
         // Optimization: Only scan events up to the end of the selection range
-        QMultiMap<int, MidiEvent *> *events = channel->eventMap();
-        QMultiMap<int, MidiEvent *>::iterator it = events->begin();
-        QMultiMap<int, MidiEvent *>::iterator endIt = events->upperBound(measureEndTick);
+        EventMap *events = channel->eventMap();
+        EventMap::iterator it = events->begin();
+        EventMap::iterator endIt = events->upperBound(measureEndTick);
 
         while (it != endIt) {
             MidiEvent *event = it.value();